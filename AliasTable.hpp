@@ -0,0 +1,200 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      AliasTable.hpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      Class definition for the AliasTable class, which draws from a discrete
+##      distribution in constant time using Walker's alias method (with Vose's
+##      linear-time construction).  Each of the n outcomes gets a bucket
+##      holding the probability of keeping that outcome and the "alias"
+##      outcome to use otherwise; a draw picks a bucket and then either keeps
+##      it or takes its alias, using one uniform deviate for both (or, for
+##      bulk drawing, 32 random bits: the high part of bits * n is the bucket
+##      and the low part is compared to a 32-bit keep threshold).
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#if     _MSC_VER > 1000
+#pragma once
+#endif
+
+#ifndef __GALOSH_ALIASTABLE_HPP__
+#define __GALOSH_ALIASTABLE_HPP__
+
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+namespace galosh {
+
+class AliasTable {
+public:
+  AliasTable ()
+  {
+    // Do nothing else.
+  } // <init>()
+
+  AliasTable (
+    double const * weights,
+    uint32_t const count
+  )
+  {
+    reinitialize( weights, count );
+  } // <init>( double const *, uint32_t const )
+
+  /**
+   * Build the table for the given (nonnegative, not necessarily normalized)
+   * weights.  Outcomes of weight 0 are never drawn.
+   */
+  void
+  reinitialize (
+    double const * weights,
+    uint32_t const count
+  )
+  {
+    double total = 0;
+    uint32_t first_positive = count;
+    for( uint32_t i = 0; i < count; i++ ) {
+      if( weights[ i ] < 0 ) {
+        throw std::string( "Can't draw from a distribution with a negative weight" );
+      }
+      total += weights[ i ];
+      if( ( first_positive == count ) && ( weights[ i ] > 0 ) ) {
+        first_positive = i;
+      }
+    }
+    if( !( total > 0 ) ) {
+      throw std::string( "Can't draw from a distribution with no mass" );
+    }
+
+    m_keepProbabilities.resize( count );
+    m_keepThresholds.resize( count );
+    m_aliases.resize( count );
+    std::vector<uint32_t> small, large;
+    small.reserve( count );
+    large.reserve( count );
+    for( uint32_t i = 0; i < count; i++ ) {
+      m_keepProbabilities[ i ] = ( weights[ i ] * count ) / total;
+      m_aliases[ i ] = i;
+      if( m_keepProbabilities[ i ] < 1.0 ) {
+        small.push_back( i );
+      } else {
+        large.push_back( i );
+      }
+    }
+    while( !small.empty() && !large.empty() ) {
+      const uint32_t less = small.back();
+      small.pop_back();
+      const uint32_t more = large.back();
+      m_aliases[ less ] = more;
+      m_keepProbabilities[ more ] -= ( 1.0 - m_keepProbabilities[ less ] );
+      if( m_keepProbabilities[ more ] < 1.0 ) {
+        large.pop_back();
+        small.push_back( more );
+      }
+    }
+    // Whatever is left is (up to rounding) exactly full, except that
+    // outcomes of weight 0 must never be kept.
+    for( size_t i = 0; i < large.size(); i++ ) {
+      m_keepProbabilities[ large[ i ] ] = 1.0;
+    }
+    for( size_t i = 0; i < small.size(); i++ ) {
+      if( weights[ small[ i ] ] > 0 ) {
+        m_keepProbabilities[ small[ i ] ] = 1.0;
+      } else {
+        m_keepProbabilities[ small[ i ] ] = 0.0;
+        m_aliases[ small[ i ] ] = first_positive;
+      }
+    }
+    for( uint32_t i = 0; i < count; i++ ) {
+      if( m_keepProbabilities[ i ] >= 1.0 ) {
+        m_keepThresholds[ i ] = 0xFFFFFFFFu;
+        m_aliases[ i ] = i; // So it doesn't matter that the threshold is short of 2^32.
+      } else {
+        m_keepThresholds[ i ] = static_cast<uint32_t>( m_keepProbabilities[ i ] * 4294967296.0 );
+      }
+    }
+  } // reinitialize( double const *, uint32_t const )
+
+  uint32_t
+  size () const
+  {
+    return m_aliases.size();
+  } // size() const
+
+  /**
+   * Draw an outcome using the uniform deviate u, in [ 0, 1 ).
+   */
+  inline uint32_t
+  draw (
+    double const u
+  ) const
+  {
+    const double scaled = u * m_aliases.size();
+    const uint32_t bucket = static_cast<uint32_t>( scaled );
+    return ( ( ( scaled - bucket ) < m_keepProbabilities[ bucket ] ) ? bucket : m_aliases[ bucket ] );
+  } // draw( double const ) const
+
+  /**
+   * Draw an outcome using 32 random bits.  This is integer-only, so loops of
+   * it vectorize; the keep probabilities are rounded down to multiples of
+   * 2^-32.
+   */
+  inline uint32_t
+  drawFromBits (
+    uint32_t const bits
+  ) const
+  {
+    const uint64_t scaled = static_cast<uint64_t>( bits ) * m_aliases.size();
+    const uint32_t bucket = static_cast<uint32_t>( scaled >> 32 );
+    return ( ( static_cast<uint32_t>( scaled ) < m_keepThresholds[ bucket ] ) ? bucket : m_aliases[ bucket ] );
+  } // drawFromBits( uint32_t const ) const
+
+  /**
+   * Draw an outcome using random.nextUniform().
+   */
+  template <typename RandomType>
+  inline uint32_t
+  draw (
+    RandomType & random
+  ) const
+  {
+    return draw( random.nextUniform() );
+  } // draw( RandomType & ) const
+
+protected:
+  std::vector<double> m_keepProbabilities;
+  /// The keep probabilities, in units of 2^-32.
+  std::vector<uint32_t> m_keepThresholds;
+  std::vector<uint32_t> m_aliases;
+}; // End class AliasTable
+
+} // End namespace galosh
+
+#endif // __GALOSH_ALIASTABLE_HPP__
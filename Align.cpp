@@ -7,7 +7,11 @@
 ##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
 ##  Description:
 ##      The align program.  It takes a profile and some unaligned sequences and
-##      computes the viterbi alignment.
+##      computes the viterbi alignment, or (with --mea) the maximum expected
+##      accuracy alignment, optionally with per-residue posterior confidences.
+##      The numeric types of the viterbi dp are chosen with --precision (see
+##      Precision.hpp); the posterior decoding has its own (scaled) dp, so
+##      --precision can't be used with --mea.
 ##
 #******************************************************************************
 #*
@@ -34,6 +38,11 @@
 #*****************************************************************************/
 
 #include "ScoreAndMaybeAlign.hpp"
+#include "Precision.hpp"
+
+#include <boost/program_options.hpp>
+
+namespace po = boost::program_options;
 
 #ifdef __HAVE_MUSCLE
 int g_argc;
@@ -42,25 +51,53 @@ char **g_argv;
 
 using namespace galosh;
 
+/**
+ * Aligns the sequences by viterbi and prints the alignments, with the
+ * numeric types chosen by dispatchPrecision(..).
+ */
+template <typename ResidueType,
+          typename SequenceResidueType>
+class AlignRunner {
+public:
+  typedef int result_type;
+
+  AlignRunner (
+    string const & profile_filename,
+    string const & fasta_filename,
+    uint32_t const sequence_count
+  ) :
+    m_profileFilename( profile_filename ),
+    m_fastaFilename( fasta_filename ),
+    m_sequenceCount( sequence_count )
+  {
+    // Do nothing else.
+  } // <init>( .. )
+
+  template <typename ProbabilityType,
+            typename ScoreType,
+            typename MatrixValueType>
+  int
+  run () const
+  {
+    ScoreAndMaybeAlign<ProbabilityType, ScoreType, MatrixValueType, ResidueType, SequenceResidueType> score_and_maybe_align;
+    score_and_maybe_align.score_and_maybe_align(
+      m_profileFilename,
+      m_fastaFilename,
+      m_sequenceCount,
+      true // use viterbi & make alignments
+    );
+    return 0;
+  } // run() const
+
+protected:
+  string m_profileFilename;
+  string m_fastaFilename;
+  uint32_t m_sequenceCount;
+}; // End class AlignRunner
+
 int
 main ( int const argc, char const ** argv )
 {
-  //typedef bfloat ProbabilityType;
-  //typedef logspace ProbabilityType;
-  //typedef floatrealspace ProbabilityType;
-  typedef doublerealspace ProbabilityType;
-  
-  typedef bfloat ScoreType; // Preferred
-  //typedef logspace ScoreType; // SLOWer than bfloat
-  //typedef realspace ScoreType; // Only for very few & small sequences
-  
-  // if using anything other than LogProbability for the MatrixValueType,
-  // params.useRabinerScaling should be set to true.
-  typedef bfloat MatrixValueType;
-  //typedef logspace MatrixValueType;
-  //typedef doublerealspace MatrixValueType;
-  //typedef floatrealspace MatrixValueType;
-
 #ifdef __PROFUSE_USE_AMINOS
   typedef seqan::AminoAcid20 ResidueType;
   typedef seqan::AminoAcid SequenceResidueType;
@@ -69,35 +106,97 @@ main ( int const argc, char const ** argv )
   typedef seqan::Iupac SequenceResidueType;
 #endif // __PROFUSE_USE_AMINOS .. else ..
 
-  string profile_filename;
-  string fasta_filename;
-  if( argc < 3 ) {
-    cout << "Usage: " << argv[ 0 ] << " <profile file> <fasta sequences file> [<number of sequences to use>]" << endl;
-    exit( 1 );
-  }
-  // else { // ( argc >= 3 )
-  // At least two arguments: profile filename and fasta filename
-  profile_filename = argv[ 1 ];
-  fasta_filename = argv[ 2 ];
-  uint32_t sequence_count = 0; // 0 means use all of the seqs in the fasta file.
-  if( argc > 3 ) {
-    try {
-      sequence_count = boost::lexical_cast<uint32_t>( argv[ 3 ] );
-    } catch( boost::bad_lexical_cast & ) {
-      std::cerr << "Unable to interpret the argument '" << argv[ 3 ] << "' as a count value for use as the number of sequences to use (or as 0 to that all sequences should be used)." << std::endl;
-      exit( 1 );
-    } // End try .. catch block for lexical_cast
-  } // End if argc > 3
+  try {
+    po::options_description visible( "Basic options" );
+    visible.add_options()
+      ( "help,h", "produce help message" )
+      ( "profile,p",
+        po::value<string>(),
+        "filename: where to find the input profile" )
+      ( "fasta,f",
+        po::value<string>(),
+        "input sequences, in (unaligned) Fasta format" )
+      ( "nseq,n",
+        po::value<uint32_t>()->default_value( 0 ),
+        "number of sequences to use (default is ALL)" )
+      ( "mea,m",
+        "compute maximum expected accuracy (posterior decoding) alignments instead of viterbi alignments" )
+      ( "confidence,c",
+        "with --mea, also show the posterior probability of each aligned residue ('0'-'9' for tenths, '*' for 0.95 and up); implies --mea" )
+      ( "threads,t",
+        po::value<uint32_t>()->default_value( 1 ),
+        "with --mea, the number of sequences to align at once (0 means one per core)" )
+      ( "checkpoint-interval",
+        po::value<uint32_t>()->default_value( 0 ),
+        "with --mea, keep every this-many-th forward row (0, the default, means the square root of the sequence length)" )
+      ( "isa",
+        po::value<string>()->default_value( "auto" ),
+        "with --mea, the instruction set of the dp kernels: auto (the default: the best that this CPU supports), scalar, sse4.2, avx2, or avx512; the results don't depend on it" )
+      ( "precision",
+        po::value<string>()->default_value( "bfloat" ),
+        "the viterbi dp matrix values (not with --mea): bfloat (the default; can't underflow), double, or float (fastest, with the rows scaled; enough for short sequences)" )
+      ;
 
-  ScoreAndMaybeAlign<ProbabilityType, ScoreType, MatrixValueType, ResidueType, SequenceResidueType> score_and_maybe_align;
+    po::positional_options_description p;
+    p.add( "profile", 1 );
+    p.add( "fasta", 1 );
+    p.add( "nseq", 1 );
 
-  score_and_maybe_align.score_and_maybe_align(
-    profile_filename,
-    fasta_filename,
-    sequence_count,
-    true // use viterbi & make alignments
-  );
+    po::variables_map vm;
+    store( po::command_line_parser( argc, argv ).options( visible ).positional( p ).run(), vm );
+    notify( vm );
 
-  return 0; // success
+#define USAGE() " " << argv[ 0 ] << " [options] <profile file> <fasta sequences file> [<number of sequences to use>]"
+
+    if( vm.count( "help" ) > 0 ) {
+      cout << "Usage: " << USAGE() << endl;
+      cout << visible << "\n";
+      return 0;
+    }
+    if( ( vm.count( "profile" ) == 0 ) || ( vm.count( "fasta" ) == 0 ) ) {
+      cout << "Usage: " << USAGE() << endl;
+      exit( 1 );
+    }
+
+    const string profile_filename = vm[ "profile" ].as<string>();
+    const string fasta_filename = vm[ "fasta" ].as<string>();
+    const uint32_t sequence_count = vm[ "nseq" ].as<uint32_t>(); // 0 means use all of the seqs in the fasta file.
+    const bool show_confidence = ( vm.count( "confidence" ) > 0 );
+    const bool use_mea = ( show_confidence || ( vm.count( "mea" ) > 0 ) );
+    galosh::selectKernelIsa( vm[ "isa" ].as<string>() );
+
+    if( use_mea ) {
+      if( !vm[ "precision" ].defaulted() ) {
+        cerr << "--precision can't be used with --mea, which aligns with its own (scaled) forward-backward." << endl;
+        exit( 1 );
+      }
+      // The posterior decoding doesn't use the dp's numeric types.
+      ScoreAndMaybeAlign<doublerealspace, bfloat, bfloat, ResidueType, SequenceResidueType> score_and_maybe_align;
+      score_and_maybe_align.posterior_align(
+        profile_filename,
+        fasta_filename,
+        sequence_count,
+        vm[ "threads" ].as<uint32_t>(),
+        vm[ "checkpoint-interval" ].as<uint32_t>(),
+        show_confidence
+      );
+      return 0;
+    }
+    return
+      dispatchPrecision(
+        parsePrecision( vm[ "precision" ].as<string>() ),
+        AlignRunner<ResidueType, SequenceResidueType>(
+          profile_filename,
+          fasta_filename,
+          sequence_count
+        )
+      );
+  } catch( std::exception& e ) { /// exceptions thrown by boost stuff
+    cerr << "error: " << e.what() << endl;
+    return 1;
+  } catch( string &err ) {      /// exceptions thrown by parallelFor, etc.
+    cerr << "error: " << err << endl;
+    return 1;
+  }
 } // main (..)
 
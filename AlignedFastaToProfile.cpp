@@ -38,17 +38,27 @@
 #include "Profile.hpp"
 #include "Fasta.hpp"
 #include "ProlificParameters.hpp" // for the parameters
+#include "AlignmentColumnCounts.hpp"
+#include "FastaRecordReader.hpp"
+#include "SequenceWeights.hpp"
 
+#include <fstream>
 #include <iostream>
+#include <string>
+#include <vector>
 
 #include <seqan/basic.h>
 #include <seqan/index.h>
 
+#include <boost/program_options.hpp>
+
 #ifdef __HAVE_MUSCLE
 int g_argc;
 char **g_argv;
 #endif // __HAVE_MUSCLE
 
+namespace po = boost::program_options;
+
 using namespace seqan;
 
 namespace galosh {
@@ -198,77 +208,359 @@ ungapFasta (
 
 /////////////
 /**
+ * Set the profile's parameters from the counts: the Match emission
+ * distributions from the residue counts, and (if estimate_transitions is
+ * true) the transition distributions from the transition counts, each with
+ * pseudocount added; otherwise the transitions are set from the parameters.
  */
 template <class ResidueType,
           class ProbabilityType,
           class ScoreType,
           class MatrixValueType,
-          class SequenceResidueType,
           class ProfileType>
 void
-gappedFastaAndConsensusToProfile (
+countsToProfile (
   typename ProlificParameters<ResidueType, ProbabilityType, ScoreType, MatrixValueType>::Parameters const & parameters,
-  galosh::Fasta<char> const & gapped_fasta,
-  seqan::String<char> const & gapped_consensus,
- ProfileType & profile
+  AlignmentColumnCounts<ResidueType> const & counts,
+  ProfileType & profile,
+  bool const estimate_transitions,
+  double const pseudocount
 )
 {
-  galosh::Sequence<SequenceResidueType> ungapped_consensus;
-  galosh::ungapSequence( gapped_consensus, ungapped_consensus );
-  // TODO: REMOVE
-  //std::cout << "gapped consensus: " << gapped_consensus << std::endl;
-  // TODO: REMOVE
-  //std::cout << "ungapped consensus: " << ungapped_consensus << std::endl;
-
-  uint32_t profile_length = ungapped_consensus.length();
-
   // Resize it, and reinitialize while we're at it.  Note that this will also
   // even() it.
-  profile.reinitialize( profile_length );
+  profile.reinitialize( counts.profileLength() );
 
-  // First calculate the default indel values.
-  // For now we just use these -- TODO: calculate these values from the input multiple alignmnt, too.
+  // First calculate the default indel values (used for any transition
+  // distribution that the alignment says nothing about).
   setTransitionsFromParameters<ResidueType, ProbabilityType, ScoreType, MatrixValueType, ProfileType>(
     parameters,
     profile
   );
+  if( estimate_transitions ) {
+    counts.toTransitionDistributions( profile, pseudocount );
+  }
   // Note Insertion distribution(s) are even now.  TODO: allow an option to set
   // the Insertion distribution to something else.
-  typedef typename seqan::Iterator< const seqan::String<char > >::Type TGappedConsensusIter;
-  const uint32_t num_seqs = gapped_fasta.size();
-
-  uint32_t prof_pos_i = 0; // Pos in profile.
-  uint32_t col_i = 0; // Pos in gapped_fasta seqs
-  uint32_t gaps_in_col_i;
-  TGappedConsensusIter it = seqan::begin( gapped_consensus );
-  TGappedConsensusIter it_end = seqan::end( gapped_consensus );
-  for( ; it != it_end; ++it, ++col_i ) {
-    if( seqan::value( it ) == '-' ) {
-      continue;
+
+  counts.toMatchDistributions( profile );
+} // countsToProfile( ProlificParameters::Parameters const &, AlignmentColumnCounts const &, ProfileType &, bool const, double const )
+
+/**
+ * Supplies the rows of an in-memory alignment to a visitor, as one batch.
+ */
+class FastaRows {
+public:
+  FastaRows (
+    galosh::Fasta<char> const & gapped_fasta,
+    uint32_t const alignment_length
+  ) :
+    m_rows( gapped_fasta.size() )
+  {
+    for( uint32_t seq_i = 0; seq_i < gapped_fasta.size(); seq_i++ ) {
+      if( seqan::length( gapped_fasta[ seq_i ] ) < alignment_length ) {
+        throw std::string( "The aligned sequence " ) + gapped_fasta.m_descriptions[ seq_i ] + " is shorter than the gapped consensus";
+      }
+      m_rows[ seq_i ] = &gapped_fasta[ seq_i ][ 0 ];
+    }
+  } // <init>( Fasta<char> const &, uint32_t const )
+
+  template <class VisitorType>
+  void
+  forEachBatch (
+    VisitorType & visitor
+  )
+  {
+    if( !m_rows.empty() ) {
+      visitor( &m_rows[ 0 ], m_rows.size() );
     }
-    gaps_in_col_i = 0;
-    profile[ prof_pos_i ][ Emission::Match ].zero();
-    for( uint32_t seq_i = 0; seq_i < num_seqs; seq_i++ ) {
-      if( gapped_fasta[ seq_i ][ col_i ] == '-' ) {
-        gaps_in_col_i += 1;
-      } else {
-        profile[ prof_pos_i ][ Emission::Match ][ ResidueType( gapped_fasta[ seq_i ][ col_i ] ) ] += 1;
+  } // forEachBatch( VisitorType & )
+
+protected:
+  std::vector<char const *> m_rows;
+}; // End class FastaRows
+
+/**
+ * Supplies the rows of an (Aligned Fasta) stream to a visitor, batch_size
+ * rows at a time, as they are read.  Each forEachBatch(..) is a pass over
+ * the whole stream, so for more than one pass it must be seekable.
+ */
+class StreamedFastaRows {
+public:
+  StreamedFastaRows (
+    std::istream & gapped_fasta_stream,
+    uint32_t const alignment_length,
+    uint32_t const batch_size
+  ) :
+    m_stream( gapped_fasta_stream ),
+    m_alignmentLength( alignment_length ),
+    m_batch( batch_size ),
+    m_rows( batch_size ),
+    m_passCount( 0 )
+  {
+    // Do nothing else.
+  } // <init>( istream &, uint32_t const, uint32_t const )
+
+  template <class VisitorType>
+  void
+  forEachBatch (
+    VisitorType & visitor
+  )
+  {
+    if( m_passCount++ > 0 ) {
+      m_stream.clear();
+      m_stream.seekg( 0 );
+      if( !m_stream.good() ) {
+        throw std::string( "Can't rewind the aligned Fasta input for another pass" );
+      }
+    }
+    FastaRecordReader reader( m_stream );
+    std::string name;
+    bool more_rows = true;
+    while( more_rows ) {
+      uint32_t batch_rows = 0;
+      while( batch_rows < m_batch.size() ) {
+        if( !reader.next( name, m_batch[ batch_rows ] ) ) {
+          more_rows = false;
+          break;
+        }
+        if( m_batch[ batch_rows ].length() < m_alignmentLength ) {
+          throw std::string( "The aligned sequence " ) + name + " is shorter than the gapped consensus";
+        }
+        m_rows[ batch_rows ] = m_batch[ batch_rows ].c_str();
+        batch_rows += 1;
+      }
+      if( batch_rows > 0 ) {
+        visitor( &m_rows[ 0 ], batch_rows );
       }
+    } // End while more_rows
+  } // forEachBatch( VisitorType & )
+
+protected:
+  std::istream & m_stream;
+  uint32_t m_alignmentLength;
+  std::vector<std::string> m_batch;
+  std::vector<char const *> m_rows;
+  uint32_t m_passCount;
+}; // End class StreamedFastaRows
+
+/**
+ * The first pass: counts the rows (unweighted), and adds them to the
+ * clusters, if any.
+ */
+template <class ResidueType>
+class CountRowsVisitor {
+public:
+  CountRowsVisitor (
+    AlignmentColumnCounts<ResidueType> & counts,
+    ClusterWeights<ResidueType> * clusters,
+    uint32_t const thread_count
+  ) :
+    m_counts( counts ),
+    m_clusters( clusters ),
+    m_threadCount( thread_count )
+  {
+    // Do nothing else.
+  } // <init>( .. )
+
+  void
+  operator() (
+    char const * const * rows,
+    size_t const row_count
+  )
+  {
+    m_counts.add( rows, row_count, m_threadCount );
+    if( m_clusters != NULL ) {
+      m_clusters->add( rows, row_count, m_threadCount );
     }
-    // TODO: REMOVE
-    //std::cout << "Prof pos " << prof_pos_i << ": totals are " << profile[ prof_pos_i ][ Emission::Match ] << "; there were " << gaps_in_col_i << " gaps." << std::endl;
-    if( gaps_in_col_i == num_seqs ) {
-      profile[ prof_pos_i ][ Emission::Match ].even();
+  } // operator()( char const * const *, size_t const )
+
+protected:
+  AlignmentColumnCounts<ResidueType> & m_counts;
+  ClusterWeights<ResidueType> * m_clusters;
+  uint32_t m_threadCount;
+}; // End class CountRowsVisitor
+
+/**
+ * The second pass (when weighting): computes the rows' weights, with
+ * whichever of pb_weights or clusters is not NULL, and counts the rows with
+ * them.
+ */
+template <class ResidueType>
+class CountWeightedRowsVisitor {
+public:
+  CountWeightedRowsVisitor (
+    AlignmentColumnCounts<ResidueType> & weighted_counts,
+    PositionBasedWeights<ResidueType> const * pb_weights,
+    ClusterWeights<ResidueType> * clusters,
+    uint32_t const thread_count
+  ) :
+    m_weightedCounts( weighted_counts ),
+    m_pbWeights( pb_weights ),
+    m_clusters( clusters ),
+    m_threadCount( thread_count ),
+    m_weightSum( 0 )
+  {
+    // Do nothing else.
+  } // <init>( .. )
+
+  void
+  operator() (
+    char const * const * rows,
+    size_t const row_count
+  )
+  {
+    if( m_pbWeights != NULL ) {
+      m_pbWeights->compute( rows, row_count, m_threadCount, m_weights );
     } else {
-      profile[ prof_pos_i ][ Emission::Match ] /=
-        ( double( num_seqs ) - gaps_in_col_i );
+      m_clusters->compute( rows, row_count, m_threadCount, m_weights );
     }
-    ++prof_pos_i;
-  } // End foreach gapped_consensus char..
+    for( size_t row_i = 0; row_i < row_count; row_i++ ) {
+      m_weightSum += m_weights[ row_i ];
+    }
+    m_weightedCounts.add( rows, row_count, m_threadCount, &m_weights[ 0 ] );
+  } // operator()( char const * const *, size_t const )
+
+  /**
+   * The total weight of the rows counted so far.
+   */
+  double
+  weightSum () const
+  {
+    return m_weightSum;
+  } // weightSum() const
+
+protected:
+  AlignmentColumnCounts<ResidueType> & m_weightedCounts;
+  PositionBasedWeights<ResidueType> const * m_pbWeights;
+  ClusterWeights<ResidueType> * m_clusters;
+  uint32_t m_threadCount;
+  double m_weightSum;
+  std::vector<double> m_weights;
+}; // End class CountWeightedRowsVisitor
+
+/////////////
+/**
+ * Build the profile from the gapped (aligned) rows supplied by rows (a
+ * FastaRows or StreamedFastaRows): the Match emission distribution at each
+ * position is the residue frequencies in the corresponding match column (a
+ * column at which the gapped consensus has a residue), as counted by
+ * AlignmentColumnCounts using thread_count threads.  With a weighting, rows
+ * are counted with their weights (scaled to add to the number of rows),
+ * which takes a second pass over the rows.  With cluster weighting, rows at
+ * least cluster_identity identical share a cluster (see ClusterWeights).
+ */
+template <class ResidueType,
+          class ProbabilityType,
+          class ScoreType,
+          class MatrixValueType,
+          class ProfileType,
+          class RowsType>
+void
+alignmentRowsToProfile (
+  typename ProlificParameters<ResidueType, ProbabilityType, ScoreType, MatrixValueType>::Parameters const & parameters,
+  RowsType & rows,
+  seqan::String<char> const & gapped_consensus,
+  ProfileType & profile,
+  uint32_t const thread_count,
+  SequenceWeighting::Index const weighting,
+  double const cluster_identity,
+  bool const estimate_transitions,
+  double const pseudocount
+)
+{
+  AlignmentColumnCounts<ResidueType> counts( gapped_consensus );
+  ClusterWeights<ResidueType> clusters( counts, cluster_identity );
+  CountRowsVisitor<ResidueType> count_rows( counts, ( ( weighting == SequenceWeighting::Cluster ) ? &clusters : NULL ), thread_count );
+  rows.forEachBatch( count_rows );
+  if( counts.rowCount() == 0 ) {
+    throw std::string( "No sequences were found in the aligned Fasta input" );
+  }
+  if( weighting == SequenceWeighting::None ) {
+    countsToProfile<ResidueType, ProbabilityType, ScoreType, MatrixValueType, ProfileType>( parameters, counts, profile, estimate_transitions, pseudocount );
+    return;
+  }
+
+  AlignmentColumnCounts<ResidueType> weighted_counts( gapped_consensus );
+  PositionBasedWeights<ResidueType> pb_weights( counts );
+  CountWeightedRowsVisitor<ResidueType> count_weighted_rows(
+    weighted_counts,
+    ( ( weighting == SequenceWeighting::PositionBased ) ? &pb_weights : NULL ),
+    ( ( weighting == SequenceWeighting::Cluster ) ? &clusters : NULL ),
+    thread_count
+  );
+  rows.forEachBatch( count_weighted_rows );
+  if( count_weighted_rows.weightSum() > 0 ) {
+    weighted_counts.scaleCounts( counts.rowCount() / count_weighted_rows.weightSum() );
+  }
+  countsToProfile<ResidueType, ProbabilityType, ScoreType, MatrixValueType, ProfileType>( parameters, weighted_counts, profile, estimate_transitions, pseudocount );
+} // alignmentRowsToProfile( ProlificParameters::Parameters const &, RowsType &, String<char> const &, ProfileType &, uint32_t const, SequenceWeighting::Index const, double const, bool const, double const )
+
+/////////////
+/**
+ * Build the profile from the gapped (aligned) sequences (see
+ * alignmentRowsToProfile(..)).
+ */
+template <class ResidueType,
+          class ProbabilityType,
+          class ScoreType,
+          class MatrixValueType,
+          class SequenceResidueType,
+          class ProfileType>
+void
+gappedFastaAndConsensusToProfile (
+  typename ProlificParameters<ResidueType, ProbabilityType, ScoreType, MatrixValueType>::Parameters const & parameters,
+  galosh::Fasta<char> const & gapped_fasta,
+  seqan::String<char> const & gapped_consensus,
+  ProfileType & profile,
+  uint32_t const thread_count,
+  SequenceWeighting::Index const weighting,
+  double const cluster_identity,
+  bool const estimate_transitions,
+  double const pseudocount
+)
+{
+  FastaRows rows( gapped_fasta, seqan::length( gapped_consensus ) );
+  alignmentRowsToProfile<ResidueType, ProbabilityType, ScoreType, MatrixValueType, ProfileType>( parameters, rows, gapped_consensus, profile, thread_count, weighting, cluster_identity, estimate_transitions, pseudocount );
+
+  // That's it.
+  return;
+} // gappedFastaAndConsensusToProfile( ProlificParameters::Parameters const &, Fasta<char> const &, String<char> const &, ProfileType &, uint32_t const, SequenceWeighting::Index const, double const, bool const, double const )
+
+/////////////
+/**
+ * Like gappedFastaAndConsensusToProfile, but the aligned sequences are read
+ * from the given (Aligned Fasta) stream as they are counted, batch_size rows
+ * at a time, so memory use doesn't depend on the number of rows.  With a
+ * weighting, the stream is read twice.  Cluster weighting here clusters only
+ * identical rows, keeping a 16-byte hash per distinct row (near-duplicate
+ * clusters would keep a copy of a row per cluster).
+ */
+template <class ResidueType,
+          class ProbabilityType,
+          class ScoreType,
+          class MatrixValueType,
+          class SequenceResidueType,
+          class ProfileType>
+void
+gappedFastaStreamAndConsensusToProfile (
+  typename ProlificParameters<ResidueType, ProbabilityType, ScoreType, MatrixValueType>::Parameters const & parameters,
+  std::istream & gapped_fasta_stream,
+  seqan::String<char> const & gapped_consensus,
+  ProfileType & profile,
+  uint32_t const thread_count,
+  uint32_t const batch_size,
+  SequenceWeighting::Index const weighting,
+  bool const estimate_transitions,
+  double const pseudocount
+)
+{
+  StreamedFastaRows rows( gapped_fasta_stream, seqan::length( gapped_consensus ), batch_size );
+  alignmentRowsToProfile<ResidueType, ProbabilityType, ScoreType, MatrixValueType, ProfileType>( parameters, rows, gapped_consensus, profile, thread_count, weighting, 1.0, estimate_transitions, pseudocount );
 
   // That's it.
   return;
-} // gappedFastaAndConsensusToProfile( ProlificParameters::Parameters const &, Fasta<char> const &, String<char> const &, ProfileType & )
+} // gappedFastaStreamAndConsensusToProfile( ProlificParameters::Parameters const &, istream &, String<char> const &, ProfileType &, uint32_t const, uint32_t const, SequenceWeighting::Index const, bool const, double const )
 
 } // End namespace galosh
 
@@ -283,69 +575,166 @@ main ( int const argc, char const ** argv )
   typedef seqan::Iupac SequenceResidueType;
 #endif // __PROFUSE_USE_AMINOS .. else ..
 
-  if( argc < 3 ) {
-    cout << "Usage: " << argv[ 0 ] << " <input (Aligned Fasta) filename> <consensus (Aligned Fasta) filename> [<output (galosh Profile) filename>]" << endl;
-    cout << "Note that only the first sequence in the consensus file will be used, and only its gaps matter: it must be the same length as the aligned strings in the first argument, and its gaps will determine which columns of the alignment are to be used to construct the profile (ie all non-gap positions of the 'consensus')." << endl;
-    exit( 1 );
-  }
-  const bool be_verbose = true; //( argc > 4 );
-  if( be_verbose ) {
-    cout << "Reading multiple alignment from Aligned Fasta file '" << argv[ 1 ] << "'" << endl;
-  }
-  galosh::Fasta<char> gapped_fasta;
-  gapped_fasta.fromFile( argv[ 1 ] );
-  if( gapped_fasta.size() == 0 ) {
-    cout << "No sequences were found in the Fasta file '" << argv[ 1 ] << "'" << endl;
-    return 1;
-  }
-  if( be_verbose ) {
-    cout << "Reading consensus from Aligned Fasta file '" << argv[ 2 ] << "'" << endl;
-  }
-  galosh::Fasta<char> gapped_consensus_fasta;
-  gapped_consensus_fasta.fromFile( argv[ 2 ] );
-  if( gapped_consensus_fasta.size() == 0 ) {
-    cout << "No sequences were found in the consensus Fasta file '" << argv[ 2 ] << "'" << endl;
-    return 1;
-  } else if( gapped_consensus_fasta.size() > 1 ) {
+  try {
+    po::options_description visible( "Basic options" );
+    visible.add_options()
+      ( "help,h", "produce help message" )
+      ( "alignment,a",
+        po::value<string>(),
+        "filename: the (Aligned Fasta) multiple alignment" )
+      ( "consensus,c",
+        po::value<string>(),
+        "filename: the (Aligned Fasta) gapped consensus; only its first sequence is used" )
+      ( "output,o",
+        po::value<string>(),
+        "filename: where to write the (galosh Profile) profile (default: standard output)" )
+      ( "threads,t",
+        po::value<uint32_t>()->default_value( 0 ),
+        "number of threads for counting (0, the default, means one per core); the profile doesn't depend on it" )
+      ( "streaming,S",
+        "count the aligned sequences as they are read, instead of reading them all first; memory use then doesn't depend on the number of sequences, except that --weights cluster keeps a 16-byte hash per distinct sequence (and --cluster-identity must be 1)" )
+      ( "batch-size",
+        po::value<uint32_t>()->default_value( 4096 ),
+        "with --streaming, number of aligned sequences to read before counting them (in parallel)" )
+      ( "weights,w",
+        po::value<string>()->default_value( "none" ),
+        "sequence weighting, to down-weight redundant sequences: none, henikoff (position-based), or cluster (each cluster of near-identical sequences, see --cluster-identity, shares one weight)" )
+      ( "cluster-identity",
+        po::value<double>()->default_value( 1.0 ),
+        "with --weights cluster, the fraction of the match columns with a residue in either sequence at which two sequences must agree to share a cluster (1, the default, means identical sequences only)" )
+      ( "estimate-transitions,e",
+        "estimate the transition parameters from the alignment's gaps, instead of using the defaults" )
+      ( "pseudocount",
+        po::value<double>()->default_value( 1.0 ),
+        "with --estimate-transitions, added to each transition count" )
+      ;
+
+    po::positional_options_description p;
+    p.add( "alignment", 1 );
+    p.add( "consensus", 1 );
+    p.add( "output", 1 );
+
+    po::variables_map vm;
+    store( po::command_line_parser( argc, argv ).options( visible ).positional( p ).run(), vm );
+    notify( vm );
+
+    if( ( vm.count( "help" ) > 0 ) || ( vm.count( "alignment" ) == 0 ) || ( vm.count( "consensus" ) == 0 ) ) {
+      cout << "Usage: " << argv[ 0 ] << " [options] <input (Aligned Fasta) filename> <consensus (Aligned Fasta) filename> [<output (galosh Profile) filename>]" << endl;
+      cout << "Note that only the first sequence in the consensus file will be used, and only its gaps matter: it must be the same length as the aligned strings in the first argument, and its gaps will determine which columns of the alignment are to be used to construct the profile (ie all non-gap positions of the 'consensus')." << endl;
+      if( vm.count( "help" ) > 0 ) {
+        cout << visible << "\n";
+        return 0;
+      }
+      exit( 1 );
+    }
+    const string alignment_filename = vm[ "alignment" ].as<string>();
+    const string consensus_filename = vm[ "consensus" ].as<string>();
+    const uint32_t thread_count = vm[ "threads" ].as<uint32_t>();
+    const bool use_streaming = ( vm.count( "streaming" ) > 0 );
+    const uint32_t batch_size = std::max( static_cast<uint32_t>( 1 ), vm[ "batch-size" ].as<uint32_t>() );
+    const bool estimate_transitions = ( vm.count( "estimate-transitions" ) > 0 );
+    const double pseudocount = vm[ "pseudocount" ].as<double>();
+    const double cluster_identity = vm[ "cluster-identity" ].as<double>();
+    galosh::SequenceWeighting::Index weighting;
+    const string weights_name = vm[ "weights" ].as<string>();
+    if( weights_name == "none" ) {
+      weighting = galosh::SequenceWeighting::None;
+    } else if( weights_name == "henikoff" ) {
+      weighting = galosh::SequenceWeighting::PositionBased;
+    } else if( weights_name == "cluster" ) {
+      weighting = galosh::SequenceWeighting::Cluster;
+    } else {
+      cerr << "Unknown sequence weighting '" << weights_name << "': use none, henikoff, or cluster." << endl;
+      exit( 1 );
+    }
+    if( pseudocount < 0 ) {
+      cerr << "The pseudocount must not be negative." << endl;
+      exit( 1 );
+    }
+    if( !( ( cluster_identity > 0 ) && ( cluster_identity <= 1 ) ) ) {
+      cerr << "The cluster identity must be greater than 0 and at most 1." << endl;
+      exit( 1 );
+    }
+    if( use_streaming && ( cluster_identity < 1 ) ) {
+      cerr << "--cluster-identity below 1 can't be used with --streaming: its clusters keep a copy of a sequence each." << endl;
+      exit( 1 );
+    }
+
+    const bool be_verbose = true; //( argc > 4 );
     if( be_verbose ) {
-      cout << "WARNING: Using only the first sequence in the given consensus Fasta file." << endl;
+      cout << "Reading consensus from Aligned Fasta file '" << consensus_filename << "'" << endl;
     }
-  }
-  if( be_verbose ) {
-    cout << "\tgot:" << std::endl;
-    cout << gapped_consensus_fasta[ 0 ];
-    cout << endl;
-  }
+    galosh::Fasta<char> gapped_consensus_fasta;
+    gapped_consensus_fasta.fromFile( consensus_filename );
+    if( gapped_consensus_fasta.size() == 0 ) {
+      cout << "No sequences were found in the consensus Fasta file '" << consensus_filename << "'" << endl;
+      return 1;
+    } else if( gapped_consensus_fasta.size() > 1 ) {
+      if( be_verbose ) {
+        cout << "WARNING: Using only the first sequence in the given consensus Fasta file." << endl;
+      }
+    }
+    if( be_verbose ) {
+      cout << "\tgot:" << std::endl;
+      cout << gapped_consensus_fasta[ 0 ];
+      cout << endl;
+    }
+
+    // The parameters
+    // TODO: Let user choose some from command line.
+    galosh::ProlificParameters<ResidueType, floatrealspace, floatrealspace, floatrealspace>::Parameters parameters;
+
+    seqan::String<char> gapped_consensus( *( dynamic_cast<const seqan::String<char> * const>( & gapped_consensus_fasta[ 0 ] ) ) );
+    galosh::ProfileTreeRoot<ResidueType, floatrealspace> profile;
+    if( use_streaming ) {
+      if( be_verbose ) {
+        cout << "Counting the multiple alignment as it is read from Aligned Fasta file '" << alignment_filename << "'" << endl;
+      }
+      std::ifstream alignment_stream( alignment_filename.c_str() );
+      if( !alignment_stream.good() ) {
+        cerr << "The Aligned Fasta file '" << alignment_filename << "' could not be opened." << endl;
+        exit( 1 );
+      }
+      galosh::gappedFastaStreamAndConsensusToProfile<ResidueType, floatrealspace, floatrealspace, floatrealspace, SequenceResidueType, galosh::ProfileTreeRoot<ResidueType, floatrealspace> >( parameters, alignment_stream, gapped_consensus, profile, thread_count, batch_size, weighting, estimate_transitions, pseudocount );
+    } else {
+      if( be_verbose ) {
+        cout << "Reading multiple alignment from Aligned Fasta file '" << alignment_filename << "'" << endl;
+      }
+      galosh::Fasta<char> gapped_fasta;
+      gapped_fasta.fromFile( alignment_filename );
+      if( gapped_fasta.size() == 0 ) {
+        cout << "No sequences were found in the Fasta file '" << alignment_filename << "'" << endl;
+        return 1;
+      }
+      galosh::gappedFastaAndConsensusToProfile<ResidueType, floatrealspace, floatrealspace, floatrealspace, SequenceResidueType, galosh::ProfileTreeRoot<ResidueType, floatrealspace> >( parameters, gapped_fasta, gapped_consensus, profile, thread_count, weighting, cluster_identity, estimate_transitions, pseudocount );
+    } // End if use_streaming .. else ..
 
-  // The parameters
-  // TODO: Let user choose some from command line.
-  galosh::ProlificParameters<ResidueType, floatrealspace, floatrealspace, floatrealspace>::Parameters parameters;
-
-  // Create ungapped consensus
-  seqan::String<char> gapped_consensus( *( dynamic_cast<const seqan::String<char> * const>( & gapped_consensus_fasta[ 0 ] ) ) );
-  galosh::ProfileTreeRoot<ResidueType, floatrealspace> profile;
-  galosh::gappedFastaAndConsensusToProfile<ResidueType, floatrealspace, floatrealspace, floatrealspace, SequenceResidueType, galosh::ProfileTreeRoot<ResidueType, floatrealspace> >( parameters, gapped_fasta, gapped_consensus, profile );
-
-  // TODO: walk through consensus, and at non-gap positions, calculate frequencies.  Also can calculate gap open and extend probs..
-
- if( argc > 3 ) {
-   if( be_verbose ) {
-     cout << "Writing Profile to file '" << argv[ 3 ] << "'" << endl;
-   }
-   std::ofstream profile_stream( argv[ 3 ] );
-   assert( profile_stream.good() );
-   profile_stream << profile;
-   profile_stream.close();
-   if( be_verbose ) {
-     cout << "\tdone." << endl;
-   }
- } else {
-   if( be_verbose ) {
-     cout << "Profile is:" << endl;
-   }
-   cout << profile;
-   cout << endl;
- }
+    if( vm.count( "output" ) ) {
+      const string profile_filename = vm[ "output" ].as<string>();
+      if( be_verbose ) {
+        cout << "Writing Profile to file '" << profile_filename << "'" << endl;
+      }
+      std::ofstream profile_stream( profile_filename.c_str() );
+      assert( profile_stream.good() );
+      profile_stream << profile;
+      profile_stream.close();
+      if( be_verbose ) {
+        cout << "\tdone." << endl;
+      }
+    } else {
+      if( be_verbose ) {
+        cout << "Profile is:" << endl;
+      }
+      cout << profile;
+      cout << endl;
+    }
+  } catch( std::exception& e ) { /// exceptions thrown by boost stuff
+    cerr << "error: " << e.what() << endl;
+    return 1;
+  } catch( string &err ) {      /// exceptions thrown by AlignmentColumnCounts, parallelFor, etc.
+    cerr << "error: " << err << endl;
+    return 1;
+  }
 
   exit( 0 );
 } // main (..)
@@ -0,0 +1,537 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      AlignmentColumnCounts.hpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      Class definition for the AlignmentColumnCounts class, which counts the
+##      residues (and gaps) in the match columns of a multiple alignment (the
+##      columns at which a gapped consensus has a residue), for building a
+##      profile from the alignment (see AlignedFastaToProfile.cpp).
+##
+##      Rows are counted a tile at a time: a tile of TileRows rows by
+##      BlockColumns match columns is transposed into column-major residue
+##      codes (each character translated through a lookup table), and then
+##      each column of the tile is counted with one simple loop per code, over
+##      contiguous bytes, that the compiler can vectorize.  The blocks of
+##      match columns are counted by any number of threads; each block's
+##      counts are written by only one thread, so the counts don't depend on
+##      the number of threads.
+##
+##      Rows may be given weights (see SequenceWeights.hpp), in which case each
+##      row adds its weight, rather than 1, to the counts.  Unweighted counts
+##      are whole numbers, so they are exact.
+##
+##      The transitions of each row's path through the profile (implied by
+##      its gaps: a residue in a match column is a Match, a gap there is a
+##      Deletion, and a residue in any other column is an Insertion, or a
+##      pre- or post-align insertion if it precedes the first or follows the
+##      last match column) are counted too, for estimating the (position
+##      independent) transition parameters.  Insertion -> Deletion and
+##      Deletion -> Insertion, which profiles don't allow, are not counted.
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#if     _MSC_VER > 1000
+#pragma once
+#endif
+
+#ifndef __GALOSH_ALIGNMENTCOLUMNCOUNTS_HPP__
+#define __GALOSH_ALIGNMENTCOLUMNCOUNTS_HPP__
+
+#include "ParallelFor.hpp"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+#include <seqan/basic.h>
+
+namespace galosh {
+
+template <typename ResidueType>
+class AlignmentColumnCounts {
+public:
+  enum { AlphabetSize = seqan::ValueSize<ResidueType>::VALUE };
+  /// Residues are coded by their ordinal values; gaps get the next code.
+  enum { GapCode = AlphabetSize, CodeCount = ( AlphabetSize + 1 ) };
+  /// The tile dimensions (a tile of codes is TileRows * BlockColumns bytes).
+  enum { TileRows = 512, BlockColumns = 64 };
+
+  /// The counted transitions.
+  enum TransitionIndex {
+    PreAlignToPreAlign,
+    PreAlignToBegin,
+    BeginToMatch,
+    BeginToDeletion,
+    MatchToMatch,
+    MatchToInsertion,
+    MatchToDeletion,
+    InsertionToMatch,
+    InsertionToInsertion,
+    DeletionToMatch,
+    DeletionToDeletion,
+    PostAlignToPostAlign,
+    PostAlignToTerminal,
+    TransitionCount
+  };
+
+  struct TransitionCounts {
+    double m_counts[ TransitionCount ];
+
+    TransitionCounts ()
+    {
+      std::fill( m_counts, m_counts + TransitionCount, 0.0 );
+    } // <init>()
+
+    TransitionCounts &
+    operator+= (
+      TransitionCounts const & other
+    )
+    {
+      for( uint32_t trans_i = 0; trans_i < TransitionCount; trans_i++ ) {
+        m_counts[ trans_i ] += other.m_counts[ trans_i ];
+      }
+      return *this;
+    } // operator+=( TransitionCounts const & )
+  }; // End inner struct TransitionCounts
+
+  /**
+   * The match columns are the columns at which gapped_consensus has a
+   * residue (anything but '-').  Throws a string if there are none, since
+   * then there is no profile to count.
+   */
+  template <typename GappedSequenceType>
+  AlignmentColumnCounts (
+    GappedSequenceType const & gapped_consensus
+  ) :
+    m_alignmentLength( seqan::length( gapped_consensus ) ),
+    m_rowCount( 0 )
+  {
+    m_isMatchColumn.assign( m_alignmentLength, 0 );
+    for( uint32_t col_i = 0; col_i < m_alignmentLength; col_i++ ) {
+      if( gapped_consensus[ col_i ] != '-' ) {
+        m_matchColumns.push_back( col_i );
+        m_isMatchColumn[ col_i ] = 1;
+      }
+    }
+    if( m_matchColumns.empty() ) {
+      throw std::string( "The gapped consensus has no match columns (it is empty, or all gaps)" );
+    }
+    for( uint32_t char_i = 0; char_i < 256; char_i++ ) {
+      m_codes[ char_i ] =
+        ( ( char_i == static_cast<uint8_t>( '-' ) ) ? static_cast<uint8_t>( GapCode ) :
+          static_cast<uint8_t>( seqan::ordValue( ResidueType( static_cast<char>( char_i ) ) ) ) );
+    }
+    m_counts.assign( m_matchColumns.size() * CodeCount, 0.0 );
+  } // <init>( GappedSequenceType const & )
+
+  /**
+   * The number of columns of the alignment (and of the gapped consensus).
+   */
+  uint32_t
+  alignmentLength () const
+  {
+    return m_alignmentLength;
+  } // alignmentLength() const
+
+  /**
+   * The number of match columns (the length of the profile).
+   */
+  uint32_t
+  profileLength () const
+  {
+    return m_matchColumns.size();
+  } // profileLength() const
+
+  /**
+   * The alignment column of each match column.
+   */
+  std::vector<uint32_t> const &
+  matchColumns () const
+  {
+    return m_matchColumns;
+  } // matchColumns() const
+
+  /**
+   * The code (a residue's ordinal value, or GapCode) of the given character.
+   */
+  uint8_t
+  code (
+    char const c
+  ) const
+  {
+    return m_codes[ static_cast<uint8_t>( c ) ];
+  } // code( char const ) const
+
+  /**
+   * The number of rows counted so far.
+   */
+  uint64_t
+  rowCount () const
+  {
+    return m_rowCount;
+  } // rowCount() const
+
+  /**
+   * The count (or total weight) of the given code (a residue's ordinal
+   * value, or GapCode) in the given match column.
+   */
+  double
+  count (
+    uint32_t const pos_i,
+    uint32_t const code
+  ) const
+  {
+    return m_counts[ ( pos_i * CodeCount ) + code ];
+  } // count( uint32_t const, uint32_t const ) const
+
+  /**
+   * The transition counts, over all of the rows counted so far.
+   */
+  TransitionCounts const &
+  transitionCounts () const
+  {
+    return m_transitionCounts;
+  } // transitionCounts() const
+
+  /**
+   * Add the counts of the given rows (each at least alignmentLength()
+   * characters long), using thread_count threads (0 means one per core).
+   * If weights is not NULL, it holds the rows' weights.  This may be called
+   * any number of times, for successive sets of rows.
+   */
+  void
+  add (
+    char const * const * rows,
+    size_t const row_count,
+    uint32_t const thread_count,
+    double const * weights = NULL
+  )
+  {
+    const size_t block_count = ( ( m_matchColumns.size() + BlockColumns - 1 ) / BlockColumns );
+    parallelFor( block_count, thread_count, CountBlockBody( *this, rows, row_count, weights ) );
+    std::vector<TransitionCounts> tile_transitions( ( row_count + TileRows - 1 ) / TileRows );
+    parallelFor( tile_transitions.size(), thread_count, CountTransitionsBody( *this, rows, row_count, weights, tile_transitions ) );
+    for( size_t tile_i = 0; tile_i < tile_transitions.size(); tile_i++ ) {
+      m_transitionCounts += tile_transitions[ tile_i ];
+    }
+    m_rowCount += row_count;
+  } // add( char const * const *, size_t const, uint32_t const, double const * )
+
+  /**
+   * Multiply all of the counts (residue and transition) by factor.
+   */
+  void
+  scaleCounts (
+    double const factor
+  )
+  {
+    for( size_t count_i = 0; count_i < m_counts.size(); count_i++ ) {
+      m_counts[ count_i ] *= factor;
+    }
+    for( uint32_t trans_i = 0; trans_i < TransitionCount; trans_i++ ) {
+      m_transitionCounts.m_counts[ trans_i ] *= factor;
+    }
+  } // scaleCounts( double const )
+
+  /**
+   * Set the Match emission distributions of the given profile (which must
+   * already be profileLength() long) to the residue frequencies among the
+   * non-gap characters of each match column (or to even, for an all-gap
+   * column).
+   */
+  template <typename ProfileType>
+  void
+  toMatchDistributions (
+    ProfileType & profile
+  ) const
+  {
+    for( uint32_t pos_i = 0; pos_i < m_matchColumns.size(); pos_i++ ) {
+      profile[ pos_i ][ Emission::Match ].zero();
+      double residue_count = 0;
+      for( uint32_t res_i = 0; res_i < AlphabetSize; res_i++ ) {
+        const double res_count = count( pos_i, res_i );
+        if( res_count > 0 ) {
+          profile[ pos_i ][ Emission::Match ][ ResidueType( res_i ) ] = res_count;
+          residue_count += res_count;
+        }
+      }
+      if( residue_count == 0 ) {
+        profile[ pos_i ][ Emission::Match ].even();
+      } else {
+        profile[ pos_i ][ Emission::Match ] /= residue_count;
+      }
+    } // End foreach pos_i
+  } // toMatchDistributions( ProfileType & ) const
+
+  /**
+   * Set the transition distributions of the given profile to the transition
+   * frequencies, after adding pseudocount to each count.  Distributions with
+   * no counts at all are left alone.
+   */
+  template <typename ProfileType>
+  void
+  toTransitionDistributions (
+    ProfileType & profile,
+    double const pseudocount
+  ) const
+  {
+    double const * counts = m_transitionCounts.m_counts;
+    double total;
+
+    total = ( counts[ PreAlignToPreAlign ] + counts[ PreAlignToBegin ] );
+    if( total > 0 ) {
+      total += ( 2 * pseudocount );
+      profile[ Transition::fromPreAlign ][ TransitionFromPreAlign::toPreAlign ] = ( ( counts[ PreAlignToPreAlign ] + pseudocount ) / total );
+      profile[ Transition::fromPreAlign ][ TransitionFromPreAlign::toBegin ] = ( ( counts[ PreAlignToBegin ] + pseudocount ) / total );
+    }
+    total = ( counts[ BeginToMatch ] + counts[ BeginToDeletion ] );
+    if( total > 0 ) {
+      total += ( 2 * pseudocount );
+      profile[ Transition::fromBegin ][ TransitionFromBegin::toMatch ] = ( ( counts[ BeginToMatch ] + pseudocount ) / total );
+      profile[ Transition::fromBegin ][ TransitionFromBegin::toDeletion ] = ( ( counts[ BeginToDeletion ] + pseudocount ) / total );
+    }
+    total = ( counts[ MatchToMatch ] + counts[ MatchToInsertion ] + counts[ MatchToDeletion ] );
+    if( total > 0 ) {
+      total += ( 3 * pseudocount );
+      profile[ Transition::fromMatch ][ TransitionFromMatch::toMatch ] = ( ( counts[ MatchToMatch ] + pseudocount ) / total );
+      profile[ Transition::fromMatch ][ TransitionFromMatch::toInsertion ] = ( ( counts[ MatchToInsertion ] + pseudocount ) / total );
+      profile[ Transition::fromMatch ][ TransitionFromMatch::toDeletion ] = ( ( counts[ MatchToDeletion ] + pseudocount ) / total );
+    }
+    total = ( counts[ InsertionToMatch ] + counts[ InsertionToInsertion ] );
+    if( total > 0 ) {
+      total += ( 2 * pseudocount );
+      profile[ Transition::fromInsertion ][ TransitionFromInsertion::toMatch ] = ( ( counts[ InsertionToMatch ] + pseudocount ) / total );
+      profile[ Transition::fromInsertion ][ TransitionFromInsertion::toInsertion ] = ( ( counts[ InsertionToInsertion ] + pseudocount ) / total );
+    }
+    total = ( counts[ DeletionToMatch ] + counts[ DeletionToDeletion ] );
+    if( total > 0 ) {
+      total += ( 2 * pseudocount );
+      profile[ Transition::fromDeletion ][ TransitionFromDeletion::toMatch ] = ( ( counts[ DeletionToMatch ] + pseudocount ) / total );
+      profile[ Transition::fromDeletion ][ TransitionFromDeletion::toDeletion ] = ( ( counts[ DeletionToDeletion ] + pseudocount ) / total );
+    }
+    total = ( counts[ PostAlignToPostAlign ] + counts[ PostAlignToTerminal ] );
+    if( total > 0 ) {
+      total += ( 2 * pseudocount );
+      profile[ Transition::fromPostAlign ][ TransitionFromPostAlign::toPostAlign ] = ( ( counts[ PostAlignToPostAlign ] + pseudocount ) / total );
+      profile[ Transition::fromPostAlign ][ TransitionFromPostAlign::toTerminal ] = ( ( counts[ PostAlignToTerminal ] + pseudocount ) / total );
+    }
+  } // toTransitionDistributions( ProfileType &, double const ) const
+
+protected:
+  /**
+   * The parallelFor body: counts the rows in match column block block_i.
+   */
+  class CountBlockBody {
+  public:
+    CountBlockBody (
+      AlignmentColumnCounts & counts,
+      char const * const * rows,
+      size_t const row_count,
+      double const * weights
+    ) :
+      m_counts( counts ),
+      m_rows( rows ),
+      m_rowCount( row_count ),
+      m_weights( weights )
+    {
+      // Do nothing else.
+    } // <init>( AlignmentColumnCounts &, char const * const *, size_t const, double const * )
+
+    void
+    operator() (
+      size_t const block_i,
+      uint32_t const thread_i
+    )
+    {
+      const uint32_t first_pos = block_i * BlockColumns;
+      const uint32_t block_columns =
+        std::min( static_cast<uint32_t>( BlockColumns ), static_cast<uint32_t>( m_counts.m_matchColumns.size() - first_pos ) );
+      uint32_t const * match_columns = &m_counts.m_matchColumns[ first_pos ];
+      uint8_t const * codes = m_counts.m_codes;
+      m_tile.resize( TileRows * BlockColumns );
+      uint8_t * tile = &m_tile[ 0 ];
+      double * block_counts = &m_counts.m_counts[ first_pos * CodeCount ];
+
+      for( size_t first_row = 0; first_row < m_rowCount; first_row += TileRows ) {
+        const uint32_t tile_rows =
+          static_cast<uint32_t>( std::min( static_cast<size_t>( TileRows ), ( m_rowCount - first_row ) ) );
+        // Transpose (and translate) the tile into column-major codes.  A
+        // partial tile is padded with a code that is never counted, so the
+        // counting loops always have the same (vectorizable) trip count.
+        if( tile_rows < TileRows ) {
+          std::fill( m_tile.begin(), m_tile.end(), static_cast<uint8_t>( 0xFF ) );
+        }
+        for( uint32_t row_i = 0; row_i < tile_rows; row_i++ ) {
+          char const * row = m_rows[ first_row + row_i ];
+          for( uint32_t col_i = 0; col_i < block_columns; col_i++ ) {
+            tile[ ( col_i * TileRows ) + row_i ] = codes[ static_cast<uint8_t>( row[ match_columns[ col_i ] ] ) ];
+          }
+        }
+        if( m_weights == NULL ) {
+          // Count each column, one code at a time.
+          for( uint32_t col_i = 0; col_i < block_columns; col_i++ ) {
+            uint8_t const * column = tile + ( col_i * TileRows );
+            for( uint32_t code = 0; code < CodeCount; code++ ) {
+              uint32_t code_count = 0;
+              for( uint32_t row_i = 0; row_i < TileRows; row_i++ ) {
+                code_count += ( column[ row_i ] == code );
+              }
+              block_counts[ ( col_i * CodeCount ) + code ] += code_count;
+            }
+          }
+        } else {
+          // Sum each column's weights, by code.
+          double const * tile_weights = m_weights + first_row;
+          for( uint32_t col_i = 0; col_i < block_columns; col_i++ ) {
+            uint8_t const * column = tile + ( col_i * TileRows );
+            double * column_counts = block_counts + ( col_i * CodeCount );
+            for( uint32_t row_i = 0; row_i < tile_rows; row_i++ ) {
+              column_counts[ column[ row_i ] ] += tile_weights[ row_i ];
+            }
+          }
+        } // End if m_weights == NULL .. else ..
+      } // End foreach tile
+    } // operator()( size_t const, uint32_t const )
+
+  protected:
+    AlignmentColumnCounts & m_counts;
+    char const * const * m_rows;
+    size_t m_rowCount;
+    double const * m_weights;
+    std::vector<uint8_t> m_tile; // Per-thread scratch space.
+  }; // End inner class CountBlockBody
+
+  /**
+   * The parallelFor body: counts the transitions of the rows in tile tile_i
+   * (rows tile_i * TileRows onward) into slot tile_i.
+   */
+  class CountTransitionsBody {
+  public:
+    CountTransitionsBody (
+      AlignmentColumnCounts const & counts,
+      char const * const * rows,
+      size_t const row_count,
+      double const * weights,
+      std::vector<TransitionCounts> & tile_transitions
+    ) :
+      m_counts( counts ),
+      m_rows( rows ),
+      m_rowCount( row_count ),
+      m_weights( weights ),
+      m_tileTransitions( tile_transitions )
+    {
+      // Do nothing else.
+    } // <init>( .. )
+
+    void
+    operator() (
+      size_t const tile_i,
+      uint32_t const thread_i
+    )
+    {
+      const size_t first_row = tile_i * TileRows;
+      const size_t last_row = std::min( ( first_row + TileRows ), m_rowCount );
+      for( size_t row_i = first_row; row_i < last_row; row_i++ ) {
+        m_counts.countTransitions( m_rows[ row_i ], ( ( m_weights == NULL ) ? 1.0 : m_weights[ row_i ] ), m_tileTransitions[ tile_i ] );
+      }
+    } // operator()( size_t const, uint32_t const )
+
+  protected:
+    AlignmentColumnCounts const & m_counts;
+    char const * const * m_rows;
+    size_t m_rowCount;
+    double const * m_weights;
+    std::vector<TransitionCounts> & m_tileTransitions;
+  }; // End inner class CountTransitionsBody
+
+  /**
+   * Add the transitions of the given row's path, with the given weight, to
+   * transitions.  There is at least one match column (see the constructor).
+   */
+  void
+  countTransitions (
+    char const * row,
+    double const weight,
+    TransitionCounts & transitions
+  ) const
+  {
+    enum { Begin, Match, Insertion, Deletion };
+    static const int to_match[] = { BeginToMatch, MatchToMatch, InsertionToMatch, DeletionToMatch };
+    static const int to_insertion[] = { -1, MatchToInsertion, InsertionToInsertion, -1 };
+    static const int to_deletion[] = { BeginToDeletion, MatchToDeletion, -1, DeletionToDeletion };
+    double * counts = transitions.m_counts;
+    const uint32_t first_match_col = m_matchColumns.front();
+    const uint32_t last_match_col = m_matchColumns.back();
+    uint32_t col_i = 0;
+    for( ; col_i < first_match_col; col_i++ ) {
+      if( row[ col_i ] != '-' ) {
+        counts[ PreAlignToPreAlign ] += weight;
+      }
+    }
+    counts[ PreAlignToBegin ] += weight;
+    int state = Begin;
+    int transition;
+    for( ; col_i <= last_match_col; col_i++ ) {
+      const bool is_gap = ( row[ col_i ] == '-' );
+      if( m_isMatchColumn[ col_i ] ) {
+        transition = ( is_gap ? to_deletion[ state ] : to_match[ state ] );
+        state = ( is_gap ? Deletion : Match );
+      } else if( !is_gap ) {
+        transition = to_insertion[ state ];
+        state = Insertion;
+      } else {
+        continue;
+      }
+      if( transition >= 0 ) {
+        counts[ transition ] += weight;
+      }
+    } // End foreach col_i in the profile's span
+    for( ; col_i < m_alignmentLength; col_i++ ) {
+      if( row[ col_i ] != '-' ) {
+        counts[ PostAlignToPostAlign ] += weight;
+      }
+    }
+    counts[ PostAlignToTerminal ] += weight;
+  } // countTransitions( char const *, double const, TransitionCounts & ) const
+
+  uint32_t m_alignmentLength;
+  uint64_t m_rowCount;
+  std::vector<uint32_t> m_matchColumns;
+  std::vector<uint8_t> m_isMatchColumn;
+  TransitionCounts m_transitionCounts;
+  uint8_t m_codes[ 256 ];
+  std::vector<double> m_counts; // CodeCount per match column.
+
+}; // End class AlignmentColumnCounts
+
+} // End namespace galosh
+
+#endif // __GALOSH_ALIGNMENTCOLUMNCOUNTS_HPP__
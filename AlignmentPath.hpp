@@ -0,0 +1,129 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      AlignmentPath.hpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      A compact representation of a single sequence's path through a
+##      profile HMM (see ProfileTables.hpp for the model): the sequence of
+##      states visited, one byte per state.  PreAlign, Match, Insertion and
+##      PostAlign states each emit one residue; Deletion states emit nothing.
+##      Match and Deletion states advance the profile position, so positions
+##      are implicit.
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#if     _MSC_VER > 1000
+#pragma once
+#endif
+
+#ifndef __GALOSH_ALIGNMENTPATH_HPP__
+#define __GALOSH_ALIGNMENTPATH_HPP__
+
+#include <iostream>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+namespace galosh {
+
+  namespace PathState {
+    enum Index {
+      PreAlign = 0,
+      Match = 1,
+      Insertion = 2,
+      Deletion = 3,
+      PostAlign = 4,
+      Count
+    };
+  } // End namespace PathState
+
+  typedef std::vector<uint8_t> AlignmentPath;
+
+  inline bool
+  pathStateEmits (
+    uint8_t const state
+  )
+  {
+    return ( state != PathState::Deletion );
+  } // pathStateEmits( uint8_t const )
+
+  inline char
+  pathStateCode (
+    uint8_t const state
+  )
+  {
+    static const char codes[ PathState::Count ] = { 'N', 'M', 'I', 'D', 'C' };
+    return codes[ state ];
+  } // pathStateCode( uint8_t const )
+
+  /**
+   * For each residue of the sequence, the state that emitted it and the
+   * (1-based) profile position of that state (0 for PreAlign; for Insertion
+   * states, the position after which the insertion occurs; profile length for
+   * PostAlign).
+   */
+  inline void
+  pathToResidueStates (
+    AlignmentPath const & path,
+    std::vector<uint8_t> & residue_states,
+    std::vector<uint32_t> & residue_positions
+  )
+  {
+    residue_states.clear();
+    residue_positions.clear();
+    uint32_t pos = 0;
+    for( size_t step_i = 0; step_i < path.size(); step_i++ ) {
+      const uint8_t state = path[ step_i ];
+      if( ( state == PathState::Match ) || ( state == PathState::Deletion ) ) {
+        pos += 1;
+      }
+      if( pathStateEmits( state ) ) {
+        residue_states.push_back( state );
+        residue_positions.push_back( pos );
+      }
+    }
+  } // pathToResidueStates( AlignmentPath const &, vector<uint8_t> &, vector<uint32_t> & )
+
+  /**
+   * Write the path as a string of state codes (N, M, I, D, C), one per state.
+   */
+  template <class AnyCharT, class AnyTraitsT>
+  void
+  writePathCodes (
+    std::basic_ostream<AnyCharT,AnyTraitsT> & os,
+    AlignmentPath const & path
+  )
+  {
+    for( size_t step_i = 0; step_i < path.size(); step_i++ ) {
+      os << pathStateCode( path[ step_i ] );
+    }
+  } // writePathCodes( basic_ostream &, AlignmentPath const & )
+
+} // End namespace galosh
+
+#endif // __GALOSH_ALIGNMENTPATH_HPP__
@@ -0,0 +1,375 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      BenchmarkForward.cpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      The benchmarkForward program.  It times the forward algorithm on the
+##      sequences of a Fasta file, given a profile, with each kind of dp
+##      arithmetic:
+##        bfloat   the DynamicProgramming forward_score(..) (as score does),
+##                 with bfloat matrices;
+##        scaled   doubles, each row scaled to sum to 1
+##                 (CheckpointedForwardBackward);
+##        mixed    float cells, each row scaled to sum to 1, with double
+##                 scale factors (MixedPrecisionForward; it also reports
+##                 how many sequences were held in floats);
+##        flogsum  unscaled, in log space with tabulated log sums
+##                 (UnscaledForward with flogspace; see LogSum.hpp);
+##        logsum   unscaled, in exact log space (UnscaledForward with
+##                 exactlogspace).
+##      For each it reports the (best over --repeat runs) time, its speed
+##      relative to bfloat (the score program's default), and the total
+##      probability of the sequences; for scaled, mixed and flogsum, also
+##      the largest difference from the exact (logsum) log probability of any
+##      sequence, and for bfloat (which gives only the total) the difference
+##      of the log of the total from the exact one.  It ends by saying
+##      whether flogsum is faster than bfloat, and how far mixed's total is
+##      from bfloat's (that of score --precision mixed from that of the
+##      default score).  With --tolerance, it is also a validation: it fails
+##      (exits with 2) if any of those differences, per sequence, is larger.
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#include "Algebra.hpp"
+#include "Profile.hpp"
+#include "Fasta.hpp"
+#include "DynamicProgramming.hpp"
+#include "ProfileTables.hpp"
+#include "CheckpointedForwardBackward.hpp"
+#include "MixedPrecisionForward.hpp"
+#include "UnscaledForward.hpp"
+#include "LogSum.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <seqan/basic.h>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/program_options.hpp>
+
+#ifdef __HAVE_MUSCLE
+int g_argc;
+char **g_argv;
+#endif // __HAVE_MUSCLE
+
+using namespace galosh;
+
+namespace po = boost::program_options;
+
+  static double
+  secondsSince (
+    boost::posix_time::ptime const & start_time
+  )
+  {
+    return ( boost::posix_time::microsec_clock::universal_time() - start_time ).total_microseconds() / 1.0E6;
+  } // secondsSince( ptime const & )
+
+  /**
+   * Put the forward log probability of each sequence, by forward_algorithm
+   * (CheckpointedForwardBackward, MixedPrecisionForward or UnscaledForward),
+   * into
+   * log_probabilities, repeat_count times.  Returns the fastest time.
+   */
+  template <typename ForwardType>
+  static double
+  timeForward (
+    ForwardType const & forward_algorithm,
+    std::vector<std::vector<uint32_t> > const & sequences,
+    uint32_t const repeat_count,
+    std::vector<double> & log_probabilities
+  )
+  {
+    double best_seconds = std::numeric_limits<double>::infinity();
+    log_probabilities.resize( sequences.size() );
+    for( uint32_t repeat_i = 0; repeat_i < repeat_count; repeat_i++ ) {
+      const boost::posix_time::ptime start_time = boost::posix_time::microsec_clock::universal_time();
+      for( size_t seq_i = 0; seq_i < sequences.size(); seq_i++ ) {
+        log_probabilities[ seq_i ] = forward_algorithm.forward( sequences[ seq_i ] );
+      }
+      best_seconds = std::min( best_seconds, secondsSince( start_time ) );
+    }
+    return best_seconds;
+  } // timeForward( ForwardType const &, vector<vector<uint32_t> > const &, uint32_t const, vector<double> & )
+
+  static double
+  sum (
+    std::vector<double> const & values
+  )
+  {
+    double total = 0;
+    for( size_t i = 0; i < values.size(); i++ ) {
+      total += values[ i ];
+    }
+    return total;
+  } // sum( vector<double> const & )
+
+  static double
+  maxDifference (
+    std::vector<double> const & values,
+    std::vector<double> const & exact_values
+  )
+  {
+    double max_difference = 0;
+    for( size_t i = 0; i < values.size(); i++ ) {
+      max_difference = std::max( max_difference, std::fabs( values[ i ] - exact_values[ i ] ) );
+    }
+    return max_difference;
+  } // maxDifference( vector<double> const &, vector<double> const & )
+
+  /**
+   * The natural log of value / exp( log_reference ), computed with
+   * ScoreTypes, so that neither has to fit in a double.
+   */
+  template <typename ScoreType>
+  static double
+  logRatio (
+    ScoreType const & value,
+    double log_reference
+  )
+  {
+    // exp( -700 ) is still a normal double.
+    ScoreType reference( 1.0 );
+    while( log_reference < -700.0 ) {
+      reference *= ScoreType( std::exp( -700.0 ) );
+      log_reference += 700.0;
+    }
+    reference *= ScoreType( std::exp( log_reference ) );
+    return std::log( toDouble( value / reference ) );
+  } // logRatio( ScoreType const &, double )
+
+  static std::string
+  toString (
+    double const value
+  )
+  {
+    std::ostringstream os;
+    os << value;
+    return os.str();
+  } // toString( double const )
+
+  template <class AnyCharT, class AnyTraitsT, typename ProbabilityType>
+  static void
+  writeRow (
+    std::basic_ostream<AnyCharT,AnyTraitsT> & os,
+    std::string const & method,
+    double const seconds,
+    size_t const sequence_count,
+    double const bfloat_seconds,
+    ProbabilityType const & total_probability,
+    std::string const & max_error
+  )
+  {
+    os << method << "\t" << seconds << "\t" << ( ( seconds > 0 ) ? ( sequence_count / seconds ) : 0.0 ) << "\t";
+    if( bfloat_seconds > 0 ) {
+      os << ( bfloat_seconds / seconds );
+    } else {
+      os << "-";
+    }
+    os << "\t" << total_probability << "\t" << max_error << std::endl;
+  } // writeRow( basic_ostream &, .. )
+
+int
+main ( int const argc, char const ** argv )
+{
+  typedef doublerealspace ProbabilityType;
+  typedef bfloat ScoreType;
+  typedef bfloat MatrixValueType;
+
+#ifdef __PROFUSE_USE_AMINOS
+  typedef seqan::AminoAcid20 ResidueType;
+  typedef seqan::AminoAcid SequenceResidueType;
+#else // __PROFUSE_USE_AMINOS .. else
+  typedef seqan::Dna ResidueType;
+  typedef seqan::Iupac SequenceResidueType;
+#endif // __PROFUSE_USE_AMINOS .. else ..
+
+  typedef DynamicProgramming<ResidueType, ProbabilityType, ScoreType, MatrixValueType> DPType;
+
+  try {
+    po::options_description visible( "Basic options" );
+    visible.add_options()
+      ( "help,h", "produce help message" )
+      ( "profile,p",
+        po::value<string>(),
+        "filename: the (galosh Profile) profile" )
+      ( "fasta,f",
+        po::value<string>(),
+        "filename: the Fasta file of unaligned sequences" )
+      ( "nseq,n",
+        po::value<uint32_t>()->default_value( 0 ),
+        "number of sequences to use (0, the default, means all of them)" )
+      ( "repeat,r",
+        po::value<uint32_t>()->default_value( 3 ),
+        "run each method this many times, and report the fastest" )
+      ( "no-bfloat",
+        "skip the bfloat (DynamicProgramming) method, which keeps the whole dp matrices (and so the comparisons with it)" )
+      ( "tolerance",
+        po::value<double>(),
+        "fail (exit with 2) if the log probability of any sequence by the scaled, mixed, or flogsum method (or, per sequence, the total by bfloat, or mixed's total from bfloat's) differs from the exact one by more than this many nats" )
+      ;
+
+    po::positional_options_description p;
+    p.add( "profile", 1 );
+    p.add( "fasta", 1 );
+    p.add( "nseq", 1 );
+
+    po::variables_map vm;
+    store( po::command_line_parser( argc, argv ).options( visible ).positional( p ).run(), vm );
+    notify( vm );
+
+#define USAGE() " " << argv[ 0 ] << " [options] <profile file> <fasta sequences file> [<num seqs>]"
+
+    if( vm.count( "help" ) > 0 ) {
+      cout << "Usage: " << USAGE() << endl;
+      cout << visible << "\n";
+      return 0;
+    }
+    if( ( vm.count( "profile" ) == 0 ) || ( vm.count( "fasta" ) == 0 ) ) {
+      cout << "Usage: " << USAGE() << endl;
+      exit( 1 );
+    }
+
+    const string profile_filename = vm[ "profile" ].as<string>();
+    const string fasta_filename = vm[ "fasta" ].as<string>();
+    const uint32_t repeat_count = std::max( static_cast<uint32_t>( 1 ), vm[ "repeat" ].as<uint32_t>() );
+
+    ProfileTreeRoot<ResidueType, ProbabilityType> profile;
+    profile.fromFile( profile_filename );
+    Fasta<SequenceResidueType> fasta;
+    fasta.fromFile( fasta_filename );
+    const uint32_t nseq = vm[ "nseq" ].as<uint32_t>();
+    const uint32_t sequence_count =
+      ( ( nseq == 0 ) ? fasta.size() : std::min( static_cast<size_t>( nseq ), fasta.size() ) );
+
+    std::vector<std::vector<uint32_t> > sequences( sequence_count );
+    for( uint32_t seq_i = 0; seq_i < sequence_count; seq_i++ ) {
+      sequenceToOrdinals( fasta[ seq_i ], sequences[ seq_i ] );
+    }
+
+    cout << "profile\t" << profile_filename << endl;
+    cout << "sequences\t" << fasta_filename << "\t" << sequence_count << endl;
+    cout << "method\tseconds\tsequences per second\tspeed relative to bfloat\ttotal probability\tmax error (nats per sequence)" << endl;
+
+    const ProfileTables<ResidueType, SequenceResidueType> tables( profile );
+
+    // The exact log probabilities, which the others are compared to.
+    std::vector<double> exact_log_probabilities;
+    const double exact_seconds =
+      timeForward( UnscaledForward<ResidueType, SequenceResidueType, exactlogspace>( tables ), sequences, repeat_count, exact_log_probabilities );
+    const double exact_log_total = sum( exact_log_probabilities );
+
+    // The largest difference from exact of any method, per sequence.
+    double max_error = 0;
+
+    // 0 if it wasn't run.
+    double bfloat_seconds = 0;
+    double bfloat_log_total = 0;
+    if( vm.count( "no-bfloat" ) == 0 ) {
+      DPType::Matrix::SequentialAccessContainer dp_matrices( profile, fasta, sequence_count );
+      DPType dp;
+      DPType::Parameters parameters;
+      ScoreType score;
+      bfloat_seconds = std::numeric_limits<double>::infinity();
+      for( uint32_t repeat_i = 0; repeat_i < repeat_count; repeat_i++ ) {
+        const boost::posix_time::ptime start_time = boost::posix_time::microsec_clock::universal_time();
+        score = dp.forward_score( parameters, profile, fasta, sequence_count, dp_matrices );
+        bfloat_seconds = std::min( bfloat_seconds, secondsSince( start_time ) );
+      }
+      bfloat_log_total = exact_log_total + logRatio( score, exact_log_total );
+      const double error = std::fabs( bfloat_log_total - exact_log_total );
+      if( sequence_count > 0 ) {
+        max_error = std::max( max_error, ( error / sequence_count ) );
+      }
+      writeRow( cout, "bfloat", bfloat_seconds, sequence_count, bfloat_seconds, score, toString( error ) + " (total)" );
+    } // End if bfloat
+
+    std::vector<double> log_probabilities;
+    const double scaled_seconds =
+      timeForward( CheckpointedForwardBackward<ResidueType, SequenceResidueType>( tables ), sequences, repeat_count, log_probabilities );
+    double error = maxDifference( log_probabilities, exact_log_probabilities );
+    max_error = std::max( max_error, error );
+    writeRow( cout, "scaled", scaled_seconds, sequence_count, bfloat_seconds, flogspace::fromLogValue( sum( log_probabilities ) ), toString( error ) );
+
+    const MixedPrecisionForward<ResidueType, SequenceResidueType> mixed_forward( tables );
+    const double mixed_seconds =
+      timeForward( mixed_forward, sequences, repeat_count, log_probabilities );
+    error = maxDifference( log_probabilities, exact_log_probabilities );
+    max_error = std::max( max_error, error );
+    const double mixed_log_total = sum( log_probabilities );
+    writeRow( cout, "mixed", mixed_seconds, sequence_count, bfloat_seconds, flogspace::fromLogValue( mixed_log_total ), toString( error ) );
+    // The rest were computed with doubles; see MixedPrecisionForward.hpp.
+    uint32_t float_sequence_count = 0;
+    for( size_t seq_i = 0; seq_i < sequences.size(); seq_i++ ) {
+      bool used_floats;
+      mixed_forward.forward( sequences[ seq_i ], &used_floats );
+      if( used_floats ) {
+        float_sequence_count++;
+      }
+    }
+
+    const double tabulated_seconds =
+      timeForward( UnscaledForward<ResidueType, SequenceResidueType, flogspace>( tables ), sequences, repeat_count, log_probabilities );
+    error = maxDifference( log_probabilities, exact_log_probabilities );
+    max_error = std::max( max_error, error );
+    writeRow( cout, "flogsum", tabulated_seconds, sequence_count, bfloat_seconds, flogspace::fromLogValue( sum( log_probabilities ) ), toString( error ) );
+
+    writeRow( cout, "logsum", exact_seconds, sequence_count, bfloat_seconds, flogspace::fromLogValue( exact_log_total ), "0" );
+    cout << endl << "mixed used floats for " << float_sequence_count << " of " << sequence_count << " sequences." << endl;
+    if( bfloat_seconds > 0 ) {
+      if( tabulated_seconds < bfloat_seconds ) {
+        cout << "flogsum is faster than bfloat, by " << ( bfloat_seconds / tabulated_seconds ) << " times." << endl;
+      } else {
+        cout << "flogsum is NOT faster than bfloat: it takes " << ( tabulated_seconds / bfloat_seconds ) << " times as long." << endl;
+      }
+      const double mixed_difference = std::fabs( mixed_log_total - bfloat_log_total );
+      cout << "mixed's total differs from bfloat's by " << mixed_difference << " nats." << endl;
+      if( sequence_count > 0 ) {
+        max_error = std::max( max_error, ( mixed_difference / sequence_count ) );
+      }
+    }
+
+    if( ( vm.count( "tolerance" ) > 0 ) && !( max_error <= vm[ "tolerance" ].as<double>() ) ) {
+      cerr << "error: a log probability differs from the exact one by " << max_error << " nats, more than the tolerance of " << vm[ "tolerance" ].as<double>() << endl;
+      return 2;
+    }
+  } catch( std::exception& e ) { /// exceptions thrown by boost stuff
+    cerr << "error: " << e.what() << endl;
+    return 1;
+  } catch( string &err ) {
+    cerr << "error: " << err << endl;
+    return 1;
+  }
+
+  return 0; // success
+} // main (..)
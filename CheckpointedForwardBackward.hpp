@@ -0,0 +1,721 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      CheckpointedForwardBackward.hpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      Class definition for the CheckpointedForwardBackward class, which runs
+##      the forward and backward algorithms of a sequence against a profile HMM
+##      (see ProfileTables.hpp) and hands each row of posteriors to a visitor,
+##      eg. one that accumulates the expected state and transition counts used
+##      for alignment profiles (see ExpectedCounts.hpp).
+##
+##      The forward pass keeps only every k-th row (k defaults to the square
+##      root of the sequence length; see defaultCheckpointInterval(..)).  The
+##      backward sweep, which needs only the current and the next backward
+##      row, recomputes the forward rows one block of k at a time from the
+##      nearest checkpoint.  That costs one extra forward pass and uses
+##      O( sqrt( L ) * M ) memory instead of O( L * M ).  The recomputation is
+##      deterministic, so the posteriors are exactly those of the
+##      full-matrix computation (which is what you get with an interval of at
+##      least L + 1).  The backward row at each checkpoint is kept too, so
+##      that afterwards any one block can be visited again (see
+##      revisitBlock(..)), eg. for a traceback.
+##
+##      Every forward row is scaled to sum to 1; the backward rows are scaled
+##      by the same factors, so no logs are needed in the inner loops.
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#if     _MSC_VER > 1000
+#pragma once
+#endif
+
+#ifndef __GALOSH_CHECKPOINTEDFORWARDBACKWARD_HPP__
+#define __GALOSH_CHECKPOINTEDFORWARDBACKWARD_HPP__
+
+#include "ProfileTables.hpp"
+#include "ExpectedCounts.hpp"
+#include "CheckpointedViterbi.hpp" // for defaultCheckpointInterval(..)
+#include "RowKernels.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace galosh {
+
+template <typename ResidueType,
+          typename SequenceResidueType>
+class CheckpointedForwardBackward {
+public:
+  typedef ProfileTables<ResidueType, SequenceResidueType> ProfileTablesType;
+  enum { AlphabetSize = ProfileTablesType::AlphabetSize };
+
+  /**
+   * One (scaled) row of the forward or backward matrix: the values of each
+   * state after having emitted the first i residues of the sequence.  The
+   * vectors have profile length + 1 entries; entry 0 is unused, as is the
+   * Insertion entry of the last position.
+   */
+  struct Row {
+    double m_preAlign;
+    double m_postAlign;
+    std::vector<double> m_match;
+    std::vector<double> m_insertion;
+    std::vector<double> m_deletion;
+
+    void
+    reinitialize (
+      uint32_t const profile_length
+    )
+    {
+      m_match.assign( profile_length + 1, 0.0 );
+      m_insertion.assign( profile_length + 1, 0.0 );
+      m_deletion.assign( profile_length + 1, 0.0 );
+    } // reinitialize( uint32_t const )
+  }; // End inner struct Row
+
+  /**
+   * A visitor that adds the expected counts of each state and transition (the
+   * posteriors) to an ExpectedCounts.
+   *
+   * The per-position counts are summed (by the RowKernels) into contiguous
+   * arrays, one per transition and one per emitted (sequence) residue, and
+   * are added to the ExpectedCounts by addToCounts(), after the last row;
+   * there the emission counts of each ambiguous residue are spread over the
+   * residues it stands for (see ResidueShares), once per position rather
+   * than once per row.
+   */
+  class CountsVisitor {
+  public:
+    /// The per-position transitions, in the order of the arrays in m_sums.
+    enum SumIndex {
+      MatchToMatchSums,
+      InsertionToMatchSums,
+      DeletionToMatchSums,
+      MatchToInsertionSums,
+      InsertionToInsertionSums,
+      MatchToDeletionSums,
+      DeletionToDeletionSums,
+      TransitionSumsCount
+    };
+
+    CountsVisitor (
+      ProfileTablesType const & tables,
+      std::vector<uint32_t> const & residues,
+      ResidueShares<ResidueType, SequenceResidueType> const & shares,
+      ExpectedCounts<ResidueType> & counts,
+      double const weight
+    ) :
+      m_tables( tables ),
+      m_residues( residues ),
+      m_shares( shares ),
+      m_counts( counts ),
+      m_weight( weight ),
+      m_kernels( rowKernels() ),
+      m_sums( ( TransitionSumsCount + ( 2 * AlphabetSize ) ) * ( tables.m_profileLength + 1 ), 0.0 )
+    {
+      // Do nothing else.
+    } // <init>( .. )
+
+    /**
+     * forward and backward are rows row_i; next_backward is row row_i + 1 (or
+     * null, for the last row), and next_scale is the scale of forward row
+     * row_i + 1.  Multiplying forward and backward values by inverse_z gives
+     * posteriors.
+     */
+    void
+    visitRow (
+      uint32_t const row_i,
+      Row const & forward,
+      Row const & backward,
+      Row const * next_backward,
+      double const next_scale,
+      double const inverse_z
+    )
+    {
+      const uint32_t profile_length = m_tables.m_profileLength;
+      const double w = m_weight * inverse_z;
+      double g;
+
+      // Emissions of residue row_i (1-based).
+      if( row_i > 0 ) {
+        const uint32_t c = m_residues[ row_i - 1 ];
+        m_kernels.addEmissionPosteriors( &forward.m_match[ 0 ] + 1, &backward.m_match[ 0 ] + 1, w, matchEmissionSums( c ) + 1, profile_length );
+        m_kernels.addEmissionPosteriors( &forward.m_insertion[ 0 ] + 1, &backward.m_insertion[ 0 ] + 1, w, insertionEmissionSums( c ) + 1, profile_length - 1 );
+        g = forward.m_preAlign * backward.m_preAlign * w;
+        insertionEmissionSums( c )[ 0 ] += g;
+        m_counts.transition( 0, ProfileTransition::PreAlignToPreAlign ) += g;
+      } // End if row_i > 0
+
+      // Transitions within this row (into Deletion states).
+      g =
+        forward.m_preAlign * m_tables[ ProfileTransition::PreAlignToBegin ] *
+        m_tables[ ProfileTransition::BeginToDeletion ] * backward.m_deletion[ 1 ] * w;
+      m_counts.transition( 0, ProfileTransition::PreAlignToBegin ) += g;
+      m_counts.transition( 0, ProfileTransition::BeginToDeletion ) += g;
+      m_kernels.addDeletionTransitionPosteriors(
+        &forward.m_match[ 0 ] + 1,
+        &forward.m_deletion[ 0 ] + 1,
+        &backward.m_deletion[ 0 ] + 2,
+        w,
+        m_tables.m_transitions,
+        transitionSums( MatchToDeletionSums ) + 1,
+        transitionSums( DeletionToDeletionSums ) + 1,
+        profile_length - 1
+      );
+
+      if( next_backward == 0 ) {
+        m_counts.transition( profile_length, ProfileTransition::PostAlignToTerminal ) += m_weight;
+        return;
+      }
+
+      // Transitions into the states that emit residue row_i + 1.
+      const uint32_t x = m_residues[ row_i ];
+      const double wn = w / next_scale;
+      const double insertion_emission = m_tables.insertionEmission( x );
+
+      g =
+        forward.m_postAlign * m_tables[ ProfileTransition::PostAlignToPostAlign ] *
+        insertion_emission * next_backward->m_postAlign * wn;
+      insertionEmissionSums( x )[ profile_length ] += g;
+      m_counts.transition( profile_length, ProfileTransition::PostAlignToPostAlign ) += g;
+
+      g =
+        forward.m_preAlign * m_tables[ ProfileTransition::PreAlignToBegin ] *
+        m_tables[ ProfileTransition::BeginToMatch ] * m_tables.matchEmission( 0, x ) *
+        next_backward->m_match[ 1 ] * wn;
+      m_counts.transition( 0, ProfileTransition::PreAlignToBegin ) += g;
+      m_counts.transition( 0, ProfileTransition::BeginToMatch ) += g;
+
+      m_kernels.addEmittingTransitionPosteriors(
+        &forward.m_match[ 0 ] + 1,
+        &forward.m_insertion[ 0 ] + 1,
+        &forward.m_deletion[ 0 ] + 1,
+        &next_backward->m_match[ 0 ] + 2,
+        &next_backward->m_insertion[ 0 ] + 1,
+        m_tables.matchEmissions( x ) + 1,
+        insertion_emission,
+        wn,
+        m_tables.m_transitions,
+        transitionSums( MatchToMatchSums ) + 1,
+        transitionSums( InsertionToMatchSums ) + 1,
+        transitionSums( DeletionToMatchSums ) + 1,
+        transitionSums( MatchToInsertionSums ) + 1,
+        transitionSums( InsertionToInsertionSums ) + 1,
+        profile_length - 1
+      );
+    } // visitRow( .. )
+
+    /**
+     * Add the summed per-position counts to the ExpectedCounts (and zero the
+     * sums).
+     */
+    void
+    addToCounts ()
+    {
+      static const ProfileTransition::Index transitions[ TransitionSumsCount ] = {
+        ProfileTransition::MatchToMatch,
+        ProfileTransition::InsertionToMatch,
+        ProfileTransition::DeletionToMatch,
+        ProfileTransition::MatchToInsertion,
+        ProfileTransition::InsertionToInsertion,
+        ProfileTransition::MatchToDeletion,
+        ProfileTransition::DeletionToDeletion
+      };
+      const uint32_t profile_length = m_tables.m_profileLength;
+      for( uint32_t sums_i = 0; sums_i < TransitionSumsCount; sums_i++ ) {
+        double const * sums = transitionSums( static_cast<SumIndex>( sums_i ) );
+        for( uint32_t pos = 1; pos < profile_length; pos++ ) {
+          m_counts.transition( pos, transitions[ sums_i ] ) += sums[ pos ];
+        }
+      }
+      for( uint32_t c = 0; c < AlphabetSize; c++ ) {
+        double const * match_sums = matchEmissionSums( c );
+        double const * insertion_sums = insertionEmissionSums( c );
+        for( uint32_t pos = 1; pos <= profile_length; pos++ ) {
+          if( match_sums[ pos ] != 0 ) {
+            m_shares.addMatchEmission( m_counts, pos, c, match_sums[ pos ] );
+          }
+        }
+        for( uint32_t pos = 0; pos <= profile_length; pos++ ) {
+          if( insertion_sums[ pos ] != 0 ) {
+            m_shares.addInsertionEmission( m_counts, pos, c, insertion_sums[ pos ] );
+          }
+        }
+      }
+      std::fill( m_sums.begin(), m_sums.end(), 0.0 );
+    } // addToCounts()
+
+  protected:
+    ProfileTablesType const & m_tables;
+    std::vector<uint32_t> const & m_residues;
+    ResidueShares<ResidueType, SequenceResidueType> const & m_shares;
+    ExpectedCounts<ResidueType> & m_counts;
+    double m_weight;
+    RowKernels const & m_kernels;
+
+    /// The transition sums, then the match emission sums of each (sequence)
+    /// residue, then the insertion emission sums of each; each profile
+    /// length + 1 long, by position (insertion position 0 being PreAlign,
+    /// and position M PostAlign).
+    std::vector<double> m_sums;
+
+    inline double *
+    transitionSums (
+      SumIndex const sums_i
+    )
+    {
+      return &m_sums[ 0 ] + ( sums_i * ( m_tables.m_profileLength + 1 ) );
+    } // transitionSums( SumIndex const )
+
+    inline double *
+    matchEmissionSums (
+      uint32_t const c
+    )
+    {
+      return &m_sums[ 0 ] + ( ( TransitionSumsCount + c ) * ( m_tables.m_profileLength + 1 ) );
+    } // matchEmissionSums( uint32_t const )
+
+    inline double *
+    insertionEmissionSums (
+      uint32_t const c
+    )
+    {
+      return &m_sums[ 0 ] + ( ( TransitionSumsCount + AlphabetSize + c ) * ( m_tables.m_profileLength + 1 ) );
+    } // insertionEmissionSums( uint32_t const )
+  }; // End inner class CountsVisitor
+
+  /**
+   * The tables must hold probabilities (not logs).  A checkpoint_interval of 0
+   * means use defaultCheckpointInterval( sequence length ).
+   */
+  CheckpointedForwardBackward (
+    ProfileTablesType const & tables,
+    uint32_t const checkpoint_interval = 0
+  ) :
+    m_tables( tables ),
+    m_checkpointInterval( checkpoint_interval ),
+    m_kernels( rowKernels() )
+  {
+    assert( !tables.m_isLog );
+  } // <init>( ProfileTablesType const &, uint32_t const )
+
+  /**
+   * Returns the natural log of the probability of the given sequence (given
+   * as residue ordinal values; see sequenceToOrdinals(..)), using two rows.
+   */
+  double
+  forward (
+    std::vector<uint32_t> const & residues
+  ) const
+  {
+    const uint32_t sequence_length = residues.size();
+    Row current, next;
+    current.reinitialize( m_tables.m_profileLength );
+    next.reinitialize( m_tables.m_profileLength );
+    firstRow( current );
+    double log_scale = 0;
+    for( uint32_t row_i = 1; row_i <= sequence_length; row_i++ ) {
+      log_scale += std::log( nextRow( current, residues[ row_i - 1 ], next ) );
+      std::swap( current, next );
+    }
+    return ( log_scale + ProfileTablesType::safeLog( current.m_postAlign * m_tables[ ProfileTransition::PostAlignToTerminal ] ) );
+  } // forward( vector<uint32_t> const & ) const
+
+  /**
+   * Add the expected counts of the given sequence to counts, times weight.
+   * Returns the natural log of the probability of the sequence.  shares
+   * (made from the same profile as the tables) spreads the counts of
+   * ambiguous residues.
+   */
+  double
+  expectedCounts (
+    std::vector<uint32_t> const & residues,
+    ResidueShares<ResidueType, SequenceResidueType> const & shares,
+    ExpectedCounts<ResidueType> & counts,
+    double const weight = 1.0
+  ) const
+  {
+    CountsVisitor visitor( m_tables, residues, shares, counts, weight );
+    const double log_probability = forwardBackward( residues, visitor );
+    visitor.addToCounts();
+    return log_probability;
+  } // expectedCounts( vector<uint32_t> const &, ResidueShares const &, ExpectedCounts &, double const ) const
+
+  /**
+   * What forwardBackward(..) keeps, so that a block of rows can be visited
+   * again afterwards (see revisitBlock(..)): the forward row and the
+   * backward row at every k-th row, and all of the scales.  That is
+   * O( sqrt( L ) * M ) memory.  It also holds the scratch rows of a block.
+   */
+  struct Checkpoints {
+    uint32_t m_interval;
+    double m_inverseZ;
+    std::vector<double> m_scales;
+    /// Forward rows 0, k, 2k, ..
+    std::vector<Row> m_forward;
+    /// Backward rows 0, k, 2k, ..
+    std::vector<Row> m_backward;
+
+    std::vector<Row> m_block;
+    Row m_backwardRow;
+    Row m_nextBackwardRow;
+  }; // End inner struct Checkpoints
+
+  /**
+   * Run the checkpointed forward and backward algorithms, calling
+   * visitor.visitRow(..) for each row from the last (row L) to the first (row
+   * 0).  Returns the natural log of the probability of the sequence (and
+   * visits nothing if it is 0).
+   */
+  template <typename VisitorType>
+  double
+  forwardBackward (
+    std::vector<uint32_t> const & residues,
+    VisitorType & visitor
+  ) const
+  {
+    Checkpoints checkpoints;
+    return forwardBackward( residues, visitor, checkpoints );
+  } // forwardBackward( vector<uint32_t> const &, VisitorType & ) const
+
+  /**
+   * As above, keeping the checkpoints, for revisitBlock(..).
+   */
+  template <typename VisitorType>
+  double
+  forwardBackward (
+    std::vector<uint32_t> const & residues,
+    VisitorType & visitor,
+    Checkpoints & checkpoints
+  ) const
+  {
+    const uint32_t profile_length = m_tables.m_profileLength;
+    const uint32_t sequence_length = residues.size();
+    const uint32_t k = checkpointInterval( sequence_length );
+
+    // The forward pass, keeping every k-th row and all of the scales.
+    checkpoints.m_interval = k;
+    checkpoints.m_forward.resize( ( sequence_length / k ) + 1 );
+    checkpoints.m_backward.resize( ( sequence_length / k ) + 1 );
+    checkpoints.m_scales.assign( sequence_length + 1, 1.0 );
+    Row current, next;
+    current.reinitialize( profile_length );
+    next.reinitialize( profile_length );
+    firstRow( current );
+    checkpoints.m_forward[ 0 ] = current;
+    double log_scale = 0;
+    for( uint32_t row_i = 1; row_i <= sequence_length; row_i++ ) {
+      checkpoints.m_scales[ row_i ] = nextRow( current, residues[ row_i - 1 ], next );
+      log_scale += std::log( checkpoints.m_scales[ row_i ] );
+      std::swap( current, next );
+      if( ( row_i % k ) == 0 ) {
+        checkpoints.m_forward[ row_i / k ] = current;
+      }
+    }
+    const double z = current.m_postAlign * m_tables[ ProfileTransition::PostAlignToTerminal ];
+    if( !( z > 0 ) ) {
+      return -std::numeric_limits<double>::infinity();
+    }
+    checkpoints.m_inverseZ = 1.0 / z;
+
+    // The backward sweep, one block of k rows at a time.
+    for( int64_t block_start = ( sequence_length / k ) * k; block_start >= 0; block_start -= k ) {
+      visitBlock( residues, checkpoints, block_start, visitor );
+      checkpoints.m_backward[ block_start / k ] = checkpoints.m_backwardRow;
+    }
+
+    return ( log_scale + std::log( z ) );
+  } // forwardBackward( vector<uint32_t> const &, VisitorType &, Checkpoints & ) const
+
+  /**
+   * After forwardBackward(..) has returned a nonzero probability, call
+   * visitor.visitRow(..) again for the rows block_start (a multiple of the
+   * checkpoint interval) .. block_start + k - 1, from the last to the first,
+   * with exactly the same rows as the first time.  This costs at most k
+   * forward and k backward rows.
+   */
+  template <typename VisitorType>
+  void
+  revisitBlock (
+    std::vector<uint32_t> const & residues,
+    Checkpoints & checkpoints,
+    uint32_t const block_start,
+    VisitorType & visitor
+  ) const
+  {
+    assert( ( block_start % checkpoints.m_interval ) == 0 );
+    visitBlock( residues, checkpoints, block_start, visitor );
+  } // revisitBlock( vector<uint32_t> const &, Checkpoints &, uint32_t const, VisitorType & ) const
+
+  /**
+   * The checkpoint interval used for a sequence of the given length.
+   */
+  uint32_t
+  checkpointInterval (
+    uint32_t const sequence_length
+  ) const
+  {
+    return ( ( m_checkpointInterval == 0 ) ? defaultCheckpointInterval( sequence_length ) : m_checkpointInterval );
+  } // checkpointInterval( uint32_t const ) const
+
+  uint32_t
+  checkpointInterval () const
+  {
+    return m_checkpointInterval;
+  } // checkpointInterval() const
+
+protected:
+  ProfileTablesType const & m_tables;
+  uint32_t m_checkpointInterval;
+  RowKernels const & m_kernels;
+
+  /**
+   * Recompute the forward rows of the block from its checkpoint, then
+   * compute its backward rows (from the checkpointed backward row after it,
+   * or from scratch if it is the last block), visiting each.  Leaves
+   * backward row block_start in checkpoints.m_backwardRow.
+   */
+  template <typename VisitorType>
+  void
+  visitBlock (
+    std::vector<uint32_t> const & residues,
+    Checkpoints & checkpoints,
+    uint32_t const block_start,
+    VisitorType & visitor
+  ) const
+  {
+    const uint32_t profile_length = m_tables.m_profileLength;
+    const uint32_t sequence_length = residues.size();
+    const uint32_t k = checkpoints.m_interval;
+    const uint32_t block_end = std::min( block_start + k - 1, sequence_length );
+    std::vector<Row> & block = checkpoints.m_block;
+    Row & backward = checkpoints.m_backwardRow;
+    Row & next_backward = checkpoints.m_nextBackwardRow;
+    if( block.size() != k ) {
+      block.resize( k );
+      for( uint32_t block_i = 0; block_i < k; block_i++ ) {
+        block[ block_i ].reinitialize( profile_length );
+      }
+      backward.reinitialize( profile_length );
+      next_backward.reinitialize( profile_length );
+    }
+
+    block[ 0 ] = checkpoints.m_forward[ block_start / k ];
+    for( uint32_t r = block_start + 1; r <= block_end; r++ ) {
+      nextRow( block[ r - block_start - 1 ], residues[ r - 1 ], block[ r - block_start ] );
+    }
+    if( block_end == sequence_length ) {
+      lastBackwardRow( backward );
+      visitor.visitRow( block_end, block[ block_end - block_start ], backward, static_cast<Row const *>( 0 ), 1.0, checkpoints.m_inverseZ );
+    } else {
+      // The next block's first backward row.
+      next_backward = checkpoints.m_backward[ ( block_end + 1 ) / k ];
+      previousBackwardRow( next_backward, residues[ block_end ], checkpoints.m_scales[ block_end + 1 ], backward );
+      visitor.visitRow( block_end, block[ block_end - block_start ], backward, &next_backward, checkpoints.m_scales[ block_end + 1 ], checkpoints.m_inverseZ );
+    }
+    for( int64_t row_i = static_cast<int64_t>( block_end ) - 1; row_i >= block_start; row_i-- ) {
+      std::swap( backward, next_backward );
+      previousBackwardRow( next_backward, residues[ row_i ], checkpoints.m_scales[ row_i + 1 ], backward );
+      visitor.visitRow( row_i, block[ row_i - block_start ], backward, &next_backward, checkpoints.m_scales[ row_i + 1 ], checkpoints.m_inverseZ );
+    }
+  } // visitBlock( vector<uint32_t> const &, Checkpoints &, uint32_t const, VisitorType & ) const
+
+  /**
+   * Forward row 0: nothing emitted yet.
+   */
+  void
+  firstRow (
+    Row & row
+  ) const
+  {
+    const uint32_t profile_length = m_tables.m_profileLength;
+    row.m_preAlign = 1.0;
+    std::fill( row.m_match.begin(), row.m_match.end(), 0.0 );
+    std::fill( row.m_insertion.begin(), row.m_insertion.end(), 0.0 );
+    row.m_deletion[ 0 ] = 0.0;
+    row.m_deletion[ 1 ] =
+      m_tables[ ProfileTransition::PreAlignToBegin ] * m_tables[ ProfileTransition::BeginToDeletion ];
+    for( uint32_t pos = 2; pos <= profile_length; pos++ ) {
+      row.m_deletion[ pos ] = row.m_deletion[ pos - 1 ] * m_tables[ ProfileTransition::DeletionToDeletion ];
+    }
+    row.m_postAlign = row.m_deletion[ profile_length ];
+  } // firstRow( Row & ) const
+
+  /**
+   * Calculate forward row i from (scaled) row i - 1 and the i^th residue,
+   * then scale it to sum to 1.  Returns the scale (the sum before scaling).
+   */
+  double
+  nextRow (
+    Row const & prev,
+    uint32_t const residue,
+    Row & row
+  ) const
+  {
+    const uint32_t profile_length = m_tables.m_profileLength;
+    const double insertion_emission = m_tables.insertionEmission( residue );
+    const double t_md = m_tables[ ProfileTransition::MatchToDeletion ];
+    const double t_dd = m_tables[ ProfileTransition::DeletionToDeletion ];
+
+    row.m_preAlign =
+      prev.m_preAlign * m_tables[ ProfileTransition::PreAlignToPreAlign ] * insertion_emission;
+    double sum = row.m_preAlign;
+
+    // Match at pos + 1 and Insertion at pos both come from position pos of
+    // prev (see RowKernels.hpp).
+    row.m_match[ 1 ] =
+      m_tables.matchEmission( 0, residue ) *
+      prev.m_preAlign * m_tables[ ProfileTransition::PreAlignToBegin ] * m_tables[ ProfileTransition::BeginToMatch ];
+    sum += row.m_match[ 1 ];
+    sum +=
+      m_kernels.forwardMatchInsertion(
+        &prev.m_match[ 0 ] + 1,
+        &prev.m_insertion[ 0 ] + 1,
+        &prev.m_deletion[ 0 ] + 1,
+        m_tables.matchEmissions( residue ) + 1,
+        insertion_emission,
+        m_tables.m_transitions,
+        &row.m_match[ 0 ] + 2,
+        &row.m_insertion[ 0 ] + 1,
+        profile_length - 1
+      );
+
+    // Deletions depend on the states to their left in this row.  (The
+    // running value is kept in a local, so that it stays in a register.)
+    double deletion =
+      row.m_preAlign * m_tables[ ProfileTransition::PreAlignToBegin ] * m_tables[ ProfileTransition::BeginToDeletion ];
+    row.m_deletion[ 1 ] = deletion;
+    sum += deletion;
+    for( uint32_t pos = 2; pos <= profile_length; pos++ ) {
+      deletion = ( row.m_match[ pos - 1 ] * t_md ) + ( deletion * t_dd );
+      row.m_deletion[ pos ] = deletion;
+      sum += deletion;
+    }
+
+    row.m_postAlign =
+      ( prev.m_postAlign * m_tables[ ProfileTransition::PostAlignToPostAlign ] * insertion_emission ) +
+      row.m_match[ profile_length ] + row.m_deletion[ profile_length ];
+    sum += row.m_postAlign;
+
+    if( !( sum > 0 ) ) {
+      // The sequence is impossible; leave the row (all zeros) unscaled.
+      return 1.0;
+    }
+    const double inverse_sum = 1.0 / sum;
+    row.m_preAlign *= inverse_sum;
+    row.m_postAlign *= inverse_sum;
+    m_kernels.scale( &row.m_match[ 0 ] + 1, inverse_sum, profile_length );
+    m_kernels.scale( &row.m_insertion[ 0 ] + 1, inverse_sum, profile_length );
+    m_kernels.scale( &row.m_deletion[ 0 ] + 1, inverse_sum, profile_length );
+    return sum;
+  } // nextRow( Row const &, uint32_t const, Row & ) const
+
+  /**
+   * Backward row L: only the Terminal transition remains.
+   */
+  void
+  lastBackwardRow (
+    Row & row
+  ) const
+  {
+    const uint32_t profile_length = m_tables.m_profileLength;
+    const double t_md = m_tables[ ProfileTransition::MatchToDeletion ];
+    const double t_dd = m_tables[ ProfileTransition::DeletionToDeletion ];
+    row.m_postAlign = m_tables[ ProfileTransition::PostAlignToTerminal ];
+    row.m_match[ profile_length ] = row.m_postAlign;
+    row.m_deletion[ profile_length ] = row.m_postAlign;
+    row.m_insertion[ profile_length ] = 0.0;
+    for( uint32_t pos = profile_length - 1; pos >= 1; pos-- ) {
+      row.m_match[ pos ] = t_md * row.m_deletion[ pos + 1 ];
+      row.m_deletion[ pos ] = t_dd * row.m_deletion[ pos + 1 ];
+      row.m_insertion[ pos ] = 0.0;
+    }
+    row.m_preAlign =
+      m_tables[ ProfileTransition::PreAlignToBegin ] * m_tables[ ProfileTransition::BeginToDeletion ] *
+      row.m_deletion[ 1 ];
+  } // lastBackwardRow( Row & ) const
+
+  /**
+   * Calculate backward row i from backward row i + 1, the ( i + 1 )^th
+   * residue, and the scale of forward row i + 1.
+   */
+  void
+  previousBackwardRow (
+    Row const & next,
+    uint32_t const residue,
+    double const next_scale,
+    Row & row
+  ) const
+  {
+    const uint32_t profile_length = m_tables.m_profileLength;
+    const double inverse_scale = 1.0 / next_scale;
+    const double insertion_emission = m_tables.insertionEmission( residue ) * inverse_scale;
+    const double t_md = m_tables[ ProfileTransition::MatchToDeletion ];
+    const double t_dd = m_tables[ ProfileTransition::DeletionToDeletion ];
+
+    row.m_postAlign =
+      m_tables[ ProfileTransition::PostAlignToPostAlign ] * insertion_emission * next.m_postAlign;
+    row.m_match[ profile_length ] = row.m_postAlign;
+    row.m_deletion[ profile_length ] = row.m_postAlign;
+    row.m_insertion[ profile_length ] = 0.0;
+    // First the terms from the next row (all of Insertion's) ..
+    m_kernels.backwardMatchInsertion(
+      &next.m_match[ 0 ] + 2,
+      &next.m_insertion[ 0 ] + 1,
+      m_tables.matchEmissions( residue ) + 1,
+      inverse_scale,
+      insertion_emission,
+      m_tables.m_transitions,
+      &row.m_match[ 0 ] + 1,
+      &row.m_insertion[ 0 ] + 1,
+      &row.m_deletion[ 0 ] + 1,
+      profile_length - 1
+    );
+    // .. then the Deletion terms, which depend on the states to their right.
+    double next_deletion = row.m_deletion[ profile_length ];
+    for( uint32_t pos = profile_length - 1; pos >= 1; pos-- ) {
+      row.m_match[ pos ] += ( t_md * next_deletion );
+      next_deletion = row.m_deletion[ pos ] + ( t_dd * next_deletion );
+      row.m_deletion[ pos ] = next_deletion;
+    }
+    row.m_preAlign =
+      ( m_tables[ ProfileTransition::PreAlignToPreAlign ] * insertion_emission * next.m_preAlign ) +
+      ( m_tables[ ProfileTransition::PreAlignToBegin ] *
+        ( ( m_tables[ ProfileTransition::BeginToMatch ] * m_tables.matchEmission( 0, residue ) * inverse_scale * next.m_match[ 1 ] ) +
+          ( m_tables[ ProfileTransition::BeginToDeletion ] * row.m_deletion[ 1 ] ) ) );
+  } // previousBackwardRow( Row const &, uint32_t const, double const, Row & ) const
+
+}; // End class CheckpointedForwardBackward
+
+} // End namespace galosh
+
+#endif // __GALOSH_CHECKPOINTEDFORWARDBACKWARD_HPP__
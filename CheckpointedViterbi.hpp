@@ -0,0 +1,354 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      CheckpointedViterbi.hpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      Class definition for the CheckpointedViterbi class, which computes the
+##      Viterbi (most likely) path of a sequence through a profile HMM (see
+##      ProfileTables.hpp), in log space.
+##
+##      Rather than keeping the whole ( sequence length + 1 ) x ( profile
+##      length + 1 ) matrix for the traceback, it keeps only every k-th row
+##      (k defaults to the square root of the sequence length) and, during the
+##      traceback, recomputes the k rows of one block at a time from the
+##      nearest checkpoint.  No traceback pointers are stored: the predecessor
+##      of each state is found by recomputing its candidates.  This costs one
+##      extra forward pass.
+##
+##      The memory is not linear in the profile length alone, as a
+##      Hirschberg (divide and conquer) traceback's would be: it holds
+##      ( L / k ) + 1 checkpoint rows and k + 1 block rows, each of
+##      3 * ( M + 1 ) + 2 doubles, so with the default k it is
+##      O( sqrt( L ) * M ): about 2 * sqrt( L ) rows, or 780 KB for a
+##      1000-residue sequence and a 500-position profile.  That is a small,
+##      fixed multiple of the dp rows for the sequences that profiles are
+##      used with, and it keeps the traceback a plain recomputation of the
+##      forward rows (Hirschberg's would also need a backward Viterbi pass,
+##      and about twice the dp work).
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#if     _MSC_VER > 1000
+#pragma once
+#endif
+
+#ifndef __GALOSH_CHECKPOINTEDVITERBI_HPP__
+#define __GALOSH_CHECKPOINTEDVITERBI_HPP__
+
+#include "ProfileTables.hpp"
+#include "AlignmentPath.hpp"
+#include "RowKernels.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace galosh {
+
+  /**
+   * The default distance between checkpointed rows for a sequence of the
+   * given length: about its square root.
+   */
+  inline uint32_t
+  defaultCheckpointInterval (
+    uint32_t const sequence_length
+  )
+  {
+    return std::max( static_cast<uint32_t>( 1 ), static_cast<uint32_t>( std::ceil( std::sqrt( static_cast<double>( sequence_length + 1 ) ) ) ) );
+  } // defaultCheckpointInterval( uint32_t const )
+
+template <typename ResidueType,
+          typename SequenceResidueType>
+class CheckpointedViterbi {
+public:
+  typedef ProfileTables<ResidueType, SequenceResidueType> ProfileTablesType;
+
+  /**
+   * One row of the (log-space) Viterbi matrix: the values of each state after
+   * having emitted the first i residues of the sequence.  The vectors have
+   * profile length + 1 entries; entry 0 is unused.
+   */
+  struct Row {
+    double m_preAlign;
+    double m_postAlign;
+    std::vector<double> m_match;
+    std::vector<double> m_insertion;
+    std::vector<double> m_deletion;
+
+    void
+    reinitialize (
+      uint32_t const profile_length
+    )
+    {
+      m_match.resize( profile_length + 1 );
+      m_insertion.resize( profile_length + 1 );
+      m_deletion.resize( profile_length + 1 );
+    } // reinitialize( uint32_t const )
+  }; // End inner struct Row
+
+  /**
+   * The tables must have been convertToLogs()ed.  A checkpoint_interval of 0
+   * means use defaultCheckpointInterval( sequence length ).
+   */
+  CheckpointedViterbi (
+    ProfileTablesType const & log_tables,
+    uint32_t const checkpoint_interval = 0
+  ) :
+    m_tables( log_tables ),
+    m_checkpointInterval( checkpoint_interval ),
+    m_kernels( rowKernels() )
+  {
+    assert( log_tables.m_isLog );
+  } // <init>( ProfileTablesType const &, uint32_t const )
+
+  /**
+   * Calculate the Viterbi path of the given sequence, which is given as
+   * residue ordinal values (see sequenceToOrdinals(..)).  Returns the natural
+   * log of the probability of the path (-infinity if there is no path, in
+   * which case the path is left empty).
+   */
+  double
+  viterbi (
+    std::vector<uint32_t> const & residues,
+    AlignmentPath & path
+  ) const
+  {
+    const uint32_t profile_length = m_tables.m_profileLength;
+    const uint32_t sequence_length = residues.size();
+    const uint32_t k =
+      ( ( m_checkpointInterval == 0 ) ? defaultCheckpointInterval( sequence_length ) : m_checkpointInterval );
+
+    // The forward pass, keeping every k-th row.
+    std::vector<Row> checkpoints( ( sequence_length / k ) + 1 );
+    Row current, next;
+    current.reinitialize( profile_length );
+    next.reinitialize( profile_length );
+    firstRow( current );
+    checkpoints[ 0 ] = current;
+    for( uint32_t row_i = 1; row_i <= sequence_length; row_i++ ) {
+      nextRow( current, residues[ row_i - 1 ], next );
+      std::swap( current, next );
+      if( ( row_i % k ) == 0 ) {
+        checkpoints[ row_i / k ] = current;
+      }
+    }
+    const double score =
+      current.m_postAlign + m_tables[ ProfileTransition::PostAlignToTerminal ];
+
+    path.clear();
+    if( score == -std::numeric_limits<double>::infinity() ) {
+      return score;
+    }
+
+    // The traceback.  block holds rows block_start .. block_start + k.
+    std::vector<Row> block( k + 1 );
+    for( uint32_t block_i = 0; block_i <= k; block_i++ ) {
+      block[ block_i ].reinitialize( profile_length );
+    }
+    int64_t block_start = -1;
+
+    uint8_t state = PathState::PostAlign;
+    uint32_t row_i = sequence_length;
+    uint32_t pos = profile_length;
+    while( true ) {
+      // Make sure that rows row_i and row_i - 1 are available.
+      const uint32_t needed_start = ( ( row_i == 0 ) ? 0 : ( ( ( row_i - 1 ) / k ) * k ) );
+      if( block_start != needed_start ) {
+        block_start = needed_start;
+        block[ 0 ] = checkpoints[ needed_start / k ];
+        const uint32_t block_end = std::min( needed_start + k, sequence_length );
+        for( uint32_t r = needed_start + 1; r <= block_end; r++ ) {
+          nextRow( block[ r - needed_start - 1 ], residues[ r - 1 ], block[ r - needed_start ] );
+        }
+      }
+      Row const & row = block[ row_i - block_start ];
+      Row const * prev = ( ( row_i == 0 ) ? 0 : &block[ row_i - block_start - 1 ] );
+
+      if( state == PathState::PreAlign ) {
+        // The remaining residues are all PreAlign.
+        for( ; row_i > 0; row_i-- ) {
+          path.push_back( PathState::PreAlign );
+        }
+        break;
+      }
+      if( state == PathState::PostAlign ) {
+        const double from_end = std::max( row.m_match[ profile_length ], row.m_deletion[ profile_length ] );
+        if( ( row_i > 0 ) &&
+            ( ( prev->m_postAlign + m_tables[ ProfileTransition::PostAlignToPostAlign ] + m_tables.insertionEmission( residues[ row_i - 1 ] ) ) > from_end ) ) {
+          path.push_back( PathState::PostAlign );
+          row_i -= 1;
+        } else {
+          // Leave via End.
+          pos = profile_length;
+          state =
+            ( ( row.m_match[ profile_length ] >= row.m_deletion[ profile_length ] ) ? PathState::Match : PathState::Deletion );
+        }
+        continue;
+      }
+      path.push_back( state );
+      if( state == PathState::Match ) {
+        if( pos == 1 ) {
+          state = PathState::PreAlign;
+        } else {
+          state =
+            bestOf3(
+              prev->m_match[ pos - 1 ] + m_tables[ ProfileTransition::MatchToMatch ],
+              prev->m_insertion[ pos - 1 ] + m_tables[ ProfileTransition::InsertionToMatch ],
+              prev->m_deletion[ pos - 1 ] + m_tables[ ProfileTransition::DeletionToMatch ]
+            );
+          pos -= 1;
+        }
+        row_i -= 1;
+      } else if( state == PathState::Insertion ) {
+        state =
+          ( ( ( prev->m_match[ pos ] + m_tables[ ProfileTransition::MatchToInsertion ] ) >=
+              ( prev->m_insertion[ pos ] + m_tables[ ProfileTransition::InsertionToInsertion ] ) ) ?
+            PathState::Match : PathState::Insertion );
+        row_i -= 1;
+      } else { // state == PathState::Deletion
+        if( pos == 1 ) {
+          state = PathState::PreAlign;
+        } else {
+          state =
+            ( ( ( row.m_match[ pos - 1 ] + m_tables[ ProfileTransition::MatchToDeletion ] ) >=
+                ( row.m_deletion[ pos - 1 ] + m_tables[ ProfileTransition::DeletionToDeletion ] ) ) ?
+              PathState::Match : PathState::Deletion );
+          pos -= 1;
+        }
+      }
+    } // End while tracing back
+
+    std::reverse( path.begin(), path.end() );
+    return score;
+  } // viterbi( vector<uint32_t> const &, AlignmentPath & ) const
+
+protected:
+  ProfileTablesType const & m_tables;
+  uint32_t m_checkpointInterval;
+  RowKernels const & m_kernels;
+
+  static inline uint8_t
+  bestOf3 (
+    double const from_match,
+    double const from_insertion,
+    double const from_deletion
+  )
+  {
+    if( ( from_match >= from_insertion ) && ( from_match >= from_deletion ) ) {
+      return PathState::Match;
+    }
+    return ( ( from_insertion >= from_deletion ) ? PathState::Insertion : PathState::Deletion );
+  } // bestOf3( double const, double const, double const )
+
+  /**
+   * Row 0: nothing emitted yet.  Only PreAlign, the Deletion states reachable
+   * from Begin, and (through End) PostAlign are possible.
+   */
+  void
+  firstRow (
+    Row & row
+  ) const
+  {
+    const uint32_t profile_length = m_tables.m_profileLength;
+    const double neg_inf = -std::numeric_limits<double>::infinity();
+    row.m_preAlign = 0;
+    std::fill( row.m_match.begin(), row.m_match.end(), neg_inf );
+    std::fill( row.m_insertion.begin(), row.m_insertion.end(), neg_inf );
+    row.m_deletion[ 0 ] = neg_inf;
+    row.m_deletion[ 1 ] =
+      row.m_preAlign + m_tables[ ProfileTransition::PreAlignToBegin ] + m_tables[ ProfileTransition::BeginToDeletion ];
+    for( uint32_t pos = 2; pos <= profile_length; pos++ ) {
+      row.m_deletion[ pos ] = row.m_deletion[ pos - 1 ] + m_tables[ ProfileTransition::DeletionToDeletion ];
+    }
+    row.m_postAlign = row.m_deletion[ profile_length ];
+  } // firstRow( Row & ) const
+
+  /**
+   * Calculate row i from row i - 1 and the i^th residue.
+   */
+  void
+  nextRow (
+    Row const & prev,
+    uint32_t const residue,
+    Row & row
+  ) const
+  {
+    const uint32_t profile_length = m_tables.m_profileLength;
+    const double neg_inf = -std::numeric_limits<double>::infinity();
+    const double insertion_emission = m_tables.insertionEmission( residue );
+    const double t_md = m_tables[ ProfileTransition::MatchToDeletion ];
+    const double t_dd = m_tables[ ProfileTransition::DeletionToDeletion ];
+
+    row.m_preAlign =
+      prev.m_preAlign + m_tables[ ProfileTransition::PreAlignToPreAlign ] + insertion_emission;
+
+    // Match and Insertion depend only on the previous row: Match at pos + 1
+    // and Insertion at pos both come from position pos of prev.
+    row.m_match[ 0 ] = neg_inf;
+    row.m_insertion[ 0 ] = neg_inf;
+    row.m_match[ 1 ] =
+      m_tables.matchEmission( 0, residue ) +
+      prev.m_preAlign + m_tables[ ProfileTransition::PreAlignToBegin ] + m_tables[ ProfileTransition::BeginToMatch ];
+    m_kernels.viterbiMatchInsertion(
+      &prev.m_match[ 0 ] + 1,
+      &prev.m_insertion[ 0 ] + 1,
+      &prev.m_deletion[ 0 ] + 1,
+      m_tables.matchEmissions( residue ) + 1,
+      insertion_emission,
+      m_tables.m_transitions,
+      &row.m_match[ 0 ] + 2,
+      &row.m_insertion[ 0 ] + 1,
+      profile_length - 1
+    );
+    row.m_insertion[ profile_length ] = neg_inf;
+
+    // Deletions depend on the states to their left in this row.  (The
+    // running value is kept in a local, so that it stays in a register.)
+    row.m_deletion[ 0 ] = neg_inf;
+    double deletion =
+      row.m_preAlign + m_tables[ ProfileTransition::PreAlignToBegin ] + m_tables[ ProfileTransition::BeginToDeletion ];
+    row.m_deletion[ 1 ] = deletion;
+    for( uint32_t pos = 2; pos <= profile_length; pos++ ) {
+      deletion = std::max( row.m_match[ pos - 1 ] + t_md, deletion + t_dd );
+      row.m_deletion[ pos ] = deletion;
+    }
+
+    row.m_postAlign =
+      std::max(
+        prev.m_postAlign + m_tables[ ProfileTransition::PostAlignToPostAlign ] + insertion_emission,
+        std::max( row.m_match[ profile_length ], row.m_deletion[ profile_length ] )
+      );
+  } // nextRow( Row const &, uint32_t const, Row & ) const
+
+}; // End class CheckpointedViterbi
+
+} // End namespace galosh
+
+#endif // __GALOSH_CHECKPOINTEDVITERBI_HPP__
@@ -9,6 +9,9 @@
 ##      The createRandomSequence program.  It creates a sequence of a specified
 ##      length by drawing from a discrete distribution over the DNA alphabet.
 ##
+##      The residues are drawn through an alias table (see AliasTable.hpp),
+##      so each costs one uniform deviate and one comparison.
+##
 ##      NOTE: At present this supports only DNA, not AminoAcids.
 ##
 #******************************************************************************
@@ -41,6 +44,7 @@
 #include "Sequence.hpp"
 #include "Random.hpp"
 #include "Algebra.hpp"
+#include "AliasTable.hpp"
 
 #include <iostream>
 
@@ -70,18 +74,18 @@ createRandomSequence (
   Sequence<Dna> & sequence
 )
 {
-  MultinomialDistribution<Dna,ProbabilityType> residue_dist;
-
-  Dna residue;
-  residue_dist[ ( residue = 'a' ) ] = a_prob;
-  residue_dist[ ( residue = 'c' ) ] = c_prob;
-  residue_dist[ ( residue = 'g' ) ] = g_prob;
-  residue_dist[ ( residue = 't' ) ] = t_prob;
-  residue_dist.normalize(); // in case they don't add to 1..
+  // In Dna ordinal order; the table normalizes, in case they don't add to 1..
+  const double residue_weights[ 4 ] = {
+    toDouble( a_prob ),
+    toDouble( c_prob ),
+    toDouble( g_prob ),
+    toDouble( t_prob )
+  };
+  const AliasTable residue_table( residue_weights, 4 );
 
   sequence.reinitialize( length );
   for( uint32_t i = 0; i < length; i++ ) {
-    sequence[ i ] = residue_dist.draw( random );
+    sequence[ i ] = Dna( residue_table.draw( random ) );
   }
 
   return;
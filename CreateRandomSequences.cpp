@@ -0,0 +1,297 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      CreateRandomSequences.cpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      The createRandomSequences program.  It creates any number of sequences
+##      of a specified length (up to chromosome scale) by drawing i.i.d.
+##      residues from a discrete distribution over the residue alphabet, in
+##      parallel (see RandomSequenceGenerator.hpp), writing them as they are
+##      drawn, in Fasta format or (for DNA) the UCSC .2bit format.  The output
+##      for a given seed is identical for any number of threads.
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#include "RandomSequenceGenerator.hpp"
+#include "ParallelFor.hpp"
+
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <seqan/basic.h>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/program_options.hpp>
+
+#ifdef __HAVE_MUSCLE
+int g_argc;
+char **g_argv;
+#endif // __HAVE_MUSCLE
+
+namespace po = boost::program_options;
+
+using namespace seqan;
+using namespace std;
+
+/**
+ * The parallelFor body: draws chunk number first_chunk + batch_i (counting
+ * all of the chunks of all of the sequences) into slot batch_i.
+ */
+template <typename ResidueType>
+class GenerateBody {
+public:
+  GenerateBody (
+    galosh::RandomSequenceGenerator<ResidueType> const & generator,
+    uint64_t const first_chunk,
+    std::vector<std::vector<uint8_t> > & chunks
+  ) :
+    m_generator( generator ),
+    m_firstChunk( first_chunk ),
+    m_chunks( chunks )
+  {
+    // Do nothing else.
+  } // <init>( .. )
+
+  void
+  operator() (
+    size_t const batch_i,
+    uint32_t const thread_i
+  )
+  {
+    const uint64_t chunk_number = m_firstChunk + batch_i;
+    m_generator.generateChunk(
+      ( chunk_number / m_generator.chunksPerSequence() ),
+      ( chunk_number % m_generator.chunksPerSequence() ),
+      m_chunks[ batch_i ],
+      m_randomBits
+    );
+  } // operator()( size_t const, uint32_t const )
+
+protected:
+  galosh::RandomSequenceGenerator<ResidueType> const & m_generator;
+  uint64_t m_firstChunk;
+  std::vector<std::vector<uint8_t> > & m_chunks;
+  std::vector<uint32_t> m_randomBits; // Per-thread scratch space.
+}; // End class GenerateBody
+
+int
+main ( int const argc, char const ** argv )
+{
+#ifdef __PROFUSE_USE_AMINOS
+  typedef seqan::AminoAcid20 ResidueType;
+#else // __PROFUSE_USE_AMINOS .. else
+  typedef seqan::Dna ResidueType;
+#endif // __PROFUSE_USE_AMINOS .. else ..
+  enum { AlphabetSize = seqan::ValueSize<ResidueType>::VALUE };
+
+  try {
+    po::options_description visible( "Basic options" );
+    visible.add_options()
+      ( "help,h", "produce help message" )
+      ( "length,l",
+        po::value<uint64_t>(),
+        "length of each sequence" )
+      ( "nseq,n",
+        po::value<uint64_t>()->default_value( 1 ),
+        "number of sequences to create" )
+      ( "output,o",
+        po::value<string>(),
+        "filename: where to write the sequences (default: standard output)" )
+      ( "seed,r",
+        po::value<uint64_t>(),
+        "random seed (default: the current time)" )
+      ( "probabilities,P",
+        po::value<string>(),
+        "the residue distribution, as comma-separated weights in alphabet order (eg. A,C,G,T); they needn't add to 1 (default: uniform)" )
+      ( "format,f",
+        po::value<string>()->default_value( "fasta" ),
+        "output format: fasta, or (DNA only) 2bit, the UCSC .2bit format" )
+      ( "name",
+        po::value<string>()->default_value( "Randomly generated sequence #" ),
+        "each sequence is named this followed by its number" )
+      ( "line-width",
+        po::value<uint32_t>()->default_value( 60 ),
+        "residues per Fasta line (0 means one line per sequence)" )
+      ( "threads,t",
+        po::value<uint32_t>()->default_value( 0 ),
+        "number of threads (0, the default, means one per core); the output doesn't depend on it" )
+      ( "chunk-length",
+        po::value<uint32_t>()->default_value( galosh::RandomSequenceGenerator<ResidueType>::DefaultChunkLength ),
+        "residues per independently-drawn chunk (a multiple of 4); the output depends on it" )
+      ( "batch-chunks",
+        po::value<uint32_t>()->default_value( 64 ),
+        "number of chunks to draw (in parallel) before writing them out; memory use is proportional to this" )
+      ;
+
+    po::positional_options_description p;
+    p.add( "length", 1 );
+    p.add( "nseq", 1 );
+    p.add( "output", 1 );
+    p.add( "seed", 1 );
+
+    po::variables_map vm;
+    store( po::command_line_parser( argc, argv ).options( visible ).positional( p ).run(), vm );
+    notify( vm );
+
+#define USAGE() " " << argv[ 0 ] << " [options] <length> [<num seqs> [<output filename> [<random seed>]]]"
+
+    if( vm.count( "help" ) > 0 ) {
+      cout << "Usage: " << USAGE() << endl;
+      cout << visible << "\n";
+      return 0;
+    }
+    if( vm.count( "length" ) == 0 ) {
+      cout << "Usage: " << USAGE() << endl;
+      exit( 1 );
+    }
+
+    const uint64_t sequence_length = vm[ "length" ].as<uint64_t>();
+    const uint64_t sequence_count = vm[ "nseq" ].as<uint64_t>();
+    const uint64_t random_seed =
+      ( vm.count( "seed" ) ? vm[ "seed" ].as<uint64_t>() : static_cast<uint64_t>( std::time( NULL ) ) );
+    const string format = vm[ "format" ].as<string>();
+    const string name_prefix = vm[ "name" ].as<string>();
+    const uint32_t thread_count = vm[ "threads" ].as<uint32_t>();
+    const uint32_t batch_chunks = std::max( static_cast<uint32_t>( 1 ), vm[ "batch-chunks" ].as<uint32_t>() );
+    if( sequence_length == 0 ) {
+      cerr << "The sequence length must be positive." << endl;
+      exit( 1 );
+    }
+    const bool use_two_bit = ( format == "2bit" );
+    if( !use_two_bit && ( format != "fasta" ) ) {
+      cerr << "Unknown output format '" << format << "': use fasta or 2bit." << endl;
+      exit( 1 );
+    }
+    if( use_two_bit && ( AlphabetSize != 4 ) ) {
+      cerr << "The 2bit format is only for DNA." << endl;
+      exit( 1 );
+    }
+
+    std::vector<double> residue_weights( AlphabetSize, 1.0 );
+    if( vm.count( "probabilities" ) ) {
+      const string weights_string = vm[ "probabilities" ].as<string>();
+      residue_weights.clear();
+      string::size_type start = 0;
+      while( true ) {
+        const string::size_type comma = weights_string.find( ',', start );
+        const string weight_string = weights_string.substr( start, ( ( comma == string::npos ) ? string::npos : ( comma - start ) ) );
+        try {
+          residue_weights.push_back( boost::lexical_cast<double>( weight_string ) );
+        } catch( boost::bad_lexical_cast & ) {
+          cerr << "Unable to interpret '" << weight_string << "' as a real value for use as a residue probability." << endl;
+          exit( 1 );
+        } // End try .. catch block for lexical_cast
+        if( comma == string::npos ) {
+          break;
+        }
+        start = comma + 1;
+      }
+      if( residue_weights.size() != AlphabetSize ) {
+        cerr << "Expected " << AlphabetSize << " residue probabilities, but got " << residue_weights.size() << "." << endl;
+        exit( 1 );
+      }
+    } // End if probabilities were given
+
+    const galosh::RandomSequenceGenerator<ResidueType> generator(
+      residue_weights,
+      random_seed,
+      sequence_length,
+      vm[ "chunk-length" ].as<uint32_t>()
+    );
+
+    std::ofstream output_file_stream;
+    if( vm.count( "output" ) ) {
+      output_file_stream.open( vm[ "output" ].as<string>().c_str(), std::ios::out | std::ios::binary );
+      if( !output_file_stream.good() ) {
+        cerr << "The output file '" << vm[ "output" ].as<string>() << "' could not be opened." << endl;
+        exit( 1 );
+      }
+    }
+    std::ostream & output_stream = ( vm.count( "output" ) ? static_cast<std::ostream &>( output_file_stream ) : cout );
+
+    if( use_two_bit ) {
+      std::vector<string> names( sequence_count );
+      for( uint64_t seq_i = 0; seq_i < sequence_count; seq_i++ ) {
+        names[ seq_i ] = name_prefix + boost::lexical_cast<string>( seq_i );
+      }
+      galosh::TwoBit::writeHeader( output_stream, names, sequence_length );
+    }
+    galosh::FastaLineWriter<ResidueType> fasta_writer( output_stream, vm[ "line-width" ].as<uint32_t>() );
+    std::vector<char> packed;
+
+    const uint64_t chunks_per_sequence = generator.chunksPerSequence();
+    const uint64_t total_chunks = sequence_count * chunks_per_sequence;
+    std::vector<std::vector<uint8_t> > chunks( std::min( static_cast<uint64_t>( batch_chunks ), total_chunks ) );
+    for( uint64_t first_chunk = 0; first_chunk < total_chunks; first_chunk += batch_chunks ) {
+      const size_t batch_size = std::min( static_cast<uint64_t>( batch_chunks ), ( total_chunks - first_chunk ) );
+      galosh::parallelFor(
+        batch_size,
+        thread_count,
+        GenerateBody<ResidueType>( generator, first_chunk, chunks )
+      );
+      for( size_t batch_i = 0; batch_i < batch_size; batch_i++ ) {
+        const uint64_t seq_i = ( first_chunk + batch_i ) / chunks_per_sequence;
+        const uint64_t chunk_i = ( first_chunk + batch_i ) % chunks_per_sequence;
+        if( use_two_bit ) {
+          if( chunk_i == 0 ) {
+            galosh::TwoBit::beginSequence( output_stream, sequence_length );
+          }
+          galosh::TwoBit::writePacked( output_stream, chunks[ batch_i ], packed );
+        } else {
+          if( chunk_i == 0 ) {
+            fasta_writer.beginSequence( name_prefix + boost::lexical_cast<string>( seq_i ) );
+          }
+          fasta_writer.write( chunks[ batch_i ] );
+          if( chunk_i == ( chunks_per_sequence - 1 ) ) {
+            fasta_writer.endSequence();
+          }
+        }
+      }
+      if( !output_stream.good() ) {
+        cerr << "Unable to write the sequences." << endl;
+        exit( 1 );
+      }
+    } // End foreach batch
+    output_stream.flush();
+    if( vm.count( "output" ) ) {
+      output_file_stream.close();
+    }
+  } catch( std::exception& e ) { /// exceptions thrown by boost stuff
+    cerr << "error: " << e.what() << endl;
+    return 1;
+  } catch( string &err ) {      /// exceptions thrown by RandomSequenceGenerator, parallelFor, etc.
+    cerr << "error: " << err << endl;
+    return 1;
+  }
+
+  return 0; // success
+} // main (..)
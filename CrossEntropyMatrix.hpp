@@ -0,0 +1,390 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      CrossEntropyMatrix.hpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      Class definition for the CrossEntropyMatrix class, which computes the
+##      cross entropies between all pairs of a collection of profiles.
+##
+##      The cross entropy H( p, q ) of profile p with profile q is the sum,
+##      over all of the profiles' distributions (each position's Match
+##      emission distribution, the Insertion emission distribution, and the
+##      transition distributions), of -sum_x p( x ) log q( x ).  Flattening
+##      each profile's parameters into one vector P (see
+##      ProfileTables::toParameters(..)), that is -( P_p . log P_q ), so the
+##      whole matrix is (minus) a matrix product of the parameter vectors
+##      with their logs.  It is computed in cache-sized blocks: for each tile
+##      of rows, for each block of columns and of parameters, an inner loop
+##      over contiguous columns (of the transposed logs) that the compiler can
+##      vectorize.  Each entry's sum is accumulated in the same order whatever
+##      the number of threads.
+##
+##      Profiles of different lengths aren't comparable; their cross entropy
+##      is reported as infinity.  A zero probability's log is replaced by
+##      ZeroLog (a huge but finite negative number) so that 0 log 0 is 0;
+##      results beyond InfinityThreshold (only possible when q( x ) is 0 but
+##      p( x ) isn't) are reported as infinity.
+##
+##      Also here is the binary format for the matrix (see writeHeader(..)),
+##      and a helper for the k nearest neighbors of each profile.
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#if     _MSC_VER > 1000
+#pragma once
+#endif
+
+#ifndef __GALOSH_CROSSENTROPYMATRIX_HPP__
+#define __GALOSH_CROSSENTROPYMATRIX_HPP__
+
+#include "ProfileTables.hpp"
+#include "ParallelFor.hpp"
+#include "LittleEndian.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+namespace galosh {
+
+  static const char CROSS_ENTROPY_MATRIX_MAGIC[ 8 ] = { 'P', 'R', 'F', 'X', 'E', 'N', 'T', '1' };
+  static const uint32_t CROSS_ENTROPY_MATRIX_VERSION = 1;
+
+template <typename ResidueType>
+class CrossEntropyMatrix {
+public:
+  /// Rows are computed RowTile at a time, against ColumnBlock columns and
+  /// DepthBlock parameters at a time (a block of the transposed logs is
+  /// DepthBlock * ColumnBlock doubles).
+  enum { RowTile = 8, ColumnBlock = 256, DepthBlock = 64 };
+
+  static double
+  ZeroLog ()
+  {
+    return -1.0E300;
+  } // ZeroLog()
+
+  static double
+  InfinityThreshold ()
+  {
+    return 1.0E200;
+  } // InfinityThreshold()
+
+  CrossEntropyMatrix () :
+    m_profiles(),
+    m_groups(),
+    m_groupOfDimension(),
+    m_isPrepared( false )
+  {
+    // Do nothing else.
+  } // <init>()
+
+  /**
+   * Add a profile (its parameters are copied).
+   */
+  template <typename ProfileType>
+  void
+  add (
+    ProfileType const & profile
+  )
+  {
+    const ProfileTables<ResidueType, ResidueType> tables( profile );
+    ProfileEntry entry;
+    tables.toParameters( entry.m_parameters );
+    entry.m_logs.resize( entry.m_parameters.size() );
+    for( size_t param_i = 0; param_i < entry.m_parameters.size(); param_i++ ) {
+      entry.m_logs[ param_i ] =
+        ( ( entry.m_parameters[ param_i ] > 0 ) ? std::log( entry.m_parameters[ param_i ] ) : ZeroLog() );
+    }
+    // Profiles are comparable only with those of the same length (and so
+    // the same number of parameters).
+    const size_t dimension = entry.m_parameters.size();
+    std::map<size_t, size_t>::const_iterator it = m_groupOfDimension.find( dimension );
+    if( it == m_groupOfDimension.end() ) {
+      m_groupOfDimension[ dimension ] = m_groups.size();
+      m_groups.push_back( Group() );
+      m_groups.back().m_dimension = dimension;
+      entry.m_group = m_groups.size() - 1;
+    } else {
+      entry.m_group = it->second;
+    }
+    m_groups[ entry.m_group ].m_members.push_back( m_profiles.size() );
+    m_profiles.push_back( entry );
+    m_isPrepared = false;
+  } // add( ProfileType const & )
+
+  size_t
+  size () const
+  {
+    return m_profiles.size();
+  } // size() const
+
+  /**
+   * Compute rows first_row .. first_row + row_count - 1 of the matrix into
+   * rows (row-major, size() columns each), using thread_count threads.  If
+   * symmetrize is true, each entry is ( H( i, j ) + H( j, i ) ) / 2.
+   */
+  void
+  computeRows (
+    size_t const first_row,
+    size_t const row_count,
+    bool const symmetrize,
+    uint32_t const thread_count,
+    std::vector<double> & rows
+  )
+  {
+    prepare();
+    rows.assign( row_count * m_profiles.size(), std::numeric_limits<double>::infinity() );
+    const size_t tile_count = ( ( row_count + RowTile - 1 ) / RowTile );
+    parallelFor( tile_count, thread_count, RowTileBody( *this, first_row, row_count, symmetrize, rows ) );
+  } // computeRows( size_t const, size_t const, bool const, uint32_t const, vector<double> & )
+
+protected:
+  struct ProfileEntry {
+    std::vector<double> m_parameters;
+    std::vector<double> m_logs;
+    size_t m_group;
+  }; // End inner struct ProfileEntry
+
+  /**
+   * The profiles with a given number of parameters, with their parameters
+   * and logs transposed (parameter-major), so that a parameter's values for
+   * consecutive members are contiguous.
+   */
+  struct Group {
+    size_t m_dimension;
+    std::vector<size_t> m_members;
+    std::vector<double> m_transposedParameters;
+    std::vector<double> m_transposedLogs;
+  }; // End inner struct Group
+
+  void
+  prepare ()
+  {
+    if( m_isPrepared ) {
+      return;
+    }
+    for( size_t group_i = 0; group_i < m_groups.size(); group_i++ ) {
+      Group & group = m_groups[ group_i ];
+      const size_t member_count = group.m_members.size();
+      group.m_transposedParameters.resize( group.m_dimension * member_count );
+      group.m_transposedLogs.resize( group.m_dimension * member_count );
+      for( size_t member_i = 0; member_i < member_count; member_i++ ) {
+        ProfileEntry const & entry = m_profiles[ group.m_members[ member_i ] ];
+        for( size_t param_i = 0; param_i < group.m_dimension; param_i++ ) {
+          group.m_transposedParameters[ ( param_i * member_count ) + member_i ] = entry.m_parameters[ param_i ];
+          group.m_transposedLogs[ ( param_i * member_count ) + member_i ] = entry.m_logs[ param_i ];
+        }
+      }
+    }
+    m_isPrepared = true;
+  } // prepare()
+
+  /**
+   * The parallelFor body: computes the rows in tile tile_i (of RowTile
+   * rows), against the members of each row's group.
+   */
+  class RowTileBody {
+  public:
+    RowTileBody (
+      CrossEntropyMatrix const & matrix,
+      size_t const first_row,
+      size_t const row_count,
+      bool const symmetrize,
+      std::vector<double> & rows
+    ) :
+      m_matrix( matrix ),
+      m_firstRow( first_row ),
+      m_rowCount( row_count ),
+      m_symmetrize( symmetrize ),
+      m_rows( rows )
+    {
+      // Do nothing else.
+    } // <init>( .. )
+
+    void
+    operator() (
+      size_t const tile_i,
+      uint32_t const thread_i
+    )
+    {
+      const size_t profile_count = m_matrix.m_profiles.size();
+      const size_t first_tile_row = tile_i * RowTile;
+      const size_t last_tile_row = std::min( ( first_tile_row + RowTile ), m_rowCount );
+      // Rows in the same group share the blocks of their group's members;
+      // handle each group's rows together.
+      for( size_t group_i = 0; group_i < m_matrix.m_groups.size(); group_i++ ) {
+        Group const & group = m_matrix.m_groups[ group_i ];
+        const size_t member_count = group.m_members.size();
+        m_tileRows.clear();
+        for( size_t row_i = first_tile_row; row_i < last_tile_row; row_i++ ) {
+          if( m_matrix.m_profiles[ m_firstRow + row_i ].m_group == group_i ) {
+            m_tileRows.push_back( row_i );
+          }
+        }
+        if( m_tileRows.empty() ) {
+          continue;
+        }
+        m_sums.assign( m_tileRows.size() * member_count, 0.0 );
+        for( size_t first_member = 0; first_member < member_count; first_member += ColumnBlock ) {
+          const size_t block_members = std::min( static_cast<size_t>( ColumnBlock ), ( member_count - first_member ) );
+          for( size_t first_param = 0; first_param < group.m_dimension; first_param += DepthBlock ) {
+            const size_t last_param = std::min( ( first_param + DepthBlock ), group.m_dimension );
+            for( size_t tile_row_i = 0; tile_row_i < m_tileRows.size(); tile_row_i++ ) {
+              ProfileEntry const & entry = m_matrix.m_profiles[ m_firstRow + m_tileRows[ tile_row_i ] ];
+              double * sums = &m_sums[ ( tile_row_i * member_count ) + first_member ];
+              for( size_t param_i = first_param; param_i < last_param; param_i++ ) {
+                const double p = entry.m_parameters[ param_i ];
+                double const * other_logs = &group.m_transposedLogs[ ( param_i * member_count ) + first_member ];
+                for( size_t member_i = 0; member_i < block_members; member_i++ ) {
+                  sums[ member_i ] += p * other_logs[ member_i ];
+                }
+                if( m_symmetrize ) {
+                  const double log_p = entry.m_logs[ param_i ];
+                  double const * other_parameters = &group.m_transposedParameters[ ( param_i * member_count ) + first_member ];
+                  for( size_t member_i = 0; member_i < block_members; member_i++ ) {
+                    sums[ member_i ] += log_p * other_parameters[ member_i ];
+                  }
+                }
+              } // End foreach param_i
+            } // End foreach tile_row_i
+          } // End foreach block of parameters
+        } // End foreach block of members
+        const double scale = ( m_symmetrize ? -0.5 : -1.0 );
+        for( size_t tile_row_i = 0; tile_row_i < m_tileRows.size(); tile_row_i++ ) {
+          double * row = &m_rows[ m_tileRows[ tile_row_i ] * profile_count ];
+          double const * sums = &m_sums[ tile_row_i * member_count ];
+          for( size_t member_i = 0; member_i < member_count; member_i++ ) {
+            const double cross_entropy = scale * sums[ member_i ];
+            row[ group.m_members[ member_i ] ] =
+              ( ( cross_entropy > InfinityThreshold() ) ? std::numeric_limits<double>::infinity() : cross_entropy );
+          }
+        }
+      } // End foreach group_i
+    } // operator()( size_t const, uint32_t const )
+
+  protected:
+    CrossEntropyMatrix const & m_matrix;
+    size_t m_firstRow;
+    size_t m_rowCount;
+    bool m_symmetrize;
+    std::vector<double> & m_rows;
+    std::vector<size_t> m_tileRows; // Per-thread scratch space.
+    std::vector<double> m_sums; // Per-thread scratch space.
+  }; // End inner class RowTileBody
+
+  std::vector<ProfileEntry> m_profiles;
+  std::vector<Group> m_groups;
+  std::map<size_t, size_t> m_groupOfDimension;
+  bool m_isPrepared;
+
+}; // End class CrossEntropyMatrix
+
+  /**
+   * Write the header of a binary cross entropy matrix file: the magic bytes
+   * "PRFXENT1"; the version, the flags (1 if symmetrized), and the number of
+   * profiles N (uint32, uint32, uint64); then each profile's name (uint32
+   * length, then the bytes).  The N rows of N doubles follow, in order (see
+   * writeCrossEntropyMatrixRows(..)).  All are little-endian.
+   */
+  inline void
+  writeCrossEntropyMatrixHeader (
+    std::ostream & os,
+    std::vector<std::string> const & names,
+    bool const symmetrized
+  )
+  {
+    os.write( CROSS_ENTROPY_MATRIX_MAGIC, sizeof( CROSS_ENTROPY_MATRIX_MAGIC ) );
+    writeLittleEndian( os, CROSS_ENTROPY_MATRIX_VERSION, 4 );
+    writeLittleEndian( os, ( symmetrized ? 1 : 0 ), 4 );
+    writeLittleEndian( os, names.size(), 8 );
+    for( size_t name_i = 0; name_i < names.size(); name_i++ ) {
+      writeLittleEndian( os, names[ name_i ].length(), 4 );
+      os.write( names[ name_i ].data(), names[ name_i ].length() );
+    }
+  } // writeCrossEntropyMatrixHeader( ostream &, vector<string> const &, bool const )
+
+  /**
+   * Write the given count matrix entries (rows of the matrix, after the
+   * header), each as the little-endian IEEE 754 bits of its double.
+   */
+  inline void
+  writeCrossEntropyMatrixRows (
+    std::ostream & os,
+    double const * values,
+    size_t const count
+  )
+  {
+    std::vector<uint8_t> bytes;
+    bytes.reserve( count * sizeof( double ) );
+    for( size_t value_i = 0; value_i < count; value_i++ ) {
+      uint64_t bits;
+      std::memcpy( &bits, &values[ value_i ], sizeof( bits ) );
+      appendLittleEndian( bytes, bits, 8 );
+    }
+    if( !bytes.empty() ) {
+      os.write( reinterpret_cast<char const *>( &bytes[ 0 ] ), bytes.size() );
+    }
+  } // writeCrossEntropyMatrixRows( ostream &, double const *, size_t const )
+
+  /**
+   * Find the (at most) k other profiles with the smallest finite values in
+   * the given matrix row (that of profile row_i), nearest first (ties go to
+   * the lower index).
+   */
+  inline void
+  nearestNeighbors (
+    double const * row,
+    size_t const profile_count,
+    size_t const row_i,
+    size_t const k,
+    std::vector<std::pair<double, size_t> > & neighbors
+  )
+  {
+    neighbors.clear();
+    for( size_t col_i = 0; col_i < profile_count; col_i++ ) {
+      if( ( col_i != row_i ) && ( row[ col_i ] < std::numeric_limits<double>::infinity() ) ) {
+        neighbors.push_back( std::make_pair( row[ col_i ], col_i ) );
+      }
+    }
+    const size_t keep = std::min( k, neighbors.size() );
+    std::partial_sort( neighbors.begin(), neighbors.begin() + keep, neighbors.end() );
+    neighbors.resize( keep );
+  } // nearestNeighbors( double const *, size_t const, size_t const, size_t const, vector<pair<double, size_t> > & )
+
+} // End namespace galosh
+
+#endif // __GALOSH_CROSSENTROPYMATRIX_HPP__
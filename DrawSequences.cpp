@@ -9,6 +9,14 @@
 ##      The drawSequences program.  It draws sequences from a distribution
 ##      represented in a Profile HMM (found in a profile file).
 ##
+##      Each sequence is drawn with its own counter-based random stream
+##      (Philox, keyed by the seed and the sequence's number), in parallel, so
+##      the output for a given seed is identical for any number of threads.
+##      Sequences are drawn and written in batches, in order, so memory use
+##      doesn't grow with the number of sequences.  The true paths can be
+##      written alongside, as text (--paths) or as a compact, indexed binary
+##      sidecar (--path-sidecar; see PathSidecar.hpp), in the same pass.
+##
 #******************************************************************************
 #*
 #*    This file is part of profuse, a suite of programs for working with
@@ -36,21 +44,112 @@
 
 #include "Algebra.hpp"
 #include "Profile.hpp"
-#include "DynamicProgramming.hpp"
-#include "Fasta.hpp"
-#include "Random.hpp"
+#include "ProfileSampler.hpp"
+#include "Philox.hpp"
+#include "ParallelFor.hpp"
+#include "PathSidecar.hpp"
 
+#include <algorithm>
+#include <ctime>
 #include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
 
 #include <seqan/basic.h>
 
+#include <boost/lexical_cast.hpp>
+#include <boost/program_options.hpp>
+
 #ifdef __HAVE_MUSCLE
 int g_argc;
 char **g_argv;
 #endif // __HAVE_MUSCLE
 
+namespace po = boost::program_options;
+
 using namespace seqan;
 
+/**
+ * The parallelFor body: draws sequence number first_draw + batch_i, with the
+ * stream of that number, into slot batch_i.
+ */
+template <typename ResidueType>
+class DrawBody {
+public:
+  DrawBody (
+    galosh::ProfileSampler<ResidueType> const & sampler,
+    uint64_t const random_seed,
+    uint64_t const first_draw,
+    bool const keep_paths,
+    std::vector<std::vector<uint8_t> > & sequences,
+    std::vector<galosh::AlignmentPath> & paths
+  ) :
+    m_sampler( sampler ),
+    m_randomSeed( random_seed ),
+    m_firstDraw( first_draw ),
+    m_keepPaths( keep_paths ),
+    m_sequences( sequences ),
+    m_paths( paths )
+  {
+    // Do nothing else.
+  } // <init>( .. )
+
+  void
+  operator() (
+    size_t const batch_i,
+    uint32_t const thread_i
+  )
+  {
+    galosh::PhiloxStream random( m_randomSeed, m_firstDraw + batch_i );
+    m_sampler.draw( random, m_sequences[ batch_i ], ( m_keepPaths ? &m_paths[ batch_i ] : 0 ) );
+  } // operator()( size_t const, uint32_t const )
+
+protected:
+  galosh::ProfileSampler<ResidueType> const & m_sampler;
+  uint64_t m_randomSeed;
+  uint64_t m_firstDraw;
+  bool m_keepPaths;
+  std::vector<std::vector<uint8_t> > & m_sequences;
+  std::vector<galosh::AlignmentPath> & m_paths;
+}; // End class DrawBody
+
+/**
+ * Write one drawn sequence in Fasta format.
+ */
+template <typename ResidueType>
+void
+writeFastaRecord (
+  std::ostream & os,
+  std::string const & name_prefix,
+  uint64_t const draw_i,
+  std::vector<uint8_t> const & residues
+)
+{
+  os << '>' << name_prefix << draw_i << '\n';
+  std::string line( residues.size(), ' ' );
+  for( size_t i = 0; i < residues.size(); i++ ) {
+    line[ i ] = static_cast<char>( ResidueType( residues[ i ] ) );
+  }
+  os << line << '\n';
+} // writeFastaRecord( ostream &, string const &, uint64_t const, vector<uint8_t> const & )
+
+/**
+ * Write one true path, as a line of state codes (see writePathCodes).
+ */
+void
+writePathRecord (
+  std::ostream & os,
+  std::string const & name_prefix,
+  uint64_t const draw_i,
+  galosh::AlignmentPath const & path
+)
+{
+  os << name_prefix << draw_i << '\t';
+  galosh::writePathCodes( os, path );
+  os << '\n';
+} // writePathRecord( ostream &, string const &, uint64_t const, AlignmentPath const & )
+
 int
 main ( int const argc, char const ** argv )
 {
@@ -62,99 +161,160 @@ main ( int const argc, char const ** argv )
   typedef seqan::Iupac SequenceResidueType;
 #endif // __PROFUSE_USE_AMINOS .. else ..
 
-  if( argc < 3 ) {
-    cout << "Usage: " << argv[ 0 ] << " <input (galosh Profile) filename> <num seqs> [<output (Fasta) filename> [<random seed>]]" << endl;
-    exit( 1 );
-  }
-
-  //typedef bfloat ProbabilityType;
-  //typedef logspace ProbabilityType;
-  //typedef floatrealspace ProbabilityType;
+  // The ProfileSampler draws from its own tables of doubles, so there is no
+  // dp precision to choose here (cf. --precision of score and align).
   typedef doublerealspace ProbabilityType;
-  
-  typedef bfloat ScoreType; // Preferred
-  //typedef logspace ScoreType; // SLOWer than bfloat
-  //typedef realspace ScoreType; // Only for very few & small sequences
-  
-  // if using anything other than LogProbability for the MatrixValueType,
-  // params.useRabinerScaling should be set to true.
-  typedef bfloat MatrixValueType;
-  //typedef logspace MatrixValueType;
-  //typedef doublerealspace MatrixValueType;
-  //typedef floatrealspace MatrixValueType;
-
-  const bool be_verbose = ( argc >= 6 );
-  if( be_verbose ) {
-    cout << "Reading profile from file '" << argv[ 1 ] << "'" << endl;
-  }
-  typedef galosh::ProfileTreeRoot<ResidueType, ProbabilityType> ProfileType;
-  ProfileType profile;
-  profile.fromFile( argv[ 1 ] );
-  if( be_verbose ) {
-    cout << "\tgot:" << std::endl;
-    cout << profile;
-    cout << endl;
-  }
 
-  uint32_t num_draws = 0;
   try {
-    num_draws = boost::lexical_cast<uint32_t>( argv[ 2 ] );
-  } catch( boost::bad_lexical_cast & ) {
-    std::cerr << "Unable to interpret the argument '" << argv[ 2 ] << "' as an unsigned long value for use as the number of sequences to generate." << std::endl;
-    exit( 1 );
-  } // End try .. catch block for lexical_cast
-  
-  uint32_t random_seed = static_cast<uint32_t>( std::time( NULL ) );
-  if( argc >= 5 ) {
-    try {
-      random_seed = boost::lexical_cast<uint32_t>( argv[ 4 ] );
-    } catch( boost::bad_lexical_cast & ) {
-      std::cerr << "Unable to interpret the argument '" << argv[ 4 ] << "' as an unsigned long value for use as the random seed." << std::endl;
+    po::options_description visible( "Basic options" );
+    visible.add_options()
+      ( "help,h", "produce help message" )
+      ( "profile,p",
+        po::value<string>(),
+        "filename: the (galosh Profile) profile to draw from" )
+      ( "nseq,n",
+        po::value<uint64_t>(),
+        "number of sequences to draw" )
+      ( "output,o",
+        po::value<string>(),
+        "filename: where to write the drawn sequences, in Fasta format (default: standard output)" )
+      ( "seed,r",
+        po::value<uint64_t>(),
+        "random seed (default: the current time)" )
+      ( "threads,t",
+        po::value<uint32_t>()->default_value( 0 ),
+        "number of threads to draw with (0, the default, means one per core); the output doesn't depend on it" )
+      ( "paths,P",
+        po::value<string>(),
+        "filename: where to write the true path of each drawn sequence, one per line, as its name, a tab, and its states (N, M, I, D, C)" )
+      ( "path-sidecar,B",
+        po::value<string>(),
+        "filename: where to write the true paths as a compact binary file (run-length encoded, indexed by sequence number); cheap enough for very many sequences" )
+      ( "batch-size",
+        po::value<uint32_t>()->default_value( 65536 ),
+        "number of sequences to draw (in parallel) before writing them out; memory use is proportional to this, not to the number of sequences" )
+      ( "verbose,v",
+        po::value<string>()->implicit_value( "1" ),
+        "show the profile and the true paths of the drawn sequences" )
+      ;
+
+    po::positional_options_description p;
+    p.add( "profile", 1 );
+    p.add( "nseq", 1 );
+    p.add( "output", 1 );
+    p.add( "seed", 1 );
+    p.add( "verbose", 1 ); // For compatibility: any fifth argument means verbose.
+
+    po::variables_map vm;
+    store( po::command_line_parser( argc, argv ).options( visible ).positional( p ).run(), vm );
+    notify( vm );
+
+#define USAGE() " " << argv[ 0 ] << " [options] <input (galosh Profile) filename> <num seqs> [<output (Fasta) filename> [<random seed>]]"
+
+    if( vm.count( "help" ) > 0 ) {
+      cout << "Usage: " << USAGE() << endl;
+      cout << visible << "\n";
+      return 0;
+    }
+    if( ( vm.count( "profile" ) == 0 ) || ( vm.count( "nseq" ) == 0 ) ) {
+      cout << "Usage: " << USAGE() << endl;
       exit( 1 );
-    } // End try .. catch block for lexical_cast
-  } // End if argc >= 4
-  galosh::Random random( random_seed );
-
-  galosh::DynamicProgramming<ResidueType, ProbabilityType, ScoreType, MatrixValueType> dp;
-  galosh::DynamicProgramming<ResidueType, ProbabilityType, ScoreType, MatrixValueType>::Parameters parameters;
-
-  galosh::Fasta<ResidueType> random_seqs_fasta( num_draws );
-  galosh::DynamicProgramming<ResidueType, ProbabilityType, ScoreType, MatrixValueType>::MultipleAlignment<ProfileType, ResidueType> random_seqs_true_multiple_alignment;
-
-  std::string name_prefix( "Randomly generated sequence from profile \"" );
-  name_prefix += argv[ 1 ];
-  name_prefix += "\" #";
-  dp.drawSequences(
-                   parameters,
-                   profile,
-                   num_draws,
-                   name_prefix,
-                   random,
-                   random_seqs_fasta,
-                   random_seqs_true_multiple_alignment
-                   );
-  if( be_verbose ) { // TODO: ? 
-    cout << "Alignment paths of the training sequences are:" << endl;
-    random_seqs_true_multiple_alignment.toPairwiseStream( cout );
-  } // End if be_verbose
-
-  if( argc >= 4 ) {
-    if( be_verbose ) {
-      cout << "Writing Fasta to file '" << argv[ 3 ] << "'" << endl;
     }
-    std::ofstream fasta_stream( argv[ 3 ] );
-    assert( fasta_stream.good() );
-    fasta_stream << random_seqs_fasta;
-    fasta_stream.close();
+
+    const string profile_filename = vm[ "profile" ].as<string>();
+    const uint64_t num_draws = vm[ "nseq" ].as<uint64_t>();
+    const uint64_t random_seed =
+      ( vm.count( "seed" ) ? vm[ "seed" ].as<uint64_t>() : static_cast<uint64_t>( std::time( NULL ) ) );
+    const uint32_t thread_count = vm[ "threads" ].as<uint32_t>();
+    const bool be_verbose = ( vm.count( "verbose" ) > 0 );
+
     if( be_verbose ) {
-      cout << "\tdone." << endl;
+      cout << "Reading profile from file '" << profile_filename << "'" << endl;
     }
-  } else {
+    typedef galosh::ProfileTreeRoot<ResidueType, ProbabilityType> ProfileType;
+    ProfileType profile;
+    profile.fromFile( profile_filename );
     if( be_verbose ) {
-      cout << "Fasta is:" << endl;
+      cout << "\tgot:" << std::endl;
+      cout << profile;
+      cout << endl;
+    }
+
+    const uint32_t batch_size = std::max( static_cast<uint32_t>( 1 ), vm[ "batch-size" ].as<uint32_t>() );
+
+    std::string name_prefix( "Randomly generated sequence from profile \"" );
+    name_prefix += profile_filename;
+    name_prefix += "\" #";
+
+    std::ofstream fasta_file_stream;
+    if( vm.count( "output" ) ) {
+      if( be_verbose ) {
+        cout << "Writing Fasta to file '" << vm[ "output" ].as<string>() << "'" << endl;
+      }
+      fasta_file_stream.open( vm[ "output" ].as<string>().c_str() );
+      if( !fasta_file_stream.good() ) {
+        cerr << "The output file '" << vm[ "output" ].as<string>() << "' could not be opened." << endl;
+        exit( 1 );
+      }
+    }
+    std::ostream & fasta_stream = ( vm.count( "output" ) ? static_cast<std::ostream &>( fasta_file_stream ) : cout );
+    std::ofstream paths_stream;
+    if( vm.count( "paths" ) ) {
+      paths_stream.open( vm[ "paths" ].as<string>().c_str() );
+      if( !paths_stream.good() ) {
+        cerr << "The paths output file '" << vm[ "paths" ].as<string>() << "' could not be opened." << endl;
+        exit( 1 );
+      }
+    }
+    galosh::PathSidecarWriter path_sidecar;
+    if( vm.count( "path-sidecar" ) ) {
+      path_sidecar.open( vm[ "path-sidecar" ].as<string>() );
+    }
+    const bool keep_paths = ( be_verbose || paths_stream.is_open() || path_sidecar.isOpen() );
+
+    const galosh::ProfileSampler<ResidueType> sampler( profile );
+    std::vector<std::vector<uint8_t> > random_seqs( std::min( static_cast<uint64_t>( batch_size ), num_draws ) );
+    std::vector<galosh::AlignmentPath> random_seqs_true_paths( keep_paths ? random_seqs.size() : 0 );
+    for( uint64_t first_draw = 0; first_draw < num_draws; first_draw += batch_size ) {
+      const size_t batch_draws = std::min( static_cast<uint64_t>( batch_size ), ( num_draws - first_draw ) );
+      galosh::parallelFor(
+        batch_draws,
+        thread_count,
+        DrawBody<ResidueType>( sampler, random_seed, first_draw, keep_paths, random_seqs, random_seqs_true_paths )
+      );
+      for( size_t batch_i = 0; batch_i < batch_draws; batch_i++ ) {
+        writeFastaRecord<ResidueType>( fasta_stream, name_prefix, first_draw + batch_i, random_seqs[ batch_i ] );
+        if( paths_stream.is_open() ) {
+          writePathRecord( paths_stream, name_prefix, first_draw + batch_i, random_seqs_true_paths[ batch_i ] );
+        }
+        if( path_sidecar.isOpen() ) {
+          path_sidecar.append( random_seqs_true_paths[ batch_i ] );
+        }
+        if( be_verbose ) {
+          cout << "True path: ";
+          writePathRecord( cout, name_prefix, first_draw + batch_i, random_seqs_true_paths[ batch_i ] );
+        }
+      }
+    } // End foreach batch
+    fasta_stream.flush();
+    if( paths_stream.is_open() ) {
+      paths_stream.close();
+    }
+    if( path_sidecar.isOpen() ) {
+      path_sidecar.close();
+    }
+    if( vm.count( "output" ) ) {
+      fasta_file_stream.close();
+      if( be_verbose ) {
+        cout << "\tdone." << endl;
+      }
     }
-    cout << random_seqs_fasta;
-    cout << endl;
+  } catch( std::exception& e ) { /// exceptions thrown by boost stuff
+    cerr << "error: " << e.what() << endl;
+    return 1;
+  } catch( string &err ) {      /// exceptions thrown by ProfileSampler, parallelFor, etc.
+    cerr << "error: " << err << endl;
+    return 1;
   }
 
   exit( 0 );
@@ -0,0 +1,446 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      ExpectedCounts.hpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      Class definition for the ExpectedCounts class, which accumulates
+##      (expected or hard) state and transition usage counts of sequences
+##      aligned to a profile, in flat arrays, and can add them to an
+##      AlignmentProfile.
+##
+##      Positions are laid out like an AlignmentProfile (profile length + 1
+##      positions): position 0 holds the Begin state's transitions and the
+##      PreAlign insertions; position pos (1..M) holds the Match emissions of
+##      profile position pos, the transitions out of that position's states,
+##      and the insertions that follow it (the insertions of position M being
+##      the PostAlign ones).
+##
+##      Also ResidueShares, which adds the counts of a sequence residue (which
+##      may be ambiguous, eg. Iupac N or AminoAcid X) to the profile residues
+##      that it stands for.
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#if     _MSC_VER > 1000
+#pragma once
+#endif
+
+#ifndef __GALOSH_EXPECTEDCOUNTS_HPP__
+#define __GALOSH_EXPECTEDCOUNTS_HPP__
+
+#include "ProfileTables.hpp"
+#include "AlignmentPath.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#include <seqan/basic.h>
+
+namespace galosh {
+
+template <typename ResidueType, typename SequenceResidueType>
+class ResidueShares;
+
+/**
+ * \class ExpectedCounts
+ * \brief per-position emission and transition counts, indexed by the
+ * profile's ResidueType.
+ */
+template <typename ResidueType>
+class ExpectedCounts {
+public:
+  enum { AlphabetSize = seqan::ValueSize<ResidueType>::VALUE };
+
+  /// Profile length (M); there are M + 1 positions.
+  uint32_t m_profileLength;
+
+  /// At [ ( pos * AlphabetSize ) + ordValue( residue ) ], pos 1..M.
+  std::vector<double> m_matchEmissions;
+
+  /// At [ ( pos * AlphabetSize ) + ordValue( residue ) ], pos 0..M.
+  std::vector<double> m_insertionEmissions;
+
+  /// At [ ( pos * ProfileTransition::Count ) + transition ], pos 0..M.
+  std::vector<double> m_transitions;
+
+  ExpectedCounts () :
+    m_profileLength( 0 )
+  {
+    // Do nothing else.
+  } // <init>()
+
+  ExpectedCounts (
+    uint32_t const profile_length
+  )
+  {
+    reinitialize( profile_length );
+  } // <init>( uint32_t const )
+
+  void
+  reinitialize (
+    uint32_t const profile_length
+  )
+  {
+    m_profileLength = profile_length;
+    m_matchEmissions.assign( ( profile_length + 1 ) * AlphabetSize, 0.0 );
+    m_insertionEmissions.assign( ( profile_length + 1 ) * AlphabetSize, 0.0 );
+    m_transitions.assign( ( profile_length + 1 ) * ProfileTransition::Count, 0.0 );
+  } // reinitialize( uint32_t const )
+
+  void
+  zero ()
+  {
+    std::fill( m_matchEmissions.begin(), m_matchEmissions.end(), 0.0 );
+    std::fill( m_insertionEmissions.begin(), m_insertionEmissions.end(), 0.0 );
+    std::fill( m_transitions.begin(), m_transitions.end(), 0.0 );
+  } // zero()
+
+  inline double &
+  matchEmission (
+    uint32_t const pos,
+    uint32_t const res_i
+  )
+  {
+    return m_matchEmissions[ ( pos * AlphabetSize ) + res_i ];
+  } // matchEmission( uint32_t const, uint32_t const )
+
+  inline double &
+  insertionEmission (
+    uint32_t const pos,
+    uint32_t const res_i
+  )
+  {
+    return m_insertionEmissions[ ( pos * AlphabetSize ) + res_i ];
+  } // insertionEmission( uint32_t const, uint32_t const )
+
+  inline double &
+  transition (
+    uint32_t const pos,
+    ProfileTransition::Index const transition
+  )
+  {
+    return m_transitions[ ( pos * ProfileTransition::Count ) + transition ];
+  } // transition( uint32_t const, ProfileTransition::Index const )
+
+  ExpectedCounts &
+  operator+= (
+    ExpectedCounts const & other
+  )
+  {
+    for( size_t i = 0; i < m_matchEmissions.size(); i++ ) {
+      m_matchEmissions[ i ] += other.m_matchEmissions[ i ];
+      m_insertionEmissions[ i ] += other.m_insertionEmissions[ i ];
+    }
+    for( size_t i = 0; i < m_transitions.size(); i++ ) {
+      m_transitions[ i ] += other.m_transitions[ i ];
+    }
+    return *this;
+  } // operator+=( ExpectedCounts const & )
+
+  /**
+   * Add one count for each state and transition used by the given path of the
+   * given sequence (given as residue ordinal values; see
+   * sequenceToOrdinals(..)).  The count of an emission of an ambiguous
+   * residue is spread over the residues it stands for (see ResidueShares).
+   */
+  template <typename SequenceResidueType>
+  void
+  addPath (
+    AlignmentPath const & path,
+    std::vector<uint32_t> const & residues,
+    ResidueShares<ResidueType, SequenceResidueType> const & shares,
+    double const weight = 1.0
+  )
+  {
+    uint32_t pos = 0; // 0 means we're before the first position.
+    uint32_t seq_i = 0;
+    uint8_t previous_state = PathState::PreAlign;
+    for( size_t step_i = 0; step_i < path.size(); step_i++ ) {
+      const uint8_t state = path[ step_i ];
+
+      // First the transition into this state.
+      switch( state ) {
+        case PathState::PreAlign:
+          transition( 0, ProfileTransition::PreAlignToPreAlign ) += weight;
+          break;
+        case PathState::Match:
+        case PathState::Deletion:
+          if( pos == 0 ) {
+            transition( 0, ProfileTransition::PreAlignToBegin ) += weight;
+            transition( 0, ( ( state == PathState::Match ) ? ProfileTransition::BeginToMatch : ProfileTransition::BeginToDeletion ) ) += weight;
+          } else if( previous_state == PathState::Match ) {
+            transition( pos, ( ( state == PathState::Match ) ? ProfileTransition::MatchToMatch : ProfileTransition::MatchToDeletion ) ) += weight;
+          } else if( previous_state == PathState::Insertion ) {
+            // Insertion -> Deletion is not allowed.
+            transition( pos, ProfileTransition::InsertionToMatch ) += weight;
+          } else { // previous_state == PathState::Deletion
+            transition( pos, ( ( state == PathState::Match ) ? ProfileTransition::DeletionToMatch : ProfileTransition::DeletionToDeletion ) ) += weight;
+          }
+          pos += 1;
+          break;
+        case PathState::Insertion:
+          transition( pos, ( ( previous_state == PathState::Match ) ? ProfileTransition::MatchToInsertion : ProfileTransition::InsertionToInsertion ) ) += weight;
+          break;
+        case PathState::PostAlign:
+          // Like PreAlign, PostAlign is entered silently (from End), and each
+          // of its emissions comes with a self-transition.
+          transition( m_profileLength, ProfileTransition::PostAlignToPostAlign ) += weight;
+          break;
+      } // End switch( state )
+
+      // Then its emission.
+      if( pathStateEmits( state ) ) {
+        if( state == PathState::Match ) {
+          shares.addMatchEmission( *this, pos, residues[ seq_i ], weight );
+        } else {
+          // PreAlign is at pos 0 and PostAlign at pos M, as it should be.
+          shares.addInsertionEmission( *this, pos, residues[ seq_i ], weight );
+        }
+        seq_i += 1;
+      }
+      previous_state = state;
+    } // End foreach step_i
+    transition( m_profileLength, ProfileTransition::PostAlignToTerminal ) += weight;
+  } // addPath( AlignmentPath const &, vector<uint32_t> const &, ResidueShares const &, double const )
+
+  /**
+   * Add these counts to the given AlignmentProfile (which must have
+   * profile length + 1 positions).
+   */
+  template <typename MatrixValueType,
+            typename AlignmentProfileType>
+  void
+  addTo (
+    AlignmentProfileType & alignment_profile
+  ) const
+  {
+    for( uint32_t pos = 0; pos <= m_profileLength; pos++ ) {
+      double const * t = &m_transitions[ pos * ProfileTransition::Count ];
+      for( uint32_t res_i = 0; res_i < AlphabetSize; res_i++ ) {
+        const ResidueType residue( res_i );
+        if( pos > 0 ) {
+          alignment_profile[ pos ][ Emission::Match ][ residue ] +=
+            MatrixValueType( m_matchEmissions[ ( pos * AlphabetSize ) + res_i ] );
+        }
+        alignment_profile[ pos ][ Emission::Insertion ][ residue ] +=
+          MatrixValueType( m_insertionEmissions[ ( pos * AlphabetSize ) + res_i ] );
+      } // End foreach res_i
+      if( pos == 0 ) {
+        // Position 0's "Match" state is the Begin state, and its "Insertion"
+        // state is PreAlign.
+        alignment_profile[ pos ][ Transition::fromMatch ][ TransitionFromMatch::toMatch ] +=
+          MatrixValueType( t[ ProfileTransition::BeginToMatch ] );
+        alignment_profile[ pos ][ Transition::fromMatch ][ TransitionFromMatch::toDeletion ] +=
+          MatrixValueType( t[ ProfileTransition::BeginToDeletion ] );
+        alignment_profile[ pos ][ Transition::fromInsertion ][ TransitionFromInsertion::toInsertion ] +=
+          MatrixValueType( t[ ProfileTransition::PreAlignToPreAlign ] );
+        alignment_profile[ pos ][ Transition::fromInsertion ][ TransitionFromInsertion::toMatch ] +=
+          MatrixValueType( t[ ProfileTransition::PreAlignToBegin ] );
+        continue;
+      }
+      if( pos == m_profileLength ) {
+        // The last position's "Insertion" state is PostAlign.
+        alignment_profile[ pos ][ Transition::fromInsertion ][ TransitionFromInsertion::toInsertion ] +=
+          MatrixValueType( t[ ProfileTransition::PostAlignToPostAlign ] );
+        alignment_profile[ pos ][ Transition::fromInsertion ][ TransitionFromInsertion::toMatch ] +=
+          MatrixValueType( t[ ProfileTransition::PostAlignToTerminal ] );
+        continue;
+      }
+      alignment_profile[ pos ][ Transition::fromMatch ][ TransitionFromMatch::toMatch ] +=
+        MatrixValueType( t[ ProfileTransition::MatchToMatch ] );
+      alignment_profile[ pos ][ Transition::fromMatch ][ TransitionFromMatch::toInsertion ] +=
+        MatrixValueType( t[ ProfileTransition::MatchToInsertion ] );
+      alignment_profile[ pos ][ Transition::fromMatch ][ TransitionFromMatch::toDeletion ] +=
+        MatrixValueType( t[ ProfileTransition::MatchToDeletion ] );
+      alignment_profile[ pos ][ Transition::fromInsertion ][ TransitionFromInsertion::toMatch ] +=
+        MatrixValueType( t[ ProfileTransition::InsertionToMatch ] );
+      alignment_profile[ pos ][ Transition::fromInsertion ][ TransitionFromInsertion::toInsertion ] +=
+        MatrixValueType( t[ ProfileTransition::InsertionToInsertion ] );
+      alignment_profile[ pos ][ Transition::fromDeletion ][ TransitionFromDeletion::toMatch ] +=
+        MatrixValueType( t[ ProfileTransition::DeletionToMatch ] );
+      alignment_profile[ pos ][ Transition::fromDeletion ][ TransitionFromDeletion::toDeletion ] +=
+        MatrixValueType( t[ ProfileTransition::DeletionToDeletion ] );
+    } // End foreach pos
+  } // addTo( AlignmentProfileType & ) const
+
+}; // End class ExpectedCounts
+
+/**
+ * \class ResidueShares
+ * \brief adds an emission count of a SequenceResidueType to the
+ * ExpectedCounts of the ResidueTypes that it stands for.
+ *
+ * A residue that stands for just one ResidueType gets the whole count; an
+ * ambiguous one (eg. Iupac R, or AminoAcid B) has its count spread over its
+ * residues in proportion to their emission probabilities in the emitting
+ * state, which is their posterior given the state and the ambiguity code
+ * (or evenly, if those are all 0).  Which residues a code stands for is
+ * read from the profile's own distributions, so that it agrees with how the
+ * profile scores the code.
+ */
+template <typename ResidueType,
+          typename SequenceResidueType>
+class ResidueShares {
+public:
+  enum {
+    AlphabetSize = seqan::ValueSize<ResidueType>::VALUE,
+    SequenceAlphabetSize = seqan::ValueSize<SequenceResidueType>::VALUE
+  };
+
+  template <typename ProfileType>
+  ResidueShares (
+    ProfileType const & profile
+  ) :
+    m_tables( profile ),
+    m_isMember( SequenceAlphabetSize * AlphabetSize, false ),
+    m_onlyMember( SequenceAlphabetSize, AlphabetSize )
+  {
+    findMembers( profile[ Emission::Insertion ] );
+  } // <init>( ProfileType const & )
+
+  /**
+   * Add count to the Match emissions (of counts) of profile position pos
+   * (1-based) of the residues that the given sequence residue (ordinal)
+   * stands for.
+   */
+  inline void
+  addMatchEmission (
+    ExpectedCounts<ResidueType> & counts,
+    uint32_t const pos,
+    uint32_t const residue,
+    double const count
+  ) const
+  {
+    add( &counts.matchEmission( pos, 0 ), &m_tables.m_matchEmissions[ ( pos - 1 ) * AlphabetSize ], residue, count );
+  } // addMatchEmission( ExpectedCounts &, uint32_t const, uint32_t const, double const ) const
+
+  /**
+   * Add count to the Insertion emissions (of counts) of position pos (0 for
+   * PreAlign, the profile length for PostAlign) of the residues that the
+   * given sequence residue (ordinal) stands for.
+   */
+  inline void
+  addInsertionEmission (
+    ExpectedCounts<ResidueType> & counts,
+    uint32_t const pos,
+    uint32_t const residue,
+    double const count
+  ) const
+  {
+    add( &counts.insertionEmission( pos, 0 ), &m_tables.m_insertionEmissions[ 0 ], residue, count );
+  } // addInsertionEmission( ExpectedCounts &, uint32_t const, uint32_t const, double const ) const
+
+protected:
+  /// The profile's emissions, by ResidueType.
+  ProfileTables<ResidueType, ResidueType> m_tables;
+
+  /// Whether sequence residue s stands for residue r, at
+  /// [ ( s * AlphabetSize ) + r ].
+  std::vector<bool> m_isMember;
+
+  /// The one residue that sequence residue s stands for, at [ s ], or
+  /// AlphabetSize if it is ambiguous (or stands for none).
+  std::vector<uint32_t> m_onlyMember;
+
+  /**
+   * Fill m_isMember and m_onlyMember by giving all of a copy of the given
+   * distribution's probability to each residue in turn, and seeing which
+   * sequence residues then have any.
+   */
+  template <typename DistributionType>
+  void
+  findMembers (
+    DistributionType const & distribution
+  )
+  {
+    DistributionType probe( distribution );
+    DistributionType const & const_probe = probe;
+    for( uint32_t r = 0; r < AlphabetSize; r++ ) {
+      for( uint32_t other_r = 0; other_r < AlphabetSize; other_r++ ) {
+        probe[ ResidueType( other_r ) ] = ( ( other_r == r ) ? 1.0 : 0.0 );
+      }
+      for( uint32_t s = 0; s < SequenceAlphabetSize; s++ ) {
+        m_isMember[ ( s * AlphabetSize ) + r ] =
+          ( toDouble( const_probe[ SequenceResidueType( s ) ] ) > 0 );
+      }
+    } // End foreach r
+    for( uint32_t s = 0; s < SequenceAlphabetSize; s++ ) {
+      uint32_t member_count = 0;
+      for( uint32_t r = 0; r < AlphabetSize; r++ ) {
+        if( m_isMember[ ( s * AlphabetSize ) + r ] ) {
+          m_onlyMember[ s ] = r;
+          member_count += 1;
+        }
+      }
+      if( member_count != 1 ) {
+        m_onlyMember[ s ] = AlphabetSize;
+      }
+    } // End foreach s
+  } // findMembers( DistributionType const & )
+
+  /**
+   * Add count to counts (the counts of one state, by ResidueType) for the
+   * given sequence residue, given the state's emissions.
+   */
+  inline void
+  add (
+    double * counts,
+    double const * emissions,
+    uint32_t const residue,
+    double const count
+  ) const
+  {
+    const uint32_t only_member = m_onlyMember[ residue ];
+    if( only_member < AlphabetSize ) {
+      counts[ only_member ] += count;
+      return;
+    }
+    double total = 0;
+    uint32_t member_count = 0;
+    for( uint32_t r = 0; r < AlphabetSize; r++ ) {
+      if( m_isMember[ ( residue * AlphabetSize ) + r ] ) {
+        total += emissions[ r ];
+        member_count += 1;
+      }
+    }
+    if( member_count == 0 ) {
+      // It stands for nothing (eg. a gap), so it can't have been emitted.
+      return;
+    }
+    for( uint32_t r = 0; r < AlphabetSize; r++ ) {
+      if( m_isMember[ ( residue * AlphabetSize ) + r ] ) {
+        counts[ r ] += ( ( total > 0 ) ? ( count * ( emissions[ r ] / total ) ) : ( count / member_count ) );
+      }
+    }
+  } // add( double *, double const *, uint32_t const, double const ) const
+
+}; // End class ResidueShares
+
+} // End namespace galosh
+
+#endif // __GALOSH_EXPECTEDCOUNTS_HPP__
@@ -0,0 +1,177 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      ExtractAlignmentProfiles.cpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      The extractAlignmentProfiles program.  It reads an alignment profile
+##      container written by profileToAlignmentProfile --container and writes
+##      its records out in the per-sequence file layout that
+##      profileToAlignmentProfile --individual would have produced (all of
+##      them, or just those requested by name or number).  It can also list
+##      the contents of the container.
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#include "IndividualFilenames.hpp"
+#include "RecordContainer.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+namespace po = boost::program_options;
+
+using namespace galosh;
+using namespace std;
+
+int
+main ( int const argc, char ** argv )
+{
+  try {
+    po::options_description visible( "Basic options" );
+    visible.add_options()
+      ( "help,h", "produce help message" )
+      ( "container,C",
+        po::value<string>(),
+        "filename: the alignment profile container to read" )
+      ( "alignment_profiles_prefix,o",
+        po::value<string>()->default_value( "profillic_profileToAlignmentProfile" ),
+        "filename prefix: where to put the output alignment profiles" )
+      ( "individual-filename-suffix-pattern,s",
+        po::value<string>()->default_value( "_$n.aprof" ),
+        "pattern for filenames by which to differentiate output individual alignment profiles, in which $n will be replaced by the sequence name (possibly modified to be a valid filename) and $d with be replaced by the sequence number (default: '_$n.aprof'" )
+      ( "name,N",
+        po::value<vector<string> >(),
+        "extract only the alignment profile of the sequence with this name (may be repeated)" )
+      ( "number,d",
+        po::value<vector<uint64_t> >(),
+        "extract only the alignment profile of the sequence with this number (may be repeated)" )
+      ( "list,l",
+        "list the contents of the container instead of extracting" )
+      ;
+
+    po::positional_options_description p;
+    p.add( "container", 1 );
+    p.add( "alignment_profiles_prefix", 1 );
+
+    po::variables_map vm;
+    store( po::command_line_parser( argc, argv ).options( visible ).positional( p ).run(), vm );
+    notify( vm );
+
+#define USAGE() " " << argv[ 0 ] << " [options] <alignment profile container file> [<output alignment profiles file prefix>]"
+
+    if( vm.count( "help" ) > 0 ) {
+      cout << "Usage: " << USAGE() << endl;
+      cout << visible << "\n";
+      return 0;
+    }
+    if( vm.count( "container" ) == 0 ) {
+      cout << "Usage: " << USAGE() << endl;
+      return 1;
+    }
+
+    const string container_filename = vm[ "container" ].as<string>();
+    const string output_filename_prefix = vm[ "alignment_profiles_prefix" ].as<string>();
+    const string individual_filename_suffix_pattern = vm[ "individual-filename-suffix-pattern" ].as<string>();
+
+    RecordContainerReader container( container_filename );
+    if( container.kind() != "AlignmentProfile" ) {
+      cerr << "error: the container '" << container_filename << "' holds records of kind '" << container.kind() << "', not alignment profiles." << endl;
+      return 1;
+    }
+
+    if( vm.count( "list" ) > 0 ) {
+      for( uint64_t entry_i = 0; entry_i < container.size(); entry_i++ ) {
+        cout << container.entry( entry_i ).m_number << '\t' << container.entry( entry_i ).m_name << endl;
+      }
+      return 0;
+    }
+
+    // Figure out which records to extract.
+    vector<uint64_t> selected;
+    if( ( vm.count( "name" ) == 0 ) && ( vm.count( "number" ) == 0 ) ) {
+      for( uint64_t entry_i = 0; entry_i < container.size(); entry_i++ ) {
+        selected.push_back( entry_i );
+      }
+    } else {
+      if( vm.count( "name" ) > 0 ) {
+        vector<string> const & names = vm[ "name" ].as<vector<string> >();
+        for( size_t name_i = 0; name_i < names.size(); name_i++ ) {
+          const uint64_t entry_i = container.find( names[ name_i ] );
+          if( entry_i == container.size() ) {
+            cerr << "There is no alignment profile for a sequence named '" << names[ name_i ] << "' in the container '" << container_filename << "'." << endl;
+            return 1;
+          }
+          selected.push_back( entry_i );
+        }
+      }
+      if( vm.count( "number" ) > 0 ) {
+        vector<uint64_t> const & numbers = vm[ "number" ].as<vector<uint64_t> >();
+        for( size_t number_i = 0; number_i < numbers.size(); number_i++ ) {
+          const uint64_t entry_i = container.findNumber( numbers[ number_i ] );
+          if( entry_i == container.size() ) {
+            cerr << "There is no alignment profile for sequence number " << numbers[ number_i ] << " in the container '" << container_filename << "'." << endl;
+            return 1;
+          }
+          selected.push_back( entry_i );
+        }
+      }
+    } // End if extracting all .. else ..
+
+    string record;
+    for( size_t selected_i = 0; selected_i < selected.size(); selected_i++ ) {
+      RecordContainerReader::IndexEntry const & entry = container.entry( selected[ selected_i ] );
+      container.read( selected[ selected_i ], record );
+      const string output_filename =
+        individual_filename( output_filename_prefix, individual_filename_suffix_pattern, entry.m_name, entry.m_number );
+      std::ofstream fs( output_filename.c_str(), std::ios::out | std::ios::binary );
+      if( !fs.is_open() ) {
+        cerr << "The alignment profiles output file '" << output_filename << "' could not be opened." << endl;
+      } else {
+        fs.write( record.data(), record.length() );
+        fs.close();
+        // We print out the output files as a side effect
+        cout << output_filename << endl;
+      }
+    } // End foreach selected record
+
+    return 0; // success
+  } catch( std::exception& e ) { /// exceptions thrown by boost stuff
+    cerr << "error: " << e.what() << endl;
+    return 1;
+  } catch( string &err ) {      /// exceptions thrown by RecordContainerReader, etc.
+    cerr << "error: " << err << endl;
+    return 1;
+  } catch( ... ) {               /// anything else
+    cerr << "Strange unknown exception" << endl;
+    return 1;
+  }
+} // main (..)
@@ -0,0 +1,128 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      FastaRecordReader.hpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      Class definition for the FastaRecordReader class, which reads a
+##      (possibly aligned) Fasta stream one record at a time, so that inputs
+##      too big to hold in a galosh::Fasta can be processed as they are read.
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#if     _MSC_VER > 1000
+#pragma once
+#endif
+
+#ifndef __GALOSH_FASTARECORDREADER_HPP__
+#define __GALOSH_FASTARECORDREADER_HPP__
+
+#include <cctype>
+#include <iostream>
+#include <string>
+
+namespace galosh {
+
+class FastaRecordReader {
+public:
+  FastaRecordReader (
+    std::istream & is
+  ) :
+    m_stream( is ),
+    m_nextName(),
+    m_haveNext( false )
+  {
+    // Find the first record.
+    std::string line;
+    while( std::getline( m_stream, line ) ) {
+      trim( line );
+      if( line.empty() ) {
+        continue;
+      }
+      if( line[ 0 ] != '>' ) {
+        throw std::string( "Expected a Fasta record (a line starting with '>'), but got: " ) + line;
+      }
+      m_nextName = line.substr( 1 );
+      m_haveNext = true;
+      break;
+    }
+  } // <init>( istream & )
+
+  /**
+   * Read the next record's name (its description line, without the '>') and
+   * residues (its lines, concatenated, without whitespace).  Returns false,
+   * leaving them alone, if there are no more records.
+   */
+  bool
+  next (
+    std::string & name,
+    std::string & residues
+  )
+  {
+    if( !m_haveNext ) {
+      return false;
+    }
+    name = m_nextName;
+    residues.clear();
+    m_haveNext = false;
+    std::string line;
+    while( std::getline( m_stream, line ) ) {
+      trim( line );
+      if( !line.empty() && ( line[ 0 ] == '>' ) ) {
+        m_nextName = line.substr( 1 );
+        m_haveNext = true;
+        break;
+      }
+      for( std::string::size_type char_i = 0; char_i < line.length(); char_i++ ) {
+        if( !std::isspace( static_cast<unsigned char>( line[ char_i ] ) ) ) {
+          residues += line[ char_i ];
+        }
+      }
+    }
+    return true;
+  } // next( string &, string & )
+
+protected:
+  static void
+  trim (
+    std::string & line
+  )
+  {
+    while( !line.empty() && std::isspace( static_cast<unsigned char>( line[ line.length() - 1 ] ) ) ) {
+      line.erase( line.length() - 1 );
+    }
+  } // trim( string & )
+
+  std::istream & m_stream;
+  std::string m_nextName;
+  bool m_haveNext;
+
+}; // End class FastaRecordReader
+
+} // End namespace galosh
+
+#endif // __GALOSH_FASTARECORDREADER_HPP__
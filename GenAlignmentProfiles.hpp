@@ -54,8 +54,18 @@
 #include "Fasta.hpp"
 #include "Random.hpp"
 #include "DynamicProgramming.hpp"
+#include "ProfileTables.hpp"
+#include "AlignmentPath.hpp"
+#include "ExpectedCounts.hpp"
+#include "CheckpointedViterbi.hpp"
+#include "CheckpointedForwardBackward.hpp"
+#include "Precision.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <fstream>
+#include <limits>
 #include "stddef.h"
 
 #include <seqan/basic.h>
@@ -71,6 +81,7 @@
 #include "muscle/textfile.h"
 #endif // __HAVE_MUSCLE
 
+#include <boost/filesystem.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/program_options.hpp>
 namespace galosh {
@@ -119,7 +130,25 @@ public:
     const bool be_verbose_show_profiles = verbosity > VERBOSITY_Low;
     const bool be_verbose_show_sequences = verbosity > VERBOSITY_High;
     const bool use_viterbi = vm.count( "viterbi" ) > 0;
+    const bool use_checkpointed = vm.count( "checkpointed" ) > 0;
+    const uint32_t checkpoint_interval =
+      ( vm.count( "checkpoint-interval" ) ? vm["checkpoint-interval"].as<uint32_t>() : 0 );
+    const bool verify = vm.count( "verify" ) > 0;
+    if( verify && !use_checkpointed ) {
+      throw std::string( "Only the checkpointed alignment profiles can be verified; use --verify together with --checkpointed" );
+    }
+    if( vm.count( "isa" ) ) {
+      selectKernelIsa( vm["isa"].as<string>() );
+    }
     const bool indiv_profiles = vm.count( "individual" ) > 0;
+    const bool incremental = vm.count( "incremental" ) > 0;
+    const bool remove_sequences = vm.count( "remove" ) > 0;
+    if( incremental && indiv_profiles ) {
+      throw std::string( "The incremental mode updates the combined alignment profile; it can't be used with individual alignment profiles" );
+    }
+    if( remove_sequences && !incremental ) {
+      throw std::string( "Sequences can only be removed from a saved state; use --remove together with --incremental" );
+    }
 
     ProfileType profile;
     if( be_verbose ) {
@@ -159,6 +188,178 @@ public:
 
     sequence_count = ( ( sequence_count == 0 ) ? fasta.size() : min( static_cast<size_t>( sequence_count ), fasta.size() ) );
 
+    std::vector<typename DynamicProgramming<ResidueType, ProbabilityType, ScoreType, MatrixValueType>::AlignmentProfile> alignment_profiles;
+    if( use_viterbi ) {
+      // Hard counts along each sequence's Viterbi path: there's no backward
+      // pass and no dp matrices, just one forward pass (and a checkpointed
+      // recomputation of it for the traceback) per sequence.
+      if( be_verbose ) {
+        cerr << "Calculating " << ( indiv_profiles ? "" : "combined " ) << "Viterbi-path alignment profiles with " << sequence_count << " sequences." << endl;
+      }
+      const double log_score =
+        viterbi_alignment_profiles(
+          profile,
+          fasta,
+          sequence_count,
+          indiv_profiles,
+          alignment_profiles
+        );
+      if( be_verbose ) {
+        cerr << "\tdone.  The total (natural log) viterbi score for these sequences is: " << log_score << endl;
+      }
+    } else if( use_checkpointed ) { // if use_viterbi .. else if use_checkpointed ..
+      if( be_verbose ) {
+        cerr << "Calculating " << ( indiv_profiles ? "" : "combined " ) << "alignment profiles with " << sequence_count << " sequences, using checkpointed forward-backward." << endl;
+      }
+      const double log_score =
+        checkpointed_alignment_profiles(
+          profile,
+          fasta,
+          sequence_count,
+          indiv_profiles,
+          checkpoint_interval,
+          alignment_profiles
+        );
+      if( be_verbose ) {
+        cerr << "\tdone.  The total (natural log) probability of these sequences, given this profile model, is: " << log_score << endl;
+      }
+      if( verify ) {
+        std::vector<typename DynamicProgramming<ResidueType, ProbabilityType, ScoreType, MatrixValueType>::AlignmentProfile> dp_profiles;
+        dp_alignment_profiles(
+          vm,
+          profile,
+          fasta,
+          sequence_count,
+          be_verbose,
+          dp_profiles
+        );
+        verify_alignment_profiles(
+          alignment_profiles,
+          dp_profiles,
+          vm["verify"].as<double>()
+        );
+        if( be_verbose ) {
+          cerr << "Verified the checkpointed alignment profiles against calculateAlignmentProfiles." << endl;
+        }
+      } // End if verify
+    } else { // if use_viterbi .. else if use_checkpointed .. else ..
+      dp_alignment_profiles(
+        vm,
+        profile,
+        fasta,
+        sequence_count,
+        be_verbose,
+        alignment_profiles
+      );
+    } // End if use_viterbi .. else if use_checkpointed .. else ..
+
+    if( indiv_profiles ) {
+
+      if( be_verbose ) {
+        cerr << "Unscaling each of " << sequence_count << " alignment profiles." << endl;
+      }
+      // Normalize them
+      // Actually, don't normalize them.  But do unscale them.
+      // \todo Make the normalization option into a command-line parameter
+      for( int i = 0; i < sequence_count; i++ )
+      {
+      //  alignment_profiles[ i ].normalize( 0.0 );
+        alignment_profiles[ i ].unscale();
+      }
+      if( be_verbose ) { 
+        cerr << "\tdone." << endl;
+      }
+      return alignment_profiles;
+    }
+
+    typename DynamicProgramming<ResidueType, ProbabilityType, ScoreType, MatrixValueType>::AlignmentProfile combined_alignment_profile;
+    combined_alignment_profile.reinitialize( profile.length() + 1 );
+    combined_alignment_profile.zero();
+    if( be_verbose ) {
+      cerr << "Combining " << alignment_profiles.size() << " alignment profiles." << endl;
+    }
+    for( size_t i = 0; i < alignment_profiles.size(); i++ )
+    {
+      combined_alignment_profile += alignment_profiles[ i ];
+    }
+    if( be_verbose ) {
+      cerr << "\tdone." << endl;
+    }
+    // \todo Make the normalization option into a command-line parameter
+    combined_alignment_profile.unscale();
+
+    if( incremental ) {
+      // Fold this run's contributions into the running sum saved alongside
+      // the output by the previous run (if any), and save the result.
+      const std::string state_prefix = incrementalStatePrefix( vm );
+      typename DynamicProgramming<ResidueType, ProbabilityType, ScoreType, MatrixValueType>::AlignmentProfile running_alignment_profile;
+      uint64_t running_sequence_count = 0;
+      const bool have_state =
+        readIncrementalState( state_prefix, running_alignment_profile, running_sequence_count );
+      if( be_verbose ) {
+        if( have_state ) {
+          cerr << "Read the saved state of " << running_sequence_count << " sequences from '" << state_prefix << "'." << endl;
+        } else {
+          cerr << "There is no saved state at '" << state_prefix << "'; starting a new one." << endl;
+        }
+      }
+      if( !have_state ) {
+        if( remove_sequences ) {
+          throw ( "There is no saved state at " + state_prefix + " from which to remove sequences" );
+        }
+        running_alignment_profile.reinitialize( profile.length() + 1 );
+        running_alignment_profile.zero();
+      } else if( running_alignment_profile.size() != ( profile.length() + 1 ) ) {
+        throw ( "The saved state at " + state_prefix + " was made with a profile of a different length" );
+      }
+      if( remove_sequences ) {
+        if( static_cast<uint64_t>( sequence_count ) > running_sequence_count ) {
+          throw ( "Can't remove more sequences than were saved in the state at " + state_prefix );
+        }
+        if( be_verbose ) {
+          cerr << "Subtracting the contributions of " << sequence_count << " sequences." << endl;
+        }
+        running_alignment_profile -= combined_alignment_profile;
+        running_sequence_count -= sequence_count;
+      } else {
+        if( be_verbose ) {
+          cerr << "Adding the contributions of " << sequence_count << " sequences." << endl;
+        }
+        running_alignment_profile += combined_alignment_profile;
+        running_sequence_count += sequence_count;
+      }
+      writeIncrementalState( state_prefix, running_alignment_profile, running_sequence_count );
+      if( be_verbose ) {
+        cerr << "\tSaved the state of " << running_sequence_count << " sequences to '" << state_prefix << "'." << endl;
+      }
+      combined_alignment_profile = running_alignment_profile;
+    } // End if incremental
+
+    // TODO: Put back normalize?  I kind of like the unnormalized version, because you can glean the number of sequences used.
+    //combined_alignment_profile.normalize( 0.0 );
+    alignment_profiles.clear();
+    alignment_profiles.push_back( combined_alignment_profile );
+    return alignment_profiles;
+  } // gen_alignment_profiles( variables_map vm )
+
+  /**
+   * \fn dp_alignment_profiles
+   * \brief fill alignment_profiles with the posterior expected counts of the
+   * states and transitions used by each of the first sequence_count
+   * sequences, one alignment profile per sequence, using the full dp
+   * matrices of DynamicProgramming (calculateAlignmentProfiles).
+   **/
+  template <typename ProfileType>
+  static void
+  dp_alignment_profiles (
+    boost::program_options::variables_map const & vm,
+    ProfileType const & profile,
+    Fasta<SequenceResidueType> const & fasta,
+    int const sequence_count,
+    bool const be_verbose,
+    std::vector<typename DynamicProgramming<ResidueType, ProbabilityType, ScoreType, MatrixValueType>::AlignmentProfile> & alignment_profiles
+  )
+  {
     if( be_verbose ) {
       cerr << "Allocating the dp matrices for " << sequence_count << " sequences." << endl;
     }
@@ -171,12 +372,14 @@ public:
       cerr << "\tdone." << endl;
     }
 
-    ScoreType score;
     DynamicProgramming<ResidueType, ProbabilityType, ScoreType, MatrixValueType> dp;
     typename DynamicProgramming<ResidueType, ProbabilityType, ScoreType, MatrixValueType>::Parameters parameters;
 
     parameters.m_galosh_options_map = vm;
     parameters.resetToDefaults();
+    if( UsesRabinerScaling<MatrixValueType>::value ) {
+      parameters.useRabinerScaling = true;
+    }
     #ifdef DEBUG 
     if(be_verbose) {
        cerr << "matrixRowScaleFactor in m_galosh_options_map is " << parameters.m_galosh_options_map["matrixRowScaleFactor"].template as<double>() << endl;
@@ -186,39 +389,24 @@ public:
     if( be_verbose ) {
       cerr << "Computing the dp matrices for the multiple alignment." << endl;
     }
-    if( use_viterbi ) {
-      score =
-        dp.forward_score_viterbi(
-          parameters,
-          profile,
-          fasta,
-          sequence_count,
-          dp_matrices
-        );
-      if( be_verbose ) {
-        cerr << "\tThe total viterbi score for these sequences is: " << score << endl;
-      }
-
-    } else { // if use_viterbi .. else ..
-      score =
-        dp.forward_score(
-          parameters,
-          profile,
-          fasta,
-          sequence_count,
-          dp_matrices
-        );
-      if( be_verbose ) {
-        cerr << "\tThe total probability of these sequences, given this profile model, is: " << score << endl;
-      }
-    } // End if use_viterbi .. else ..
+    ScoreType score =
+      dp.forward_score(
+        parameters,
+        profile,
+        fasta,
+        sequence_count,
+        dp_matrices
+      );
+    if( be_verbose ) {
+      cerr << "\tThe total probability of these sequences, given this profile model, is: " << score << endl;
+    }
     // End calculating score and filling the dp matrices
 
     // For now we go ahead and allocate as many alignment profiles as there are
     // sequences, though in future we needn't do this if the user wants only
     // the summed / common alignment profile.
     // TODO: Use only one alignment profile, unless indiv_profiles is true.
-    std::vector<typename DynamicProgramming<ResidueType, ProbabilityType, ScoreType, MatrixValueType>::AlignmentProfile> alignment_profiles( sequence_count );
+    alignment_profiles.resize( sequence_count );
     for ( int i = 0; i < sequence_count; i++ )
     {
       alignment_profiles[ i ].reinitialize( profile.length() + 1 );
@@ -228,11 +416,11 @@ public:
     if( be_verbose ) { //TAH copy fasta file names to alignment profiles 
        cerr << "Copying sequence names from fasta to alignment profiles" << endl;
     } // be_verbose
-    
+  
     for( int j = 0; j < sequence_count ; j++ ) {
        alignment_profiles[ j ].m_comment = fasta.m_descriptions[ j ];
     }
-    
+  
     if( be_verbose ) {
       cerr << "\tdone.\nCalculating alignment profiles with " << sequence_count << " sequences." << endl;
     }
@@ -248,47 +436,333 @@ public:
     if( be_verbose ) { 
       cerr << "\tdone." << endl;
     }
+  } // dp_alignment_profiles( variables_map const &, ProfileType const &, Fasta const &, int const, bool const, vector<AlignmentProfile> & )
 
-    if( indiv_profiles ) {
+  /**
+   * \fn verify_alignment_profiles
+   * \brief check that the given (checkpointed) alignment profiles hold the
+   * same counts as dp_profiles, the per-sequence alignment profiles of
+   * dp_alignment_profiles(..), to within the given tolerance (relative to
+   * counts of more than 1).  There is one of alignment_profiles per
+   * sequence, or one for all of them (which is then compared to the sum of
+   * dp_profiles).  Throws a string describing the largest difference if
+   * any is larger than that.
+   **/
+  static void
+  verify_alignment_profiles (
+    std::vector<typename DynamicProgramming<ResidueType, ProbabilityType, ScoreType, MatrixValueType>::AlignmentProfile> const & alignment_profiles,
+    std::vector<typename DynamicProgramming<ResidueType, ProbabilityType, ScoreType, MatrixValueType>::AlignmentProfile> const & dp_profiles,
+    double const tolerance
+  )
+  {
+    typedef typename DynamicProgramming<ResidueType, ProbabilityType, ScoreType, MatrixValueType>::AlignmentProfile AlignmentProfileType;
 
-      if( be_verbose ) {
-        cerr << "Unscaling each of " << sequence_count << " alignment profiles." << endl;
+    std::vector<AlignmentProfileType> expected_profiles;
+    if( alignment_profiles.size() == dp_profiles.size() ) {
+      expected_profiles = dp_profiles;
+    } else {
+      expected_profiles.resize( 1 );
+      expected_profiles[ 0 ].reinitialize( alignment_profiles[ 0 ].size() );
+      expected_profiles[ 0 ].zero();
+      for( size_t i = 0; i < dp_profiles.size(); i++ ) {
+        expected_profiles[ 0 ] += dp_profiles[ i ];
       }
-      // Normalize them
-      // Actually, don't normalize them.  But do unscale them.
-      // \todo Make the normalization option into a command-line parameter
-      for( int i = 0; i < sequence_count; i++ )
-      {
-      //  alignment_profiles[ i ].normalize( 0.0 );
-        alignment_profiles[ i ].unscale();
+    }
+
+    double max_difference = 0;
+    std::string max_difference_description;
+    for( size_t i = 0; i < alignment_profiles.size(); i++ ) {
+      AlignmentProfileType actual( alignment_profiles[ i ] );
+      AlignmentProfileType & expected = expected_profiles[ i ];
+      actual.unscale();
+      expected.unscale();
+      for( uint32_t pos = 0; pos < actual.size(); pos++ ) {
+        const std::string where =
+          " at position " + boost::lexical_cast<std::string>( pos ) + " of alignment profile " + boost::lexical_cast<std::string>( i );
+        for( uint32_t res_i = 0; res_i < seqan::ValueSize<ResidueType>::VALUE; res_i++ ) {
+          const ResidueType residue( res_i );
+          compareCount( actual[ pos ][ Emission::Match ][ residue ], expected[ pos ][ Emission::Match ][ residue ], "Match emission count", where, max_difference, max_difference_description );
+          compareCount( actual[ pos ][ Emission::Insertion ][ residue ], expected[ pos ][ Emission::Insertion ][ residue ], "Insertion emission count", where, max_difference, max_difference_description );
+        }
+        compareCount( actual[ pos ][ Transition::fromMatch ][ TransitionFromMatch::toMatch ], expected[ pos ][ Transition::fromMatch ][ TransitionFromMatch::toMatch ], "Match->Match count", where, max_difference, max_difference_description );
+        compareCount( actual[ pos ][ Transition::fromMatch ][ TransitionFromMatch::toInsertion ], expected[ pos ][ Transition::fromMatch ][ TransitionFromMatch::toInsertion ], "Match->Insertion count", where, max_difference, max_difference_description );
+        compareCount( actual[ pos ][ Transition::fromMatch ][ TransitionFromMatch::toDeletion ], expected[ pos ][ Transition::fromMatch ][ TransitionFromMatch::toDeletion ], "Match->Deletion count", where, max_difference, max_difference_description );
+        compareCount( actual[ pos ][ Transition::fromInsertion ][ TransitionFromInsertion::toMatch ], expected[ pos ][ Transition::fromInsertion ][ TransitionFromInsertion::toMatch ], "Insertion->Match count", where, max_difference, max_difference_description );
+        compareCount( actual[ pos ][ Transition::fromInsertion ][ TransitionFromInsertion::toInsertion ], expected[ pos ][ Transition::fromInsertion ][ TransitionFromInsertion::toInsertion ], "Insertion->Insertion count", where, max_difference, max_difference_description );
+        compareCount( actual[ pos ][ Transition::fromDeletion ][ TransitionFromDeletion::toMatch ], expected[ pos ][ Transition::fromDeletion ][ TransitionFromDeletion::toMatch ], "Deletion->Match count", where, max_difference, max_difference_description );
+        compareCount( actual[ pos ][ Transition::fromDeletion ][ TransitionFromDeletion::toDeletion ], expected[ pos ][ Transition::fromDeletion ][ TransitionFromDeletion::toDeletion ], "Deletion->Deletion count", where, max_difference, max_difference_description );
+      } // End foreach pos
+    } // End foreach alignment profile
+    if( max_difference > tolerance ) {
+      throw ( "The checkpointed alignment profiles differ from calculateAlignmentProfiles': " + max_difference_description );
+    }
+  } // verify_alignment_profiles( vector<AlignmentProfile> const &, vector<AlignmentProfile> const &, double const )
+
+  /**
+   * \fn compareCount
+   * \brief if the difference of the two counts (relative, for counts of
+   * more than 1) is more than max_difference, make it max_difference and
+   * describe it in max_difference_description.
+   **/
+  template <typename ValueType>
+  static void
+  compareCount (
+    ValueType const & actual_value,
+    ValueType const & expected_value,
+    std::string const & what,
+    std::string const & where,
+    double & max_difference,
+    std::string & max_difference_description
+  )
+  {
+    const double actual = toDouble( actual_value );
+    const double expected = toDouble( expected_value );
+    double difference =
+      std::fabs( actual - expected ) / std::max( 1.0, std::max( std::fabs( actual ), std::fabs( expected ) ) );
+    if( difference != difference ) { // NaN
+      difference = std::numeric_limits<double>::infinity();
+    }
+    if( difference > max_difference ) {
+      max_difference = difference;
+      max_difference_description =
+        what + where + " is " + boost::lexical_cast<std::string>( actual ) + " rather than " + boost::lexical_cast<std::string>( expected );
+    }
+  } // compareCount( ValueType const &, ValueType const &, string const &, string const &, double &, string & )
+
+  /**
+   * \fn viterbi_alignment_profiles
+   * \brief fill alignment_profiles with the hard (0/1) counts of the states
+   * and transitions used by the Viterbi path of each of the first
+   * sequence_count sequences: one alignment profile per sequence if
+   * indiv_profiles is true, else just one holding all of their counts.
+   * Returns the natural log of the product of the paths' probabilities.
+   *
+   * The paths are found with CheckpointedViterbi, so the memory used is
+   * O( sqrt( L ) * M ) per sequence rather than the O( L * M ) of the dp
+   * matrices.
+   **/
+  template <typename ProfileType>
+  static double
+  viterbi_alignment_profiles (
+    ProfileType const & profile,
+    Fasta<SequenceResidueType> const & fasta,
+    int const sequence_count,
+    bool const indiv_profiles,
+    std::vector<typename DynamicProgramming<ResidueType, ProbabilityType, ScoreType, MatrixValueType>::AlignmentProfile> & alignment_profiles
+  )
+  {
+    ProfileTables<ResidueType, SequenceResidueType> log_tables( profile );
+    log_tables.convertToLogs();
+    CheckpointedViterbi<ResidueType, SequenceResidueType> viterbi( log_tables );
+    const ResidueShares<ResidueType, SequenceResidueType> shares( profile );
+
+    alignment_profiles.resize( indiv_profiles ? sequence_count : 1 );
+    for( size_t i = 0; i < alignment_profiles.size(); i++ ) {
+      alignment_profiles[ i ].reinitialize( profile.length() + 1 );
+      alignment_profiles[ i ].zero();
+    }
+
+    ExpectedCounts<ResidueType> counts( profile.length() );
+    std::vector<uint32_t> residues;
+    AlignmentPath path;
+    double total_log_score = 0;
+    for( int seq_i = 0; seq_i < sequence_count; seq_i++ ) {
+      sequenceToOrdinals( fasta[ seq_i ], residues );
+      const double log_score = viterbi.viterbi( residues, path );
+      if( path.empty() ) {
+        throw ( "There is no path through the profile for sequence " + fasta.m_descriptions[ seq_i ] );
       }
-      if( be_verbose ) { 
-        cerr << "\tdone." << endl;
+      total_log_score += log_score;
+      counts.addPath( path, residues, shares );
+      if( indiv_profiles ) {
+        alignment_profiles[ seq_i ].m_comment = fasta.m_descriptions[ seq_i ];
+        counts.template addTo<MatrixValueType>( alignment_profiles[ seq_i ] );
+        counts.zero();
       }
-      return alignment_profiles;
+    } // End foreach seq_i
+    if( !indiv_profiles ) {
+      counts.template addTo<MatrixValueType>( alignment_profiles[ 0 ] );
     }
+    return total_log_score;
+  } // viterbi_alignment_profiles( ProfileType const &, Fasta const &, int const, bool const, vector<AlignmentProfile> & )
 
-    typename DynamicProgramming<ResidueType, ProbabilityType, ScoreType, MatrixValueType>::AlignmentProfile combined_alignment_profile;
-    combined_alignment_profile.reinitialize( profile.length() + 1 );
-    combined_alignment_profile.zero();
-    if( be_verbose ) {
-      cerr << "Combining " << sequence_count << " alignment profiles." << endl;
+  /**
+   * \fn checkpointed_alignment_profiles
+   * \brief like calculateAlignmentProfiles, fill alignment_profiles with the
+   * posterior expected counts of the states and transitions used by each of
+   * the first sequence_count sequences (one alignment profile per sequence if
+   * indiv_profiles is true, else just one holding all of their counts), but
+   * using CheckpointedForwardBackward, which needs only
+   * O( L / checkpoint_interval + checkpoint_interval ) rows per sequence
+   * instead of the full dp matrices.  A checkpoint_interval of 0 means the
+   * square root of each sequence's length.  Returns the natural log of the
+   * product of the sequences' probabilities.
+   **/
+  template <typename ProfileType>
+  static double
+  checkpointed_alignment_profiles (
+    ProfileType const & profile,
+    Fasta<SequenceResidueType> const & fasta,
+    int const sequence_count,
+    bool const indiv_profiles,
+    uint32_t const checkpoint_interval,
+    std::vector<typename DynamicProgramming<ResidueType, ProbabilityType, ScoreType, MatrixValueType>::AlignmentProfile> & alignment_profiles
+  )
+  {
+    ProfileTables<ResidueType, SequenceResidueType> tables( profile );
+    CheckpointedForwardBackward<ResidueType, SequenceResidueType> forward_backward( tables, checkpoint_interval );
+    const ResidueShares<ResidueType, SequenceResidueType> shares( profile );
+
+    alignment_profiles.resize( indiv_profiles ? sequence_count : 1 );
+    for( size_t i = 0; i < alignment_profiles.size(); i++ ) {
+      alignment_profiles[ i ].reinitialize( profile.length() + 1 );
+      alignment_profiles[ i ].zero();
     }
-    for( int i = 0; i < sequence_count; i++ )
-    {
-      combined_alignment_profile += alignment_profiles[ i ];
+
+    ExpectedCounts<ResidueType> counts( profile.length() );
+    std::vector<uint32_t> residues;
+    double total_log_score = 0;
+    for( int seq_i = 0; seq_i < sequence_count; seq_i++ ) {
+      sequenceToOrdinals( fasta[ seq_i ], residues );
+      const double log_score =
+        forward_backward.expectedCounts( residues, shares, counts );
+      if( log_score == -std::numeric_limits<double>::infinity() ) {
+        throw ( "The probability of sequence " + fasta.m_descriptions[ seq_i ] + " is 0 given the profile" );
+      }
+      total_log_score += log_score;
+      if( indiv_profiles ) {
+        alignment_profiles[ seq_i ].m_comment = fasta.m_descriptions[ seq_i ];
+        counts.template addTo<MatrixValueType>( alignment_profiles[ seq_i ] );
+        counts.zero();
+      }
+    } // End foreach seq_i
+    if( !indiv_profiles ) {
+      counts.template addTo<MatrixValueType>( alignment_profiles[ 0 ] );
     }
-    if( be_verbose ) {
-      cerr << "\tdone." << endl;
+    return total_log_score;
+  } // checkpointed_alignment_profiles( ProfileType const &, Fasta const &, int const, bool const, uint32_t const, vector<AlignmentProfile> & )
+
+  /**
+   * \fn incrementalStatePrefix
+   * \brief the filename prefix of the state files used by the incremental
+   * mode: the --state option if given, else the output prefix plus ".state".
+   **/
+  static std::string
+  incrementalStatePrefix (
+    boost::program_options::variables_map const & vm
+  )
+  {
+    if( vm.count( "state" ) ) {
+      return vm["state"].as<string>();
     }
-    // \todo Make the normalization option into a command-line parameter
-    combined_alignment_profile.unscale();
-    // TODO: Put back normalize?  I kind of like the unnormalized version, because you can glean the number of sequences used.
-    //combined_alignment_profile.normalize( 0.0 );
-    alignment_profiles.clear();
-    alignment_profiles.push_back( combined_alignment_profile );
-    return alignment_profiles;
-  } // gen_alignment_profiles( variables_map vm )
+    return ( vm["alignment_profiles_prefix"].as<string>() + ".state" );
+  } // incrementalStatePrefix( variables_map const & )
+
+  /**
+   * \fn readIncrementalState
+   * \brief read the unscaled running sum (from <prefix>.aprof) and the number
+   * of sequences in it (from <prefix>.nseq).  Returns false if there is no
+   * saved state.  First finishes (or discards) the write of an interrupted
+   * writeIncrementalState(..).
+   **/
+  static bool
+  readIncrementalState (
+    std::string const & state_prefix,
+    typename DynamicProgramming<ResidueType, ProbabilityType, ScoreType, MatrixValueType>::AlignmentProfile & running_alignment_profile,
+    uint64_t & running_sequence_count
+  )
+  {
+    recoverIncrementalState( state_prefix );
+    const std::string count_filename = state_prefix + ".nseq";
+    std::ifstream count_stream( count_filename.c_str() );
+    if( !count_stream.is_open() ) {
+      return false;
+    }
+    if( !( count_stream >> running_sequence_count ) ) {
+      throw ( "Can't read the sequence count from state file " + count_filename );
+    }
+    const std::string sum_filename = state_prefix + ".aprof";
+    if( !running_alignment_profile.fromFile( sum_filename ) ) {
+      throw ( "Can't open state alignment profile file " + sum_filename );
+    }
+    return true;
+  } // readIncrementalState( string const &, AlignmentProfile &, uint64_t & )
+
+  /**
+   * \fn writeIncrementalState
+   * \brief write the files read by readIncrementalState.
+   *
+   * Both are written in full to temporary names (<prefix>.aprof.tmp and
+   * <prefix>.nseq.tmp, in that order) and then renamed over the old ones,
+   * the sum first and the count last.  So an interrupted write leaves either
+   *   - the sum's temporary file: the old state is whole, and the new one is
+   *     discarded; or
+   *   - just the count's temporary file: the new sum is in place, and the
+   *     rename of its count is finished
+   * by recoverIncrementalState(..), before the state is next read.
+   **/
+  static void
+  writeIncrementalState (
+    std::string const & state_prefix,
+    typename DynamicProgramming<ResidueType, ProbabilityType, ScoreType, MatrixValueType>::AlignmentProfile const & running_alignment_profile,
+    uint64_t const running_sequence_count
+  )
+  {
+    const std::string sum_filename = state_prefix + ".aprof";
+    const std::string count_filename = state_prefix + ".nseq";
+    const std::string sum_temp_filename = sum_filename + ".tmp";
+    const std::string count_temp_filename = count_filename + ".tmp";
+
+    // The sum's temporary file first: while it exists, the count's is
+    // ignored.
+    std::ofstream sum_stream( sum_temp_filename.c_str() );
+    if( !sum_stream.is_open() ) {
+      throw ( "Can't open state alignment profile file " + sum_temp_filename + " for writing" );
+    }
+    sum_stream << running_alignment_profile;
+    sum_stream.close();
+    if( sum_stream.fail() ) {
+      throw ( "Can't write state alignment profile file " + sum_temp_filename );
+    }
+
+    std::ofstream count_stream( count_temp_filename.c_str() );
+    if( !count_stream.is_open() ) {
+      throw ( "Can't open state file " + count_temp_filename + " for writing" );
+    }
+    count_stream << running_sequence_count << endl;
+    count_stream.close();
+    if( count_stream.fail() ) {
+      throw ( "Can't write state file " + count_temp_filename );
+    }
+
+    // Both are whole; commit the sum, then the count.
+    boost::filesystem::rename( sum_temp_filename, sum_filename );
+    boost::filesystem::rename( count_temp_filename, count_filename );
+  } // writeIncrementalState( string const &, AlignmentProfile const &, uint64_t const )
+
+  /**
+   * \fn recoverIncrementalState
+   * \brief finish or undo a writeIncrementalState(..) that was interrupted
+   * (see there), so that the sum and the count saved at state_prefix match.
+   **/
+  static void
+  recoverIncrementalState (
+    std::string const & state_prefix
+  )
+  {
+    const std::string sum_filename = state_prefix + ".aprof";
+    const std::string count_filename = state_prefix + ".nseq";
+    const std::string sum_temp_filename = sum_filename + ".tmp";
+    const std::string count_temp_filename = count_filename + ".tmp";
+    if( boost::filesystem::exists( sum_temp_filename ) ) {
+      // Interrupted before the new sum was committed: keep the old state.
+      boost::filesystem::remove( sum_temp_filename );
+      boost::filesystem::remove( count_temp_filename );
+    } else if( boost::filesystem::exists( count_temp_filename ) ) {
+      // Interrupted between the two renames: the new sum is in place.
+      boost::filesystem::rename( count_temp_filename, count_filename );
+    }
+  } // recoverIncrementalState( string const & )
 
 }; // End class GenAlignmentProfiles
 
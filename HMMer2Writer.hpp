@@ -0,0 +1,499 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      HMMer2Writer.hpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      Conversion of galosh Profiles to HMMer (version 2) Plan7 models, and a
+##      writer for HMMer's ASCII save-file format, without the hmmer and squid
+##      libraries.  The conversion follows what profileToHMMer used to do with
+##      them (AllocPlan7Body, Plan7FSConfig, a geometric entry/exit
+##      configuration, Plan7SetNullModel, Plan7Renormalize), and the writer
+##      what WriteAscHMM does, so the files are interchangeable: integer
+##      log-odds scores, 1000 * log2( p / null ), with "*" for 0.  Models are
+##      terminated by "//", so any number of them can be written to one file
+##      (as for hmmpfam databases).
+##
+##      Works for DNA and for AminoAcid20 profiles (residues are matched to
+##      HMMer's alphabet by character).  Galosh's USE_DEL_IN_DEL_OUT
+##      configuration is not supported.
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#if     _MSC_VER > 1000
+#pragma once
+#endif
+
+#ifndef __GALOSH_HMMER2WRITER_HPP__
+#define __GALOSH_HMMER2WRITER_HPP__
+
+#ifdef USE_DEL_IN_DEL_OUT
+#error "HMMer2Writer.hpp does not support USE_DEL_IN_DEL_OUT profiles"
+#endif // USE_DEL_IN_DEL_OUT
+
+#include "ProfileTables.hpp"
+
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+#include <seqan/basic.h>
+
+namespace galosh {
+
+  /**
+   * HMMer's alphabets, in its symbol order, for a given residue type.
+   */
+  template <typename ResidueType>
+  struct HMMer2Alphabet {
+    static char const * symbols () { return "ACGT"; }
+    static char const * name () { return "Nucleic"; }
+  }; // End struct HMMer2Alphabet<ResidueType>
+
+  template <>
+  struct HMMer2Alphabet<seqan::AminoAcid20> {
+    static char const * symbols () { return "ACDEFGHIKLMNPQRSTVWY"; }
+    static char const * name () { return "Amino"; }
+  }; // End struct HMMer2Alphabet<seqan::AminoAcid20>
+
+/**
+ * \class HMMer2Model
+ * \brief The probability parameters of a HMMer 2 Plan7 model, in HMMer's
+ * layout (nodes 1..M, symbols in HMMer's order; single precision, as in
+ * HMMer).
+ */
+template <typename ResidueType>
+class HMMer2Model {
+public:
+  enum { AlphabetSize = seqan::ValueSize<ResidueType>::VALUE };
+  /// Indices into m_xt (the special states) and its rows.
+  enum { XTN = 0, XTE = 1, XTC = 2, XTJ = 3, MOVE = 0, LOOP = 1 };
+  /// Indices into each node's transitions.
+  enum { TMM = 0, TMI = 1, TMD = 2, TIM = 3, TII = 4, TDM = 5, TDD = 6, TransitionCount = 7 };
+
+  std::string m_name;
+  std::string m_date;
+  uint32_t m_length; // M
+
+  /// [ k * AlphabetSize + x ], k in 1..M (row 0 unused).
+  std::vector<float> m_match;
+  /// [ k * AlphabetSize + x ], k in 1..M-1.
+  std::vector<float> m_insertion;
+  /// [ k * TransitionCount + t ], k in 1..M-1.
+  std::vector<float> m_transitions;
+  /// [ k ], k in 1..M.
+  std::vector<float> m_begin;
+  std::vector<float> m_end;
+  float m_tbd1;
+  float m_xt[ 4 ][ 2 ];
+  float m_null[ AlphabetSize ];
+  float m_p1;
+
+  /**
+   * Allocate (zeroed) parameters for a model of length M (like
+   * AllocPlan7Body).
+   */
+  void
+  reinitialize (
+    uint32_t const length
+  )
+  {
+    m_length = length;
+    m_match.assign( ( length + 1 ) * AlphabetSize, 0.0f );
+    m_insertion.assign( ( length + 1 ) * AlphabetSize, 0.0f );
+    m_transitions.assign( ( length + 1 ) * TransitionCount, 0.0f );
+    m_begin.assign( length + 1, 0.0f );
+    m_end.assign( length + 1, 0.0f );
+    m_tbd1 = 0;
+    std::memset( m_xt, 0, sizeof( m_xt ) );
+    std::memset( m_null, 0, sizeof( m_null ) );
+    m_p1 = 0;
+  } // reinitialize( uint32_t const )
+
+  float *
+  transitions (
+    uint32_t const k
+  )
+  {
+    return &m_transitions[ k * TransitionCount ];
+  } // transitions( uint32_t const )
+
+  /**
+   * Scale each node's match transitions after the exit probabilities change
+   * (exactly as Plan7RenormalizeExits does).
+   */
+  void
+  renormalizeExits ()
+  {
+    for( uint32_t k = 1; k < m_length; k++ ) {
+      float * t = transitions( k );
+      const float d = ( t[ TMM ] + t[ TMI ] + t[ TMD ] );
+      scale( t, 3, ( 1.0f / ( d + ( d * m_end[ k ] ) ) ) );
+    }
+  } // renormalizeExits()
+
+  /**
+   * Normalize every distribution (as Plan7Renormalize does).
+   */
+  void
+  renormalize ()
+  {
+    for( uint32_t k = 1; k <= m_length; k++ ) {
+      normalize( &m_match[ k * AlphabetSize ], AlphabetSize );
+    }
+    for( uint32_t k = 1; k < m_length; k++ ) {
+      normalize( &m_insertion[ k * AlphabetSize ], AlphabetSize );
+    }
+    float d = ( sum( &m_begin[ 1 ], m_length ) + m_tbd1 );
+    scale( &m_begin[ 1 ], m_length, ( 1.0f / d ) );
+    m_tbd1 /= d;
+    for( uint32_t k = 1; k < m_length; k++ ) {
+      float * t = transitions( k );
+      d = ( sum( t, 3 ) + m_end[ k ] );
+      scale( t, 3, ( 1.0f / d ) );
+      m_end[ k ] /= d;
+      normalize( t + TIM, 2 );
+      normalize( t + TDM, 2 );
+    }
+    normalize( m_null, AlphabetSize );
+  } // renormalize()
+
+protected:
+  static float
+  sum (
+    float const * values,
+    uint32_t const count
+  )
+  {
+    float total = 0;
+    for( uint32_t i = 0; i < count; i++ ) {
+      total += values[ i ];
+    }
+    return total;
+  } // sum( float const *, uint32_t const )
+
+  static void
+  scale (
+    float * values,
+    uint32_t const count,
+    float const factor
+  )
+  {
+    for( uint32_t i = 0; i < count; i++ ) {
+      values[ i ] *= factor;
+    }
+  } // scale( float *, uint32_t const, float const )
+
+  static void
+  normalize (
+    float * values,
+    uint32_t const count
+  )
+  {
+    const float total = sum( values, count );
+    if( total != 0.0f ) {
+      scale( values, count, ( 1.0f / total ) );
+    } else {
+      for( uint32_t i = 0; i < count; i++ ) {
+        values[ i ] = ( 1.0f / count );
+      }
+    }
+  } // normalize( float *, uint32_t const )
+
+}; // End class HMMer2Model
+
+  /**
+   * Convert the given profile (of length at least 2) to a HMMer model
+   * configured for multiple local (hmmfs-style) alignment.
+   * expected_distance_between_hits and null_model_expected_length of 0 mean
+   * to use the expected insertion length.
+   */
+  template <typename ResidueType, typename ProfileType>
+  void
+  profileToHMMer2Model (
+    ProfileType const & profile,
+    HMMer2Model<ResidueType> & hmm,
+    double const swentry = .5,
+    double const swexit = .5,
+    double const expected_distance_between_hits = 0,
+    double const null_model_expected_length = 0
+  )
+  {
+    typedef HMMer2Model<ResidueType> ModelType;
+    enum { AlphabetSize = ModelType::AlphabetSize };
+    const ProfileTables<ResidueType, ResidueType> tables( profile );
+    const uint32_t M = tables.m_profileLength;
+    if( M <= 1 ) {
+      throw std::string( "The profile is too short to convert to a HMMer model" );
+    }
+    // HMMer's symbol x is our residue ordinal residue_of[ x ].
+    uint32_t residue_of[ AlphabetSize ];
+    char const * const symbols = HMMer2Alphabet<ResidueType>::symbols();
+    for( uint32_t x = 0; x < AlphabetSize; x++ ) {
+      residue_of[ x ] = seqan::ordValue( ResidueType( symbols[ x ] ) );
+    }
+
+    hmm.reinitialize( M );
+    for( uint32_t pos_i = 0; pos_i < M; pos_i++ ) {
+      for( uint32_t x = 0; x < AlphabetSize; x++ ) {
+        hmm.m_match[ ( ( pos_i + 1 ) * AlphabetSize ) + x ] =
+          static_cast<float>( tables.matchEmission( pos_i, residue_of[ x ] ) );
+        hmm.m_insertion[ ( pos_i * AlphabetSize ) + x ] =
+          static_cast<float>( tables.insertionEmission( residue_of[ x ] ) );
+      }
+      if( pos_i != ( M - 1 ) ) { // Last pos has no transitions
+        float * t = hmm.transitions( pos_i + 1 );
+        t[ ModelType::TMM ] = static_cast<float>( tables[ ProfileTransition::MatchToMatch ] );
+        t[ ModelType::TMI ] = static_cast<float>( tables[ ProfileTransition::MatchToInsertion ] );
+        t[ ModelType::TMD ] = static_cast<float>( tables[ ProfileTransition::MatchToDeletion ] );
+        t[ ModelType::TIM ] = static_cast<float>( tables[ ProfileTransition::InsertionToMatch ] );
+        t[ ModelType::TII ] = static_cast<float>( tables[ ProfileTransition::InsertionToInsertion ] );
+        t[ ModelType::TDM ] = static_cast<float>( tables[ ProfileTransition::DeletionToMatch ] );
+        t[ ModelType::TDD ] = static_cast<float>( tables[ ProfileTransition::DeletionToDeletion ] );
+      }
+    } // End foreach pos_i
+
+    // Use the M->D prob for B->D.
+    hmm.m_tbd1 =
+      static_cast<float>( tables[ ProfileTransition::MatchToDeletion ] / ( 1.0 - tables[ ProfileTransition::MatchToInsertion ] ) );
+
+    // The p1 (null model extension prob) governs the amount of non-model
+    // stuff to expect in between hits; it is set again below, for the null
+    // model.
+    if( expected_distance_between_hits == 0 ) {
+      hmm.m_p1 = static_cast<float>( tables[ ProfileTransition::InsertionToInsertion ] );
+    } else {
+      hmm.m_p1 = static_cast<float>( 1.0 - ( 1.0 / expected_distance_between_hits ) );
+    }
+
+    // Special states, as configured by Plan7FSConfig.
+    hmm.m_xt[ ModelType::XTN ][ ModelType::MOVE ] = ( 1.0f - hmm.m_p1 );
+    hmm.m_xt[ ModelType::XTN ][ ModelType::LOOP ] = hmm.m_p1;
+    hmm.m_xt[ ModelType::XTE ][ ModelType::MOVE ] = 0.5f;
+    hmm.m_xt[ ModelType::XTE ][ ModelType::LOOP ] = 0.5f;
+    hmm.m_xt[ ModelType::XTC ][ ModelType::MOVE ] = ( 1.0f - hmm.m_p1 );
+    hmm.m_xt[ ModelType::XTC ][ ModelType::LOOP ] = hmm.m_p1;
+    hmm.m_xt[ ModelType::XTJ ][ ModelType::MOVE ] = ( 1.0f - hmm.m_p1 );
+    hmm.m_xt[ ModelType::XTJ ][ ModelType::LOOP ] = hmm.m_p1;
+
+    // Entry and exit: Plan7FSConfig's uniform ones (whose only lasting
+    // effect is through renormalizeExits()), replaced by geometric del-in and
+    // del-out lengths (expected length 1/4 of the profile).
+    const float entry = static_cast<float>( swentry );
+    const float exit = static_cast<float>( swexit );
+    for( uint32_t k = 1; k < M; k++ ) {
+      hmm.m_end[ k ] = ( exit / static_cast<float>( M - 1 ) );
+    }
+    hmm.m_end[ M ] = 1.0f;
+    hmm.renormalizeExits();
+
+    const float swentry_extend = ( 1.0f - ( 1.0f / ( M / 4.0f ) ) );
+    const float swexit_extend = ( 1.0f - ( 1.0f / ( M / 4.0f ) ) );
+    hmm.m_begin[ 1 ] = ( ( 1.0f - entry ) * ( 1.0f - hmm.m_tbd1 ) );
+    float cum_extend = ( ( 1.0f - hmm.m_tbd1 ) * ( entry / M ) );
+    for( uint32_t k = 2; k < M; k++ ) {
+      hmm.m_begin[ k ] = ( cum_extend * ( 1.0f - swentry_extend ) );
+      cum_extend *= swentry_extend;
+    }
+    hmm.m_begin[ M ] = cum_extend; // it always starts at or before the end!
+    hmm.m_end[ M ] = 1.0f;
+    cum_extend = ( exit / M );
+    for( uint32_t k = ( M - 1 ); k >= 1; k-- ) {
+      hmm.m_end[ k ] = cum_extend;
+      cum_extend *= swexit_extend;
+    }
+    hmm.renormalizeExits();
+
+    // Null model: the insertion distribution.
+    for( uint32_t x = 0; x < AlphabetSize; x++ ) {
+      hmm.m_null[ x ] = static_cast<float>( tables.insertionEmission( residue_of[ x ] ) );
+    }
+    if( null_model_expected_length == 0 ) {
+      // By default, use insertion length.
+      hmm.m_p1 = static_cast<float>( tables[ ProfileTransition::InsertionToInsertion ] );
+    } else {
+      hmm.m_p1 = static_cast<float>( 1.0 - ( 1.0 / null_model_expected_length ) );
+    }
+
+    hmm.renormalize();
+  } // profileToHMMer2Model( ProfileType const &, HMMer2Model<ResidueType> &, double const, double const, double const, double const )
+
+  /**
+   * The given name as a HMMer 2 model NAME, which HMMer reads as a single
+   * word: each whitespace character becomes '_', and an empty name becomes
+   * "GaloshProfile".
+   */
+  inline std::string
+  toHMMer2Name (
+    std::string const & name
+  )
+  {
+    if( name.empty() ) {
+      return "GaloshProfile";
+    }
+    std::string hmmer2_name( name );
+    for( size_t char_i = 0; char_i < hmmer2_name.length(); char_i++ ) {
+      if( std::isspace( static_cast<unsigned char>( hmmer2_name[ char_i ] ) ) ) {
+        hmmer2_name[ char_i ] = '_';
+      }
+    }
+    return hmmer2_name;
+  } // toHMMer2Name( string const & )
+
+  namespace hmmer2_writer_detail {
+
+    /**
+     * HMMer's integer score for probability p given the null probability
+     * (Prob2Score), as text (prob2ascii): "*" for 0.
+     */
+    inline std::string
+    probabilityToText (
+      float const p,
+      float const null
+    )
+    {
+      if( p == 0.0f ) {
+        return "*";
+      }
+      const float ratio = ( p / null );
+      const double log2_ratio = ( ( ratio > 0 ) ? ( std::log( ratio ) * 1.44269504 ) : -9999. );
+      char buffer[ 32 ];
+      std::sprintf( buffer, "%6d", static_cast<int>( std::floor( 0.5 + ( 1000.0 * log2_ratio ) ) ) );
+      return buffer;
+    } // probabilityToText( float const, float const )
+
+    inline void
+    writeField (
+      std::ostream & os,
+      std::string const & text
+    )
+    {
+      char buffer[ 32 ];
+      std::sprintf( buffer, "%6s ", text.c_str() );
+      os << buffer;
+    } // writeField( ostream &, string const & )
+
+  } // End namespace hmmer2_writer_detail
+
+  /**
+   * Write the model in HMMer 2's ASCII save-file format (as WriteAscHMM
+   * does), ending with "//".
+   */
+  template <typename ResidueType>
+  void
+  writeHMMer2Model (
+    std::ostream & os,
+    HMMer2Model<ResidueType> const & hmm
+  )
+  {
+    using namespace hmmer2_writer_detail;
+    typedef HMMer2Model<ResidueType> ModelType;
+    enum { AlphabetSize = ModelType::AlphabetSize };
+    char const * const symbols = HMMer2Alphabet<ResidueType>::symbols();
+    const uint32_t M = hmm.m_length;
+
+    os << "HMMER2.0  [2.3.2]\n";
+    os << "NAME  " << hmm.m_name << "\n";
+    os << "LENG  " << M << "\n";
+    os << "ALPH  " << HMMer2Alphabet<ResidueType>::name() << "\n";
+    os << "RF    no\n";
+    os << "CS    no\n";
+    os << "MAP   no\n";
+    if( !hmm.m_date.empty() ) {
+      os << "DATE  " << hmm.m_date << "\n";
+    }
+    os << "CKSUM 0\n";
+    os << "XT     ";
+    for( uint32_t k = 0; k < 4; k++ ) {
+      for( uint32_t x = 0; x < 2; x++ ) {
+        writeField( os, probabilityToText( hmm.m_xt[ k ][ x ], 1.0f ) );
+      }
+    }
+    os << "\n";
+    char buffer[ 32 ];
+    os << "NULT   ";
+    writeField( os, probabilityToText( hmm.m_p1, 1.0f ) );
+    std::sprintf( buffer, "%6s\n", probabilityToText( ( 1.0f - hmm.m_p1 ), 1.0f ).c_str() );
+    os << buffer;
+    os << "NULE   ";
+    for( uint32_t x = 0; x < AlphabetSize; x++ ) {
+      writeField( os, probabilityToText( hmm.m_null[ x ], ( 1.0f / AlphabetSize ) ) );
+    }
+    os << "\n";
+
+    os << "HMM      ";
+    for( uint32_t x = 0; x < AlphabetSize; x++ ) {
+      os << "  " << symbols[ x ] << "    ";
+    }
+    os << "\n";
+    static char const * const transition_names[] = { "m->m", "m->i", "m->d", "i->m", "i->i", "d->m", "d->d", "b->m", "m->e" };
+    os << "       ";
+    for( uint32_t t = 0; t < 8; t++ ) {
+      writeField( os, transition_names[ t ] );
+    }
+    std::sprintf( buffer, "%6s\n", transition_names[ 8 ] );
+    os << buffer;
+    os << "      ";
+    writeField( os, probabilityToText( ( 1.0f - hmm.m_tbd1 ), 1.0f ) );
+    writeField( os, "*" );
+    std::sprintf( buffer, "%6s\n", probabilityToText( hmm.m_tbd1, 1.0f ).c_str() );
+    os << buffer;
+    for( uint32_t k = 1; k <= M; k++ ) {
+      // Line 1: k, match emissions
+      std::sprintf( buffer, " %5u ", k );
+      os << buffer;
+      for( uint32_t x = 0; x < AlphabetSize; x++ ) {
+        writeField( os, probabilityToText( hmm.m_match[ ( k * AlphabetSize ) + x ], hmm.m_null[ x ] ) );
+      }
+      os << "\n";
+      // Line 2: RF and insert emissions
+      os << "     - ";
+      for( uint32_t x = 0; x < AlphabetSize; x++ ) {
+        writeField( os, ( ( k < M ) ? probabilityToText( hmm.m_insertion[ ( k * AlphabetSize ) + x ], hmm.m_null[ x ] ) : "*" ) );
+      }
+      os << "\n";
+      // Line 3: CS and transition probs
+      os << "     - ";
+      for( uint32_t t = 0; t < ModelType::TransitionCount; t++ ) {
+        writeField( os, ( ( k < M ) ? probabilityToText( hmm.m_transitions[ ( k * ModelType::TransitionCount ) + t ], 1.0f ) : "*" ) );
+      }
+      writeField( os, probabilityToText( hmm.m_begin[ k ], 1.0f ) );
+      writeField( os, probabilityToText( hmm.m_end[ k ], 1.0f ) );
+      os << "\n";
+    } // End foreach node k
+    os << "//\n";
+  } // writeHMMer2Model( ostream &, HMMer2Model<ResidueType> const & )
+
+} // End namespace galosh
+
+#endif // __GALOSH_HMMER2WRITER_HPP__
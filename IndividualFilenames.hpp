@@ -0,0 +1,96 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      IndividualFilenames.hpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      Helpers for naming per-sequence output files (eg. the individual
+##      alignment profiles of profileToAlignmentProfile).  Shared by the
+##      programs that write such files and by the ones that extract them from
+##      a record container.
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2012, 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#if     _MSC_VER > 1000
+#pragma once
+#endif
+
+#ifndef __GALOSH_INDIVIDUALFILENAMES_HPP__
+#define __GALOSH_INDIVIDUALFILENAMES_HPP__
+
+#include <string>
+
+#include <boost/algorithm/string/replace.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/filesystem.hpp>
+
+namespace galosh {
+
+/**
+ * Replace characters in the given sequence name that would be a problem in a
+ * filename.
+ */
+inline std::string
+escape_path ( const std::string & unescaped_path )
+{
+  std::string escaped_path_str( unescaped_path );
+  boost::replace_all( escaped_path_str, "|", "-x-BAR-x-" );
+  boost::replace_all( escaped_path_str, "/", "-x-SLASH-x-" );
+  boost::replace_all( escaped_path_str, "\\", "-x-BACKSLASH-x-" );
+  boost::replace_all( escaped_path_str, "..", "-x-DOTDOT-x-" );
+  boost::replace_all( escaped_path_str, ".", "-x-DOT-x-" );
+  boost::filesystem::path escaped_path( escaped_path_str );
+  return( escaped_path.native() );
+} // escape_path ( const string & )
+
+/**
+ * Build the filename for the individual output for the sequence with the
+ * given name and number: in the suffix pattern, $n is replaced by the
+ * (escaped) name, or by the number if the name is empty, and $d is replaced
+ * by the number.
+ */
+inline std::string
+individual_filename (
+  std::string const & prefix,
+  std::string const & suffix_pattern,
+  std::string const & name,
+  uint64_t const number
+)
+{
+  std::string filename = prefix + suffix_pattern;
+  if( name.length() > 0 ) {
+    boost::replace_all( filename, "$n", escape_path( name ) );
+  } else {
+    boost::replace_all( filename, "$n", boost::lexical_cast<std::string>( number ) );
+  }
+  boost::replace_all( filename, "$d", boost::lexical_cast<std::string>( number ) );
+  return filename;
+} // individual_filename( string const &, string const &, string const &, uint64_t const )
+
+} // End namespace galosh
+
+#endif // __GALOSH_INDIVIDUALFILENAMES_HPP__
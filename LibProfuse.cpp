@@ -0,0 +1,733 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      LibProfuse.cpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      The implementation of libprofuse, the C API of profuse (see
+##      libprofuse.h).  It is built once per alphabet: with
+##      __PROFUSE_USE_AMINOS defined for amino acid profiles (libprofuse_AA),
+##      and without it for DNA (libprofuse_DNA).
+##
+##      Scoring, aligning and counting use the memory-bounded checkpointed dp
+##      (CheckpointedViterbi, CheckpointedForwardBackward and
+##      PosteriorDecoding) on ProfileTables made once per loaded profile, run
+##      over the caller's sequences with parallelFor.
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#include "libprofuse.h"
+
+#include "Algebra.hpp"
+#include "Profile.hpp"
+#include "ProfileTables.hpp"
+#include "ExpectedCounts.hpp"
+#include "CheckpointedViterbi.hpp"
+#include "PosteriorDecoding.hpp"
+#include "ProfileTreeContainer.hpp"
+#include "ParallelFor.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <limits>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <seqan/basic.h>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/tss.hpp>
+
+using namespace galosh;
+
+namespace galosh {
+namespace libprofuse {
+
+#ifdef __PROFUSE_USE_AMINOS
+  typedef seqan::AminoAcid20 ResidueType;
+  typedef seqan::AminoAcid SequenceResidueType;
+#else // __PROFUSE_USE_AMINOS .. else
+  typedef seqan::Dna ResidueType;
+  typedef seqan::Iupac SequenceResidueType;
+#endif // __PROFUSE_USE_AMINOS .. else ..
+
+  // Profile files are read at the precision the command-line tools use;
+  // ProfileTree containers hold floatrealspace profiles.
+  typedef ProfileTreeRoot<ResidueType, doublerealspace> FileProfileType;
+  typedef ProfileTreeRoot<ResidueType, floatrealspace> ArchiveProfileType;
+
+  typedef ProfileTables<ResidueType, SequenceResidueType> TablesType;
+  typedef ResidueShares<ResidueType, SequenceResidueType> SharesType;
+
+  /// Sequences are counted in chunks of this many, each chunk's counts
+  /// summed separately and then added in chunk order, so that the totals
+  /// don't depend on the number of threads.
+  static const size_t COUNTS_CHUNK_SIZE = 16;
+
+  static boost::thread_specific_ptr<std::string> g_lastError;
+
+  inline void
+  setLastError (
+    std::string const & error
+  )
+  {
+    if( g_lastError.get() == NULL ) {
+      g_lastError.reset( new std::string() );
+    }
+    *g_lastError = error;
+  } // setLastError( string const & )
+
+  inline profuse_status
+  fail (
+    profuse_status const status,
+    std::string const & error
+  )
+  {
+    setLastError( error );
+    return status;
+  } // fail( profuse_status const, string const & )
+
+  /**
+   * Call from within a catch( ... ) block: records the exception being
+   * handled as the last error, and returns status.
+   */
+  inline profuse_status
+  failWithCurrentException (
+    profuse_status const status = PROFUSE_FAILED
+  )
+  {
+    try {
+      throw;
+    } catch( std::string const & err ) {
+      return fail( status, err );
+    } catch( char const * err ) {
+      return fail( status, err );
+    } catch( std::bad_alloc const & ) {
+      return fail( PROFUSE_FAILED, "out of memory" );
+    } catch( std::exception const & e ) {
+      return fail( status, e.what() );
+    } catch( ... ) {
+      return fail( status, "unknown error" );
+    }
+  } // failWithCurrentException( profuse_status const )
+
+  /**
+   * The residues of ResidueType, in ordinal order.
+   */
+  inline std::string
+  alphabetString ()
+  {
+    std::string alphabet;
+    for( uint32_t res_i = 0; res_i < seqan::ValueSize<ResidueType>::VALUE; res_i++ ) {
+      alphabet += static_cast<char>( ResidueType( res_i ) );
+    }
+    return alphabet;
+  } // alphabetString()
+
+  inline void
+  checkSequences (
+    profuse_sequence const * sequences,
+    size_t const count
+  )
+  {
+    if( ( sequences == NULL ) && ( count > 0 ) ) {
+      throw std::string( "the sequences are NULL" );
+    }
+    for( size_t seq_i = 0; seq_i < count; seq_i++ ) {
+      if( ( sequences[ seq_i ].residues == NULL ) && ( sequences[ seq_i ].length > 0 ) ) {
+        throw std::string( "the residues of sequence " ) + boost::lexical_cast<std::string>( seq_i ) + " are NULL";
+      }
+    }
+  } // checkSequences( profuse_sequence const *, size_t const )
+
+  /**
+   * Convert the given sequence into the residue ordinal values of its
+   * residues as SequenceResidueTypes.
+   */
+  inline void
+  sequenceToOrdinals (
+    profuse_sequence const & sequence,
+    std::vector<uint32_t> & residues
+  )
+  {
+    residues.resize( sequence.length );
+    for( size_t i = 0; i < sequence.length; i++ ) {
+      residues[ i ] = seqan::ordValue( SequenceResidueType( sequence.residues[ i ] ) );
+    }
+  } // sequenceToOrdinals( profuse_sequence const &, vector<uint32_t> & )
+
+} // End namespace libprofuse
+} // End namespace galosh
+
+using namespace galosh::libprofuse;
+
+/**
+ * A loaded profile: its tables, as probabilities (for forward-backward) and
+ * as logs (for Viterbi), and the shares by which the counts of ambiguous
+ * residues are spread.
+ */
+struct profuse_profile {
+  TablesType m_tables;
+  TablesType m_logTables;
+  SharesType m_shares;
+
+  template <typename ProfileType>
+  explicit profuse_profile (
+    ProfileType const & profile
+  ) :
+    m_tables( profile ),
+    m_logTables( profile ),
+    m_shares( profile )
+  {
+    m_logTables.convertToLogs();
+  } // <init>( ProfileType const & )
+}; // End struct profuse_profile
+
+struct profuse_alignments {
+  std::vector<profuse_alignment> m_alignments;
+  std::vector<AlignmentPath> m_paths;
+  std::vector<std::vector<uint8_t> > m_confidences;
+}; // End struct profuse_alignments
+
+struct profuse_alignment_profile {
+  profuse_profile const * m_profile;
+  ExpectedCounts<ResidueType> m_counts;
+}; // End struct profuse_alignment_profile
+
+namespace galosh {
+namespace libprofuse {
+
+  /**
+   * The parallelFor body for profuse_score: scores one sequence.
+   */
+  class ScoreBody {
+  public:
+    ScoreBody (
+      profuse_profile const & profile,
+      profuse_sequence const * sequences,
+      profuse_method const method,
+      double * log_probabilities
+    ) :
+      m_profile( profile ),
+      m_sequences( sequences ),
+      m_method( method ),
+      m_logProbabilities( log_probabilities )
+    {
+      // Do nothing else.
+    } // <init>( .. )
+
+    void
+    operator() (
+      size_t const seq_i,
+      uint32_t const thread_i
+    )
+    {
+      sequenceToOrdinals( m_sequences[ seq_i ], m_residues );
+      if( m_method == PROFUSE_VITERBI ) {
+        CheckpointedViterbi<ResidueType, SequenceResidueType> viterbi( m_profile.m_logTables );
+        m_logProbabilities[ seq_i ] = viterbi.viterbi( m_residues, m_path );
+      } else {
+        CheckpointedForwardBackward<ResidueType, SequenceResidueType> forward_backward( m_profile.m_tables );
+        m_logProbabilities[ seq_i ] = forward_backward.forward( m_residues );
+      }
+    } // operator()( size_t const, uint32_t const )
+
+  protected:
+    profuse_profile const & m_profile;
+    profuse_sequence const * m_sequences;
+    profuse_method m_method;
+    double * m_logProbabilities;
+    std::vector<uint32_t> m_residues; // Per-thread scratch space.
+    AlignmentPath m_path; // Per-thread scratch space.
+  }; // End class ScoreBody
+
+  /**
+   * The parallelFor body for profuse_align: aligns one sequence.
+   */
+  class AlignBody {
+  public:
+    AlignBody (
+      profuse_profile const & profile,
+      profuse_sequence const * sequences,
+      profuse_method const method,
+      bool const with_confidences,
+      uint32_t const checkpoint_interval,
+      profuse_alignments & alignments
+    ) :
+      m_profile( profile ),
+      m_sequences( sequences ),
+      m_method( method ),
+      m_withConfidences( with_confidences ),
+      m_checkpointInterval( checkpoint_interval ),
+      m_alignments( alignments )
+    {
+      // Do nothing else.
+    } // <init>( .. )
+
+    void
+    operator() (
+      size_t const seq_i,
+      uint32_t const thread_i
+    )
+    {
+      sequenceToOrdinals( m_sequences[ seq_i ], m_residues );
+      profuse_alignment & alignment = m_alignments.m_alignments[ seq_i ];
+      alignment.expected_accuracy = 0;
+      if( m_method == PROFUSE_VITERBI ) {
+        CheckpointedViterbi<ResidueType, SequenceResidueType> viterbi( m_profile.m_logTables, m_checkpointInterval );
+        alignment.log_probability = viterbi.viterbi( m_residues, m_alignments.m_paths[ seq_i ] );
+      } else {
+        PosteriorDecoding<ResidueType, SequenceResidueType> decoding( m_profile.m_tables, m_checkpointInterval );
+        alignment.log_probability =
+          decoding.decode(
+            m_residues,
+            m_alignments.m_paths[ seq_i ],
+            ( m_withConfidences ? &m_alignments.m_confidences[ seq_i ] : NULL ),
+            alignment.expected_accuracy
+          );
+      }
+    } // operator()( size_t const, uint32_t const )
+
+  protected:
+    profuse_profile const & m_profile;
+    profuse_sequence const * m_sequences;
+    profuse_method m_method;
+    bool m_withConfidences;
+    uint32_t m_checkpointInterval;
+    profuse_alignments & m_alignments;
+    std::vector<uint32_t> m_residues; // Per-thread scratch space.
+  }; // End class AlignBody
+
+  /**
+   * The parallelFor body for profuse_alignment_profile_add: counts one chunk
+   * of sequences (chunk first_chunk + slot_i) into chunk_counts[ slot_i ].
+   */
+  class CountsBody {
+  public:
+    CountsBody (
+      profuse_profile const & profile,
+      profuse_sequence const * sequences,
+      size_t const count,
+      double const * weights,
+      profuse_method const method,
+      uint32_t const checkpoint_interval,
+      size_t const first_chunk,
+      double * log_probabilities,
+      std::vector<ExpectedCounts<ResidueType> > & chunk_counts
+    ) :
+      m_profile( profile ),
+      m_sequences( sequences ),
+      m_count( count ),
+      m_weights( weights ),
+      m_method( method ),
+      m_checkpointInterval( checkpoint_interval ),
+      m_firstChunk( first_chunk ),
+      m_logProbabilities( log_probabilities ),
+      m_chunkCounts( chunk_counts )
+    {
+      // Do nothing else.
+    } // <init>( .. )
+
+    void
+    operator() (
+      size_t const slot_i,
+      uint32_t const thread_i
+    )
+    {
+      ExpectedCounts<ResidueType> & counts = m_chunkCounts[ slot_i ];
+      counts.zero();
+      const size_t first_seq = ( m_firstChunk + slot_i ) * COUNTS_CHUNK_SIZE;
+      const size_t end_seq = std::min( m_count, first_seq + COUNTS_CHUNK_SIZE );
+      for( size_t seq_i = first_seq; seq_i < end_seq; seq_i++ ) {
+        const double weight = ( ( m_weights == NULL ) ? 1.0 : m_weights[ seq_i ] );
+        double log_probability;
+        if( m_method == PROFUSE_VITERBI ) {
+          CheckpointedViterbi<ResidueType, SequenceResidueType> viterbi( m_profile.m_logTables, m_checkpointInterval );
+          sequenceToOrdinals( m_sequences[ seq_i ], m_residues );
+          log_probability = viterbi.viterbi( m_residues, m_path );
+          if( !m_path.empty() ) {
+            counts.addPath( m_path, m_residues, m_profile.m_shares, weight );
+          }
+        } else {
+          CheckpointedForwardBackward<ResidueType, SequenceResidueType> forward_backward( m_profile.m_tables, m_checkpointInterval );
+          sequenceToOrdinals( m_sequences[ seq_i ], m_residues );
+          log_probability = forward_backward.expectedCounts( m_residues, m_profile.m_shares, counts, weight );
+        }
+        if( log_probability == -std::numeric_limits<double>::infinity() ) {
+          throw std::string( "The probability of sequence " ) + boost::lexical_cast<std::string>( seq_i ) + " is 0 given the profile";
+        }
+        if( m_logProbabilities != NULL ) {
+          m_logProbabilities[ seq_i ] = log_probability;
+        }
+      } // End foreach seq_i
+    } // operator()( size_t const, uint32_t const )
+
+  protected:
+    profuse_profile const & m_profile;
+    profuse_sequence const * m_sequences;
+    size_t m_count;
+    double const * m_weights;
+    profuse_method m_method;
+    uint32_t m_checkpointInterval;
+    size_t m_firstChunk;
+    double * m_logProbabilities;
+    std::vector<ExpectedCounts<ResidueType> > & m_chunkCounts;
+    std::vector<uint32_t> m_residues; // Per-thread scratch space.
+    AlignmentPath m_path; // Per-thread scratch space.
+  }; // End class CountsBody
+
+} // End namespace libprofuse
+} // End namespace galosh
+
+
+extern "C" {
+
+uint32_t
+profuse_api_version ()
+{
+  return PROFUSE_API_VERSION;
+} // profuse_api_version()
+
+const char *
+profuse_alphabet ()
+{
+  static const std::string alphabet = alphabetString();
+  return alphabet.c_str();
+} // profuse_alphabet()
+
+const char *
+profuse_last_error ()
+{
+  return ( ( g_lastError.get() == NULL ) ? "" : g_lastError->c_str() );
+} // profuse_last_error()
+
+profuse_status
+profuse_profile_read_file (
+  const char * filename,
+  profuse_profile ** profile
+)
+{
+  if( ( filename == NULL ) || ( profile == NULL ) ) {
+    return fail( PROFUSE_INVALID_ARGUMENT, "profuse_profile_read_file: the filename and profile must not be NULL" );
+  }
+  *profile = NULL;
+  try {
+    FileProfileType file_profile;
+    if( !file_profile.fromFile( filename ) ) {
+      return fail( PROFUSE_BAD_PROFILE, std::string( "The profile file '" ) + filename + "' could not be read" );
+    }
+    *profile = new profuse_profile( file_profile );
+    return PROFUSE_OK;
+  } catch( ... ) {
+    return failWithCurrentException( PROFUSE_BAD_PROFILE );
+  }
+} // profuse_profile_read_file( const char *, profuse_profile ** )
+
+profuse_status
+profuse_profile_read_text (
+  const char * text,
+  size_t size,
+  profuse_profile ** profile
+)
+{
+  if( ( ( text == NULL ) && ( size > 0 ) ) || ( profile == NULL ) ) {
+    return fail( PROFUSE_INVALID_ARGUMENT, "profuse_profile_read_text: the text and profile must not be NULL" );
+  }
+  *profile = NULL;
+  try {
+    std::istringstream is( std::string( text, size ) );
+    FileProfileType text_profile;
+    is >> text_profile;
+    if( is.bad() || ( text_profile.length() == 0 ) ) {
+      return fail( PROFUSE_BAD_PROFILE, "The profile text could not be read" );
+    }
+    *profile = new profuse_profile( text_profile );
+    return PROFUSE_OK;
+  } catch( ... ) {
+    return failWithCurrentException( PROFUSE_BAD_PROFILE );
+  }
+} // profuse_profile_read_text( const char *, size_t, profuse_profile ** )
+
+profuse_status
+profuse_profile_read_archive (
+  const void * bytes,
+  size_t size,
+  profuse_profile ** profile
+)
+{
+  if( ( ( bytes == NULL ) && ( size > 0 ) ) || ( profile == NULL ) ) {
+    return fail( PROFUSE_INVALID_ARGUMENT, "profuse_profile_read_archive: the bytes and profile must not be NULL" );
+  }
+  *profile = NULL;
+  try {
+    ArchiveProfileType archive_profile;
+    decodeProfileTreeNode( std::string( static_cast<const char *>( bytes ), size ), archive_profile );
+    *profile = new profuse_profile( archive_profile );
+    return PROFUSE_OK;
+  } catch( ... ) {
+    return failWithCurrentException( PROFUSE_BAD_PROFILE );
+  }
+} // profuse_profile_read_archive( const void *, size_t, profuse_profile ** )
+
+void
+profuse_profile_free (
+  profuse_profile * profile
+)
+{
+  delete profile;
+} // profuse_profile_free( profuse_profile * )
+
+uint32_t
+profuse_profile_length (
+  const profuse_profile * profile
+)
+{
+  return ( ( profile == NULL ) ? 0 : profile->m_tables.m_profileLength );
+} // profuse_profile_length( const profuse_profile * )
+
+profuse_status
+profuse_score (
+  const profuse_profile * profile,
+  const profuse_sequence * sequences,
+  size_t count,
+  profuse_method method,
+  uint32_t thread_count,
+  double * log_probabilities
+)
+{
+  if( ( profile == NULL ) || ( ( log_probabilities == NULL ) && ( count > 0 ) ) ) {
+    return fail( PROFUSE_INVALID_ARGUMENT, "profuse_score: the profile and log_probabilities must not be NULL" );
+  }
+  try {
+    checkSequences( sequences, count );
+  } catch( ... ) {
+    return failWithCurrentException( PROFUSE_INVALID_ARGUMENT );
+  }
+  try {
+    parallelFor( count, thread_count, ScoreBody( *profile, sequences, method, log_probabilities ) );
+    return PROFUSE_OK;
+  } catch( ... ) {
+    return failWithCurrentException();
+  }
+} // profuse_score( .. )
+
+profuse_status
+profuse_align (
+  const profuse_profile * profile,
+  const profuse_sequence * sequences,
+  size_t count,
+  profuse_method method,
+  int with_confidences,
+  uint32_t thread_count,
+  uint32_t checkpoint_interval,
+  profuse_alignments ** alignments
+)
+{
+  if( ( profile == NULL ) || ( alignments == NULL ) ) {
+    return fail( PROFUSE_INVALID_ARGUMENT, "profuse_align: the profile and alignments must not be NULL" );
+  }
+  *alignments = NULL;
+  try {
+    checkSequences( sequences, count );
+  } catch( ... ) {
+    return failWithCurrentException( PROFUSE_INVALID_ARGUMENT );
+  }
+  profuse_alignments * result = NULL;
+  try {
+    result = new profuse_alignments();
+    result->m_alignments.resize( count );
+    result->m_paths.resize( count );
+    const bool want_confidences = ( ( with_confidences != 0 ) && ( method == PROFUSE_POSTERIOR ) );
+    if( want_confidences ) {
+      result->m_confidences.resize( count );
+    }
+    parallelFor(
+      count,
+      thread_count,
+      AlignBody( *profile, sequences, method, want_confidences, checkpoint_interval, *result )
+    );
+    // The vectors are all filled in now, so they won't move.
+    for( size_t seq_i = 0; seq_i < count; seq_i++ ) {
+      profuse_alignment & alignment = result->m_alignments[ seq_i ];
+      AlignmentPath const & path = result->m_paths[ seq_i ];
+      alignment.path_length = path.size();
+      alignment.path = ( path.empty() ? NULL : &path[ 0 ] );
+      alignment.confidences =
+        ( ( want_confidences && !result->m_confidences[ seq_i ].empty() ) ? &result->m_confidences[ seq_i ][ 0 ] : NULL );
+    }
+    *alignments = result;
+    return PROFUSE_OK;
+  } catch( ... ) {
+    delete result;
+    return failWithCurrentException();
+  }
+} // profuse_align( .. )
+
+size_t
+profuse_alignments_count (
+  const profuse_alignments * alignments
+)
+{
+  return ( ( alignments == NULL ) ? 0 : alignments->m_alignments.size() );
+} // profuse_alignments_count( const profuse_alignments * )
+
+const profuse_alignment *
+profuse_alignments_get (
+  const profuse_alignments * alignments,
+  size_t seq_i
+)
+{
+  if( ( alignments == NULL ) || ( seq_i >= alignments->m_alignments.size() ) ) {
+    return NULL;
+  }
+  return &alignments->m_alignments[ seq_i ];
+} // profuse_alignments_get( const profuse_alignments *, size_t )
+
+void
+profuse_alignments_free (
+  profuse_alignments * alignments
+)
+{
+  delete alignments;
+} // profuse_alignments_free( profuse_alignments * )
+
+profuse_status
+profuse_alignment_profile_create (
+  const profuse_profile * profile,
+  profuse_alignment_profile ** alignment_profile
+)
+{
+  if( ( profile == NULL ) || ( alignment_profile == NULL ) ) {
+    return fail( PROFUSE_INVALID_ARGUMENT, "profuse_alignment_profile_create: the profile and alignment_profile must not be NULL" );
+  }
+  *alignment_profile = NULL;
+  try {
+    profuse_alignment_profile * result = new profuse_alignment_profile();
+    result->m_profile = profile;
+    result->m_counts.reinitialize( profile->m_tables.m_profileLength );
+    *alignment_profile = result;
+    return PROFUSE_OK;
+  } catch( ... ) {
+    return failWithCurrentException();
+  }
+} // profuse_alignment_profile_create( const profuse_profile *, profuse_alignment_profile ** )
+
+profuse_status
+profuse_alignment_profile_add (
+  profuse_alignment_profile * alignment_profile,
+  const profuse_sequence * sequences,
+  size_t count,
+  const double * weights,
+  profuse_method method,
+  uint32_t thread_count,
+  uint32_t checkpoint_interval,
+  double * log_probabilities
+)
+{
+  if( alignment_profile == NULL ) {
+    return fail( PROFUSE_INVALID_ARGUMENT, "profuse_alignment_profile_add: the alignment_profile must not be NULL" );
+  }
+  try {
+    checkSequences( sequences, count );
+  } catch( ... ) {
+    return failWithCurrentException( PROFUSE_INVALID_ARGUMENT );
+  }
+  try {
+    if( thread_count == 0 ) {
+      thread_count = defaultThreadCount();
+    }
+    const uint32_t profile_length = alignment_profile->m_profile->m_tables.m_profileLength;
+    const size_t chunk_count = ( count + COUNTS_CHUNK_SIZE - 1 ) / COUNTS_CHUNK_SIZE;
+    // A few chunks per thread at a time bounds the memory for the chunks'
+    // counts while keeping the threads busy.
+    const size_t chunks_per_round = std::min( chunk_count, static_cast<size_t>( thread_count ) * 4 );
+    std::vector<ExpectedCounts<ResidueType> > chunk_counts( chunks_per_round, ExpectedCounts<ResidueType>( profile_length ) );
+    // Summed separately so that nothing is added if a sequence fails.
+    ExpectedCounts<ResidueType> total( profile_length );
+    for( size_t first_chunk = 0; first_chunk < chunk_count; first_chunk += chunks_per_round ) {
+      const size_t round_chunks = std::min( chunks_per_round, chunk_count - first_chunk );
+      parallelFor(
+        round_chunks,
+        thread_count,
+        CountsBody( *alignment_profile->m_profile, sequences, count, weights, method, checkpoint_interval, first_chunk, log_probabilities, chunk_counts )
+      );
+      for( size_t slot_i = 0; slot_i < round_chunks; slot_i++ ) {
+        total += chunk_counts[ slot_i ];
+      }
+    } // End foreach round of chunks
+    alignment_profile->m_counts += total;
+    return PROFUSE_OK;
+  } catch( ... ) {
+    return failWithCurrentException();
+  }
+} // profuse_alignment_profile_add( .. )
+
+void
+profuse_alignment_profile_free (
+  profuse_alignment_profile * alignment_profile
+)
+{
+  delete alignment_profile;
+} // profuse_alignment_profile_free( profuse_alignment_profile * )
+
+void
+profuse_alignment_profile_zero (
+  profuse_alignment_profile * alignment_profile
+)
+{
+  if( alignment_profile != NULL ) {
+    alignment_profile->m_counts.zero();
+  }
+} // profuse_alignment_profile_zero( profuse_alignment_profile * )
+
+const double *
+profuse_alignment_profile_match_emissions (
+  const profuse_alignment_profile * alignment_profile
+)
+{
+  return ( ( alignment_profile == NULL ) ? NULL : &alignment_profile->m_counts.m_matchEmissions[ 0 ] );
+} // profuse_alignment_profile_match_emissions( const profuse_alignment_profile * )
+
+const double *
+profuse_alignment_profile_insertion_emissions (
+  const profuse_alignment_profile * alignment_profile
+)
+{
+  return ( ( alignment_profile == NULL ) ? NULL : &alignment_profile->m_counts.m_insertionEmissions[ 0 ] );
+} // profuse_alignment_profile_insertion_emissions( const profuse_alignment_profile * )
+
+const double *
+profuse_alignment_profile_transitions (
+  const profuse_alignment_profile * alignment_profile
+)
+{
+  return ( ( alignment_profile == NULL ) ? NULL : &alignment_profile->m_counts.m_transitions[ 0 ] );
+} // profuse_alignment_profile_transitions( const profuse_alignment_profile * )
+
+} // End extern "C"
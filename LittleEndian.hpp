@@ -0,0 +1,111 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      LittleEndian.hpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      Little-endian encoding and decoding of unsigned integers of 1 to 8
+##      bytes, for the binary file formats (see RecordContainer.hpp,
+##      PathSidecar.hpp, and the .2bit writer in RandomSequenceGenerator.hpp),
+##      so that they don't depend on the byte order of the machine.
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#if     _MSC_VER > 1000
+#pragma once
+#endif
+
+#ifndef __GALOSH_LITTLEENDIAN_HPP__
+#define __GALOSH_LITTLEENDIAN_HPP__
+
+#include <iostream>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+namespace galosh {
+
+  /**
+   * Put the low num_bytes bytes of value into bytes[ 0 .. num_bytes - 1 ],
+   * least significant first.
+   */
+  inline void
+  encodeLittleEndian (
+    uint8_t * bytes,
+    uint64_t value,
+    uint32_t const num_bytes
+  )
+  {
+    for( uint32_t byte_i = 0; byte_i < num_bytes; byte_i++ ) {
+      bytes[ byte_i ] = static_cast<uint8_t>( value & 0xFF );
+      value >>= 8;
+    }
+  } // encodeLittleEndian( uint8_t *, uint64_t, uint32_t const )
+
+  /**
+   * The value of the num_bytes bytes at bytes, least significant first.
+   */
+  inline uint64_t
+  decodeLittleEndian (
+    uint8_t const * bytes,
+    uint32_t const num_bytes
+  )
+  {
+    uint64_t value = 0;
+    for( int32_t byte_i = ( num_bytes - 1 ); byte_i >= 0; byte_i-- ) {
+      value = ( ( value << 8 ) | bytes[ byte_i ] );
+    }
+    return value;
+  } // decodeLittleEndian( uint8_t const *, uint32_t const )
+
+  inline void
+  appendLittleEndian (
+    std::vector<uint8_t> & bytes,
+    uint64_t const value,
+    uint32_t const num_bytes
+  )
+  {
+    uint8_t encoded[ 8 ];
+    encodeLittleEndian( encoded, value, num_bytes );
+    bytes.insert( bytes.end(), encoded, encoded + num_bytes );
+  } // appendLittleEndian( vector<uint8_t> &, uint64_t const, uint32_t const )
+
+  inline void
+  writeLittleEndian (
+    std::ostream & os,
+    uint64_t const value,
+    uint32_t const num_bytes
+  )
+  {
+    uint8_t encoded[ 8 ];
+    encodeLittleEndian( encoded, value, num_bytes );
+    os.write( reinterpret_cast<char const *>( encoded ), num_bytes );
+  } // writeLittleEndian( ostream &, uint64_t const, uint32_t const )
+
+} // End namespace galosh
+
+#endif // __GALOSH_LITTLEENDIAN_HPP__
@@ -0,0 +1,306 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      LogSum.hpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      Log-space arithmetic for the dp matrices: ExactLogSum, which adds two
+##      log values with log1p and exp, and TabulatedLogSum, which looks
+##      log1p( exp( -x ) ) up in a table (in the style of HMMER's
+##      p7_FLogsum) and interpolates linearly, for an error of at most
+##      TabulatedLogSum::maxError() (about 5e-7 nats) per sum; and the
+##      basic_logspace value type built on either, as flogspace (tabulated)
+##      and exactlogspace.
+##
+##      Products in log space are sums, so a log-space forward needs no
+##      (Rabiner) scaling of its rows, and can't underflow.
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#if     _MSC_VER > 1000
+#pragma once
+#endif
+
+#ifndef __GALOSH_LOGSUM_HPP__
+#define __GALOSH_LOGSUM_HPP__
+
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+namespace galosh {
+
+/**
+ * \class ExactLogSum
+ * \brief log( exp( a ) + exp( b ) ), to within rounding.
+ */
+struct ExactLogSum {
+  static inline double
+  sum (
+    double a,
+    double b
+  )
+  {
+    if( a < b ) {
+      const double tmp = a;
+      a = b;
+      b = tmp;
+    }
+    // a is now the larger (or they are both -infinity, or NaN).
+    if( b == -std::numeric_limits<double>::infinity() ) {
+      return a;
+    }
+    return ( a + log1p( std::exp( b - a ) ) );
+  } // sum( double, double )
+}; // End struct ExactLogSum
+
+/**
+ * \class TabulatedLogSum
+ * \brief log( exp( a ) + exp( b ) ) = max + log1p( exp( -( max - min ) ) ),
+ * with the second term interpolated from a table of Scale entries per unit
+ * of difference, out to a difference of maxDifference() (beyond which it
+ * is less than double precision can add to max).  The table of floats
+ * (about 37KB) stays in the cache.
+ *
+ * The interpolation error is at most h^2/8 times the largest second
+ * derivative (1/4) of log1p( exp( -x ) ), for a step h of 1/Scale; the
+ * table is of floats, which adds at most half a float ulp of log( 2 ).
+ */
+struct TabulatedLogSum {
+  enum { Scale = 256 };
+
+  /**
+   * The largest difference of log values that is tabulated: log1p( exp( -x
+   * ) ) < 2^-53 beyond it.
+   */
+  static inline double
+  maxDifference ()
+  {
+    return 36.8;
+  } // maxDifference()
+
+  /**
+   * The largest error of a sum, in nats.
+   */
+  static inline double
+  maxError ()
+  {
+    return ( ( 0.25 / ( 8.0 * Scale * Scale ) ) + ( 0.5 * std::log( 2.0 ) * std::numeric_limits<float>::epsilon() ) );
+  } // maxError()
+
+  /**
+   * The table: log1p( exp( -( i / Scale ) ) ) at [ i ].
+   */
+  struct Table {
+    std::vector<float> m_values;
+
+    Table ()
+    {
+      const uint32_t size = static_cast<uint32_t>( maxDifference() * Scale ) + 2;
+      m_values.resize( size );
+      for( uint32_t i = 0; i < size; i++ ) {
+        m_values[ i ] = static_cast<float>( log1p( std::exp( -static_cast<double>( i ) / Scale ) ) );
+      }
+    } // <init>()
+  }; // End inner struct Table
+
+  /**
+   * The one Table, shared by every TabulatedLogSum.  It is made on first
+   * use, so sums are safe even in the constructors of other static objects.
+   */
+  static inline Table const &
+  table ()
+  {
+    static Table const s_table;
+    return s_table;
+  } // table()
+
+  static inline double
+  sum (
+    double const a,
+    double const b
+  )
+  {
+    // (The difference is | a - b |, rather than the larger less the
+    // smaller, so that the compiler needn't branch on which is larger:
+    // that branch is unpredictable here.)
+    const double larger = ( ( a > b ) ? a : b );
+    const double difference = std::fabs( a - b );
+    // This is also false when both are -infinity (difference NaN), or just
+    // one is (difference infinity).
+    if( !( difference < maxDifference() ) ) {
+      return larger;
+    }
+    const double x = difference * Scale;
+    const uint32_t i = static_cast<uint32_t>( x );
+    float const * values = &table().m_values[ i ];
+    return ( larger + ( values[ 0 ] + ( ( x - i ) * ( values[ 1 ] - values[ 0 ] ) ) ) );
+  } // sum( double const, double const )
+}; // End struct TabulatedLogSum
+
+/**
+ * \class basic_logspace
+ * \brief A probability, held as its natural log; + is LogSumType::sum(..),
+ * and * and / add and subtract the logs.  Constructing from a double takes
+ * its log; toDouble(..) converts back (underflowing to 0 below about
+ * 1e-308; use logValue() to avoid that).
+ */
+template <typename LogSumType>
+class basic_logspace {
+public:
+  basic_logspace () :
+    m_logValue( -std::numeric_limits<double>::infinity() )
+  {
+    // Do nothing else.
+  } // <init>()
+
+  basic_logspace (
+    double const probability
+  ) :
+    m_logValue( ( probability > 0 ) ? std::log( probability ) : -std::numeric_limits<double>::infinity() )
+  {
+    // Do nothing else.
+  } // <init>( double const )
+
+  static inline basic_logspace
+  fromLogValue (
+    double const log_value
+  )
+  {
+    basic_logspace value;
+    value.m_logValue = log_value;
+    return value;
+  } // fromLogValue( double const )
+
+  inline double
+  logValue () const
+  {
+    return m_logValue;
+  } // logValue() const
+
+  inline basic_logspace &
+  operator+= (
+    basic_logspace const & other
+  )
+  {
+    m_logValue = LogSumType::sum( m_logValue, other.m_logValue );
+    return *this;
+  } // operator+=( basic_logspace const & )
+
+  inline basic_logspace &
+  operator*= (
+    basic_logspace const & other
+  )
+  {
+    m_logValue += other.m_logValue;
+    return *this;
+  } // operator*=( basic_logspace const & )
+
+  inline basic_logspace &
+  operator/= (
+    basic_logspace const & other
+  )
+  {
+    m_logValue -= other.m_logValue;
+    return *this;
+  } // operator/=( basic_logspace const & )
+
+  inline basic_logspace
+  operator+ (
+    basic_logspace const & other
+  ) const
+  {
+    return fromLogValue( LogSumType::sum( m_logValue, other.m_logValue ) );
+  } // operator+( basic_logspace const & ) const
+
+  inline basic_logspace
+  operator* (
+    basic_logspace const & other
+  ) const
+  {
+    return fromLogValue( m_logValue + other.m_logValue );
+  } // operator*( basic_logspace const & ) const
+
+  inline basic_logspace
+  operator/ (
+    basic_logspace const & other
+  ) const
+  {
+    return fromLogValue( m_logValue - other.m_logValue );
+  } // operator/( basic_logspace const & ) const
+
+  inline bool operator< ( basic_logspace const & other ) const { return ( m_logValue < other.m_logValue ); }
+  inline bool operator> ( basic_logspace const & other ) const { return ( m_logValue > other.m_logValue ); }
+  inline bool operator<= ( basic_logspace const & other ) const { return ( m_logValue <= other.m_logValue ); }
+  inline bool operator>= ( basic_logspace const & other ) const { return ( m_logValue >= other.m_logValue ); }
+  inline bool operator== ( basic_logspace const & other ) const { return ( m_logValue == other.m_logValue ); }
+  inline bool operator!= ( basic_logspace const & other ) const { return ( m_logValue != other.m_logValue ); }
+
+protected:
+  double m_logValue;
+
+}; // End class basic_logspace<LogSumType>
+
+  template <typename LogSumType>
+  inline double
+  toDouble (
+    basic_logspace<LogSumType> const & value
+  )
+  {
+    return std::exp( value.logValue() );
+  } // toDouble( basic_logspace const & )
+
+  /**
+   * Write the value in scientific notation, with an exponent of any size
+   * (eg. 1.234e-5678).
+   */
+  template <typename LogSumType, class AnyCharT, class AnyTraitsT>
+  std::basic_ostream<AnyCharT,AnyTraitsT> &
+  operator<< (
+    std::basic_ostream<AnyCharT,AnyTraitsT> & os,
+    basic_logspace<LogSumType> const & value
+  )
+  {
+    const double log_value = value.logValue();
+    if( !( log_value > -std::numeric_limits<double>::infinity() ) || !( log_value < std::numeric_limits<double>::infinity() ) ) {
+      return os << std::exp( log_value );
+    }
+    const double log10_value = log_value / std::log( 10.0 );
+    const double exponent = std::floor( log10_value );
+    return os << std::pow( 10.0, log10_value - exponent ) << "e" << static_cast<int64_t>( exponent );
+  } // operator<<( basic_ostream &, basic_logspace const & )
+
+  typedef basic_logspace<TabulatedLogSum> flogspace;
+  typedef basic_logspace<ExactLogSum> exactlogspace;
+
+} // End namespace galosh
+
+#endif // __GALOSH_LOGSUM_HPP__
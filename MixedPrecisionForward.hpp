@@ -0,0 +1,384 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      MixedPrecisionForward.hpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      Class definition for the MixedPrecisionForward class, which runs the
+##      forward algorithm (in two rows, as CheckpointedForwardBackward's
+##      forward(..) does) with float dp cells, emissions and transitions, and
+##      each row scaled to sum to 1.  The scale factors and their logs are
+##      doubles, so only the cells are floats: half the memory traffic of
+##      doubles, and twice as many cells to a SIMD register (see the float
+##      kernels of RowKernels.hpp).
+##
+##      Each cell is rounded to a float once per operation, so the error of a
+##      sequence's log probability grows with its length, by about 1e-7 nats
+##      per residue; it is for short sequences (reads), where that is
+##      negligible.
+##
+##      Scaling keeps the rows' totals in range, but not the cells that hold
+##      less than about 1e-38 of their row's total, which underflow (and are
+##      flushed to zero rather than made subnormal, which is many times
+##      slower, where the cpu allows it).  So a sequence is computed with
+##      doubles (by CheckpointedForwardBackward) instead, when
+##        - it is so much shorter than the profile that the deletions that
+##          its every path needs can underflow,
+##        - some row sums to less than minimumFloatShare() of the one before
+##          it: the paths that survived all fit its residue very badly, so
+##          one lost earlier might have fit it better (and the inverse of
+##          the sum, the scale, might not fit in a float), or
+##        - the alignments that end it (PostAlign, in the last row) hold less
+##          than minimumFloatShare() of the last row's total, so that they
+##          might have lost some of their paths on the way.
+##      These are heuristics, not a bound: a path lost mid-matrix, whose row
+##      still summed to more than minimumFloatShare() at every step, could
+##      come to dominate if the paths that survived fit the rest of the
+##      sequence worse than it by a factor of about 2^100.  (Bounding that
+##      rigorously, with the largest emission probability of each residue,
+##      sends nearly every sequence longer than a few dozen residues to
+##      doubles.)  So measure the
+##      error for the profiles and sequences at hand, against the exact and
+##      bfloat scores: see benchmarkForward --tolerance.  A sequence that
+##      fails the last two costs both passes, so for profiles whose flanking
+##      states hold most of the rows, use doubles throughout.
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#if     _MSC_VER > 1000
+#pragma once
+#endif
+
+#ifndef __GALOSH_MIXEDPRECISIONFORWARD_HPP__
+#define __GALOSH_MIXEDPRECISIONFORWARD_HPP__
+
+#include "ProfileTables.hpp"
+#include "CheckpointedForwardBackward.hpp"
+#include "RowKernels.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+#if defined( __SSE__ ) || defined( _M_X64 )
+#include <xmmintrin.h>
+#define __PROFUSE_HAVE_MXCSR
+#endif
+
+namespace galosh {
+
+template <typename ResidueType,
+          typename SequenceResidueType>
+class MixedPrecisionForward {
+public:
+  typedef ProfileTables<ResidueType, SequenceResidueType> ProfileTablesType;
+  enum { AlphabetSize = ProfileTablesType::AlphabetSize };
+
+  /**
+   * The smallest share of a row's total that float cells are trusted to
+   * hold (2^-100, leaving the exponents below it for the emissions and
+   * transitions of the next row).
+   */
+  static inline double
+  minimumFloatShare ()
+  {
+    return std::ldexp( 1.0, -100 );
+  } // minimumFloatShare()
+
+  /**
+   * The tables must hold probabilities (not logs), and must outlive this;
+   * they are converted to floats once, here.
+   */
+  MixedPrecisionForward (
+    ProfileTablesType const & tables
+  ) :
+    m_profileLength( tables.m_profileLength ),
+    m_matchEmissions( AlphabetSize * tables.m_profileLength ),
+    m_insertionEmissions( AlphabetSize ),
+    m_kernels( rowKernels() ),
+    m_doubleForward( tables ),
+    m_maxFloatDeletions( 0 )
+  {
+    assert( !tables.m_isLog );
+    for( uint32_t res_i = 0; res_i < AlphabetSize; res_i++ ) {
+      double const * match_emissions = tables.matchEmissions( res_i );
+      for( uint32_t pos_i = 0; pos_i < m_profileLength; pos_i++ ) {
+        m_matchEmissions[ ( res_i * m_profileLength ) + pos_i ] = static_cast<float>( match_emissions[ pos_i ] );
+      }
+      m_insertionEmissions[ res_i ] = static_cast<float>( tables.insertionEmission( res_i ) );
+    }
+    for( uint32_t t = 0; t < ProfileTransition::Count; t++ ) {
+      m_transitions[ t ] = static_cast<float>( tables.m_transitions[ t ] );
+    }
+
+    // The longest run of deletions whose probability is at least
+    // minimumFloatShare().
+    const double log_into_deletion =
+      ProfileTablesType::safeLog( std::min( tables[ ProfileTransition::BeginToDeletion ], tables[ ProfileTransition::MatchToDeletion ] ) );
+    const double log_deletion_to_deletion = ProfileTablesType::safeLog( tables[ ProfileTransition::DeletionToDeletion ] );
+    const double log_minimum_share = std::log( minimumFloatShare() );
+    if( log_into_deletion >= log_minimum_share ) {
+      m_maxFloatDeletions =
+        ( ( log_deletion_to_deletion < 0 ) ?
+          static_cast<uint32_t>( std::min( static_cast<double>( m_profileLength ), 1.0 + std::floor( ( log_minimum_share - log_into_deletion ) / log_deletion_to_deletion ) ) ) :
+          m_profileLength );
+    }
+  } // <init>( ProfileTablesType const & )
+
+  /**
+   * Returns the natural log of the probability of the given sequence (given
+   * as residue ordinal values; see sequenceToOrdinals(..)).  If used_floats
+   * isn't null, sets it to false if the sequence was computed with doubles
+   * instead (see above).
+   */
+  double
+  forward (
+    std::vector<uint32_t> const & residues,
+    bool * used_floats = 0
+  ) const
+  {
+    const uint32_t sequence_length = residues.size();
+    if( used_floats != 0 ) {
+      *used_floats = false;
+    }
+    if( ( sequence_length < m_profileLength ) && ( ( m_profileLength - sequence_length ) > m_maxFloatDeletions ) ) {
+      return m_doubleForward.forward( residues );
+    }
+    Row current, next;
+    current.reinitialize( m_profileLength );
+    next.reinitialize( m_profileLength );
+    double log_scale = 0;
+    bool rows_scaled = true;
+    {
+      FlushSubnormals flush_subnormals;
+      firstRow( current );
+      for( uint32_t row_i = 1; rows_scaled && ( row_i <= sequence_length ); row_i++ ) {
+        const double scale = nextRow( current, residues[ row_i - 1 ], next );
+        rows_scaled = ( scale > 0 );
+        if( rows_scaled ) {
+          log_scale -= std::log( scale );
+          std::swap( current, next );
+        }
+      }
+    } // End flush_subnormals
+    // (Checked after flush_subnormals has gone, so that the doubles aren't
+    // flushed too.)
+    if( !rows_scaled || !( current.m_postAlign >= minimumFloatShare() ) ) {
+      return m_doubleForward.forward( residues );
+    }
+    if( used_floats != 0 ) {
+      *used_floats = true;
+    }
+    return ( log_scale + ProfileTablesType::safeLog( static_cast<double>( current.m_postAlign ) * m_transitions[ ProfileTransition::PostAlignToTerminal ] ) );
+  } // forward( vector<uint32_t> const &, bool * ) const
+
+protected:
+  /**
+   * While one of these exists, the (SSE) arithmetic of this thread flushes
+   * subnormal results and operands to zero; it puts the thread's previous
+   * mode back when it goes.
+   */
+  struct FlushSubnormals {
+#ifdef __PROFUSE_HAVE_MXCSR
+    const unsigned int m_previousMode;
+
+    FlushSubnormals () :
+      m_previousMode( _mm_getcsr() )
+    {
+      // Flush to zero (0x8000), and denormals are zero (0x0040).
+      _mm_setcsr( m_previousMode | 0x8040 );
+    } // <init>()
+
+    ~FlushSubnormals ()
+    {
+      _mm_setcsr( m_previousMode );
+    } // <destroy>()
+#endif // __PROFUSE_HAVE_MXCSR
+  }; // End inner struct FlushSubnormals
+
+  /**
+   * One (scaled) row of the forward matrix, as in
+   * CheckpointedForwardBackward::Row, but of floats.
+   */
+  struct Row {
+    float m_preAlign;
+    float m_postAlign;
+    std::vector<float> m_match;
+    std::vector<float> m_insertion;
+    std::vector<float> m_deletion;
+
+    void
+    reinitialize (
+      uint32_t const profile_length
+    )
+    {
+      m_match.assign( profile_length + 1, 0.0f );
+      m_insertion.assign( profile_length + 1, 0.0f );
+      m_deletion.assign( profile_length + 1, 0.0f );
+    } // reinitialize( uint32_t const )
+  }; // End inner struct Row
+
+  uint32_t m_profileLength;
+
+  /// At [ ( res_i * m_profileLength ) + pos_i ] (pos_i 0-based).
+  std::vector<float> m_matchEmissions;
+  std::vector<float> m_insertionEmissions;
+  float m_transitions[ ProfileTransition::Count ];
+
+  RowKernels const & m_kernels;
+
+  /// For the sequences that floats can't hold.
+  CheckpointedForwardBackward<ResidueType, SequenceResidueType> m_doubleForward;
+
+  /// The most positions that a sequence may need to delete to be computed
+  /// in floats.
+  uint32_t m_maxFloatDeletions;
+
+  /**
+   * Forward row 0: nothing emitted yet.
+   */
+  void
+  firstRow (
+    Row & row
+  ) const
+  {
+    row.m_preAlign = 1.0f;
+    std::fill( row.m_match.begin(), row.m_match.end(), 0.0f );
+    std::fill( row.m_insertion.begin(), row.m_insertion.end(), 0.0f );
+    row.m_deletion[ 0 ] = 0.0f;
+    row.m_deletion[ 1 ] =
+      m_transitions[ ProfileTransition::PreAlignToBegin ] * m_transitions[ ProfileTransition::BeginToDeletion ];
+    for( uint32_t pos = 2; pos <= m_profileLength; pos++ ) {
+      row.m_deletion[ pos ] = row.m_deletion[ pos - 1 ] * m_transitions[ ProfileTransition::DeletionToDeletion ];
+    }
+    row.m_postAlign = row.m_deletion[ m_profileLength ];
+  } // firstRow( Row & ) const
+
+  /**
+   * Calculate forward row i from (scaled) row i - 1 and the i^th residue,
+   * then scale it to sum to (about) 1.  Returns the factor that it was
+   * scaled by: the inverse of its sum, rounded to a float, so that the
+   * caller's log of it is exactly what was applied to the cells.  Returns 0
+   * instead, leaving the row unscaled, if the sum is less than
+   * minimumFloatShare() (or isn't a number): the sequence is then computed
+   * with doubles.
+   */
+  double
+  nextRow (
+    Row const & prev,
+    uint32_t const residue,
+    Row & row
+  ) const
+  {
+    const uint32_t profile_length = m_profileLength;
+    float const * match_emissions = &m_matchEmissions[ 0 ] + ( residue * profile_length );
+    const float insertion_emission = m_insertionEmissions[ residue ];
+    const float t_md = m_transitions[ ProfileTransition::MatchToDeletion ];
+    const float t_dd = m_transitions[ ProfileTransition::DeletionToDeletion ];
+
+    row.m_preAlign =
+      prev.m_preAlign * m_transitions[ ProfileTransition::PreAlignToPreAlign ] * insertion_emission;
+    // (The sum is a double: it is cheap, and the scale is then as exact as
+    // the cells allow.)
+    double sum = row.m_preAlign;
+
+    row.m_match[ 1 ] =
+      match_emissions[ 0 ] *
+      prev.m_preAlign * m_transitions[ ProfileTransition::PreAlignToBegin ] * m_transitions[ ProfileTransition::BeginToMatch ];
+    sum += row.m_match[ 1 ];
+    sum +=
+      m_kernels.forwardMatchInsertionFloat(
+        &prev.m_match[ 0 ] + 1,
+        &prev.m_insertion[ 0 ] + 1,
+        &prev.m_deletion[ 0 ] + 1,
+        match_emissions + 1,
+        insertion_emission,
+        m_transitions,
+        &row.m_match[ 0 ] + 2,
+        &row.m_insertion[ 0 ] + 1,
+        profile_length - 1
+      );
+
+    // Deletions depend on the states to their left in this row.  That
+    // dependence is the critical path of the row, so it is taken four
+    // positions at a time: deletion[ pos + k ] is the sum of the
+    // match-to-deletion terms since pos, and deletion[ pos - 1 ] times
+    // t_dd^( k + 1 ).
+    float deletion =
+      row.m_preAlign * m_transitions[ ProfileTransition::PreAlignToBegin ] * m_transitions[ ProfileTransition::BeginToDeletion ];
+    row.m_deletion[ 1 ] = deletion;
+    sum += deletion;
+    const float t_dd2 = t_dd * t_dd;
+    const float t_dd3 = t_dd2 * t_dd;
+    const float t_dd4 = t_dd3 * t_dd;
+    float const * match = &row.m_match[ 0 ];
+    float * deletions = &row.m_deletion[ 0 ];
+    uint32_t pos = 2;
+    for( ; ( pos + 3 ) <= profile_length; pos += 4 ) {
+      const float a0 = match[ pos - 1 ] * t_md;
+      const float a1 = match[ pos ] * t_md;
+      const float a2 = match[ pos + 1 ] * t_md;
+      const float a3 = match[ pos + 2 ] * t_md;
+      const float b1 = a1 + ( a0 * t_dd );
+      const float b2 = a2 + ( b1 * t_dd );
+      const float b3 = a3 + ( b2 * t_dd );
+      deletions[ pos ] = a0 + ( deletion * t_dd );
+      deletions[ pos + 1 ] = b1 + ( deletion * t_dd2 );
+      deletions[ pos + 2 ] = b2 + ( deletion * t_dd3 );
+      deletion = b3 + ( deletion * t_dd4 );
+      deletions[ pos + 3 ] = deletion;
+      sum += ( ( deletions[ pos ] + deletions[ pos + 1 ] ) + ( deletions[ pos + 2 ] + deletion ) );
+    }
+    for( ; pos <= profile_length; pos++ ) {
+      deletion = ( match[ pos - 1 ] * t_md ) + ( deletion * t_dd );
+      deletions[ pos ] = deletion;
+      sum += deletion;
+    }
+
+    row.m_postAlign =
+      ( prev.m_postAlign * m_transitions[ ProfileTransition::PostAlignToPostAlign ] * insertion_emission ) +
+      row.m_match[ profile_length ] + row.m_deletion[ profile_length ];
+    sum += row.m_postAlign;
+
+    if( !( sum >= minimumFloatShare() ) ) {
+      return 0;
+    }
+    const float inverse_sum = static_cast<float>( 1.0 / sum );
+    row.m_preAlign *= inverse_sum;
+    row.m_postAlign *= inverse_sum;
+    m_kernels.scaleFloat( &row.m_match[ 0 ] + 1, inverse_sum, profile_length );
+    m_kernels.scaleFloat( &row.m_insertion[ 0 ] + 1, inverse_sum, profile_length );
+    m_kernels.scaleFloat( &row.m_deletion[ 0 ] + 1, inverse_sum, profile_length );
+    return inverse_sum;
+  } // nextRow( Row const &, uint32_t const, Row & ) const
+
+}; // End class MixedPrecisionForward
+
+} // End namespace galosh
+
+#endif // __GALOSH_MIXEDPRECISIONFORWARD_HPP__
@@ -0,0 +1,171 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      ParallelFor.hpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      A minimal parallel loop over the indices 0 .. count - 1, using
+##      boost::thread.  Indices are handed out one at a time from a shared
+##      counter, so threads that get short items (eg. short sequences) just
+##      take more of them.  The body is a functor with
+##        void operator() ( size_t index, uint32_t thread_i );
+##      which is copied once per thread (so it can hold per-thread scratch
+##      space); results should go into slots owned by each index.
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#if     _MSC_VER > 1000
+#pragma once
+#endif
+
+#ifndef __GALOSH_PARALLELFOR_HPP__
+#define __GALOSH_PARALLELFOR_HPP__
+
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/thread.hpp>
+
+namespace galosh {
+
+  /**
+   * The number of threads to use when the user asks for 0 (meaning "as many
+   * as there are cores").
+   */
+  inline uint32_t
+  defaultThreadCount ()
+  {
+    const uint32_t hardware_threads = boost::thread::hardware_concurrency();
+    return ( ( hardware_threads == 0 ) ? 1 : hardware_threads );
+  } // defaultThreadCount()
+
+  namespace detail {
+
+    template <typename BodyType>
+    class ParallelForWorker {
+    public:
+      ParallelForWorker (
+        BodyType const & body,
+        uint32_t const thread_i,
+        size_t const count,
+        size_t & next_index,
+        boost::mutex & mutex,
+        std::string & error
+      ) :
+        m_body( body ),
+        m_threadIndex( thread_i ),
+        m_count( count ),
+        m_nextIndex( next_index ),
+        m_mutex( mutex ),
+        m_error( error )
+      {
+        // Do nothing else.
+      } // <init>( .. )
+
+      void
+      operator() ()
+      {
+        while( true ) {
+          size_t index;
+          {
+            boost::mutex::scoped_lock lock( m_mutex );
+            if( !m_error.empty() || ( m_nextIndex >= m_count ) ) {
+              return;
+            }
+            index = m_nextIndex++;
+          }
+          try {
+            m_body( index, m_threadIndex );
+          } catch( std::string & err ) {
+            boost::mutex::scoped_lock lock( m_mutex );
+            m_error = err;
+          } catch( std::exception & e ) {
+            boost::mutex::scoped_lock lock( m_mutex );
+            m_error = e.what();
+          }
+        } // End while there are indices left
+      } // operator()()
+
+    protected:
+      BodyType m_body;
+      uint32_t m_threadIndex;
+      size_t m_count;
+      size_t & m_nextIndex;
+      boost::mutex & m_mutex;
+      std::string & m_error;
+    }; // End class ParallelForWorker
+
+  } // End namespace detail
+
+  /**
+   * Call body( index, thread_i ) for each index in 0 .. count - 1, using
+   * thread_count threads (0 means defaultThreadCount()).  With one thread
+   * (or one index), everything happens in the calling thread.  If a body
+   * throws a string or std::exception, no more indices are started, and the
+   * (first) error is rethrown as a string once all of the threads are done.
+   */
+  template <typename BodyType>
+  void
+  parallelFor (
+    size_t const count,
+    uint32_t thread_count,
+    BodyType const & body
+  )
+  {
+    if( thread_count == 0 ) {
+      thread_count = defaultThreadCount();
+    }
+    if( static_cast<size_t>( thread_count ) > count ) {
+      thread_count = count;
+    }
+    if( thread_count <= 1 ) {
+      BodyType local_body( body );
+      for( size_t index = 0; index < count; index++ ) {
+        local_body( index, 0 );
+      }
+      return;
+    }
+
+    size_t next_index = 0;
+    boost::mutex mutex;
+    std::string error;
+    boost::thread_group threads;
+    for( uint32_t thread_i = 0; thread_i < thread_count; thread_i++ ) {
+      threads.create_thread(
+        detail::ParallelForWorker<BodyType>( body, thread_i, count, next_index, mutex, error )
+      );
+    }
+    threads.join_all();
+    if( !error.empty() ) {
+      throw error;
+    }
+  } // parallelFor( size_t const, uint32_t, BodyType const & )
+
+} // End namespace galosh
+
+#endif // __GALOSH_PARALLELFOR_HPP__
@@ -0,0 +1,428 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      PathSidecar.hpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      A compact binary file of state paths (see AlignmentPath.hpp), one per
+##      sequence, indexed by sequence number: the "true path" sidecar that
+##      drawSequences can write next to the sequences it draws.
+##
+##      The file is written in one pass, as the paths are drawn.  Each path is
+##      run-length encoded, one varint per run of a state, holding
+##      ( ( run length - 1 ) << 3 ) | state, and the record is that list of
+##      runs preceded by its length in bytes (also a varint), so records can be
+##      skipped without decoding them.  Every IndexInterval'th record's offset
+##      goes into an index, written at the end, and a fixed-size footer
+##      locates the index:
+##
+##        header:  "PRFPATH1", uint32 version, uint32 index interval
+##        records: varint byte count, then varint runs
+##        index:   uint64 offset of record 0, IndexInterval, 2 * IndexInterval, ..
+##        footer:  uint64 index offset, uint64 record count, "PRFPATH1"
+##
+##      All fixed-width integers are little-endian.  Reading path i means
+##      reading the footer and the index, seeking to the last indexed record
+##      at or before i, and skipping at most IndexInterval - 1 records.
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#if     _MSC_VER > 1000
+#pragma once
+#endif
+
+#ifndef __GALOSH_PATHSIDECAR_HPP__
+#define __GALOSH_PATHSIDECAR_HPP__
+
+#include "AlignmentPath.hpp"
+#include "LittleEndian.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+namespace galosh {
+
+  namespace PathSidecar {
+    static const char Magic[ 8 ] = { 'P', 'R', 'F', 'P', 'A', 'T', 'H', '1' };
+    enum {
+      Version = 1,
+      HeaderSize = 16,
+      FooterSize = 24,
+      DefaultIndexInterval = 1024
+    };
+
+    inline void
+    appendVarint (
+      std::vector<uint8_t> & bytes,
+      uint64_t value
+    )
+    {
+      while( value >= 0x80 ) {
+        bytes.push_back( static_cast<uint8_t>( value | 0x80 ) );
+        value >>= 7;
+      }
+      bytes.push_back( static_cast<uint8_t>( value ) );
+    } // appendVarint( vector<uint8_t> &, uint64_t )
+
+    /**
+     * Append the run-length encoding of the path (without its byte count).
+     */
+    inline void
+    appendRuns (
+      std::vector<uint8_t> & bytes,
+      AlignmentPath const & path
+    )
+    {
+      size_t step_i = 0;
+      while( step_i < path.size() ) {
+        const uint8_t state = path[ step_i ];
+        size_t run_end = step_i + 1;
+        while( ( run_end < path.size() ) && ( path[ run_end ] == state ) ) {
+          run_end += 1;
+        }
+        appendVarint( bytes, ( static_cast<uint64_t>( run_end - step_i - 1 ) << 3 ) | state );
+        step_i = run_end;
+      }
+    } // appendRuns( vector<uint8_t> &, AlignmentPath const & )
+
+  } // End namespace PathSidecar
+
+/**
+ * \class PathSidecarWriter
+ * \brief Appends paths, in sequence order, to a new path sidecar file.
+ */
+class PathSidecarWriter {
+public:
+  PathSidecarWriter () :
+    m_indexInterval( PathSidecar::DefaultIndexInterval ),
+    m_offset( 0 ),
+    m_count( 0 )
+  {
+    // Do nothing else.
+  } // <init>()
+
+  ~PathSidecarWriter ()
+  {
+    if( m_stream.is_open() ) {
+      try {
+        close();
+      } catch( std::string & ) {
+        // Nothing to be done about it here.
+      }
+    }
+  } // <destroy>()
+
+  void
+  open (
+    std::string const & filename,
+    uint32_t const index_interval = PathSidecar::DefaultIndexInterval
+  )
+  {
+    if( index_interval == 0 ) {
+      throw std::string( "The path sidecar index interval must be positive" );
+    }
+    m_filename = filename;
+    m_indexInterval = index_interval;
+    m_index.clear();
+    m_count = 0;
+    m_stream.open( filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+    if( !m_stream.good() ) {
+      throw std::string( "The path sidecar file '" ) + filename + "' could not be opened.";
+    }
+    m_buffer.clear();
+    m_buffer.insert( m_buffer.end(), PathSidecar::Magic, PathSidecar::Magic + 8 );
+    appendLittleEndian( m_buffer, PathSidecar::Version, 4 );
+    appendLittleEndian( m_buffer, m_indexInterval, 4 );
+    m_offset = 0;
+    write( m_buffer );
+  } // open( string const &, uint32_t const )
+
+  bool
+  isOpen () const
+  {
+    return m_stream.is_open();
+  } // isOpen() const
+
+  /**
+   * Append the path of the next sequence.
+   */
+  void
+  append (
+    AlignmentPath const & path
+  )
+  {
+    if( ( m_count % m_indexInterval ) == 0 ) {
+      m_index.push_back( m_offset );
+    }
+    m_runs.clear();
+    PathSidecar::appendRuns( m_runs, path );
+    m_buffer.clear();
+    PathSidecar::appendVarint( m_buffer, m_runs.size() );
+    m_buffer.insert( m_buffer.end(), m_runs.begin(), m_runs.end() );
+    write( m_buffer );
+    m_count += 1;
+  } // append( AlignmentPath const & )
+
+  /**
+   * Write the index and footer, and close the file.
+   */
+  void
+  close ()
+  {
+    const uint64_t index_offset = m_offset;
+    m_buffer.clear();
+    for( size_t index_i = 0; index_i < m_index.size(); index_i++ ) {
+      appendLittleEndian( m_buffer, m_index[ index_i ], 8 );
+    }
+    appendLittleEndian( m_buffer, index_offset, 8 );
+    appendLittleEndian( m_buffer, m_count, 8 );
+    m_buffer.insert( m_buffer.end(), PathSidecar::Magic, PathSidecar::Magic + 8 );
+    write( m_buffer );
+    m_stream.close();
+    if( m_stream.fail() ) {
+      throw std::string( "Unable to finish writing the path sidecar file '" ) + m_filename + "'.";
+    }
+  } // close()
+
+protected:
+  std::string m_filename;
+  std::ofstream m_stream;
+  uint32_t m_indexInterval;
+  uint64_t m_offset;
+  uint64_t m_count;
+  std::vector<uint64_t> m_index;
+  std::vector<uint8_t> m_runs;
+  std::vector<uint8_t> m_buffer;
+
+  void
+  write (
+    std::vector<uint8_t> const & bytes
+  )
+  {
+    if( bytes.empty() ) {
+      return;
+    }
+    m_stream.write( reinterpret_cast<char const *>( &bytes[ 0 ] ), bytes.size() );
+    if( !m_stream.good() ) {
+      throw std::string( "Unable to write to the path sidecar file '" ) + m_filename + "'.";
+    }
+    m_offset += bytes.size();
+  } // write( vector<uint8_t> const & )
+
+}; // End class PathSidecarWriter
+
+/**
+ * \class PathSidecarReader
+ * \brief Random access to the paths in a path sidecar file.
+ */
+class PathSidecarReader {
+public:
+  PathSidecarReader () :
+    m_indexInterval( PathSidecar::DefaultIndexInterval ),
+    m_count( 0 ),
+    m_indexOffset( 0 ),
+    m_nextSeq( 0 )
+  {
+    // Do nothing else.
+  } // <init>()
+
+  PathSidecarReader (
+    std::string const & filename
+  ) :
+    m_indexInterval( PathSidecar::DefaultIndexInterval ),
+    m_count( 0 ),
+    m_indexOffset( 0 ),
+    m_nextSeq( 0 )
+  {
+    open( filename );
+  } // <init>( string const & )
+
+  void
+  open (
+    std::string const & filename
+  )
+  {
+    m_filename = filename;
+    m_stream.open( filename.c_str(), std::ios::in | std::ios::binary );
+    if( !m_stream.good() ) {
+      throw std::string( "The path sidecar file '" ) + filename + "' could not be opened.";
+    }
+    uint8_t header[ PathSidecar::HeaderSize ];
+    readAt( 0, header, PathSidecar::HeaderSize );
+    if( std::memcmp( header, PathSidecar::Magic, 8 ) != 0 ) {
+      throw std::string( "The file '" ) + filename + "' is not a path sidecar file.";
+    }
+    const uint32_t version = static_cast<uint32_t>( decodeLittleEndian( header + 8, 4 ) );
+    if( version != PathSidecar::Version ) {
+      throw std::string( "The path sidecar file '" ) + filename + "' has an unsupported version.";
+    }
+    m_indexInterval = static_cast<uint32_t>( decodeLittleEndian( header + 12, 4 ) );
+
+    m_stream.seekg( 0, std::ios::end );
+    const uint64_t file_size = static_cast<uint64_t>( m_stream.tellg() );
+    if( ( m_indexInterval == 0 ) || ( file_size < ( PathSidecar::HeaderSize + PathSidecar::FooterSize ) ) ) {
+      throw std::string( "The path sidecar file '" ) + filename + "' is incomplete.";
+    }
+    uint8_t footer[ PathSidecar::FooterSize ];
+    readAt( file_size - PathSidecar::FooterSize, footer, PathSidecar::FooterSize );
+    if( std::memcmp( footer + 16, PathSidecar::Magic, 8 ) != 0 ) {
+      throw std::string( "The path sidecar file '" ) + filename + "' is incomplete.";
+    }
+    m_indexOffset = decodeLittleEndian( footer, 8 );
+    m_count = decodeLittleEndian( footer + 8, 8 );
+    const uint64_t index_size = ( m_count + m_indexInterval - 1 ) / m_indexInterval;
+    if( ( m_indexOffset + ( 8 * index_size ) + PathSidecar::FooterSize ) != file_size ) {
+      throw std::string( "The path sidecar file '" ) + filename + "' is corrupt.";
+    }
+    std::vector<uint8_t> index_bytes( 8 * index_size );
+    if( index_size > 0 ) {
+      readAt( m_indexOffset, &index_bytes[ 0 ], index_bytes.size() );
+    }
+    m_index.resize( index_size );
+    for( uint64_t index_i = 0; index_i < index_size; index_i++ ) {
+      m_index[ index_i ] = decodeLittleEndian( &index_bytes[ 8 * index_i ], 8 );
+    }
+    m_nextSeq = m_count;
+  } // open( string const & )
+
+  /**
+   * The number of paths in the file.
+   */
+  uint64_t
+  size () const
+  {
+    return m_count;
+  } // size() const
+
+  /**
+   * Read the path of sequence number seq_i.  Reading the paths in order
+   * doesn't seek at all.
+   */
+  void
+  read (
+    uint64_t const seq_i,
+    AlignmentPath & path
+  )
+  {
+    if( seq_i >= m_count ) {
+      throw std::string( "There is no path for that sequence in the path sidecar file '" ) + m_filename + "'.";
+    }
+    if( seq_i != m_nextSeq ) {
+      m_stream.clear();
+      m_stream.seekg( m_index[ seq_i / m_indexInterval ] );
+      for( uint64_t skip_i = 0; skip_i < ( seq_i % m_indexInterval ); skip_i++ ) {
+        m_stream.seekg( readVarint(), std::ios::cur );
+      }
+    }
+    m_nextSeq = seq_i + 1;
+    const uint64_t byte_count = readVarint();
+    m_runs.resize( byte_count );
+    if( byte_count > 0 ) {
+      m_stream.read( reinterpret_cast<char *>( &m_runs[ 0 ] ), byte_count );
+    }
+    if( !m_stream.good() ) {
+      m_nextSeq = m_count;
+      throw std::string( "The path sidecar file '" ) + m_filename + "' is corrupt.";
+    }
+
+    path.clear();
+    size_t byte_i = 0;
+    while( byte_i < m_runs.size() ) {
+      uint64_t run = 0;
+      int shift = 0;
+      uint8_t byte;
+      do {
+        if( ( byte_i == m_runs.size() ) || ( shift > 63 ) ) {
+          throw std::string( "The path sidecar file '" ) + m_filename + "' is corrupt.";
+        }
+        byte = m_runs[ byte_i++ ];
+        run |= ( static_cast<uint64_t>( byte & 0x7F ) << shift );
+        shift += 7;
+      } while( byte & 0x80 );
+      const uint8_t state = static_cast<uint8_t>( run & 7 );
+      if( state >= PathState::Count ) {
+        throw std::string( "The path sidecar file '" ) + m_filename + "' is corrupt.";
+      }
+      path.insert( path.end(), ( run >> 3 ) + 1, state );
+    }
+  } // read( uint64_t const, AlignmentPath & )
+
+protected:
+  std::string m_filename;
+  std::ifstream m_stream;
+  uint32_t m_indexInterval;
+  uint64_t m_count;
+  uint64_t m_indexOffset;
+  /// Offsets of every m_indexInterval'th record.
+  std::vector<uint64_t> m_index;
+  /// The sequence whose record the stream is positioned at (m_count if
+  /// unknown).
+  uint64_t m_nextSeq;
+  std::vector<uint8_t> m_runs;
+
+  void
+  readAt (
+    uint64_t const offset,
+    uint8_t * bytes,
+    size_t const count
+  )
+  {
+    m_stream.clear();
+    m_stream.seekg( offset );
+    m_stream.read( reinterpret_cast<char *>( bytes ), count );
+    if( !m_stream.good() ) {
+      throw std::string( "Unable to read the path sidecar file '" ) + m_filename + "'.";
+    }
+  } // readAt( uint64_t const, uint8_t *, size_t const )
+
+  uint64_t
+  readVarint ()
+  {
+    uint64_t value = 0;
+    int shift = 0;
+    while( true ) {
+      const std::ifstream::int_type byte = m_stream.get();
+      if( ( byte == std::char_traits<char>::eof() ) || ( shift > 63 ) ) {
+        throw std::string( "The path sidecar file '" ) + m_filename + "' is corrupt.";
+      }
+      value |= ( static_cast<uint64_t>( byte & 0x7F ) << shift );
+      if( !( byte & 0x80 ) ) {
+        return value;
+      }
+      shift += 7;
+    }
+  } // readVarint()
+
+}; // End class PathSidecarReader
+
+} // End namespace galosh
+
+#endif // __GALOSH_PATHSIDECAR_HPP__
@@ -0,0 +1,154 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      Philox.hpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      The Philox4x32-10 counter-based random number generator (Salmon et al,
+##      "Parallel random numbers: as easy as 1, 2, 3", SC 2011), and a stream
+##      class built on it.
+##
+##      A counter-based generator is a keyed function of a counter, so there
+##      is no state to share or to advance serially: stream s of seed k is
+##      just the outputs for counters ( 0, s ), ( 1, s ), .., keyed by k.  The
+##      samplers give each sequence (or chunk) its own stream, indexed by its
+##      number, so what is drawn doesn't depend on which thread draws it or in
+##      what order.
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#if     _MSC_VER > 1000
+#pragma once
+#endif
+
+#ifndef __GALOSH_PHILOX_HPP__
+#define __GALOSH_PHILOX_HPP__
+
+#include <boost/cstdint.hpp>
+
+namespace galosh {
+
+  /**
+   * One application of Philox4x32-10: encrypt the 128-bit counter ctr with
+   * the 64-bit key, giving 128 random bits in out.
+   */
+  inline void
+  philox4x32_10 (
+    uint32_t const ctr[ 4 ],
+    uint32_t const key[ 2 ],
+    uint32_t out[ 4 ]
+  )
+  {
+    uint32_t c0 = ctr[ 0 ], c1 = ctr[ 1 ], c2 = ctr[ 2 ], c3 = ctr[ 3 ];
+    uint32_t k0 = key[ 0 ], k1 = key[ 1 ];
+    for( int round_i = 0; round_i < 10; round_i++ ) {
+      const uint64_t p0 = static_cast<uint64_t>( 0xD2511F53u ) * c0;
+      const uint64_t p1 = static_cast<uint64_t>( 0xCD9E8D57u ) * c2;
+      const uint32_t hi0 = static_cast<uint32_t>( p0 >> 32 ), lo0 = static_cast<uint32_t>( p0 );
+      const uint32_t hi1 = static_cast<uint32_t>( p1 >> 32 ), lo1 = static_cast<uint32_t>( p1 );
+      c0 = hi1 ^ c1 ^ k0;
+      c1 = lo1;
+      c2 = hi0 ^ c3 ^ k1;
+      c3 = lo0;
+      k0 += 0x9E3779B9u;
+      k1 += 0xBB67AE85u;
+    }
+    out[ 0 ] = c0;
+    out[ 1 ] = c1;
+    out[ 2 ] = c2;
+    out[ 3 ] = c3;
+  } // philox4x32_10( uint32_t const [4], uint32_t const [2], uint32_t [4] )
+
+/**
+ * \class PhiloxStream
+ * \brief the random stream with the given index, for the given seed.
+ */
+class PhiloxStream {
+public:
+  PhiloxStream (
+    uint64_t const seed,
+    uint64_t const stream_index
+  )
+  {
+    reset( seed, stream_index );
+  } // <init>( uint64_t const, uint64_t const )
+
+  /**
+   * Start over, at the beginning of the given stream.
+   */
+  void
+  reset (
+    uint64_t const seed,
+    uint64_t const stream_index
+  )
+  {
+    m_key[ 0 ] = static_cast<uint32_t>( seed );
+    m_key[ 1 ] = static_cast<uint32_t>( seed >> 32 );
+    m_counter[ 0 ] = 0;
+    m_counter[ 1 ] = 0;
+    m_counter[ 2 ] = static_cast<uint32_t>( stream_index );
+    m_counter[ 3 ] = static_cast<uint32_t>( stream_index >> 32 );
+    m_available = 0;
+  } // reset( uint64_t const, uint64_t const )
+
+  /**
+   * The next 32 random bits.
+   */
+  inline uint32_t
+  nextUint32 ()
+  {
+    if( m_available == 0 ) {
+      philox4x32_10( m_counter, m_key, m_block );
+      if( ++m_counter[ 0 ] == 0 ) {
+        ++m_counter[ 1 ];
+      }
+      m_available = 4;
+    }
+    return m_block[ --m_available ];
+  } // nextUint32()
+
+  /**
+   * A uniform double in [ 0, 1 ), with 53 random bits.
+   */
+  inline double
+  nextUniform ()
+  {
+    const uint64_t high = nextUint32() >> 5; // 27 bits
+    const uint64_t low = nextUint32() >> 6;  // 26 bits
+    return ( ( ( high << 26 ) | low ) * ( 1.0 / 9007199254740992.0 ) );
+  } // nextUniform()
+
+protected:
+  uint32_t m_key[ 2 ];
+  uint32_t m_counter[ 4 ];
+  uint32_t m_block[ 4 ];
+  uint32_t m_available;
+}; // End class PhiloxStream
+
+} // End namespace galosh
+
+#endif // __GALOSH_PHILOX_HPP__
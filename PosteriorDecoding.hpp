@@ -0,0 +1,493 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      PosteriorDecoding.hpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      Class definition for the PosteriorDecoding class, which computes the
+##      maximum expected accuracy (MEA) alignment of a sequence to a profile
+##      HMM: the path through the model (using only transitions of nonzero
+##      probability) that maximizes the sum, over the residues, of the
+##      posterior probability that the residue is emitted by the state that the
+##      path assigns it to.  Optionally it also reports those posteriors, as
+##      per-residue confidences.
+##
+##      The posteriors come from CheckpointedForwardBackward, the same
+##      machinery used for posterior alignment profiles.  The MEA recursion is
+##      run in suffix form, in lockstep with the backward sweep, so the
+##      posteriors are never stored.  Nor are the traceback choices of the
+##      whole matrix: as in CheckpointedViterbi, only every k-th row of MEA
+##      values (and posteriors) is kept, and the traceback revisits one block
+##      of k rows at a time (see CheckpointedForwardBackward::revisitBlock(..)),
+##      recomputing its choices (one byte per cell, and with confidences one
+##      for each of the Match and Insertion posteriors) from the checkpoint
+##      after it.  That costs one more forward-backward pass and keeps the
+##      memory at O( sqrt( L ) * M ).
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#if     _MSC_VER > 1000
+#pragma once
+#endif
+
+#ifndef __GALOSH_POSTERIORDECODING_HPP__
+#define __GALOSH_POSTERIORDECODING_HPP__
+
+#include "ProfileTables.hpp"
+#include "AlignmentPath.hpp"
+#include "CheckpointedForwardBackward.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <vector>
+
+namespace galosh {
+
+  /**
+   * The one-character code for a posterior probability stored (by
+   * PosteriorDecoding) as a byte: '0' for [0, 0.05), '1' for [0.05, 0.15), ..,
+   * '9' for [0.85, 0.95), and '*' for 0.95 and up.
+   */
+  inline char
+  confidenceCode (
+    uint8_t const confidence
+  )
+  {
+    const double posterior = confidence / 255.0;
+    if( posterior >= 0.95 ) {
+      return '*';
+    }
+    return static_cast<char>( '0' + static_cast<int>( ( posterior * 10.0 ) + 0.5 ) );
+  } // confidenceCode( uint8_t const )
+
+template <typename ResidueType,
+          typename SequenceResidueType>
+class PosteriorDecoding {
+public:
+  typedef ProfileTables<ResidueType, SequenceResidueType> ProfileTablesType;
+  typedef CheckpointedForwardBackward<ResidueType, SequenceResidueType> ForwardBackwardType;
+  typedef typename ForwardBackwardType::Row Row;
+  typedef typename ForwardBackwardType::Checkpoints Checkpoints;
+
+  /**
+   * A CheckpointedForwardBackward visitor that runs the suffix form of the MEA
+   * recursion: for each state at row i, the best sum of posteriors of the
+   * residues after i over the valid paths that continue from it.  The
+   * choices and confidences are kept only for the current block of
+   * checkpoint_interval rows; traceback(..) revisits the others.
+   */
+  class MEAVisitor {
+  public:
+    /// Bits of the per-cell choices.
+    enum {
+      MatchChoiceMask = 0x3, // 0: to Match, 1: to Insertion, 2: to Deletion
+      InsertionToInsertionBit = 0x4,
+      DeletionToDeletionBit = 0x8
+    };
+
+    MEAVisitor (
+      ProfileTablesType const & tables,
+      uint32_t const sequence_length,
+      uint32_t const checkpoint_interval,
+      bool const keep_confidences
+    ) :
+      m_tables( tables ),
+      m_sequenceLength( sequence_length ),
+      m_checkpointInterval( checkpoint_interval ),
+      m_keepConfidences( keep_confidences ),
+      m_blockStart( 0 ),
+      m_expectedAccuracy( 0 )
+    {
+      const uint32_t profile_length = tables.m_profileLength;
+      const size_t cell_count = checkpoint_interval * ( profile_length + 1 );
+      m_choices.assign( cell_count, 0 );
+      m_preAlignChoices.assign( sequence_length + 1, 0 );
+      m_postAlignChoices.assign( sequence_length + 1, 0 );
+      if( keep_confidences ) {
+        m_matchConfidences.assign( cell_count, 0 );
+        m_insertionConfidences.assign( cell_count, 0 );
+        m_preAlignConfidences.assign( sequence_length + 1, 0 );
+        m_postAlignConfidences.assign( sequence_length + 1, 0 );
+      }
+      m_value.reinitialize( profile_length );
+      m_nextValue.reinitialize( profile_length );
+      m_gamma.reinitialize( profile_length );
+      m_nextGamma.reinitialize( profile_length );
+      m_valueCheckpoints.resize( ( sequence_length / checkpoint_interval ) + 1 );
+      m_gammaCheckpoints.resize( ( sequence_length / checkpoint_interval ) + 1 );
+    } // <init>( ProfileTablesType const &, uint32_t const, uint32_t const, bool const )
+
+    void
+    visitRow (
+      uint32_t const row_i,
+      Row const & forward,
+      Row const & backward,
+      Row const * next_backward,
+      double const next_scale,
+      double const inverse_z
+    )
+    {
+      const uint32_t profile_length = m_tables.m_profileLength;
+      const double neg_inf = -std::numeric_limits<double>::infinity();
+      const bool is_last = ( next_backward == 0 );
+      const uint32_t block_row = ( row_i % m_checkpointInterval );
+      const size_t row_offset = block_row * ( profile_length + 1 );
+      m_blockStart = row_i - block_row;
+
+      // The posteriors of this row.  For Match, Insertion, PreAlign and
+      // PostAlign these are of emitting residue row_i (so 0 in row 0); for
+      // Deletion, of being there (used only to exclude impossible states).
+      // m_gamma.m_postAlign excludes the mass that enters PostAlign in this
+      // row through End, which emits nothing here.
+      for( uint32_t pos = 1; pos <= profile_length; pos++ ) {
+        m_gamma.m_deletion[ pos ] = forward.m_deletion[ pos ] * backward.m_deletion[ pos ] * inverse_z;
+        m_gamma.m_match[ pos ] =
+          ( ( row_i == 0 ) ? 0.0 : ( forward.m_match[ pos ] * backward.m_match[ pos ] * inverse_z ) );
+        m_gamma.m_insertion[ pos ] =
+          ( ( row_i == 0 ) ? 0.0 : ( forward.m_insertion[ pos ] * backward.m_insertion[ pos ] * inverse_z ) );
+      }
+      m_gamma.m_preAlign =
+        ( ( row_i == 0 ) ? 0.0 : ( forward.m_preAlign * backward.m_preAlign * inverse_z ) );
+      m_gamma.m_postAlign =
+        ( ( row_i == 0 ) ? 0.0 :
+          std::max( 0.0, ( forward.m_postAlign - forward.m_match[ profile_length ] - forward.m_deletion[ profile_length ] ) * backward.m_postAlign * inverse_z ) );
+      if( m_keepConfidences ) {
+        for( uint32_t pos = 1; pos <= profile_length; pos++ ) {
+          m_matchConfidences[ row_offset + pos ] = toByte( m_gamma.m_match[ pos ] );
+          m_insertionConfidences[ row_offset + pos ] = toByte( m_gamma.m_insertion[ pos ] );
+        }
+        m_preAlignConfidences[ row_i ] = toByte( m_gamma.m_preAlign );
+        m_postAlignConfidences[ row_i ] = toByte( m_gamma.m_postAlign );
+      }
+
+      // PostAlign: stop here (only in the last row), or emit the next residue.
+      m_value.m_postAlign = ( is_last ? 0.0 : neg_inf );
+      m_postAlignChoices[ row_i ] = 0;
+      if( !is_last && ( m_tables[ ProfileTransition::PostAlignToPostAlign ] > 0 ) && ( m_nextGamma.m_postAlign > 0 ) ) {
+        const double emit = m_nextGamma.m_postAlign + m_nextValue.m_postAlign;
+        if( emit > m_value.m_postAlign ) {
+          m_value.m_postAlign = emit;
+          m_postAlignChoices[ row_i ] = 1;
+        }
+      }
+
+      // The last position's Match and Deletion states lead to End.
+      m_value.m_match[ profile_length ] = m_value.m_postAlign;
+      m_value.m_deletion[ profile_length ] = m_value.m_postAlign;
+      m_value.m_insertion[ profile_length ] = neg_inf;
+
+      const bool t_mm = ( m_tables[ ProfileTransition::MatchToMatch ] > 0 );
+      const bool t_mi = ( m_tables[ ProfileTransition::MatchToInsertion ] > 0 );
+      const bool t_md = ( m_tables[ ProfileTransition::MatchToDeletion ] > 0 );
+      const bool t_im = ( m_tables[ ProfileTransition::InsertionToMatch ] > 0 );
+      const bool t_ii = ( m_tables[ ProfileTransition::InsertionToInsertion ] > 0 );
+      const bool t_dm = ( m_tables[ ProfileTransition::DeletionToMatch ] > 0 );
+      const bool t_dd = ( m_tables[ ProfileTransition::DeletionToDeletion ] > 0 );
+      for( uint32_t pos = profile_length - 1; pos >= 1; pos-- ) {
+        const double to_match =
+          ( ( !is_last && ( m_nextGamma.m_match[ pos + 1 ] > 0 ) ) ?
+            ( m_nextGamma.m_match[ pos + 1 ] + m_nextValue.m_match[ pos + 1 ] ) : neg_inf );
+        const double to_insertion =
+          ( ( !is_last && ( m_nextGamma.m_insertion[ pos ] > 0 ) ) ?
+            ( m_nextGamma.m_insertion[ pos ] + m_nextValue.m_insertion[ pos ] ) : neg_inf );
+        const double to_deletion =
+          ( ( m_gamma.m_deletion[ pos + 1 ] > 0 ) ? m_value.m_deletion[ pos + 1 ] : neg_inf );
+        uint8_t choices = 0;
+
+        double best = ( t_mm ? to_match : neg_inf );
+        if( t_mi && ( to_insertion > best ) ) {
+          best = to_insertion;
+          choices = 1;
+        }
+        if( t_md && ( to_deletion > best ) ) {
+          best = to_deletion;
+          choices = 2;
+        }
+        m_value.m_match[ pos ] = best;
+
+        best = ( t_im ? to_match : neg_inf );
+        if( t_ii && ( to_insertion > best ) ) {
+          best = to_insertion;
+          choices |= InsertionToInsertionBit;
+        }
+        m_value.m_insertion[ pos ] = best;
+
+        best = ( t_dm ? to_match : neg_inf );
+        if( t_dd && ( to_deletion > best ) ) {
+          best = to_deletion;
+          choices |= DeletionToDeletionBit;
+        }
+        m_value.m_deletion[ pos ] = best;
+
+        m_choices[ row_offset + pos ] = choices;
+      } // End foreach pos, backwards
+
+      // PreAlign: emit the next residue, or go through Begin to Match 1 (on
+      // the next residue) or Deletion 1.
+      m_value.m_preAlign = neg_inf;
+      m_preAlignChoices[ row_i ] = 0;
+      if( !is_last && ( m_tables[ ProfileTransition::PreAlignToPreAlign ] > 0 ) && ( m_nextGamma.m_preAlign > 0 ) ) {
+        m_value.m_preAlign = m_nextGamma.m_preAlign + m_nextValue.m_preAlign;
+      }
+      if( m_tables[ ProfileTransition::PreAlignToBegin ] > 0 ) {
+        if( !is_last && ( m_tables[ ProfileTransition::BeginToMatch ] > 0 ) && ( m_nextGamma.m_match[ 1 ] > 0 ) &&
+            ( ( m_nextGamma.m_match[ 1 ] + m_nextValue.m_match[ 1 ] ) > m_value.m_preAlign ) ) {
+          m_value.m_preAlign = m_nextGamma.m_match[ 1 ] + m_nextValue.m_match[ 1 ];
+          m_preAlignChoices[ row_i ] = 1;
+        }
+        if( ( m_tables[ ProfileTransition::BeginToDeletion ] > 0 ) && ( m_gamma.m_deletion[ 1 ] > 0 ) &&
+            ( m_value.m_deletion[ 1 ] > m_value.m_preAlign ) ) {
+          m_value.m_preAlign = m_value.m_deletion[ 1 ];
+          m_preAlignChoices[ row_i ] = 2;
+        }
+      }
+
+      std::swap( m_value, m_nextValue );
+      std::swap( m_gamma, m_nextGamma );
+
+      // The block before this one starts from this row.
+      if( block_row == 0 ) {
+        m_valueCheckpoints[ row_i / m_checkpointInterval ] = m_nextValue;
+        m_gammaCheckpoints[ row_i / m_checkpointInterval ] = m_nextGamma;
+        if( row_i == 0 ) {
+          m_expectedAccuracy = m_nextValue.m_preAlign;
+        }
+      }
+    } // visitRow( .. )
+
+    /**
+     * After the sweep: the expected accuracy (the expected number of
+     * correctly-aligned residues) of the MEA path.
+     */
+    double
+    expectedAccuracy () const
+    {
+      return m_expectedAccuracy;
+    } // expectedAccuracy() const
+
+    /**
+     * After the sweep (forward_backward.forwardBackward( residues, *this,
+     * checkpoints )): follow the choices from PreAlign in row 0, revisiting
+     * each block of rows as the path enters it.  If confidences is non-null
+     * (and they were kept), it gets the posterior of each residue's state, as
+     * a byte (see confidenceCode(..)).
+     */
+    void
+    traceback (
+      ForwardBackwardType const & forward_backward,
+      std::vector<uint32_t> const & residues,
+      Checkpoints & checkpoints,
+      AlignmentPath & path,
+      std::vector<uint8_t> * confidences
+    )
+    {
+      const uint32_t profile_length = m_tables.m_profileLength;
+      path.clear();
+      if( confidences != 0 ) {
+        confidences->clear();
+      }
+      uint8_t state = PathState::PreAlign;
+      uint32_t row_i = 0;
+      uint32_t pos = 0;
+      while( true ) {
+        enterBlock( forward_backward, residues, checkpoints, row_i );
+        const size_t cell = ( ( row_i - m_blockStart ) * ( profile_length + 1 ) ) + pos;
+        uint8_t next_state;
+        if( state == PathState::PreAlign ) {
+          const uint8_t choice = m_preAlignChoices[ row_i ];
+          next_state = ( ( choice == 0 ) ? PathState::PreAlign : ( ( choice == 1 ) ? PathState::Match : PathState::Deletion ) );
+        } else if( state == PathState::PostAlign ) {
+          if( m_postAlignChoices[ row_i ] == 0 ) {
+            break;
+          }
+          next_state = PathState::PostAlign;
+        } else if( ( pos == profile_length ) && ( state != PathState::Insertion ) ) {
+          // Through End (silently).
+          state = PathState::PostAlign;
+          continue;
+        } else if( state == PathState::Match ) {
+          const uint8_t choice = ( m_choices[ cell ] & MatchChoiceMask );
+          next_state = ( ( choice == 0 ) ? PathState::Match : ( ( choice == 1 ) ? PathState::Insertion : PathState::Deletion ) );
+        } else if( state == PathState::Insertion ) {
+          next_state = ( ( m_choices[ cell ] & InsertionToInsertionBit ) ? PathState::Insertion : PathState::Match );
+        } else { // state == PathState::Deletion
+          next_state = ( ( m_choices[ cell ] & DeletionToDeletionBit ) ? PathState::Deletion : PathState::Match );
+        }
+
+        if( ( next_state == PathState::Match ) || ( next_state == PathState::Deletion ) ) {
+          pos += 1;
+        }
+        if( pathStateEmits( next_state ) ) {
+          row_i += 1;
+        }
+        path.push_back( next_state );
+        if( ( confidences != 0 ) && m_keepConfidences && pathStateEmits( next_state ) ) {
+          enterBlock( forward_backward, residues, checkpoints, row_i );
+          const size_t next_cell = ( ( row_i - m_blockStart ) * ( profile_length + 1 ) ) + pos;
+          switch( next_state ) {
+            case PathState::PreAlign:
+              confidences->push_back( m_preAlignConfidences[ row_i ] );
+              break;
+            case PathState::Match:
+              confidences->push_back( m_matchConfidences[ next_cell ] );
+              break;
+            case PathState::Insertion:
+              confidences->push_back( m_insertionConfidences[ next_cell ] );
+              break;
+            case PathState::PostAlign:
+              confidences->push_back( m_postAlignConfidences[ row_i ] );
+              break;
+          } // End switch( next_state )
+        }
+        state = next_state;
+      } // End while following the choices
+      assert( row_i == m_sequenceLength );
+    } // traceback( ForwardBackwardType const &, vector<uint32_t> const &, Checkpoints &, AlignmentPath &, vector<uint8_t> * )
+
+  protected:
+    ProfileTablesType const & m_tables;
+    uint32_t m_sequenceLength;
+    uint32_t m_checkpointInterval;
+    bool m_keepConfidences;
+
+    /// The first row of the block whose choices and confidences are held.
+    uint32_t m_blockStart;
+    double m_expectedAccuracy;
+
+    /// At [ ( ( row_i - m_blockStart ) * ( profile length + 1 ) ) + pos ], pos 1..M-1.
+    std::vector<uint8_t> m_choices;
+    /// 0: PreAlign, 1: Begin to Match, 2: Begin to Deletion.
+    std::vector<uint8_t> m_preAlignChoices;
+    /// 0: Terminal, 1: PostAlign.
+    std::vector<uint8_t> m_postAlignChoices;
+
+    /// Like m_choices.
+    std::vector<uint8_t> m_matchConfidences;
+    std::vector<uint8_t> m_insertionConfidences;
+    /// For every row.
+    std::vector<uint8_t> m_preAlignConfidences;
+    std::vector<uint8_t> m_postAlignConfidences;
+
+    /// The MEA values and posteriors of this row and the next one.
+    Row m_value;
+    Row m_nextValue;
+    Row m_gamma;
+    Row m_nextGamma;
+
+    /// Those of rows 0, k, 2k, .. (each the row after a block).
+    std::vector<Row> m_valueCheckpoints;
+    std::vector<Row> m_gammaCheckpoints;
+
+    /**
+     * Make the block holding row_i the current one, if it isn't already, by
+     * rerunning the recursion over it from the checkpoint after it.
+     */
+    void
+    enterBlock (
+      ForwardBackwardType const & forward_backward,
+      std::vector<uint32_t> const & residues,
+      Checkpoints & checkpoints,
+      uint32_t const row_i
+    )
+    {
+      const uint32_t block_start = row_i - ( row_i % m_checkpointInterval );
+      if( block_start == m_blockStart ) {
+        return;
+      }
+      if( ( block_start + m_checkpointInterval ) <= m_sequenceLength ) {
+        m_nextValue = m_valueCheckpoints[ ( block_start / m_checkpointInterval ) + 1 ];
+        m_nextGamma = m_gammaCheckpoints[ ( block_start / m_checkpointInterval ) + 1 ];
+      }
+      forward_backward.revisitBlock( residues, checkpoints, block_start, *this );
+      assert( m_blockStart == block_start );
+    } // enterBlock( ForwardBackwardType const &, vector<uint32_t> const &, Checkpoints &, uint32_t const )
+
+    static inline uint8_t
+    toByte (
+      double const posterior
+    )
+    {
+      return static_cast<uint8_t>( ( std::min( 1.0, std::max( 0.0, posterior ) ) * 255.0 ) + 0.5 );
+    } // toByte( double const )
+  }; // End inner class MEAVisitor
+
+  /**
+   * The tables must hold probabilities (not logs).  A checkpoint_interval of 0
+   * means use defaultCheckpointInterval( sequence length ).
+   */
+  PosteriorDecoding (
+    ProfileTablesType const & tables,
+    uint32_t const checkpoint_interval = 0
+  ) :
+    m_tables( tables ),
+    m_forwardBackward( tables, checkpoint_interval )
+  {
+    // Do nothing else.
+  } // <init>( ProfileTablesType const &, uint32_t const )
+
+  /**
+   * Compute the MEA path of the given sequence (as residue ordinal values;
+   * see sequenceToOrdinals(..)), and if confidences is non-null, the
+   * posterior of each residue's state on that path (as bytes; see
+   * confidenceCode(..)).  Returns the natural log of the probability of the
+   * sequence (-infinity if it is impossible, in which case the path is left
+   * empty); sets expected_accuracy to the path's sum of posteriors.
+   */
+  double
+  decode (
+    std::vector<uint32_t> const & residues,
+    AlignmentPath & path,
+    std::vector<uint8_t> * confidences,
+    double & expected_accuracy
+  ) const
+  {
+    MEAVisitor visitor( m_tables, residues.size(), m_forwardBackward.checkpointInterval( residues.size() ), ( confidences != 0 ) );
+    Checkpoints checkpoints;
+    const double log_probability = m_forwardBackward.forwardBackward( residues, visitor, checkpoints );
+    path.clear();
+    if( confidences != 0 ) {
+      confidences->clear();
+    }
+    expected_accuracy = 0;
+    if( log_probability == -std::numeric_limits<double>::infinity() ) {
+      return log_probability;
+    }
+    expected_accuracy = visitor.expectedAccuracy();
+    visitor.traceback( m_forwardBackward, residues, checkpoints, path, confidences );
+    return log_probability;
+  } // decode( vector<uint32_t> const &, AlignmentPath &, vector<uint8_t> *, double & ) const
+
+protected:
+  ProfileTablesType const & m_tables;
+  ForwardBackwardType m_forwardBackward;
+
+}; // End class PosteriorDecoding
+
+} // End namespace galosh
+
+#endif // __GALOSH_POSTERIORDECODING_HPP__
@@ -0,0 +1,185 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      Precision.hpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      The numeric backends of the DynamicProgramming drivers (score, align,
+##      profileToAlignmentProfile), chosen at run time by their --precision
+##      option: each names a <ProbabilityType, ScoreType, MatrixValueType>
+##      combination, all of which are compiled in.
+##
+##        bfloat  doublerealspace, bfloat, bfloat: the dp matrices can't
+##                underflow, however long the sequences (the default);
+##        double  doublerealspace, bfloat, doublerealspace, with Rabiner
+##                scaling of the dp rows;
+##        float   floatrealspace, bfloat, floatrealspace, with Rabiner
+##                scaling: the fastest, and enough for short reads.
+##
+##      The ScoreType is bfloat in every case, since the total probability
+##      of a set of sequences underflows even a double.
+##
+##      The drivers that need only forward scores (score) may also use
+##      dispatchForwardPrecision(..), which adds two precisions that don't go
+##      through DynamicProgramming:
+##
+##        flogsum UnscaledForward (a plain two-row forward), in log space
+##                with tabulated log sums (flogspace; see LogSum.hpp), so
+##                with no scaling: each sum is within 5e-7 nats;
+##        mixed   MixedPrecisionForward: float cells, each row scaled to sum
+##                to 1, with double scale factors, for short reads (it
+##                falls back to doubles where floats would lose a sequence).
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#if     _MSC_VER > 1000
+#pragma once
+#endif
+
+#ifndef __GALOSH_PRECISION_HPP__
+#define __GALOSH_PRECISION_HPP__
+
+#include "Algebra.hpp"
+#include "LogSum.hpp"
+#include "UnscaledForward.hpp"
+#include "MixedPrecisionForward.hpp"
+
+#include <string>
+
+namespace galosh {
+
+namespace Precision {
+  enum Index {
+    Bfloat,
+    Double,
+    Float,
+    Flogsum,
+    Mixed
+  };
+} // End namespace Precision
+
+  /**
+   * The Precision named by the given --precision value (bfloat, double,
+   * float, flogsum or mixed).  Throws a string if it names none of them.
+   */
+  inline Precision::Index
+  parsePrecision (
+    std::string const & name
+  )
+  {
+    if( name == "bfloat" ) {
+      return Precision::Bfloat;
+    } else if( name == "double" ) {
+      return Precision::Double;
+    } else if( name == "float" ) {
+      return Precision::Float;
+    } else if( name == "flogsum" ) {
+      return Precision::Flogsum;
+    } else if( name == "mixed" ) {
+      return Precision::Mixed;
+    }
+    throw std::string( "Unknown precision '" ) + name + "' (expected bfloat, double, float, flogsum, or mixed)";
+  } // parsePrecision( string const & )
+
+  /**
+   * Whether the dp rows must be (Rabiner) scaled when the matrices hold
+   * MatrixValueTypes, which is so for all but the types that can't
+   * underflow.
+   */
+  template <typename MatrixValueType>
+  struct UsesRabinerScaling {
+    enum { value = 1 };
+  }; // End struct UsesRabinerScaling<MatrixValueType>
+
+  template <>
+  struct UsesRabinerScaling<bfloat> {
+    enum { value = 0 };
+  }; // End struct UsesRabinerScaling<bfloat>
+
+  template <>
+  struct UsesRabinerScaling<logspace> {
+    enum { value = 0 };
+  }; // End struct UsesRabinerScaling<logspace>
+
+  /**
+   * Call runner.run<ProbabilityType, ScoreType, MatrixValueType>() for the
+   * given precision, and return what it returns.  The Runner must define
+   * result_type.  Throws a string for flogsum and mixed, which only
+   * dispatchForwardPrecision(..) supports.
+   */
+  template <typename Runner>
+  typename Runner::result_type
+  dispatchPrecision (
+    Precision::Index const precision,
+    Runner const & runner
+  )
+  {
+    switch( precision ) {
+      case Precision::Double:
+        return runner.template run<doublerealspace, bfloat, doublerealspace>();
+      case Precision::Float:
+        return runner.template run<floatrealspace, bfloat, floatrealspace>();
+      case Precision::Flogsum:
+        throw std::string( "--precision flogsum computes only forward scores (see score)" );
+      case Precision::Mixed:
+        throw std::string( "--precision mixed computes only forward scores (see score)" );
+      case Precision::Bfloat:
+      default:
+        return runner.template run<doublerealspace, bfloat, bfloat>();
+    }
+  } // dispatchPrecision( Precision::Index const, Runner const & )
+
+  /**
+   * As dispatchPrecision(..), but for flogsum call
+   * runner.runForward<UnscaledForward<ResidueType, SequenceResidueType,
+   * flogspace> >(), and for mixed
+   * runner.runForward<MixedPrecisionForward<ResidueType,
+   * SequenceResidueType> >(), which must compute the forward scores with the
+   * given forward (constructed from ProfileTables).
+   */
+  template <typename ResidueType,
+            typename SequenceResidueType,
+            typename Runner>
+  typename Runner::result_type
+  dispatchForwardPrecision (
+    Precision::Index const precision,
+    Runner const & runner
+  )
+  {
+    switch( precision ) {
+      case Precision::Flogsum:
+        return runner.template runForward<UnscaledForward<ResidueType, SequenceResidueType, flogspace> >();
+      case Precision::Mixed:
+        return runner.template runForward<MixedPrecisionForward<ResidueType, SequenceResidueType> >();
+      default:
+        return dispatchPrecision( precision, runner );
+    }
+  } // dispatchForwardPrecision( Precision::Index const, Runner const & )
+
+} // End namespace galosh
+
+#endif // __GALOSH_PRECISION_HPP__
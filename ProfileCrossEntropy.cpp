@@ -8,7 +8,12 @@
 ##  Description:
 ##      The profileCrossEntropy program.  It calculates the crossEntropy
 ##      between two Profile HMMs (or if you call it with one profile it
-##      calculates the self entropy).
+##      calculates the self entropy).  With --all-vs-all it instead loads
+##      any number of profiles once and calculates the matrix of the cross
+##      entropies between all pairs of them (see CrossEntropyMatrix.hpp),
+##      writing it in binary and/or writing each profile's k nearest
+##      neighbors.  With --verify it also checks every entry of the matrix
+##      against the profiles' own crossEntropy(..).
 ##
 #******************************************************************************
 #*
@@ -37,16 +42,52 @@
 
 #include "Algebra.hpp"
 #include "Profile.hpp"
+#include "CrossEntropyMatrix.hpp"
 
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
 
 #ifdef __HAVE_MUSCLE
 int g_argc;
 char **g_argv;
 #endif // __HAVE_MUSCLE
 
+namespace po = boost::program_options;
+
 using namespace seqan;
 
+  /**
+   * How far the matrix entry is from the expected cross entropy: relative,
+   * for entries of more than 1, and 0 if both are infinite (as
+   * CrossEntropyMatrix reports anything beyond its InfinityThreshold()).
+   */
+  template <typename ResidueType>
+  static double
+  entryDifference (
+    double const entry,
+    double expected
+  )
+  {
+    if( std::fabs( expected ) > galosh::CrossEntropyMatrix<ResidueType>::InfinityThreshold() ) {
+      expected = std::numeric_limits<double>::infinity();
+    }
+    if( entry == expected ) {
+      return 0;
+    }
+    const double difference =
+      std::fabs( entry - expected ) / std::max( 1.0, std::max( std::fabs( entry ), std::fabs( expected ) ) );
+    return ( ( difference == difference ) ? difference : std::numeric_limits<double>::infinity() );
+  } // entryDifference<ResidueType>( double const, double )
+
 int
 main ( int const argc, char const ** argv )
 {
@@ -56,36 +97,231 @@ main ( int const argc, char const ** argv )
   typedef seqan::Dna ResidueType;
 #endif // __PROFUSE_USE_AMINOS .. else ..
 
-  if( argc < 2 ) {
-    cout << "Usage: " << argv[ 0 ] << " <input (galosh Profile) filename 1> [<input (galosh Profile) filename 2>]" << endl;
-    exit( 1 );
-  }
-  const bool be_verbose = ( argc > 3 );
-  if( be_verbose ) {
-    cout << "Reading profile from file '" << argv[ 1 ] << "'" << endl;
-  }
-  galosh::ProfileTreeRoot<ResidueType, floatrealspace> profile1;
-  profile1.fromFile( argv[ 1 ] );
-  if( be_verbose ) {
-    cout << "\tgot:" << std::endl;
-    cout << profile1;
-    cout << endl;
-  }
+  try {
+    po::options_description visible( "Basic options" );
+    visible.add_options()
+      ( "help,h", "produce help message" )
+      ( "verbose,v", "print the profiles as they are read" )
+      ( "all-vs-all,a",
+        "calculate the cross entropies between all pairs of the given profiles" )
+      ( "list,l",
+        po::value<string>(),
+        "filename: with --all-vs-all, a file listing more profile filenames, one per line" )
+      ( "output,o",
+        po::value<string>(),
+        "filename: with --all-vs-all, where to write the (binary) cross entropy matrix" )
+      ( "top-k,k",
+        po::value<uint32_t>(),
+        "with --all-vs-all, write each profile's k nearest neighbors (lowest cross entropies)" )
+      ( "neighbors,n",
+        po::value<string>(),
+        "filename: where to write the --top-k neighbors (default: standard output)" )
+      ( "symmetrize,s",
+        "with --all-vs-all, use ( H( p, q ) + H( q, p ) ) / 2 instead of the cross entropy H( p, q )" )
+      ( "threads,t",
+        po::value<uint32_t>()->default_value( 0 ),
+        "number of threads for --all-vs-all (0, the default, means one per core)" )
+      ( "block-rows",
+        po::value<uint32_t>()->default_value( 256 ),
+        "with --all-vs-all, number of matrix rows to compute (in parallel) before writing them out" )
+      ( "verify",
+        po::value<double>()->implicit_value( 1E-6 ),
+        "with --all-vs-all, also compute every entry with the profiles' own crossEntropy(..) (slowly, keeping all of the profiles), and fail if any differs by more than this (relative, for entries of more than 1)" )
+      ;
+
+    po::options_description hidden( "Hidden options" );
+    hidden.add_options()
+      ( "profiles",
+        po::value<std::vector<string> >(),
+        "the (galosh Profile) profile filenames" )
+      ;
+
+    po::options_description all_options;
+    all_options.add( visible ).add( hidden );
+
+    po::positional_options_description p;
+    p.add( "profiles", -1 );
+
+    po::variables_map vm;
+    store( po::command_line_parser( argc, argv ).options( all_options ).positional( p ).run(), vm );
+    notify( vm );
+
+#define USAGE() " " << argv[ 0 ] << " [options] <input (galosh Profile) filename 1> [<input (galosh Profile) filename 2>]\n       " << argv[ 0 ] << " --all-vs-all [options] (--output <matrix filename> | --top-k <k>) [--list <filenames file>] [<input (galosh Profile) filename> ..]"
+
+    if( vm.count( "help" ) > 0 ) {
+      cout << "Usage: " << USAGE() << endl;
+      cout << visible << "\n";
+      return 0;
+    }
 
-  if( argc >= 2 ) {
-    if( be_verbose ) {
-      cout << "Reading another profile from file '" << argv[ 1 ] << "'" << endl;
+    std::vector<string> profile_filenames;
+    if( vm.count( "profiles" ) > 0 ) {
+      profile_filenames = vm[ "profiles" ].as<std::vector<string> >();
     }
-    galosh::ProfileTreeRoot<ResidueType, floatrealspace> profile2;
-    profile2.fromFile( argv[ 2 ] );
-    if( be_verbose ) {
-      cout << "\tgot:" << std::endl;
-      cout << profile2;
-      cout << endl;
+    const bool be_verbose = ( vm.count( "verbose" ) > 0 );
+
+    if( vm.count( "all-vs-all" ) == 0 ) {
+      if( ( profile_filenames.size() < 1 ) || ( profile_filenames.size() > 2 ) ) {
+        cout << "Usage: " << USAGE() << endl;
+        exit( 1 );
+      }
+      if( be_verbose ) {
+        cout << "Reading profile from file '" << profile_filenames[ 0 ] << "'" << endl;
+      }
+      galosh::ProfileTreeRoot<ResidueType, floatrealspace> profile1;
+      profile1.fromFile( profile_filenames[ 0 ] );
+      if( be_verbose ) {
+        cout << "\tgot:" << std::endl;
+        cout << profile1;
+        cout << endl;
+      }
+
+      if( profile_filenames.size() == 2 ) {
+        if( be_verbose ) {
+          cout << "Reading another profile from file '" << profile_filenames[ 1 ] << "'" << endl;
+        }
+        galosh::ProfileTreeRoot<ResidueType, floatrealspace> profile2;
+        profile2.fromFile( profile_filenames[ 1 ] );
+        if( be_verbose ) {
+          cout << "\tgot:" << std::endl;
+          cout << profile2;
+          cout << endl;
+        }
+        cout << "Cross Entropy: " << profile1.crossEntropy( profile2 ) << endl;
+      } else {
+        cout << "Self Entropy: " << profile1.crossEntropy( profile1 ) << endl;
+      }
+      exit( 0 );
+    } // End if !all-vs-all
+
+    if( vm.count( "list" ) > 0 ) {
+      const string list_filename = vm[ "list" ].as<string>();
+      std::ifstream list_stream( list_filename.c_str() );
+      if( !list_stream.good() ) {
+        cerr << "The profile list file '" << list_filename << "' could not be opened." << endl;
+        exit( 1 );
+      }
+      string line;
+      while( std::getline( list_stream, line ) ) {
+        while( !line.empty() && std::isspace( static_cast<unsigned char>( line[ line.length() - 1 ] ) ) ) {
+          line.erase( line.length() - 1 );
+        }
+        if( !line.empty() ) {
+          profile_filenames.push_back( line );
+        }
+      }
+    }
+    if( profile_filenames.empty() || ( ( vm.count( "output" ) == 0 ) && ( vm.count( "top-k" ) == 0 ) ) ) {
+      cout << "Usage: " << USAGE() << endl;
+      exit( 1 );
+    }
+
+    // Load each profile once; the matrix keeps (only) its parameters.  To
+    // verify the matrix, the profiles themselves are kept too.
+    const bool verify = ( vm.count( "verify" ) > 0 );
+    std::vector<galosh::ProfileTreeRoot<ResidueType, floatrealspace> > verify_profiles( verify ? profile_filenames.size() : 0 );
+    galosh::CrossEntropyMatrix<ResidueType> matrix;
+    for( size_t profile_i = 0; profile_i < profile_filenames.size(); profile_i++ ) {
+      galosh::ProfileTreeRoot<ResidueType, floatrealspace> loaded_profile;
+      galosh::ProfileTreeRoot<ResidueType, floatrealspace> & profile =
+        ( verify ? verify_profiles[ profile_i ] : loaded_profile );
+      profile.fromFile( profile_filenames[ profile_i ] );
+      if( be_verbose ) {
+        cout << "Read profile from file '" << profile_filenames[ profile_i ] << "':" << endl;
+        cout << profile;
+        cout << endl;
+      }
+      matrix.add( profile );
+    }
+
+    const bool symmetrize = ( vm.count( "symmetrize" ) > 0 );
+    const uint32_t thread_count = vm[ "threads" ].as<uint32_t>();
+    const uint32_t block_rows = std::max( static_cast<uint32_t>( 1 ), vm[ "block-rows" ].as<uint32_t>() );
+    const size_t profile_count = matrix.size();
+
+    std::ofstream matrix_stream;
+    if( vm.count( "output" ) > 0 ) {
+      const string matrix_filename = vm[ "output" ].as<string>();
+      matrix_stream.open( matrix_filename.c_str(), std::ios::binary );
+      if( !matrix_stream.good() ) {
+        cerr << "The matrix output file '" << matrix_filename << "' could not be opened." << endl;
+        exit( 1 );
+      }
+      galosh::writeCrossEntropyMatrixHeader( matrix_stream, profile_filenames, symmetrize );
+    }
+    const uint32_t top_k = ( ( vm.count( "top-k" ) > 0 ) ? vm[ "top-k" ].as<uint32_t>() : 0 );
+    std::ofstream neighbors_file_stream;
+    if( ( top_k > 0 ) && ( vm.count( "neighbors" ) > 0 ) ) {
+      neighbors_file_stream.open( vm[ "neighbors" ].as<string>().c_str() );
+      if( !neighbors_file_stream.good() ) {
+        cerr << "The neighbors output file '" << vm[ "neighbors" ].as<string>() << "' could not be opened." << endl;
+        exit( 1 );
+      }
+    }
+    std::ostream & neighbors_stream = ( neighbors_file_stream.is_open() ? neighbors_file_stream : cout );
+
+    /// Compute the matrix a block of rows at a time, writing each block out
+    /// (in row order) before computing the next.
+    std::vector<double> rows;
+    std::vector<std::pair<double, size_t> > neighbors;
+    double max_difference = 0;
+    std::string max_difference_description;
+    for( size_t first_row = 0; first_row < profile_count; first_row += block_rows ) {
+      const size_t row_count = std::min( static_cast<size_t>( block_rows ), ( profile_count - first_row ) );
+      matrix.computeRows( first_row, row_count, symmetrize, thread_count, rows );
+      for( size_t row_i = 0; verify && ( row_i < row_count ); row_i++ ) {
+        galosh::ProfileTreeRoot<ResidueType, floatrealspace> const & profile1 = verify_profiles[ first_row + row_i ];
+        for( size_t column_i = 0; column_i < profile_count; column_i++ ) {
+          galosh::ProfileTreeRoot<ResidueType, floatrealspace> const & profile2 = verify_profiles[ column_i ];
+          double expected = std::numeric_limits<double>::infinity();
+          if( profile1.length() == profile2.length() ) {
+            const double cross_entropy = profile1.crossEntropy( profile2 );
+            if( symmetrize ) {
+              const double reverse_cross_entropy = profile2.crossEntropy( profile1 );
+              expected = ( cross_entropy + reverse_cross_entropy ) / 2;
+            } else {
+              expected = cross_entropy;
+            }
+          }
+          const double entry = rows[ ( row_i * profile_count ) + column_i ];
+          const double difference = entryDifference<ResidueType>( entry, expected );
+          if( difference > max_difference ) {
+            max_difference = difference;
+            std::ostringstream description;
+            description << "the entry for " << profile_filenames[ first_row + row_i ] << " and " << profile_filenames[ column_i ] << " is " << entry << " but crossEntropy(..) gives " << expected;
+            max_difference_description = description.str();
+          }
+        } // End foreach column_i
+      } // End foreach row_i, if verify
+      if( matrix_stream.is_open() ) {
+        galosh::writeCrossEntropyMatrixRows( matrix_stream, &rows[ 0 ], rows.size() );
+      }
+      for( size_t row_i = 0; ( top_k > 0 ) && ( row_i < row_count ); row_i++ ) {
+        galosh::nearestNeighbors( &rows[ row_i * profile_count ], profile_count, ( first_row + row_i ), top_k, neighbors );
+        for( size_t neighbor_i = 0; neighbor_i < neighbors.size(); neighbor_i++ ) {
+          neighbors_stream << profile_filenames[ first_row + row_i ] << "\t" << profile_filenames[ neighbors[ neighbor_i ].second ] << "\t" << neighbors[ neighbor_i ].first << endl;
+        }
+      }
+    } // End foreach block of rows
+
+    if( verify ) {
+      if( max_difference > vm[ "verify" ].as<double>() ) {
+        throw ( "The cross entropy matrix is wrong: " + max_difference_description );
+      }
+      cerr << "Verified all " << profile_count << " x " << profile_count << " entries against crossEntropy(..); the largest difference was " << max_difference << "." << endl;
+    }
+
+    if( matrix_stream.is_open() ) {
+      matrix_stream.close();
+      // We print out the output file as a side effect
+      cout << vm[ "output" ].as<string>() << endl;
     }
-    cout << "Cross Entropy: " << profile1.crossEntropy( profile2 ) << endl;
-  } else {
-    cout << "Self Entropy: " << profile1.crossEntropy( profile1 ) << endl;
+  } catch( std::exception& e ) { /// exceptions thrown by boost stuff
+    cerr << "error: " << e.what() << endl;
+    return 1;
+  } catch( string &err ) {      /// exceptions thrown by parallelFor, etc.
+    cerr << "error: " << err << endl;
+    return 1;
   }
 
   exit( 0 );
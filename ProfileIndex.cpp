@@ -0,0 +1,270 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      ProfileIndex.cpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      The profileIndex program.  It builds (or adds to) a persistent index
+##      over a library of profiles, and finds the profiles in the index that
+##      are nearest to query profiles by cross entropy (see ProfileIndex.hpp),
+##      without comparing each query to the whole library:
+##
+##        profileIndex build <index file> <profile file> ..
+##        profileIndex add <index file> <profile file> ..
+##        profileIndex query <index file> <query profile file> ..
+##
+##      Profiles are named in the index by their filenames.  A query writes
+##      one line per neighbor: the query filename, the neighbor's name, and
+##      the cross entropy H( query, neighbor ), nearest first.
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#include "Algebra.hpp"
+#include "Profile.hpp"
+#include "ProfileIndex.hpp"
+#include "ParallelFor.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#ifdef __HAVE_MUSCLE
+int g_argc;
+char **g_argv;
+#endif // __HAVE_MUSCLE
+
+namespace po = boost::program_options;
+
+/**
+ * The parallelFor body: finds the neighbors of query number first_query +
+ * batch_i, into slot batch_i.
+ */
+template <typename ResidueType, typename ProfileType>
+class QueryBody {
+public:
+  typedef galosh::ProfileIndex<ResidueType> IndexType;
+
+  QueryBody (
+    IndexType const & index,
+    std::vector<ProfileType> const & queries,
+    uint32_t const k,
+    std::vector<std::vector<std::pair<double, size_t> > > & neighbors,
+    std::vector<typename IndexType::QueryStatistics> & stats
+  ) :
+    m_index( index ),
+    m_queries( queries ),
+    m_k( k ),
+    m_neighbors( neighbors ),
+    m_stats( stats )
+  {
+    // Do nothing else.
+  } // <init>( .. )
+
+  void
+  operator() (
+    size_t const query_i,
+    uint32_t const thread_i
+  )
+  {
+    m_index.nearest( m_queries[ query_i ], m_k, m_neighbors[ query_i ], &m_stats[ query_i ] );
+  } // operator()( size_t const, uint32_t const )
+
+protected:
+  IndexType const & m_index;
+  std::vector<ProfileType> const & m_queries;
+  uint32_t m_k;
+  std::vector<std::vector<std::pair<double, size_t> > > & m_neighbors;
+  std::vector<typename IndexType::QueryStatistics> & m_stats;
+}; // End class QueryBody<ResidueType, ProfileType>
+
+int
+main ( int const argc, char const ** argv )
+{
+#ifdef __PROFUSE_USE_AMINOS
+  typedef seqan::AminoAcid20 ResidueType;
+#else // __PROFUSE_USE_AMINOS .. else
+  typedef seqan::Dna ResidueType;
+#endif // __PROFUSE_USE_AMINOS .. else ..
+  typedef galosh::ProfileTreeRoot<ResidueType, floatrealspace> ProfileType;
+  typedef galosh::ProfileIndex<ResidueType> IndexType;
+
+  try {
+    po::options_description visible( "Basic options" );
+    visible.add_options()
+      ( "help,h", "produce help message" )
+      ( "list,l",
+        po::value<std::string>(),
+        "filename: a file listing more profile filenames, one per line" )
+      ( "top-k,k",
+        po::value<uint32_t>()->default_value( 10 ),
+        "query: number of nearest profiles to find for each query" )
+      ( "threads,t",
+        po::value<uint32_t>()->default_value( 0 ),
+        "query: number of threads (0, the default, means one per core)" )
+      ( "batch-size",
+        po::value<uint32_t>()->default_value( 1024 ),
+        "query: number of queries to read and run (in parallel) before writing their neighbors out" )
+      ( "kmer-length",
+        po::value<uint32_t>()->default_value( 8 ),
+        "build: length of the consensus k-mers used to order candidates" )
+      ( "sketch-size",
+        po::value<uint32_t>()->default_value( 64 ),
+        "build: number of consensus k-mer hashes kept per profile" )
+      ( "stats",
+        "query: report how many candidates were pruned, abandoned, and computed in full" )
+      ;
+
+    po::options_description hidden( "Hidden options" );
+    hidden.add_options()
+      ( "command",
+        po::value<std::string>(),
+        "build, add, or query" )
+      ( "index",
+        po::value<std::string>(),
+        "the index filename" )
+      ( "profiles",
+        po::value<std::vector<std::string> >(),
+        "the (galosh Profile) profile filenames" )
+      ;
+
+    po::options_description all_options;
+    all_options.add( visible ).add( hidden );
+
+    po::positional_options_description p;
+    p.add( "command", 1 );
+    p.add( "index", 1 );
+    p.add( "profiles", -1 );
+
+    po::variables_map vm;
+    store( po::command_line_parser( argc, argv ).options( all_options ).positional( p ).run(), vm );
+    notify( vm );
+
+#define USAGE() " " << argv[ 0 ] << " [options] (build | add | query) <index filename> [<input (galosh Profile) filename> ..]"
+
+    if( vm.count( "help" ) > 0 ) {
+      std::cout << "Usage: " << USAGE() << std::endl;
+      std::cout << visible << "\n";
+      return 0;
+    }
+    const std::string command = ( vm.count( "command" ) ? vm[ "command" ].as<std::string>() : std::string( "" ) );
+    if( ( ( command != "build" ) && ( command != "add" ) && ( command != "query" ) ) || ( vm.count( "index" ) == 0 ) ) {
+      std::cout << "Usage: " << USAGE() << std::endl;
+      exit( 1 );
+    }
+    const std::string index_filename = vm[ "index" ].as<std::string>();
+
+    std::vector<std::string> profile_filenames;
+    if( vm.count( "profiles" ) > 0 ) {
+      profile_filenames = vm[ "profiles" ].as<std::vector<std::string> >();
+    }
+    if( vm.count( "list" ) > 0 ) {
+      const std::string list_filename = vm[ "list" ].as<std::string>();
+      std::ifstream list_stream( list_filename.c_str() );
+      if( !list_stream.good() ) {
+        std::cerr << "The profile list file '" << list_filename << "' could not be opened." << std::endl;
+        exit( 1 );
+      }
+      std::string line;
+      while( std::getline( list_stream, line ) ) {
+        while( !line.empty() && std::isspace( static_cast<unsigned char>( line[ line.length() - 1 ] ) ) ) {
+          line.erase( line.length() - 1 );
+        }
+        if( !line.empty() ) {
+          profile_filenames.push_back( line );
+        }
+      }
+    }
+
+    IndexType index( vm[ "kmer-length" ].as<uint32_t>(), vm[ "sketch-size" ].as<uint32_t>() );
+    if( command != "build" ) {
+      index.fromFile( index_filename );
+    }
+
+    if( command != "query" ) {
+      for( size_t profile_i = 0; profile_i < profile_filenames.size(); profile_i++ ) {
+        ProfileType profile;
+        profile.fromFile( profile_filenames[ profile_i ] );
+        index.add( profile_filenames[ profile_i ], profile );
+      }
+      index.toFile( index_filename );
+      // We print out the output file as a side effect
+      std::cout << index_filename << std::endl;
+      return 0;
+    }
+
+    /// Run the queries a batch at a time, writing each batch's neighbors in
+    /// query order (so the output doesn't depend on the number of threads).
+    const uint32_t k = vm[ "top-k" ].as<uint32_t>();
+    const uint32_t thread_count = vm[ "threads" ].as<uint32_t>();
+    const uint32_t batch_size = std::max( static_cast<uint32_t>( 1 ), vm[ "batch-size" ].as<uint32_t>() );
+    const bool report_stats = ( vm.count( "stats" ) > 0 );
+    IndexType::QueryStatistics total_stats;
+    std::vector<ProfileType> queries;
+    std::vector<std::vector<std::pair<double, size_t> > > neighbors;
+    std::vector<IndexType::QueryStatistics> stats;
+    for( size_t first_query = 0; first_query < profile_filenames.size(); first_query += batch_size ) {
+      const size_t batch_queries = std::min( static_cast<size_t>( batch_size ), ( profile_filenames.size() - first_query ) );
+      queries.resize( batch_queries );
+      for( size_t batch_i = 0; batch_i < batch_queries; batch_i++ ) {
+        queries[ batch_i ].fromFile( profile_filenames[ first_query + batch_i ] );
+      }
+      neighbors.resize( batch_queries );
+      stats.resize( batch_queries );
+      galosh::parallelFor(
+        batch_queries,
+        thread_count,
+        QueryBody<ResidueType, ProfileType>( index, queries, k, neighbors, stats )
+      );
+      for( size_t batch_i = 0; batch_i < batch_queries; batch_i++ ) {
+        for( size_t neighbor_i = 0; neighbor_i < neighbors[ batch_i ].size(); neighbor_i++ ) {
+          std::cout << profile_filenames[ first_query + batch_i ] << "\t" << index.name( neighbors[ batch_i ][ neighbor_i ].second ) << "\t" << neighbors[ batch_i ][ neighbor_i ].first << std::endl;
+        }
+        total_stats.m_candidates += stats[ batch_i ].m_candidates;
+        total_stats.m_pruned += stats[ batch_i ].m_pruned;
+        total_stats.m_abandoned += stats[ batch_i ].m_abandoned;
+        total_stats.m_completed += stats[ batch_i ].m_completed;
+      }
+    } // End foreach batch of queries
+
+    if( report_stats ) {
+      std::cerr << "Candidates: " << total_stats.m_candidates << ", pruned: " << total_stats.m_pruned << ", abandoned: " << total_stats.m_abandoned << ", computed in full: " << total_stats.m_completed << std::endl;
+    }
+  } catch( std::exception& e ) { /// exceptions thrown by boost stuff
+    std::cerr << "error: " << e.what() << std::endl;
+    return 1;
+  } catch( std::string &err ) {      /// exceptions thrown by ProfileIndex, parallelFor, etc.
+    std::cerr << "error: " << err << std::endl;
+    return 1;
+  }
+
+  return 0; // success
+} // main (..)
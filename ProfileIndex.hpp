@@ -0,0 +1,544 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      ProfileIndex.hpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      Class definition for the ProfileIndex class, an index over a
+##      collection of profiles for finding the k profiles nearest to a query
+##      profile by cross entropy (H( query, profile ), as computed by
+##      CrossEntropyMatrix), without computing every cross entropy in full.
+##
+##      Every term -q( x ) log p( x ) is non-negative, so a partial sum is a
+##      lower bound on the whole.  The index keeps, for each profile and
+##      position, the least cost -log max_x p( x ) of that position's Match
+##      distribution; since each of the query's Match distributions sums to
+##      (about) 1, the sum of those over the positions not yet visited bounds
+##      what is left.  A candidate is skipped outright if its bound for the
+##      whole profile exceeds the current k-th best value, and abandoned part
+##      way through once the partial sum plus the bound for the rest does.
+##      To find good candidates early (so the k-th best value falls quickly),
+##      candidates are visited in order of the number of consensus k-mers
+##      they share with the query (bottom-s sketches of the hashes of the
+##      k-mers of the profiles' consensus sequences).  The results are the
+##      same as those of a full scan (up to rounding at ties).
+##
+##      Only profiles of the query's length are candidates; others aren't
+##      comparable (see CrossEntropyMatrix.hpp).
+##
+##      The index is persisted with toFile(..) and fromFile(..).  The file
+##      holds the magic bytes "PRFIDX01"; the version, the alphabet size, the
+##      k-mer length, and the sketch size (all uint32); the number of profiles
+##      (uint64); then for each profile its name (uint32 length, then the
+##      bytes), its length (uint32), and its parameters (uint64 count, then
+##      the doubles' IEEE 754 bits), all little-endian.  The bounds and
+##      sketches are recomputed when it is read.
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#if     _MSC_VER > 1000
+#pragma once
+#endif
+
+#ifndef __GALOSH_PROFILEINDEX_HPP__
+#define __GALOSH_PROFILEINDEX_HPP__
+
+#include "ProfileTables.hpp"
+#include "CrossEntropyMatrix.hpp"
+#include "LittleEndian.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+#include <seqan/basic.h>
+
+namespace galosh {
+
+  static const char PROFILE_INDEX_MAGIC[ 8 ] = { 'P', 'R', 'F', 'I', 'D', 'X', '0', '1' };
+  static const uint32_t PROFILE_INDEX_VERSION = 1;
+
+template <typename ResidueType>
+class ProfileIndex {
+public:
+  enum { AlphabetSize = seqan::ValueSize<ResidueType>::VALUE };
+
+  /// The partial sum is checked against the bound every CheckPositions
+  /// positions.
+  enum { CheckPositions = 16 };
+
+  /**
+   * What happened to the candidates of a query.
+   */
+  struct QueryStatistics {
+    uint64_t m_candidates; // profiles of the query's length
+    uint64_t m_pruned; // skipped by their whole-profile bound
+    uint64_t m_abandoned; // abandoned part way through
+    uint64_t m_completed; // computed in full
+
+    QueryStatistics () :
+      m_candidates( 0 ),
+      m_pruned( 0 ),
+      m_abandoned( 0 ),
+      m_completed( 0 )
+    {
+      // Do nothing else.
+    } // <init>()
+  }; // End inner struct QueryStatistics
+
+  ProfileIndex (
+    uint32_t const kmer_length = 8,
+    uint32_t const sketch_size = 64
+  ) :
+    m_kmerLength( kmer_length ),
+    m_sketchSize( sketch_size ),
+    m_entries(),
+    m_membersOfLength()
+  {
+    // Do nothing else.
+  } // <init>( uint32_t const, uint32_t const )
+
+  /**
+   * Add a profile to the index (its parameters are copied).
+   */
+  template <typename ProfileType>
+  void
+  add (
+    std::string const & name,
+    ProfileType const & profile
+  )
+  {
+    const ProfileTables<ResidueType, ResidueType> tables( profile );
+    Entry entry;
+    entry.m_name = name;
+    entry.m_profileLength = tables.m_profileLength;
+    tables.toParameters( entry.m_parameters );
+    addEntry( entry );
+  } // add( string const &, ProfileType const & )
+
+  size_t
+  size () const
+  {
+    return m_entries.size();
+  } // size() const
+
+  std::string const &
+  name (
+    size_t const profile_i
+  ) const
+  {
+    return m_entries[ profile_i ].m_name;
+  } // name( size_t const ) const
+
+  uint32_t
+  kmerLength () const
+  {
+    return m_kmerLength;
+  } // kmerLength() const
+
+  uint32_t
+  sketchSize () const
+  {
+    return m_sketchSize;
+  } // sketchSize() const
+
+  /**
+   * Find the (at most) k indexed profiles with the lowest (finite) cross
+   * entropies H( profile, indexed profile ), nearest first (ties go to the
+   * lower index).  Safe to call from several threads at once.
+   */
+  template <typename ProfileType>
+  void
+  nearest (
+    ProfileType const & profile,
+    size_t const k,
+    std::vector<std::pair<double, size_t> > & neighbors,
+    QueryStatistics * stats = NULL
+  ) const
+  {
+    const ProfileTables<ResidueType, ResidueType> tables( profile );
+    Entry query;
+    query.m_profileLength = tables.m_profileLength;
+    tables.toParameters( query.m_parameters );
+    computeSketch( query );
+    nearestEntries( query, k, neighbors, stats );
+  } // nearest( ProfileType const &, size_t const, vector<pair<double, size_t> > &, QueryStatistics * ) const
+
+  void
+  toFile (
+    std::string const & filename
+  ) const
+  {
+    std::ofstream os( filename.c_str(), std::ios::binary );
+    if( !os.good() ) {
+      throw std::string( "The profile index file '" ) + filename + "' could not be opened for writing.";
+    }
+    os.write( PROFILE_INDEX_MAGIC, sizeof( PROFILE_INDEX_MAGIC ) );
+    writeLittleEndian( os, PROFILE_INDEX_VERSION, 4 );
+    writeLittleEndian( os, AlphabetSize, 4 );
+    writeLittleEndian( os, m_kmerLength, 4 );
+    writeLittleEndian( os, m_sketchSize, 4 );
+    writeLittleEndian( os, m_entries.size(), 8 );
+    for( size_t entry_i = 0; entry_i < m_entries.size(); entry_i++ ) {
+      Entry const & entry = m_entries[ entry_i ];
+      writeLittleEndian( os, entry.m_name.length(), 4 );
+      os.write( entry.m_name.data(), entry.m_name.length() );
+      writeLittleEndian( os, entry.m_profileLength, 4 );
+      writeLittleEndian( os, entry.m_parameters.size(), 8 );
+      for( size_t param_i = 0; param_i < entry.m_parameters.size(); param_i++ ) {
+        uint64_t bits;
+        std::memcpy( &bits, &entry.m_parameters[ param_i ], sizeof( bits ) );
+        writeLittleEndian( os, bits, 8 );
+      }
+    }
+    if( !os.good() ) {
+      throw std::string( "Writing the profile index file '" ) + filename + "' failed.";
+    }
+  } // toFile( string const & ) const
+
+  void
+  fromFile (
+    std::string const & filename
+  )
+  {
+    std::ifstream is( filename.c_str(), std::ios::binary );
+    if( !is.good() ) {
+      throw std::string( "The profile index file '" ) + filename + "' could not be opened.";
+    }
+    // The lengths read below are checked against what is left of the file
+    // before anything is allocated for them.
+    is.seekg( 0, std::ios::end );
+    const uint64_t file_size = static_cast<uint64_t>( is.tellg() );
+    is.seekg( 0, std::ios::beg );
+    char magic[ sizeof( PROFILE_INDEX_MAGIC ) ];
+    is.read( magic, sizeof( magic ) );
+    if( !is.good() || !std::equal( magic, magic + sizeof( magic ), PROFILE_INDEX_MAGIC ) ) {
+      throw std::string( "The file '" ) + filename + "' is not a profile index.";
+    }
+    if( readValue( is, 4, filename ) != PROFILE_INDEX_VERSION ) {
+      throw std::string( "The profile index file '" ) + filename + "' has an unsupported version.";
+    }
+    if( readValue( is, 4, filename ) != AlphabetSize ) {
+      throw std::string( "The profile index file '" ) + filename + "' is for profiles of a different alphabet.";
+    }
+    m_kmerLength = static_cast<uint32_t>( readValue( is, 4, filename ) );
+    m_sketchSize = static_cast<uint32_t>( readValue( is, 4, filename ) );
+    const uint64_t entry_count = readValue( is, 8, filename );
+    m_entries.clear();
+    m_membersOfLength.clear();
+    for( uint64_t entry_i = 0; entry_i < entry_count; entry_i++ ) {
+      Entry entry;
+      const uint64_t name_length = readValue( is, 4, filename );
+      if( name_length > remainingBytes( is, file_size ) ) {
+        throw std::string( "The profile index file '" ) + filename + "' is corrupt.";
+      }
+      entry.m_name.resize( static_cast<size_t>( name_length ) );
+      if( name_length > 0 ) {
+        is.read( &entry.m_name[ 0 ], entry.m_name.length() );
+      }
+      entry.m_profileLength = static_cast<uint32_t>( readValue( is, 4, filename ) );
+      const uint64_t parameter_count = readValue( is, 8, filename );
+      if( ( parameter_count > ( remainingBytes( is, file_size ) / sizeof( double ) ) ) ||
+          ( parameter_count != parameterCount( entry.m_profileLength ) ) ) {
+        throw std::string( "The profile index file '" ) + filename + "' is corrupt.";
+      }
+      entry.m_parameters.resize( static_cast<size_t>( parameter_count ) );
+      for( size_t param_i = 0; param_i < entry.m_parameters.size(); param_i++ ) {
+        const uint64_t bits = readValue( is, 8, filename );
+        std::memcpy( &entry.m_parameters[ param_i ], &bits, sizeof( bits ) );
+      }
+      addEntry( entry );
+    }
+  } // fromFile( string const & )
+
+protected:
+  struct Entry {
+    std::string m_name;
+    uint32_t m_profileLength;
+    std::vector<double> m_parameters;
+    /// -log( parameter ), with -CrossEntropyMatrix::ZeroLog() for 0.
+    std::vector<double> m_costs;
+    /// [ pos_i ]: the sum, over the positions from pos_i on, of the least
+    /// cost of the position's Match distribution (profile length + 1 values).
+    std::vector<double> m_remainingBounds;
+    /// The smallest (at most sketch size) distinct hashes of consensus k-mers,
+    /// ascending.
+    std::vector<uint64_t> m_sketch;
+  }; // End inner struct Entry
+
+  static size_t
+  parameterCount (
+    uint32_t const profile_length
+  )
+  {
+    return ( ( ( profile_length + 1 ) * AlphabetSize ) + ProfileTransition::Count );
+  } // parameterCount( uint32_t const )
+
+  void
+  addEntry (
+    Entry & entry
+  )
+  {
+    const double zero_cost = -CrossEntropyMatrix<ResidueType>::ZeroLog();
+    entry.m_costs.resize( entry.m_parameters.size() );
+    for( size_t param_i = 0; param_i < entry.m_parameters.size(); param_i++ ) {
+      entry.m_costs[ param_i ] =
+        ( ( entry.m_parameters[ param_i ] > 0 ) ? -std::log( entry.m_parameters[ param_i ] ) : zero_cost );
+    }
+    entry.m_remainingBounds.assign( entry.m_profileLength + 1, 0.0 );
+    for( uint32_t pos_i = entry.m_profileLength; pos_i-- > 0; ) {
+      double const * costs = &entry.m_costs[ pos_i * AlphabetSize ];
+      entry.m_remainingBounds[ pos_i ] =
+        ( entry.m_remainingBounds[ pos_i + 1 ] + *std::min_element( costs, costs + AlphabetSize ) );
+    }
+    computeSketch( entry );
+    m_membersOfLength[ entry.m_profileLength ].push_back( m_entries.size() );
+    m_entries.push_back( entry );
+  } // addEntry( Entry & )
+
+  /**
+   * Fill in entry.m_sketch from its parameters.
+   */
+  void
+  computeSketch (
+    Entry & entry
+  ) const
+  {
+    entry.m_sketch.clear();
+    if( ( m_kmerLength == 0 ) || ( entry.m_profileLength < m_kmerLength ) ) {
+      return;
+    }
+    std::vector<uint8_t> consensus( entry.m_profileLength );
+    for( uint32_t pos_i = 0; pos_i < entry.m_profileLength; pos_i++ ) {
+      double const * emissions = &entry.m_parameters[ pos_i * AlphabetSize ];
+      consensus[ pos_i ] = static_cast<uint8_t>( std::max_element( emissions, emissions + AlphabetSize ) - emissions );
+    }
+    for( uint32_t first_pos = 0; ( first_pos + m_kmerLength ) <= entry.m_profileLength; first_pos++ ) {
+      uint64_t hash = 14695981039346656037ull; // FNV-1a, then mixed (splitmix64's finalizer).
+      for( uint32_t pos_i = first_pos; pos_i < ( first_pos + m_kmerLength ); pos_i++ ) {
+        hash ^= consensus[ pos_i ];
+        hash *= 1099511628211ull;
+      }
+      hash ^= ( hash >> 30 );
+      hash *= 0xbf58476d1ce4e5b9ull;
+      hash ^= ( hash >> 27 );
+      hash *= 0x94d049bb133111ebull;
+      hash ^= ( hash >> 31 );
+      entry.m_sketch.push_back( hash );
+    }
+    std::sort( entry.m_sketch.begin(), entry.m_sketch.end() );
+    entry.m_sketch.erase( std::unique( entry.m_sketch.begin(), entry.m_sketch.end() ), entry.m_sketch.end() );
+    if( entry.m_sketch.size() > m_sketchSize ) {
+      entry.m_sketch.resize( m_sketchSize );
+    }
+  } // computeSketch( Entry & ) const
+
+  static uint32_t
+  sharedHashes (
+    std::vector<uint64_t> const & sketch1,
+    std::vector<uint64_t> const & sketch2
+  )
+  {
+    uint32_t shared = 0;
+    std::vector<uint64_t>::const_iterator it1 = sketch1.begin(), it2 = sketch2.begin();
+    while( ( it1 != sketch1.end() ) && ( it2 != sketch2.end() ) ) {
+      if( *it1 < *it2 ) {
+        ++it1;
+      } else if( *it2 < *it1 ) {
+        ++it2;
+      } else {
+        ++shared;
+        ++it1;
+        ++it2;
+      }
+    }
+    return shared;
+  } // sharedHashes( vector<uint64_t> const &, vector<uint64_t> const & )
+
+  /**
+   * Orders candidates by the number of shared k-mers (descending), then by
+   * their whole-profile bounds, then by index.
+   */
+  struct CandidateOrder {
+    bool
+    operator() (
+      std::pair<std::pair<uint32_t, double>, size_t> const & a,
+      std::pair<std::pair<uint32_t, double>, size_t> const & b
+    ) const
+    {
+      if( a.first.first != b.first.first ) {
+        return ( a.first.first > b.first.first );
+      }
+      if( a.first.second != b.first.second ) {
+        return ( a.first.second < b.first.second );
+      }
+      return ( a.second < b.second );
+    } // operator()( .. ) const
+  }; // End inner struct CandidateOrder
+
+  void
+  nearestEntries (
+    Entry const & query,
+    size_t const k,
+    std::vector<std::pair<double, size_t> > & neighbors,
+    QueryStatistics * stats
+  ) const
+  {
+    neighbors.clear();
+    typename std::map<uint32_t, std::vector<size_t> >::const_iterator members_it =
+      m_membersOfLength.find( query.m_profileLength );
+    if( ( k == 0 ) || ( members_it == m_membersOfLength.end() ) ) {
+      return;
+    }
+    std::vector<size_t> const & members = members_it->second;
+    const uint32_t profile_length = query.m_profileLength;
+    const size_t parameter_count = query.m_parameters.size();
+
+    // The bounds assume each query Match distribution sums to 1; scale them
+    // by the least sum, to allow for rounding.
+    double bound_scale = 1.0;
+    for( uint32_t pos_i = 0; pos_i < profile_length; pos_i++ ) {
+      double const * emissions = &query.m_parameters[ pos_i * AlphabetSize ];
+      double mass = 0;
+      for( uint32_t res_i = 0; res_i < AlphabetSize; res_i++ ) {
+        mass += emissions[ res_i ];
+      }
+      bound_scale = std::min( bound_scale, mass );
+    }
+    bound_scale = std::max( 0.0, ( bound_scale * ( 1.0 - 1.0E-12 ) ) );
+
+    std::vector<std::pair<std::pair<uint32_t, double>, size_t> > candidates( members.size() );
+    for( size_t member_i = 0; member_i < members.size(); member_i++ ) {
+      Entry const & entry = m_entries[ members[ member_i ] ];
+      candidates[ member_i ] =
+        std::make_pair( std::make_pair( sharedHashes( query.m_sketch, entry.m_sketch ), entry.m_remainingBounds[ 0 ] ), members[ member_i ] );
+    }
+    std::sort( candidates.begin(), candidates.end(), CandidateOrder() );
+
+    QueryStatistics local_stats;
+    local_stats.m_candidates = candidates.size();
+    std::priority_queue<std::pair<double, size_t> > best; // The largest on top.
+    for( size_t candidate_i = 0; candidate_i < candidates.size(); candidate_i++ ) {
+      const size_t entry_i = candidates[ candidate_i ].second;
+      Entry const & entry = m_entries[ entry_i ];
+      const bool have_k = ( best.size() == k );
+      const double threshold = ( have_k ? best.top().first : std::numeric_limits<double>::infinity() );
+      if( have_k && ( ( bound_scale * entry.m_remainingBounds[ 0 ] ) > threshold ) ) {
+        local_stats.m_pruned += 1;
+        continue;
+      }
+      double const * q = &query.m_parameters[ 0 ];
+      double const * costs = &entry.m_costs[ 0 ];
+      double sum = 0;
+      bool abandoned = false;
+      for( uint32_t first_pos = 0; first_pos < profile_length; first_pos += CheckPositions ) {
+        const uint32_t last_pos = std::min( static_cast<uint32_t>( first_pos + CheckPositions ), profile_length );
+        for( size_t param_i = ( first_pos * AlphabetSize ); param_i < ( last_pos * AlphabetSize ); param_i++ ) {
+          sum += q[ param_i ] * costs[ param_i ];
+        }
+        if( have_k && ( ( sum + ( bound_scale * entry.m_remainingBounds[ last_pos ] ) ) > threshold ) ) {
+          abandoned = true;
+          break;
+        }
+      }
+      if( abandoned ) {
+        local_stats.m_abandoned += 1;
+        continue;
+      }
+      for( size_t param_i = ( profile_length * AlphabetSize ); param_i < parameter_count; param_i++ ) {
+        sum += q[ param_i ] * costs[ param_i ];
+      }
+      local_stats.m_completed += 1;
+      if( sum > CrossEntropyMatrix<ResidueType>::InfinityThreshold() ) {
+        continue;
+      }
+      const std::pair<double, size_t> neighbor( sum, entry_i );
+      if( !have_k ) {
+        best.push( neighbor );
+      } else if( neighbor < best.top() ) {
+        best.pop();
+        best.push( neighbor );
+      }
+    } // End foreach candidate_i
+
+    neighbors.resize( best.size() );
+    for( size_t neighbor_i = best.size(); neighbor_i-- > 0; ) {
+      neighbors[ neighbor_i ] = best.top();
+      best.pop();
+    }
+    if( stats != NULL ) {
+      *stats = local_stats;
+    }
+  } // nearestEntries( Entry const &, size_t const, vector<pair<double, size_t> > &, QueryStatistics * ) const
+
+  /**
+   * Read a num_bytes little-endian unsigned integer.
+   */
+  static uint64_t
+  readValue (
+    std::istream & is,
+    uint32_t const num_bytes,
+    std::string const & filename
+  )
+  {
+    uint8_t bytes[ 8 ];
+    is.read( reinterpret_cast<char *>( bytes ), num_bytes );
+    if( !is.good() ) {
+      throw std::string( "The profile index file '" ) + filename + "' is truncated.";
+    }
+    return decodeLittleEndian( bytes, num_bytes );
+  } // readValue( istream &, uint32_t const, string const & )
+
+  static uint64_t
+  remainingBytes (
+    std::istream & is,
+    uint64_t const file_size
+  )
+  {
+    return ( file_size - static_cast<uint64_t>( is.tellg() ) );
+  } // remainingBytes( istream &, uint64_t const )
+
+  uint32_t m_kmerLength;
+  uint32_t m_sketchSize;
+  std::vector<Entry> m_entries;
+  std::map<uint32_t, std::vector<size_t> > m_membersOfLength;
+
+}; // End class ProfileIndex
+
+} // End namespace galosh
+
+#endif // __GALOSH_PROFILEINDEX_HPP__
@@ -0,0 +1,227 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      ProfileSampler.hpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      Class definition for the ProfileSampler class, which draws sequences
+##      (and their true paths) from a profile HMM (see ProfileTables.hpp).
+##
+##      The sampler only reads its tables, so one sampler can be shared by any
+##      number of threads, each drawing with its own random stream (eg. a
+##      PhiloxStream per sequence, so that the draws are reproducible
+##      regardless of the number of threads).  The random stream type just
+##      needs a "double nextUniform()" returning values in [ 0, 1 ).
+##
+##      The emission distributions (and the three-way transition out of
+##      Match) are drawn through alias tables (see AliasTable.hpp), built
+##      once, so each draw costs one uniform and one comparison however big
+##      the alphabet is; the other transitions are two-way, so they are just
+##      one comparison anyway.
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#if     _MSC_VER > 1000
+#pragma once
+#endif
+
+#ifndef __GALOSH_PROFILESAMPLER_HPP__
+#define __GALOSH_PROFILESAMPLER_HPP__
+
+#include "ProfileTables.hpp"
+#include "AlignmentPath.hpp"
+#include "AliasTable.hpp"
+
+#include <string>
+#include <vector>
+
+namespace galosh {
+
+template <typename ResidueType>
+class ProfileSampler {
+public:
+  typedef ProfileTables<ResidueType, ResidueType> ProfileTablesType;
+  enum { AlphabetSize = ProfileTablesType::AlphabetSize };
+
+  template <typename ProfileType>
+  ProfileSampler (
+    ProfileType const & profile
+  ) :
+    m_tables( profile )
+  {
+    const uint32_t profile_length = m_tables.m_profileLength;
+    if( profile_length == 0 ) {
+      throw std::string( "Can't draw sequences from a profile of length 0" );
+    }
+    m_matchTables.resize( profile_length );
+    for( uint32_t pos_i = 0; pos_i < profile_length; pos_i++ ) {
+      m_matchTables[ pos_i ].reinitialize( &m_tables.m_matchEmissions[ pos_i * AlphabetSize ], AlphabetSize );
+    }
+    m_insertionTable.reinitialize( &m_tables.m_insertionEmissions[ 0 ], AlphabetSize );
+
+    m_preAlignToPreAlign = probabilityOfFirst( ProfileTransition::PreAlignToPreAlign, ProfileTransition::PreAlignToBegin );
+    m_beginToMatch = probabilityOfFirst( ProfileTransition::BeginToMatch, ProfileTransition::BeginToDeletion );
+    m_postAlignToPostAlign = probabilityOfFirst( ProfileTransition::PostAlignToPostAlign, ProfileTransition::PostAlignToTerminal );
+    m_insertionToMatch = probabilityOfFirst( ProfileTransition::InsertionToMatch, ProfileTransition::InsertionToInsertion );
+    m_deletionToMatch = probabilityOfFirst( ProfileTransition::DeletionToMatch, ProfileTransition::DeletionToDeletion );
+    const double from_match[ 3 ] = {
+      m_tables[ ProfileTransition::MatchToMatch ],
+      m_tables[ ProfileTransition::MatchToInsertion ],
+      m_tables[ ProfileTransition::MatchToDeletion ]
+    };
+    m_fromMatchTable.reinitialize( from_match, 3 );
+  } // <init>( ProfileType const & )
+
+  uint32_t
+  profileLength () const
+  {
+    return m_tables.m_profileLength;
+  } // profileLength() const
+
+  /**
+   * Draw one sequence (as residue ordinal values) and, if path is non-null,
+   * its path through the profile.
+   */
+  template <typename RandomType>
+  void
+  draw (
+    RandomType & random,
+    std::vector<uint8_t> & residues,
+    AlignmentPath * path
+  ) const
+  {
+    const uint32_t profile_length = m_tables.m_profileLength;
+    residues.clear();
+    if( path != 0 ) {
+      path->clear();
+    }
+
+    while( random.nextUniform() < m_preAlignToPreAlign ) {
+      residues.push_back( drawInsertion( random ) );
+      if( path != 0 ) {
+        path->push_back( PathState::PreAlign );
+      }
+    }
+
+    uint8_t state =
+      ( ( random.nextUniform() < m_beginToMatch ) ? PathState::Match : PathState::Deletion );
+    uint32_t pos = 1;
+    while( true ) {
+      if( path != 0 ) {
+        path->push_back( state );
+      }
+      if( state == PathState::Match ) {
+        residues.push_back( drawMatch( random, pos - 1 ) );
+      } else if( state == PathState::Insertion ) {
+        residues.push_back( drawInsertion( random ) );
+      }
+      if( ( state != PathState::Insertion ) && ( pos == profile_length ) ) {
+        break; // To End.
+      }
+      uint8_t next_state;
+      if( state == PathState::Match ) {
+        next_state = m_fromMatchTable.draw( random ) + PathState::Match;
+      } else if( state == PathState::Insertion ) {
+        next_state = ( ( random.nextUniform() < m_insertionToMatch ) ? PathState::Match : PathState::Insertion );
+      } else {
+        next_state = ( ( random.nextUniform() < m_deletionToMatch ) ? PathState::Match : PathState::Deletion );
+      }
+      if( next_state != PathState::Insertion ) {
+        pos += 1;
+      }
+      state = next_state;
+    } // End while in the core of the profile
+
+    while( random.nextUniform() < m_postAlignToPostAlign ) {
+      residues.push_back( drawInsertion( random ) );
+      if( path != 0 ) {
+        path->push_back( PathState::PostAlign );
+      }
+    }
+  } // draw( RandomType &, vector<uint8_t> &, AlignmentPath * ) const
+
+protected:
+  ProfileTablesType m_tables;
+
+  /// Match emission alias tables, one per position.
+  std::vector<AliasTable> m_matchTables;
+  AliasTable m_insertionTable;
+  /// To Match, Insertion, Deletion (PathState order).
+  AliasTable m_fromMatchTable;
+
+  double m_preAlignToPreAlign;
+  double m_beginToMatch;
+  double m_postAlignToPostAlign;
+  double m_insertionToMatch;
+  double m_deletionToMatch;
+
+  template <typename RandomType>
+  inline uint8_t
+  drawMatch (
+    RandomType & random,
+    uint32_t const pos_i
+  ) const
+  {
+    return m_matchTables[ pos_i ].draw( random );
+  } // drawMatch( RandomType &, uint32_t const ) const
+
+  template <typename RandomType>
+  inline uint8_t
+  drawInsertion (
+    RandomType & random
+  ) const
+  {
+    return m_insertionTable.draw( random );
+  } // drawInsertion( RandomType & ) const
+
+  /**
+   * The probability of the first of two transitions, normalized.  It is
+   * exactly 1 when the second has probability 0, so rounding can never
+   * select it.
+   */
+  double
+  probabilityOfFirst (
+    ProfileTransition::Index const first,
+    ProfileTransition::Index const second
+  ) const
+  {
+    const double first_value = m_tables[ first ];
+    const double second_value = m_tables[ second ];
+    if( !( ( first_value + second_value ) > 0 ) ) {
+      throw std::string( "Can't draw from a distribution with no mass" );
+    }
+    if( !( second_value > 0 ) ) {
+      return 1.0;
+    }
+    return ( first_value / ( first_value + second_value ) );
+  } // probabilityOfFirst( ProfileTransition::Index const, ProfileTransition::Index const ) const
+
+}; // End class ProfileSampler
+
+} // End namespace galosh
+
+#endif // __GALOSH_PROFILESAMPLER_HPP__
@@ -0,0 +1,309 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      ProfileTables.hpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      Class definition for the ProfileTables class, which copies the
+##      parameters of a galosh Profile into flat arrays of doubles (indexed by
+##      position and residue ordinal value), for use by the dynamic
+##      programming and sampling routines in profuse that want tight inner
+##      loops rather than the Profile's accessors.
+##
+##      The model is the usual non-DEL_IN_DEL_OUT profile HMM: PreAlign ->
+##      Begin -> (Match | Deletion)_1 .. (Match | Deletion)_M -> End ->
+##      PostAlign -> Terminal, with Insertion states between consecutive
+##      positions.  Insertions, PreAlign and PostAlign all emit from the
+##      profile's (global) Insertion distribution.
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#if     _MSC_VER > 1000
+#pragma once
+#endif
+
+#ifndef __GALOSH_PROFILETABLES_HPP__
+#define __GALOSH_PROFILETABLES_HPP__
+
+#include <Algebra.hpp>
+
+#include "Profile.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include <seqan/basic.h>
+
+namespace galosh {
+
+  /**
+   * Indices into the flat transition arrays of ProfileTables and
+   * ExpectedCounts.
+   */
+  namespace ProfileTransition {
+    enum Index {
+      PreAlignToPreAlign,
+      PreAlignToBegin,
+      BeginToMatch,
+      BeginToDeletion,
+      MatchToMatch,
+      MatchToInsertion,
+      MatchToDeletion,
+      InsertionToMatch,
+      InsertionToInsertion,
+      DeletionToMatch,
+      DeletionToDeletion,
+      PostAlignToPostAlign,
+      PostAlignToTerminal,
+      Count
+    };
+  } // End namespace ProfileTransition
+
+/**
+ * \class ProfileTables
+ * \brief the parameters of a Profile, as flat arrays of doubles.
+ *
+ * EmissionResidueType is the alphabet by which the emission tables are
+ * indexed: the SequenceResidueType (eg. Iupac) for scoring sequences, or the
+ * profile's own ResidueType for drawing from it.  The tables hold
+ * probabilities, or their logs after convertToLogs().
+ */
+template <typename ResidueType,
+          typename EmissionResidueType>
+class ProfileTables {
+public:
+  enum { AlphabetSize = seqan::ValueSize<EmissionResidueType>::VALUE };
+
+  /// Number of profile positions (M).
+  uint32_t m_profileLength;
+
+  /// Match emissions for profile position pos_i (0-based), at
+  /// [ ( pos_i * AlphabetSize ) + ordValue( residue ) ].
+  std::vector<double> m_matchEmissions;
+
+  /// The same match emissions by residue, at
+  /// [ ( ordValue( residue ) * m_profileLength ) + pos_i ], so that the
+  /// emissions of one residue at every position are contiguous (for the
+  /// RowKernels).
+  std::vector<double> m_matchEmissionsByResidue;
+
+  /// Insertion (and PreAlign, PostAlign) emissions, at [ ordValue( residue ) ].
+  std::vector<double> m_insertionEmissions;
+
+  /// Transitions, indexed by ProfileTransition::Index.
+  double m_transitions[ ProfileTransition::Count ];
+
+  /// True after convertToLogs().
+  bool m_isLog;
+
+  ProfileTables () :
+    m_profileLength( 0 ),
+    m_matchEmissions(),
+    m_matchEmissionsByResidue(),
+    m_insertionEmissions(),
+    m_isLog( false )
+  {
+    std::fill( m_transitions, m_transitions + ProfileTransition::Count, 0.0 );
+  } // <init>()
+
+  template <typename ProfileType>
+  ProfileTables (
+    ProfileType const & profile
+  ) :
+    m_profileLength( 0 ),
+    m_matchEmissions(),
+    m_matchEmissionsByResidue(),
+    m_insertionEmissions(),
+    m_isLog( false )
+  {
+    fromProfile( profile );
+  } // <init>( ProfileType const & )
+
+  /**
+   * Copy the parameters of the given profile.
+   */
+  template <typename ProfileType>
+  void
+  fromProfile (
+    ProfileType const & profile
+  )
+  {
+    m_profileLength = profile.length();
+    m_isLog = false;
+    m_matchEmissions.resize( m_profileLength * AlphabetSize );
+    m_matchEmissionsByResidue.resize( m_profileLength * AlphabetSize );
+    m_insertionEmissions.resize( AlphabetSize );
+    for( uint32_t res_i = 0; res_i < AlphabetSize; res_i++ ) {
+      const EmissionResidueType residue( res_i );
+      for( uint32_t pos_i = 0; pos_i < m_profileLength; pos_i++ ) {
+        m_matchEmissions[ ( pos_i * AlphabetSize ) + res_i ] =
+          toDouble( profile[ pos_i ][ Emission::Match ][ residue ] );
+        m_matchEmissionsByResidue[ ( res_i * m_profileLength ) + pos_i ] =
+          m_matchEmissions[ ( pos_i * AlphabetSize ) + res_i ];
+      }
+      m_insertionEmissions[ res_i ] =
+        toDouble( profile[ Emission::Insertion ][ residue ] );
+    } // End foreach res_i
+
+    m_transitions[ ProfileTransition::PreAlignToPreAlign ] =
+      toDouble( profile[ Transition::fromPreAlign ][ TransitionFromPreAlign::toPreAlign ] );
+    m_transitions[ ProfileTransition::PreAlignToBegin ] =
+      toDouble( profile[ Transition::fromPreAlign ][ TransitionFromPreAlign::toBegin ] );
+    m_transitions[ ProfileTransition::BeginToMatch ] =
+      toDouble( profile[ Transition::fromBegin ][ TransitionFromBegin::toMatch ] );
+    m_transitions[ ProfileTransition::BeginToDeletion ] =
+      toDouble( profile[ Transition::fromBegin ][ TransitionFromBegin::toDeletion ] );
+    m_transitions[ ProfileTransition::MatchToMatch ] =
+      toDouble( profile[ Transition::fromMatch ][ TransitionFromMatch::toMatch ] );
+    m_transitions[ ProfileTransition::MatchToInsertion ] =
+      toDouble( profile[ Transition::fromMatch ][ TransitionFromMatch::toInsertion ] );
+    m_transitions[ ProfileTransition::MatchToDeletion ] =
+      toDouble( profile[ Transition::fromMatch ][ TransitionFromMatch::toDeletion ] );
+    m_transitions[ ProfileTransition::InsertionToMatch ] =
+      toDouble( profile[ Transition::fromInsertion ][ TransitionFromInsertion::toMatch ] );
+    m_transitions[ ProfileTransition::InsertionToInsertion ] =
+      toDouble( profile[ Transition::fromInsertion ][ TransitionFromInsertion::toInsertion ] );
+    m_transitions[ ProfileTransition::DeletionToMatch ] =
+      toDouble( profile[ Transition::fromDeletion ][ TransitionFromDeletion::toMatch ] );
+    m_transitions[ ProfileTransition::DeletionToDeletion ] =
+      toDouble( profile[ Transition::fromDeletion ][ TransitionFromDeletion::toDeletion ] );
+    m_transitions[ ProfileTransition::PostAlignToPostAlign ] =
+      toDouble( profile[ Transition::fromPostAlign ][ TransitionFromPostAlign::toPostAlign ] );
+    m_transitions[ ProfileTransition::PostAlignToTerminal ] =
+      toDouble( profile[ Transition::fromPostAlign ][ TransitionFromPostAlign::toTerminal ] );
+  } // fromProfile( ProfileType const & )
+
+  /**
+   * Replace every value by its natural log (0 becomes -infinity).
+   */
+  void
+  convertToLogs ()
+  {
+    if( m_isLog ) {
+      return;
+    }
+    for( size_t i = 0; i < m_matchEmissions.size(); i++ ) {
+      m_matchEmissions[ i ] = safeLog( m_matchEmissions[ i ] );
+      m_matchEmissionsByResidue[ i ] = safeLog( m_matchEmissionsByResidue[ i ] );
+    }
+    for( size_t i = 0; i < m_insertionEmissions.size(); i++ ) {
+      m_insertionEmissions[ i ] = safeLog( m_insertionEmissions[ i ] );
+    }
+    for( uint32_t i = 0; i < ProfileTransition::Count; i++ ) {
+      m_transitions[ i ] = safeLog( m_transitions[ i ] );
+    }
+    m_isLog = true;
+  } // convertToLogs()
+
+  /**
+   * All of the values, as one vector: the match emissions (in table order),
+   * then the insertion emissions, then the transitions.
+   */
+  void
+  toParameters (
+    std::vector<double> & parameters
+  ) const
+  {
+    parameters = m_matchEmissions;
+    parameters.insert( parameters.end(), m_insertionEmissions.begin(), m_insertionEmissions.end() );
+    parameters.insert( parameters.end(), m_transitions, m_transitions + ProfileTransition::Count );
+  } // toParameters( vector<double> & ) const
+
+  /**
+   * The match emission value of the given (0-based) profile position and
+   * residue ordinal value.
+   */
+  inline double
+  matchEmission (
+    uint32_t const pos_i,
+    uint32_t const res_i
+  ) const
+  {
+    return m_matchEmissions[ ( pos_i * AlphabetSize ) + res_i ];
+  } // matchEmission( uint32_t const, uint32_t const ) const
+
+  /**
+   * The match emission values of the given residue ordinal value, at every
+   * profile position (0-based).
+   */
+  inline double const *
+  matchEmissions (
+    uint32_t const res_i
+  ) const
+  {
+    return &m_matchEmissionsByResidue[ 0 ] + ( res_i * m_profileLength );
+  } // matchEmissions( uint32_t const ) const
+
+  inline double
+  insertionEmission (
+    uint32_t const res_i
+  ) const
+  {
+    return m_insertionEmissions[ res_i ];
+  } // insertionEmission( uint32_t const ) const
+
+  inline double
+  operator[] (
+    ProfileTransition::Index const transition
+  ) const
+  {
+    return m_transitions[ transition ];
+  } // operator[]( ProfileTransition::Index const ) const
+
+  static inline double
+  safeLog (
+    double const value
+  )
+  {
+    return ( ( value > 0 ) ? std::log( value ) : -std::numeric_limits<double>::infinity() );
+  } // safeLog( double const )
+
+}; // End class ProfileTables
+
+  /**
+   * Convert the given sequence into residue ordinal values, for indexing into
+   * ProfileTables.
+   */
+  template <typename SequenceType>
+  inline void
+  sequenceToOrdinals (
+    SequenceType const & sequence,
+    std::vector<uint32_t> & ordinals
+  )
+  {
+    const uint32_t sequence_length = seqan::length( sequence );
+    ordinals.resize( sequence_length );
+    for( uint32_t i = 0; i < sequence_length; i++ ) {
+      ordinals[ i ] = seqan::ordValue( sequence[ i ] );
+    }
+  } // sequenceToOrdinals( SequenceType const &, vector<uint32_t> & )
+
+} // End namespace galosh
+
+#endif // __GALOSH_PROFILETABLES_HPP__
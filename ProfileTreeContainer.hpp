@@ -0,0 +1,205 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      ProfileTreeContainer.hpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      Functions for storing the nodes of a ProfileTree in a record container
+##      (see RecordContainer.hpp) of kind "ProfileTree", one record per node
+##      (numbered by node index), each holding the node's profile as a boost
+##      binary archive; and the LazyProfileTree class, which opens such a
+##      container reading only its index, and seeks to and decodes just the
+##      nodes that are asked for.
+##
+##      Unlike a whole-tree XML (or binary) archive, nothing is deserialized
+##      up front, so getting a few nodes of a large tree is fast and needs
+##      memory only for those nodes.
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#if     _MSC_VER > 1000
+#pragma once
+#endif
+
+#ifndef __GALOSH_PROFILETREECONTAINER_HPP__
+#define __GALOSH_PROFILETREECONTAINER_HPP__
+
+#include "RecordContainer.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/lexical_cast.hpp>
+
+namespace galosh {
+
+  static const char * const PROFILE_TREE_CONTAINER_KIND = "ProfileTree";
+
+  /**
+   * Encode the given node profile (as a boost binary archive), for
+   * ProfileTreeContainerWriter::add(..).
+   */
+  template <typename NodeType>
+  inline void
+  encodeProfileTreeNode (
+    NodeType const & node,
+    std::string & bytes
+  )
+  {
+    std::ostringstream os( std::ios::out | std::ios::binary );
+    {
+      boost::archive::binary_oarchive oa( os );
+      oa << node;
+    } // The archive is completed when it is destroyed.
+    bytes = os.str();
+  } // encodeProfileTreeNode( NodeType const &, string & )
+
+  template <typename NodeType>
+  inline void
+  decodeProfileTreeNode (
+    std::string const & bytes,
+    NodeType & node
+  )
+  {
+    std::istringstream is( bytes, std::ios::in | std::ios::binary );
+    boost::archive::binary_iarchive ia( is );
+    ia >> node;
+  } // decodeProfileTreeNode( string const &, NodeType & )
+
+  /**
+   * True iff the given file is a record container (of any kind).
+   */
+  inline bool
+  isRecordContainer (
+    std::string const & filename
+  )
+  {
+    std::ifstream is( filename.c_str(), std::ios::in | std::ios::binary );
+    char magic[ sizeof( RECORD_CONTAINER_MAGIC ) ];
+    is.read( magic, sizeof( magic ) );
+    return ( is && std::equal( magic, magic + sizeof( magic ), RECORD_CONTAINER_MAGIC ) );
+  } // isRecordContainer( string const & )
+
+/**
+ * \class ProfileTreeContainerWriter
+ * \brief Writes ProfileTree nodes (already encoded, in node order) to a
+ * container.
+ */
+class ProfileTreeContainerWriter {
+public:
+  ProfileTreeContainerWriter (
+    std::string const & filename
+  ) :
+    m_writer( filename, PROFILE_TREE_CONTAINER_KIND )
+  {
+    // Do nothing else.
+  } // <init>( string const & )
+
+  void
+  add (
+    uint32_t const node_i,
+    std::string const & encoded_node
+  )
+  {
+    m_writer.add( boost::lexical_cast<std::string>( node_i ), node_i, encoded_node );
+  } // add( uint32_t const, string const & )
+
+  void
+  close ()
+  {
+    m_writer.close();
+  } // close()
+
+protected:
+  RecordContainerWriter m_writer;
+
+}; // End class ProfileTreeContainerWriter
+
+/**
+ * \class LazyProfileTree
+ * \brief Reads the nodes of a ProfileTree container on demand.
+ *
+ * Not safe to use from several threads at once; read the bytes of the
+ * needed nodes first (readNodeBytes(..)), then decode them in parallel
+ * (decodeProfileTreeNode(..)).
+ */
+class LazyProfileTree {
+public:
+  LazyProfileTree (
+    std::string const & filename
+  ) :
+    m_reader( filename )
+  {
+    if( m_reader.kind() != PROFILE_TREE_CONTAINER_KIND ) {
+      throw std::string( "The record container file " ) + filename + " holds " + m_reader.kind() + " records, not ProfileTree nodes";
+    }
+  } // <init>( string const & )
+
+  uint32_t
+  nodeCount () const
+  {
+    return static_cast<uint32_t>( m_reader.size() );
+  } // nodeCount() const
+
+  void
+  readNodeBytes (
+    uint32_t const node_i,
+    std::string & bytes
+  )
+  {
+    const uint64_t entry_i = m_reader.findNumber( node_i );
+    if( entry_i == m_reader.size() ) {
+      throw std::string( "There is no node " ) + boost::lexical_cast<std::string>( node_i ) + " in the ProfileTree container";
+    }
+    m_reader.read( entry_i, bytes );
+  } // readNodeBytes( uint32_t const, string & )
+
+  template <typename NodeType>
+  void
+  readNode (
+    uint32_t const node_i,
+    NodeType & node
+  )
+  {
+    readNodeBytes( node_i, m_bytes );
+    decodeProfileTreeNode( m_bytes, node );
+  } // readNode( uint32_t const, NodeType & )
+
+protected:
+  RecordContainerReader m_reader;
+  std::string m_bytes; // Scratch space.
+
+}; // End class LazyProfileTree
+
+} // End namespace galosh
+
+#endif // __GALOSH_PROFILETREECONTAINER_HPP__
@@ -8,7 +8,11 @@
 ##  Description:
 ##      The profileTreeToProfile program.  It reads a ProfileTree from an .xml
 ##      file and converts _the root only_ to a Profile HMM (and saves it in a
-##      profile file).
+##      profile file).  It can also extract any or all of the other nodes
+##      (converting them in parallel), read and write the tree as a (much
+##      faster) boost binary archive, and write the nodes to a ProfileTree
+##      container (see ProfileTreeContainer.hpp), from which later runs
+##      decode only the nodes they are asked for.
 ##
 #******************************************************************************
 #*
@@ -37,8 +41,16 @@
 
 #include "Algebra.hpp"
 #include "ProfileTree.hpp"
+#include "ProfileTreeContainer.hpp"
+#include "IndividualFilenames.hpp"
+#include "ParallelFor.hpp"
 
+#include <algorithm>
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include <boost/serialization/nvp.hpp>
 #include <boost/serialization/utility.hpp>
@@ -47,10 +59,17 @@
 
 #include <boost/archive/xml_iarchive.hpp>
 #include <boost/archive/xml_oarchive.hpp>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
 
 #include "boost/filesystem.hpp"
 namespace fs = boost::filesystem;
 
+#include <boost/scoped_ptr.hpp>
+
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+
 #include <seqan/basic.h>
 
 #ifdef __HAVE_MUSCLE
@@ -71,15 +90,107 @@ namespace galosh {
     {
       // open the archive
       std::ifstream ifs( filename );
-      assert( ifs.good() );
+      if( !ifs.good() ) {
+        throw std::string( "The file '" ) + filename + "' could not be opened.";
+      }
       boost::archive::xml_iarchive ia( ifs );
     
       // restore the profile from the archive
       ia & BOOST_SERIALIZATION_NVP( profuse_object );
     } // readXML( Serializable &, const char * )
 
+    template <class Serializable>
+    static void
+    readBinary (
+      Serializable & profuse_object,
+      const char * filename
+    )
+    {
+      std::ifstream ifs( filename, std::ios::in | std::ios::binary );
+      if( !ifs.good() ) {
+        throw std::string( "The file '" ) + filename + "' could not be opened.";
+      }
+      boost::archive::binary_iarchive ia( ifs );
+      ia & profuse_object;
+    } // readBinary( Serializable &, const char * )
+
+    template <class Serializable>
+    static void
+    writeBinary (
+      Serializable const & profuse_object,
+      const char * filename
+    )
+    {
+      std::ofstream ofs( filename, std::ios::out | std::ios::binary );
+      if( !ofs.good() ) {
+        throw std::string( "The file '" ) + filename + "' could not be opened for writing.";
+      }
+      boost::archive::binary_oarchive oa( ofs );
+      oa & profuse_object;
+    } // writeBinary( Serializable const &, const char * )
+
 } // End namespace galosh
 
+/**
+ * The parallelFor body: gets node number nodes[ first_node + batch_i ] (from
+ * the tree, or by decoding encoded_nodes[ batch_i ] if there is no tree) and
+ * puts its profile text (as it would be written to a profile file), or its
+ * encoding (for a ProfileTree container), into slot batch_i.
+ */
+template <typename ProfileTreeType, typename NodeType>
+class NodeBody {
+public:
+  NodeBody (
+    ProfileTreeType * profile_tree_ptr,
+    std::vector<std::string> const & encoded_nodes,
+    std::vector<uint32_t> const & nodes,
+    size_t const first_node,
+    bool const encode,
+    std::vector<std::string> & outputs
+  ) :
+    m_profileTreePtr( profile_tree_ptr ),
+    m_encodedNodes( encoded_nodes ),
+    m_nodes( nodes ),
+    m_firstNode( first_node ),
+    m_encode( encode ),
+    m_outputs( outputs )
+  {
+    // Do nothing else.
+  } // <init>( .. )
+
+  void
+  operator() (
+    size_t const batch_i,
+    uint32_t const thread_i
+  )
+  {
+    NodeType const * node_ptr = &m_node;
+    if( m_profileTreePtr == NULL ) {
+      decodeProfileTreeNode( m_encodedNodes[ batch_i ], m_node );
+    } else {
+      const uint32_t node_i = m_nodes[ m_firstNode + batch_i ];
+      node_ptr =
+        ( ( node_i == 0 ) ? m_profileTreePtr->getProfileTreeRoot() : m_profileTreePtr->getProfileTreeInternalNode( node_i ) );
+    }
+    if( m_encode ) {
+      encodeProfileTreeNode( *node_ptr, m_outputs[ batch_i ] );
+    } else {
+      std::ostringstream profile_stream;
+      profile_stream << *node_ptr;
+      m_outputs[ batch_i ] = profile_stream.str();
+    }
+  } // operator()( size_t const, uint32_t const )
+
+protected:
+  ProfileTreeType * m_profileTreePtr;
+  std::vector<std::string> const & m_encodedNodes;
+  std::vector<uint32_t> const & m_nodes;
+  size_t m_firstNode;
+  bool m_encode;
+  std::vector<std::string> & m_outputs;
+  NodeType m_node; // Per-thread, reused across nodes.
+}; // End class NodeBody<ProfileTreeType, NodeType>
+
 int
 main ( int const argc, char const ** argv )
 {
@@ -93,47 +204,204 @@ main ( int const argc, char const ** argv )
   typedef ProfileTreeRoot<ResidueType, ProbabilityType> InternalNodeType;
   typedef ProfileTree<ResidueType, ProbabilityType, InternalNodeType > ProfileTreeType;
 
-  if( argc < 2 ) {
-    cout << "Usage: " << argv[ 0 ] << " <input ProfileTree.xml filename> [<output (galosh Profile) filename> ]" << endl;
-    exit( 1 );
-  }
-  const bool be_verbose = true; //( argc >= 2 );
-  if( be_verbose ) {
-    cout << "Reading ProfileTree.xml from file '" << argv[ 1 ] << "'" << endl;
-  }
-  ProfileTreeType profile_tree;
-  readXML( profile_tree, argv[ 1 ] );
-  if( profile_tree.getProfileTreeRoot()->length() == 0 ) {
-    cout << "No profiles were found in the ProfileTree.xml file '" << argv[ 1 ] << "'" << endl;
-    return 1;
-  } else if( profile_tree.nodeCount() > 1 ) {
-    if( be_verbose ) {
-      cout << "WARNING: Using only the root profile in the given ProfileTree.xml file." << endl;
+  try {
+    po::options_description visible( "Basic options" );
+    visible.add_options()
+      ( "help,h", "produce help message" )
+      ( "input,i",
+        po::value<string>(),
+        "filename: the ProfileTree (an .xml archive, a binary archive, or a ProfileTree container)" )
+      ( "output,o",
+        po::value<string>(),
+        "filename: where to write the (galosh Profile) profile (default: standard output); with more than one node, the prefix of the individual profile filenames" )
+      ( "binary-input,b",
+        "the input is a boost binary archive (as written by --save-binary), not XML" )
+      ( "save-binary",
+        po::value<string>(),
+        "filename: also save the whole tree as a boost binary archive, which reads much faster than XML" )
+      ( "node,n",
+        po::value<std::vector<uint32_t> >(),
+        "the index of a node to extract (may be given more than once; default: the root, 0)" )
+      ( "all,a",
+        "extract every node" )
+      ( "individual-filename-suffix-pattern,s",
+        po::value<string>()->default_value( "_$d.prof" ),
+        "with more than one node, pattern for filenames by which to differentiate the output profiles, in which $d (and $n) will be replaced by the node index" )
+      ( "container,C",
+        po::value<string>(),
+        "filename: write the nodes (with --all or --node; default: all of them) to this ProfileTree container instead of to profile files" )
+      ( "threads,t",
+        po::value<uint32_t>()->default_value( 0 ),
+        "number of threads for converting nodes (0, the default, means one per core)" )
+      ( "batch-size",
+        po::value<uint32_t>()->default_value( 256 ),
+        "number of nodes to convert (in parallel) before writing them out" )
+      ;
+
+    po::positional_options_description p;
+    p.add( "input", 1 );
+    p.add( "output", 1 );
+
+    po::variables_map vm;
+    store( po::command_line_parser( argc, argv ).options( visible ).positional( p ).run(), vm );
+    notify( vm );
+
+#define USAGE() " " << argv[ 0 ] << " [options] <input ProfileTree.xml filename> [<output (galosh Profile) filename> ]"
+
+    if( vm.count( "help" ) > 0 ) {
+      cout << "Usage: " << USAGE() << endl;
+      cout << visible << "\n";
+      return 0;
     }
-  }
-  //if( be_verbose ) {
-  //  cout << "\tgot:" << std::endl;
-  //  cout << *( profile_tree.getProfileTreeRoot() );
-  //  cout << endl;
-  //}
-
-  if( argc >= 3 ) {
-    if( be_verbose ) {
-      cout << "Writing Profile to file '" << argv[ 2 ] << "'" << endl;
+    if( vm.count( "input" ) == 0 ) {
+      cout << "Usage: " << USAGE() << endl;
+      exit( 1 );
+    }
+
+    const string input_filename = vm[ "input" ].as<string>();
+    const bool use_container = ( vm.count( "container" ) > 0 );
+    const bool all_nodes = ( ( vm.count( "all" ) > 0 ) || ( use_container && ( vm.count( "node" ) == 0 ) ) );
+    const bool root_only = ( !all_nodes && !use_container && ( vm.count( "node" ) == 0 ) );
+    const bool be_verbose = root_only;
+
+    // A ProfileTree container is read lazily: only the requested nodes are
+    // ever decoded.  Archives have to be read whole.
+    ProfileTreeType profile_tree;
+    ProfileTreeType * profile_tree_ptr = NULL;
+    boost::scoped_ptr<LazyProfileTree> lazy_tree_ptr;
+    uint32_t node_count;
+    if( isRecordContainer( input_filename ) ) {
+      lazy_tree_ptr.reset( new LazyProfileTree( input_filename ) );
+      node_count = lazy_tree_ptr->nodeCount();
+      if( vm.count( "save-binary" ) > 0 ) {
+        cerr << "The --save-binary option needs a whole-tree (XML or binary archive) input." << endl;
+        exit( 1 );
+      }
+    } else {
+      if( be_verbose ) {
+        cout << "Reading ProfileTree" << ( ( vm.count( "binary-input" ) > 0 ) ? "" : ".xml" ) << " from file '" << input_filename << "'" << endl;
+      }
+      if( vm.count( "binary-input" ) > 0 ) {
+        readBinary( profile_tree, input_filename.c_str() );
+      } else {
+        readXML( profile_tree, input_filename.c_str() );
+      }
+      profile_tree_ptr = &profile_tree;
+      node_count = profile_tree.nodeCount();
+      if( profile_tree.getProfileTreeRoot()->length() == 0 ) {
+        cout << "No profiles were found in the ProfileTree.xml file '" << input_filename << "'" << endl;
+        return 1;
+      } else if( root_only && ( node_count > 1 ) ) {
+        if( be_verbose ) {
+          cout << "WARNING: Using only the root profile in the given ProfileTree.xml file (use --all or --node for the others)." << endl;
+        }
+      }
+      if( vm.count( "save-binary" ) > 0 ) {
+        writeBinary( profile_tree, vm[ "save-binary" ].as<string>().c_str() );
+      }
+    }
+
+    std::vector<uint32_t> nodes;
+    if( all_nodes ) {
+      for( uint32_t node_i = 0; node_i < node_count; node_i++ ) {
+        nodes.push_back( node_i );
+      }
+    } else if( vm.count( "node" ) > 0 ) {
+      nodes = vm[ "node" ].as<std::vector<uint32_t> >();
+    } else {
+      nodes.push_back( 0 );
     }
-    std::ofstream profile_stream( argv[ 2 ] );
-    assert( profile_stream.good() );
-    profile_stream << *( profile_tree.getProfileTreeRoot() );
-    profile_stream.close();
-    if( be_verbose ) {
-      cout << "\tdone." << endl;
+    for( size_t nodes_i = 0; nodes_i < nodes.size(); nodes_i++ ) {
+      if( nodes[ nodes_i ] >= node_count ) {
+        cerr << "There is no node " << nodes[ nodes_i ] << "; the tree has " << node_count << " nodes." << endl;
+        exit( 1 );
+      }
+    }
+
+    /// Convert the nodes a batch at a time, writing each batch out in node
+    /// order (so the output doesn't depend on the number of threads).
+    const uint32_t thread_count = vm[ "threads" ].as<uint32_t>();
+    const uint32_t batch_size = std::max( static_cast<uint32_t>( 1 ), vm[ "batch-size" ].as<uint32_t>() );
+    const string output_filename_prefix = ( vm.count( "output" ) ? vm[ "output" ].as<string>() : string( "" ) );
+    const string individual_filename_suffix_pattern = vm[ "individual-filename-suffix-pattern" ].as<string>();
+    const bool use_stdout = ( !use_container && ( vm.count( "output" ) == 0 ) );
+
+    boost::scoped_ptr<ProfileTreeContainerWriter> container_ptr;
+    if( use_container ) {
+      container_ptr.reset( new ProfileTreeContainerWriter( vm[ "container" ].as<string>() ) );
     }
-  } else {
-    if( be_verbose ) {
-      cout << "Profile is:" << endl;
+
+    std::vector<string> encoded_nodes;
+    std::vector<string> outputs( std::min( static_cast<size_t>( batch_size ), nodes.size() ) );
+    for( size_t first_node = 0; first_node < nodes.size(); first_node += batch_size ) {
+      const size_t batch_nodes = std::min( static_cast<size_t>( batch_size ), ( nodes.size() - first_node ) );
+      if( lazy_tree_ptr ) {
+        encoded_nodes.resize( batch_nodes );
+        for( size_t batch_i = 0; batch_i < batch_nodes; batch_i++ ) {
+          lazy_tree_ptr->readNodeBytes( nodes[ first_node + batch_i ], encoded_nodes[ batch_i ] );
+        }
+      }
+      galosh::parallelFor(
+        batch_nodes,
+        thread_count,
+        NodeBody<ProfileTreeType, InternalNodeType>( profile_tree_ptr, encoded_nodes, nodes, first_node, use_container, outputs )
+      );
+      for( size_t batch_i = 0; batch_i < batch_nodes; batch_i++ ) {
+        const uint32_t node_i = nodes[ first_node + batch_i ];
+        if( use_container ) {
+          container_ptr->add( node_i, outputs[ batch_i ] );
+        } else if( root_only ) {
+          if( use_stdout ) {
+            if( be_verbose ) {
+              cout << "Profile is:" << endl;
+            }
+            cout << outputs[ batch_i ];
+            cout << endl;
+          } else {
+            if( be_verbose ) {
+              cout << "Writing Profile to file '" << output_filename_prefix << "'" << endl;
+            }
+            std::ofstream profile_stream( output_filename_prefix.c_str() );
+            if( !profile_stream.good() ) {
+              cerr << "The profile output file '" << output_filename_prefix << "' could not be opened." << endl;
+              exit( 1 );
+            }
+            profile_stream << outputs[ batch_i ];
+            profile_stream.close();
+            if( be_verbose ) {
+              cout << "\tdone." << endl;
+            }
+          }
+        } else if( use_stdout ) {
+          cout << "#" << node_i << endl;
+          cout << outputs[ batch_i ];
+        } else {
+          const string profile_filename =
+            galosh::individual_filename( output_filename_prefix, individual_filename_suffix_pattern, "", node_i );
+          std::ofstream profile_stream( profile_filename.c_str() );
+          if( !profile_stream.good() ) {
+            cerr << "The profile output file '" << profile_filename << "' could not be opened." << endl;
+            exit( 1 );
+          }
+          profile_stream << outputs[ batch_i ];
+          profile_stream.close();
+          // We print out the output files as a side effect
+          cout << profile_filename << endl;
+        }
+      }
+    } // End foreach batch
+
+    if( use_container ) {
+      container_ptr->close();
+      // We print out the output file as a side effect
+      cout << vm[ "container" ].as<string>() << endl;
     }
-    cout << *( profile_tree.getProfileTreeRoot() );
-    cout << endl;
+  } catch( std::exception& e ) { /// exceptions thrown by boost stuff
+    cerr << "error: " << e.what() << endl;
+    return 1;
+  } catch( string &err ) {      /// exceptions thrown by LazyProfileTree, parallelFor, etc.
+    cerr << "error: " << err << endl;
+    return 1;
   }
 
   exit( 0 );
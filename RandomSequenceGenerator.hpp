@@ -0,0 +1,324 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      RandomSequenceGenerator.hpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      Class definition for the RandomSequenceGenerator class, which draws
+##      i.i.d. residues from a discrete distribution over any residue type, in
+##      bulk, for many sequences or for chromosome-scale ones.
+##
+##      Each sequence is cut into fixed-length chunks, and each chunk is drawn
+##      with its own Philox stream (indexed by its number among all of the
+##      chunks of all of the sequences), so chunks can be drawn by any number
+##      of threads, in any order, with the same result.  A chunk is drawn in
+##      two simple loops that the compiler can vectorize: one fills a buffer
+##      with Philox output (the counters are independent), and one maps each
+##      32 random bits to a residue through an alias table
+##      (AliasTable::drawFromBits(..), an integer multiply and one threshold
+##      comparison).
+##
+##      There are also helpers for writing the residues, as Fasta text or
+##      packed two bits per residue in the UCSC ".2bit" format.
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#if     _MSC_VER > 1000
+#pragma once
+#endif
+
+#ifndef __GALOSH_RANDOMSEQUENCEGENERATOR_HPP__
+#define __GALOSH_RANDOMSEQUENCEGENERATOR_HPP__
+
+#include "AliasTable.hpp"
+#include "LittleEndian.hpp"
+#include "Philox.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+#include <seqan/basic.h>
+
+namespace galosh {
+
+template <typename ResidueType>
+class RandomSequenceGenerator {
+public:
+  enum { AlphabetSize = seqan::ValueSize<ResidueType>::VALUE };
+
+  /// The default chunk length, in residues (a multiple of 4, for packing).
+  enum { DefaultChunkLength = ( 1 << 20 ) };
+
+  /**
+   * residue_weights holds AlphabetSize nonnegative weights (not necessarily
+   * normalized), in residue ordinal order.  chunk_length must be a positive
+   * multiple of 4.
+   */
+  RandomSequenceGenerator (
+    std::vector<double> const & residue_weights,
+    uint64_t const random_seed,
+    uint64_t const sequence_length,
+    uint32_t const chunk_length = DefaultChunkLength
+  ) :
+    m_randomSeed( random_seed ),
+    m_sequenceLength( sequence_length ),
+    m_chunkLength( chunk_length )
+  {
+    if( residue_weights.size() != AlphabetSize ) {
+      throw std::string( "The residue distribution must have one weight per residue" );
+    }
+    if( ( m_chunkLength == 0 ) || ( ( m_chunkLength % 4 ) != 0 ) ) {
+      throw std::string( "The chunk length must be a positive multiple of 4" );
+    }
+    m_residueTable.reinitialize( &residue_weights[ 0 ], AlphabetSize );
+    m_chunksPerSequence = ( ( m_sequenceLength + m_chunkLength - 1 ) / m_chunkLength );
+  } // <init>( vector<double> const &, uint64_t const, uint64_t const, uint32_t const )
+
+  uint64_t
+  sequenceLength () const
+  {
+    return m_sequenceLength;
+  } // sequenceLength() const
+
+  uint32_t
+  chunkLength () const
+  {
+    return m_chunkLength;
+  } // chunkLength() const
+
+  uint64_t
+  chunksPerSequence () const
+  {
+    return m_chunksPerSequence;
+  } // chunksPerSequence() const
+
+  /**
+   * The number of residues in chunk chunk_i of each sequence.
+   */
+  uint32_t
+  chunkSize (
+    uint64_t const chunk_i
+  ) const
+  {
+    return static_cast<uint32_t>( std::min( static_cast<uint64_t>( m_chunkLength ), ( m_sequenceLength - ( chunk_i * m_chunkLength ) ) ) );
+  } // chunkSize( uint64_t const ) const
+
+  /**
+   * Draw the residues (as ordinal values) of chunk chunk_i of sequence
+   * seq_i.  random_bits is scratch space.
+   */
+  void
+  generateChunk (
+    uint64_t const seq_i,
+    uint64_t const chunk_i,
+    std::vector<uint8_t> & residues,
+    std::vector<uint32_t> & random_bits
+  ) const
+  {
+    const uint32_t size = chunkSize( chunk_i );
+    const uint64_t stream_index = ( seq_i * m_chunksPerSequence ) + chunk_i;
+    const uint32_t key[ 2 ] = {
+      static_cast<uint32_t>( m_randomSeed ),
+      static_cast<uint32_t>( m_randomSeed >> 32 )
+    };
+    const uint32_t block_count = ( size + 3 ) / 4;
+    random_bits.resize( block_count * 4 );
+    uint32_t * bits = ( random_bits.empty() ? 0 : &random_bits[ 0 ] );
+    for( uint32_t block_i = 0; block_i < block_count; block_i++ ) {
+      const uint32_t counter[ 4 ] = {
+        block_i,
+        0,
+        static_cast<uint32_t>( stream_index ),
+        static_cast<uint32_t>( stream_index >> 32 )
+      };
+      philox4x32_10( counter, key, bits + ( block_i * 4 ) );
+    }
+    residues.resize( size );
+    for( uint32_t i = 0; i < size; i++ ) {
+      residues[ i ] = static_cast<uint8_t>( m_residueTable.drawFromBits( bits[ i ] ) );
+    }
+  } // generateChunk( uint64_t const, uint64_t const, vector<uint8_t> &, vector<uint32_t> & ) const
+
+protected:
+  AliasTable m_residueTable;
+  uint64_t m_randomSeed;
+  uint64_t m_sequenceLength;
+  uint32_t m_chunkLength;
+  uint64_t m_chunksPerSequence;
+
+}; // End class RandomSequenceGenerator
+
+  /**
+   * Writes residues as Fasta text lines of a fixed width, across calls (so a
+   * sequence can be written a chunk at a time).
+   */
+  template <typename ResidueType>
+  class FastaLineWriter {
+  public:
+    FastaLineWriter (
+      std::ostream & os,
+      uint32_t const line_width
+    ) :
+      m_stream( os ),
+      m_lineWidth( line_width ),
+      m_column( 0 )
+    {
+      for( uint32_t res_i = 0; res_i < seqan::ValueSize<ResidueType>::VALUE; res_i++ ) {
+        m_codes[ res_i ] = static_cast<char>( ResidueType( res_i ) );
+      }
+    } // <init>( ostream &, uint32_t const )
+
+    void
+    beginSequence (
+      std::string const & name
+    )
+    {
+      m_stream << '>' << name << '\n';
+      m_column = 0;
+    } // beginSequence( string const & )
+
+    void
+    write (
+      std::vector<uint8_t> const & residues
+    )
+    {
+      m_line.clear();
+      for( size_t i = 0; i < residues.size(); i++ ) {
+        m_line += m_codes[ residues[ i ] ];
+        if( ++m_column == m_lineWidth ) {
+          m_line += '\n';
+          m_column = 0;
+        }
+      }
+      m_stream.write( m_line.data(), m_line.size() );
+    } // write( vector<uint8_t> const & )
+
+    void
+    endSequence ()
+    {
+      if( m_column != 0 ) {
+        m_stream << '\n';
+        m_column = 0;
+      }
+    } // endSequence()
+
+  protected:
+    std::ostream & m_stream;
+    uint32_t m_lineWidth;
+    uint32_t m_column;
+    char m_codes[ seqan::ValueSize<ResidueType>::VALUE ];
+    std::string m_line;
+  }; // End class FastaLineWriter
+
+  /**
+   * The UCSC ".2bit" format (for Dna only): a header and an index of the
+   * sequences' names and offsets, then each sequence's length, no N or mask
+   * blocks, and its residues packed four to a byte (T, C, A, G as 0 .. 3,
+   * first residue in the high bits).  All of the sequences' lengths must be
+   * known up front; offsets are 32-bit, so the file must be under 4GB.
+   */
+  namespace TwoBit {
+
+    /**
+     * Write the file header and index, for sequence_count sequences of
+     * sequence_length residues each, named by names.
+     */
+    inline void
+    writeHeader (
+      std::ostream & os,
+      std::vector<std::string> const & names,
+      uint64_t const sequence_length
+    )
+    {
+      uint64_t offset = 16;
+      for( size_t seq_i = 0; seq_i < names.size(); seq_i++ ) {
+        if( names[ seq_i ].size() > 255 ) {
+          throw std::string( "Sequence names in .2bit files are limited to 255 characters" );
+        }
+        offset += 1 + names[ seq_i ].size() + 4;
+      }
+      const uint64_t record_size = 16 + ( ( sequence_length + 3 ) / 4 );
+      if( ( sequence_length > 0xFFFFFFFFull ) ||
+          ( ( offset + ( record_size * names.size() ) ) > 0xFFFFFFFFull ) ) {
+        throw std::string( "That is too much sequence for a .2bit file (the limit is 4GB)" );
+      }
+      writeLittleEndian( os, 0x1A412743u, 4 ); // signature
+      writeLittleEndian( os, 0, 4 );          // version
+      writeLittleEndian( os, names.size(), 4 );
+      writeLittleEndian( os, 0, 4 );          // reserved
+      for( size_t seq_i = 0; seq_i < names.size(); seq_i++ ) {
+        os.put( static_cast<char>( names[ seq_i ].size() ) );
+        os.write( names[ seq_i ].data(), names[ seq_i ].size() );
+        writeLittleEndian( os, static_cast<uint32_t>( offset + ( record_size * seq_i ) ), 4 );
+      }
+    } // writeHeader( ostream &, vector<string> const &, uint64_t const )
+
+    /**
+     * Write the start of a sequence's record (before its packed residues).
+     */
+    inline void
+    beginSequence (
+      std::ostream & os,
+      uint64_t const sequence_length
+    )
+    {
+      writeLittleEndian( os, static_cast<uint32_t>( sequence_length ), 4 );
+      writeLittleEndian( os, 0, 4 ); // N block count
+      writeLittleEndian( os, 0, 4 ); // mask block count
+      writeLittleEndian( os, 0, 4 ); // reserved
+    } // beginSequence( ostream &, uint64_t const )
+
+    /**
+     * Write Dna residues (as ordinal values: A, C, G, T as 0 .. 3), packed.
+     * All but a sequence's last chunk must have a multiple of 4 residues.
+     */
+    inline void
+    writePacked (
+      std::ostream & os,
+      std::vector<uint8_t> const & residues,
+      std::vector<char> & packed // scratch
+    )
+    {
+      static const uint8_t codes[ 4 ] = { 2, 1, 3, 0 };
+      packed.assign( ( residues.size() + 3 ) / 4, 0 );
+      for( size_t i = 0; i < residues.size(); i++ ) {
+        packed[ i / 4 ] |= static_cast<char>( codes[ residues[ i ] ] << ( 6 - ( 2 * ( i % 4 ) ) ) );
+      }
+      if( !packed.empty() ) {
+        os.write( &packed[ 0 ], packed.size() );
+      }
+    } // writePacked( ostream &, vector<uint8_t> const &, vector<char> & )
+
+  } // End namespace TwoBit
+
+} // End namespace galosh
+
+#endif // __GALOSH_RANDOMSEQUENCEGENERATOR_HPP__
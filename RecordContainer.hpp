@@ -0,0 +1,381 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      RecordContainer.hpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      Class definitions for the RecordContainerWriter and
+##      RecordContainerReader classes, which write and read a single binary
+##      file holding many named records (eg. one alignment profile per input
+##      sequence), followed by an index keyed by record name and number.
+##
+##      The records are written sequentially, and the index is appended when
+##      the writer is closed, so the container can be produced in one pass.
+##      The reader loads only the index, and seeks to individual records on
+##      request.
+##
+##      Layout (all integers are little-endian):
+##        header:  8-byte magic, uint32 version, uint32 kind length, kind
+##        records: raw record bytes, back to back
+##        index:   per record: uint64 number, uint64 offset, uint64 length,
+##                 uint32 name length, name
+##        footer:  uint64 index offset, uint64 record count, 8-byte magic
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#if     _MSC_VER > 1000
+#pragma once
+#endif
+
+#ifndef __GALOSH_RECORDCONTAINER_HPP__
+#define __GALOSH_RECORDCONTAINER_HPP__
+
+#include "LittleEndian.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+namespace galosh {
+
+  static const char RECORD_CONTAINER_MAGIC[ 8 ] = { 'P', 'R', 'F', 'S', 'R', 'E', 'C', 'S' };
+  static const uint32_t RECORD_CONTAINER_VERSION = 1;
+
+  namespace record_container_detail {
+
+    inline uint64_t
+    readUInt (
+      std::istream & is,
+      uint32_t const num_bytes
+    )
+    {
+      uint8_t bytes[ 8 ];
+      is.read( reinterpret_cast<char *>( bytes ), num_bytes );
+      if( !is ) {
+        throw std::string( "Unexpected end of record container" );
+      }
+      return decodeLittleEndian( bytes, num_bytes );
+    } // readUInt( istream &, uint32_t const )
+
+  } // End namespace record_container_detail
+
+/**
+ * \class RecordContainerWriter
+ * \brief Sequentially writes named records to a single container file.
+ *
+ * Call add(..) once per record, in order; the index is written by close()
+ * (or by the destructor, if close() was not called).
+ */
+class RecordContainerWriter {
+public:
+  struct IndexEntry {
+    std::string m_name;
+    uint64_t m_number;
+    uint64_t m_offset;
+    uint64_t m_length;
+  };
+
+  RecordContainerWriter (
+    std::string const & filename,
+    std::string const & kind
+  ) :
+    m_filename( filename ),
+    m_stream( filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc ),
+    m_index()
+  {
+    if( !m_stream.is_open() ) {
+      throw ( "Can't open record container file " + filename + " for writing" );
+    }
+    m_stream.write( RECORD_CONTAINER_MAGIC, sizeof( RECORD_CONTAINER_MAGIC ) );
+    writeLittleEndian( m_stream, RECORD_CONTAINER_VERSION, 4 );
+    writeLittleEndian( m_stream, kind.length(), 4 );
+    m_stream.write( kind.data(), kind.length() );
+  } // <init>( string const &, string const & )
+
+  ~RecordContainerWriter ()
+  {
+    if( m_stream.is_open() ) {
+      try {
+        close();
+      } catch( ... ) {
+        // Don't throw from a destructor.
+      }
+    }
+  } // <destroy>()
+
+  /**
+   * Append the given bytes as a new record.  Returns the record's index.
+   */
+  uint64_t
+  add (
+    std::string const & name,
+    uint64_t const number,
+    std::string const & bytes
+  )
+  {
+    IndexEntry entry;
+    entry.m_name = name;
+    entry.m_number = number;
+    entry.m_offset = static_cast<uint64_t>( m_stream.tellp() );
+    entry.m_length = bytes.length();
+    m_stream.write( bytes.data(), bytes.length() );
+    if( !m_stream ) {
+      throw ( "Error writing to record container file " + m_filename );
+    }
+    m_index.push_back( entry );
+    return ( m_index.size() - 1 );
+  } // add( string const &, uint64_t const, string const & )
+
+  uint64_t
+  size () const
+  {
+    return m_index.size();
+  } // size() const
+
+  /**
+   * Write the index and footer, and close the file.
+   */
+  void
+  close ()
+  {
+    const uint64_t index_offset = static_cast<uint64_t>( m_stream.tellp() );
+    for( uint64_t entry_i = 0; entry_i < m_index.size(); entry_i++ ) {
+      IndexEntry const & entry = m_index[ entry_i ];
+      writeLittleEndian( m_stream, entry.m_number, 8 );
+      writeLittleEndian( m_stream, entry.m_offset, 8 );
+      writeLittleEndian( m_stream, entry.m_length, 8 );
+      writeLittleEndian( m_stream, entry.m_name.length(), 4 );
+      m_stream.write( entry.m_name.data(), entry.m_name.length() );
+    }
+    writeLittleEndian( m_stream, index_offset, 8 );
+    writeLittleEndian( m_stream, m_index.size(), 8 );
+    m_stream.write( RECORD_CONTAINER_MAGIC, sizeof( RECORD_CONTAINER_MAGIC ) );
+    if( !m_stream ) {
+      throw ( "Error writing the index of record container file " + m_filename );
+    }
+    m_stream.close();
+  } // close()
+
+protected:
+  std::string m_filename;
+  std::ofstream m_stream;
+  std::vector<IndexEntry> m_index;
+
+}; // End class RecordContainerWriter
+
+/**
+ * \class RecordContainerReader
+ * \brief Random-access reader for files written by RecordContainerWriter.
+ *
+ * Opening the container reads only the header and the index; record bytes
+ * are read on demand.
+ */
+class RecordContainerReader {
+public:
+  typedef RecordContainerWriter::IndexEntry IndexEntry;
+
+  RecordContainerReader (
+    std::string const & filename
+  ) :
+    m_filename( filename ),
+    m_stream( filename.c_str(), std::ios::in | std::ios::binary ),
+    m_kind(),
+    m_index(),
+    m_indexByName()
+  {
+    if( !m_stream.is_open() ) {
+      throw ( "Can't open record container file " + filename );
+    }
+    // Every length read below is checked against the file size before it's
+    // used, so a corrupt file can't make us allocate (or seek) wildly.
+    m_stream.seekg( 0, std::ios::end );
+    const uint64_t file_size = static_cast<uint64_t>( m_stream.tellg() );
+    m_stream.seekg( 0, std::ios::beg );
+    if( file_size < ( HeaderSize + FooterSize ) ) {
+      throw ( "The file " + filename + " is too short to be a profuse record container" );
+    }
+    char magic[ sizeof( RECORD_CONTAINER_MAGIC ) ];
+    m_stream.read( magic, sizeof( magic ) );
+    if( !m_stream || !std::equal( magic, magic + sizeof( magic ), RECORD_CONTAINER_MAGIC ) ) {
+      throw ( "The file " + filename + " is not a profuse record container" );
+    }
+    const uint32_t version =
+      static_cast<uint32_t>( record_container_detail::readUInt( m_stream, 4 ) );
+    if( version != RECORD_CONTAINER_VERSION ) {
+      throw ( "Unsupported version of record container file " + filename );
+    }
+    const uint64_t kind_length = record_container_detail::readUInt( m_stream, 4 );
+    if( kind_length > ( file_size - HeaderSize - FooterSize ) ) {
+      throw ( "The record container file " + filename + " is corrupt (its kind is longer than the file)" );
+    }
+    m_kind.resize( static_cast<size_t>( kind_length ) );
+    if( m_kind.length() > 0 ) {
+      m_stream.read( &m_kind[ 0 ], m_kind.length() );
+    }
+    const uint64_t records_start = ( HeaderSize + kind_length );
+
+    // The footer is the last 24 bytes.
+    m_stream.seekg( -static_cast<std::streamoff>( FooterSize ), std::ios::end );
+    const uint64_t index_offset = record_container_detail::readUInt( m_stream, 8 );
+    const uint64_t record_count = record_container_detail::readUInt( m_stream, 8 );
+    m_stream.read( magic, sizeof( magic ) );
+    if( !m_stream || !std::equal( magic, magic + sizeof( magic ), RECORD_CONTAINER_MAGIC ) ) {
+      throw ( "The record container file " + filename + " is truncated (was it closed?)" );
+    }
+    const uint64_t index_end = ( file_size - FooterSize );
+    if( ( index_offset < records_start ) || ( index_offset > index_end ) ||
+        ( record_count > ( ( index_end - index_offset ) / MinIndexEntrySize ) ) ) {
+      throw ( "The record container file " + filename + " is corrupt (its footer doesn't describe an index within the file)" );
+    }
+
+    m_stream.seekg( static_cast<std::streamoff>( index_offset ), std::ios::beg );
+    m_index.resize( static_cast<size_t>( record_count ) );
+    uint64_t entry_offset = index_offset;
+    for( uint64_t entry_i = 0; entry_i < record_count; entry_i++ ) {
+      IndexEntry & entry = m_index[ entry_i ];
+      entry.m_number = record_container_detail::readUInt( m_stream, 8 );
+      entry.m_offset = record_container_detail::readUInt( m_stream, 8 );
+      entry.m_length = record_container_detail::readUInt( m_stream, 8 );
+      const uint64_t name_length = record_container_detail::readUInt( m_stream, 4 );
+      entry_offset += MinIndexEntrySize;
+      if( ( name_length > ( index_end - entry_offset ) ) ||
+          ( entry.m_offset < records_start ) || ( entry.m_offset > index_offset ) ||
+          ( entry.m_length > ( index_offset - entry.m_offset ) ) ) {
+        throw ( "The record container file " + filename + " is corrupt (its index points outside the file)" );
+      }
+      entry_offset += name_length;
+      entry.m_name.resize( static_cast<size_t>( name_length ) );
+      if( entry.m_name.length() > 0 ) {
+        m_stream.read( &entry.m_name[ 0 ], entry.m_name.length() );
+      }
+      // First one wins if names are repeated; use the number to get the rest.
+      m_indexByName.insert( std::make_pair( entry.m_name, entry_i ) );
+    }
+    if( !m_stream ) {
+      throw ( "Error reading the index of record container file " + filename );
+    }
+  } // <init>( string const & )
+
+  std::string const &
+  kind () const
+  {
+    return m_kind;
+  } // kind() const
+
+  uint64_t
+  size () const
+  {
+    return m_index.size();
+  } // size() const
+
+  IndexEntry const &
+  entry (
+    uint64_t const entry_i
+  ) const
+  {
+    return m_index[ entry_i ];
+  } // entry( uint64_t const ) const
+
+  /**
+   * Return the index of the (first) record with the given name, or size() if
+   * there is none.
+   */
+  uint64_t
+  find (
+    std::string const & name
+  ) const
+  {
+    std::map<std::string, uint64_t>::const_iterator it = m_indexByName.find( name );
+    if( it == m_indexByName.end() ) {
+      return size();
+    }
+    return it->second;
+  } // find( string const & ) const
+
+  /**
+   * Return the index of the record with the given number, or size() if there
+   * is none.  Records are usually numbered in order, so try that first.
+   */
+  uint64_t
+  findNumber (
+    uint64_t const number
+  ) const
+  {
+    if( ( number < m_index.size() ) && ( m_index[ number ].m_number == number ) ) {
+      return number;
+    }
+    for( uint64_t entry_i = 0; entry_i < m_index.size(); entry_i++ ) {
+      if( m_index[ entry_i ].m_number == number ) {
+        return entry_i;
+      }
+    }
+    return size();
+  } // findNumber( uint64_t const ) const
+
+  /**
+   * Read the bytes of the record at the given index.
+   */
+  void
+  read (
+    uint64_t const entry_i,
+    std::string & bytes
+  )
+  {
+    IndexEntry const & entry = m_index[ entry_i ];
+    bytes.resize( static_cast<size_t>( entry.m_length ) );
+    m_stream.clear();
+    m_stream.seekg( static_cast<std::streamoff>( entry.m_offset ), std::ios::beg );
+    if( entry.m_length > 0 ) {
+      m_stream.read( &bytes[ 0 ], entry.m_length );
+    }
+    if( !m_stream ) {
+      throw ( "Error reading record '" + entry.m_name + "' from record container file " + m_filename );
+    }
+  } // read( uint64_t const, string & )
+
+protected:
+  enum {
+    HeaderSize = 16, // Magic, version, kind length (then the kind).
+    FooterSize = 24,
+    MinIndexEntrySize = 28 // Number, offset, length, name length (then the name).
+  };
+
+  std::string m_filename;
+  std::ifstream m_stream;
+  std::string m_kind;
+  std::vector<IndexEntry> m_index;
+  std::map<std::string, uint64_t> m_indexByName;
+
+}; // End class RecordContainerReader
+
+} // End namespace galosh
+
+#endif // __GALOSH_RECORDCONTAINER_HPP__
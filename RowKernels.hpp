@@ -0,0 +1,919 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      RowKernels.hpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      The inner loops of the dynamic programming rows (CheckpointedViterbi,
+##      CheckpointedForwardBackward and its CountsVisitor), built for several
+##      instruction sets -- scalar, SSE4.2, AVX2, and AVX-512 -- in the one
+##      binary.  The best variant that the CPU supports is chosen (via CPUID)
+##      the first time the kernels are asked for; selectKernelIsa(..) (the
+##      --isa option of the programs) forces another, eg. for benchmarking.
+##
+##      Each kernel is the part of a row that depends only on the previous
+##      (or next) row, so that it can run across profile positions; the
+##      Deletion recurrences stay in the callers.  All of the variants give
+##      bit-identical results: the kernels do the same operations in the same
+##      order (without fused multiply-adds), and the one reduction (the
+##      forward row sum) always uses one 512-bit register's worth of lanes
+##      (eight doubles or sixteen floats), however wide the registers.
+##
+##      The forward kernels also come in a float version, for the float cells
+##      of MixedPrecisionForward, which fit twice as many to a register, and
+##      a log-space version with tabulated log sums, for UnscaledForward with
+##      flogspace cells (whose table lookups are the one part done lane by
+##      lane).
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#if     _MSC_VER > 1000
+#pragma once
+#endif
+
+#ifndef __GALOSH_ROWKERNELS_HPP__
+#define __GALOSH_ROWKERNELS_HPP__
+
+#include "ProfileTables.hpp" // for ProfileTransition
+#include "LogSum.hpp" // for TabulatedLogSum
+
+#include <cstring>
+#include <string>
+
+#include <boost/cstdint.hpp>
+
+// The SIMD variants need GCC-style vector extensions, target attributes, and
+// __builtin_cpu_supports(..); elsewhere there is only the scalar variant.
+#if ( defined( __GNUC__ ) || defined( __clang__ ) ) && ( defined( __x86_64__ ) || defined( __i386__ ) ) && !defined( __PROFUSE_SCALAR_KERNELS_ONLY )
+#define __PROFUSE_HAVE_KERNEL_ISAS
+#endif
+
+#if defined( __clang__ )
+#define PROFUSE_KERNEL_BEGIN _Pragma( "clang fp contract(off)" )
+#define PROFUSE_KERNEL_VARIANT( target_string ) __attribute__(( target( target_string ) ))
+#define PROFUSE_KERNEL_INLINE inline __attribute__(( always_inline ))
+#define PROFUSE_KERNEL_UNROLL _Pragma( "unroll" )
+#elif defined( __GNUC__ )
+#define PROFUSE_KERNEL_BEGIN
+#define PROFUSE_KERNEL_VARIANT( target_string ) __attribute__(( target( target_string ), optimize( "fp-contract=off" ) ))
+#define PROFUSE_KERNEL_INLINE inline __attribute__(( always_inline ))
+#if ( __GNUC__ >= 8 )
+#define PROFUSE_KERNEL_UNROLL _Pragma( "GCC unroll 16" )
+#else
+#define PROFUSE_KERNEL_UNROLL
+#endif
+#else
+#define PROFUSE_KERNEL_BEGIN
+#define PROFUSE_KERNEL_VARIANT( target_string )
+#define PROFUSE_KERNEL_INLINE inline
+#define PROFUSE_KERNEL_UNROLL
+#endif
+
+namespace galosh {
+
+  namespace KernelIsa {
+    enum Variant {
+      Scalar,
+      SSE42,
+      AVX2,
+      AVX512,
+      Count
+    };
+  } // End namespace KernelIsa
+
+  /**
+   * The kernels of one variant.  Positions are 0-based and contiguous here:
+   * the callers offset the row pointers so that entry i of each array
+   * belongs to the same position.  match_emissions are the emissions of the
+   * current residue, by position (see ProfileTables::matchEmissions(..));
+   * transitions are ProfileTables::m_transitions.
+   */
+  struct RowKernels {
+    KernelIsa::Variant m_isa;
+
+    /// Log-space (max-plus) Viterbi: match[ i ] (the next position) and
+    /// insertion[ i ] from the previous row's values at i.
+    void ( *viterbiMatchInsertion ) (
+      double const * prev_match,
+      double const * prev_insertion,
+      double const * prev_deletion,
+      double const * match_emissions,
+      double const insertion_emission,
+      double const * transitions,
+      double * match,
+      double * insertion,
+      uint32_t const count
+    );
+
+    /// Forward: as viterbiMatchInsertion, but sum-product.  Returns the sum
+    /// of the new values.
+    double ( *forwardMatchInsertion ) (
+      double const * prev_match,
+      double const * prev_insertion,
+      double const * prev_deletion,
+      double const * match_emissions,
+      double const insertion_emission,
+      double const * transitions,
+      double * match,
+      double * insertion,
+      uint32_t const count
+    );
+
+    /// Backward: the terms of match[ i ], insertion[ i ], and deletion[ i ]
+    /// that come from the next row (next_match at the next position,
+    /// next_insertion at this one).  The caller adds the Deletion terms.
+    void ( *backwardMatchInsertion ) (
+      double const * next_match,
+      double const * next_insertion,
+      double const * match_emissions,
+      double const emission_scale,
+      double const insertion_emission,
+      double const * transitions,
+      double * match,
+      double * insertion,
+      double * deletion,
+      uint32_t const count
+    );
+
+    /// values[ i ] *= factor.
+    void ( *scale ) (
+      double * values,
+      double const factor,
+      uint32_t const count
+    );
+
+    /// posteriors[ i ] += forward[ i ] * backward[ i ] * weight.
+    void ( *addEmissionPosteriors ) (
+      double const * forward,
+      double const * backward,
+      double const weight,
+      double * posteriors,
+      uint32_t const count
+    );
+
+    /// Adds the posteriors of the Match->Deletion and Deletion->Deletion
+    /// transitions out of each position (next_deletion is at the next one).
+    void ( *addDeletionTransitionPosteriors ) (
+      double const * forward_match,
+      double const * forward_deletion,
+      double const * next_deletion,
+      double const weight,
+      double const * transitions,
+      double * match_to_deletion,
+      double * deletion_to_deletion,
+      uint32_t const count
+    );
+
+    /// Adds the posteriors of the transitions out of each position into the
+    /// emitting states of the next row (next_match is at the next position,
+    /// next_insertion at this one).
+    void ( *addEmittingTransitionPosteriors ) (
+      double const * forward_match,
+      double const * forward_insertion,
+      double const * forward_deletion,
+      double const * next_match,
+      double const * next_insertion,
+      double const * match_emissions,
+      double const insertion_emission,
+      double const weight,
+      double const * transitions,
+      double * match_to_match,
+      double * insertion_to_match,
+      double * deletion_to_match,
+      double * match_to_insertion,
+      double * insertion_to_insertion,
+      uint32_t const count
+    );
+
+    /// forwardMatchInsertion, in floats (the emissions and transitions
+    /// too).
+    float ( *forwardMatchInsertionFloat ) (
+      float const * prev_match,
+      float const * prev_insertion,
+      float const * prev_deletion,
+      float const * match_emissions,
+      float const insertion_emission,
+      float const * transitions,
+      float * match,
+      float * insertion,
+      uint32_t const count
+    );
+
+    /// scale, in floats.
+    void ( *scaleFloat ) (
+      float * values,
+      float const factor,
+      uint32_t const count
+    );
+
+    /// forwardMatchInsertion, in log space: every value (and emission, and
+    /// transition) is a natural log, and the sums are
+    /// TabulatedLogSum::sum(..)s, in the order that UnscaledForward with
+    /// flogspace cells does them.  Returns nothing.
+    void ( *tabulatedLogForwardMatchInsertion ) (
+      double const * prev_match,
+      double const * prev_insertion,
+      double const * prev_deletion,
+      double const * match_emissions,
+      double const insertion_emission,
+      double const * transitions,
+      double * match,
+      double * insertion,
+      uint32_t const count
+    );
+  }; // End struct RowKernels
+
+  namespace row_kernels {
+
+    /**
+     * One register's worth of ValueTypes (just one, for the scalar variant),
+     * and the few operations that the kernels need.  tableEntries(..) gives,
+     * for each x >= 0, its integer part (as a ValueType), the entry of the
+     * table there, and the (float) difference of the next entry from it.  The vectors go in and
+     * out by reference, never by value: these are compiled (inlined) only
+     * within the target-attributed variants, but a vector return type would
+     * still have the default target's ABI, which GCC warns about (-Wpsabi).
+     */
+    template <typename ValueType>
+    struct BasicScalarPack {
+      typedef ValueType Value;
+      typedef ValueType Type;
+      enum { Width = 1 };
+
+      static PROFUSE_KERNEL_INLINE void load ( Type & v, Value const * p ) { v = *p; }
+      static PROFUSE_KERNEL_INLINE void store ( Value * p, Type const & v ) { *p = v; }
+      static PROFUSE_KERNEL_INLINE void broadcast ( Type & v, Value const x ) { v = x; }
+      static PROFUSE_KERNEL_INLINE void max ( Type & v, Type const & a, Type const & b ) { v = ( ( a > b ) ? a : b ); }
+      static PROFUSE_KERNEL_INLINE void selectLess ( Type & v, Type const & a, Type const & b, Type const & if_less, Type const & otherwise ) { v = ( ( a < b ) ? if_less : otherwise ); }
+      static PROFUSE_KERNEL_INLINE void
+      tableEntries ( Type & index, Type & entry, Type & step, float const * table, Type const & x )
+      {
+        const uint32_t i = static_cast<uint32_t>( x );
+        index = i;
+        entry = table[ i ];
+        step = ( table[ i + 1 ] - table[ i ] );
+      } // tableEntries( Type &, Type &, Type &, float const *, Type const & )
+    }; // End struct BasicScalarPack<ValueType>
+
+    typedef BasicScalarPack<double> ScalarPack;
+
+#ifdef __PROFUSE_HAVE_KERNEL_ISAS
+    template <int Bytes, typename ValueType = double>
+    struct VectorPack {
+      typedef ValueType Value;
+      typedef ValueType Type __attribute__(( vector_size( Bytes ) ));
+      enum { Width = ( Bytes / sizeof( ValueType ) ) };
+
+      static PROFUSE_KERNEL_INLINE void load ( Type & v, Value const * p ) { std::memcpy( &v, p, sizeof( v ) ); }
+      static PROFUSE_KERNEL_INLINE void store ( Value * p, Type const & v ) { std::memcpy( p, &v, sizeof( v ) ); }
+      static PROFUSE_KERNEL_INLINE void broadcast ( Type & v, Value const x ) { const Type zero = { }; v = ( x - zero ); } // ( x - 0 is exactly x, even for -0. )
+      static PROFUSE_KERNEL_INLINE void max ( Type & v, Type const & a, Type const & b ) { v = ( ( a > b ) ? a : b ); }
+      static PROFUSE_KERNEL_INLINE void selectLess ( Type & v, Type const & a, Type const & b, Type const & if_less, Type const & otherwise ) { v = ( ( a < b ) ? if_less : otherwise ); }
+      static PROFUSE_KERNEL_INLINE void
+      tableEntries ( Type & index, Type & entry, Type & step, float const * table, Type const & x )
+      {
+        // There's no gather in the vector extensions; this is it, by lane.
+        PROFUSE_KERNEL_UNROLL
+        for( int lane_i = 0; lane_i < Width; lane_i++ ) {
+          const uint32_t i = static_cast<uint32_t>( x[ lane_i ] );
+          index[ lane_i ] = i;
+          entry[ lane_i ] = table[ i ];
+          step[ lane_i ] = ( table[ i + 1 ] - table[ i ] );
+        }
+      } // tableEntries( Type &, Type &, Type &, float const *, Type const & )
+    }; // End struct VectorPack<Bytes, ValueType>
+
+    /// VectorPack<Bytes, float>, under a name without a comma (for the
+    /// macro arguments below).
+    template <int Bytes>
+    struct FloatVectorPack : public VectorPack<Bytes, float> {
+    }; // End struct FloatVectorPack<Bytes>
+#endif // __PROFUSE_HAVE_KERNEL_ISAS
+
+    /**
+     * The number of partial sums in forwardMatchInsertion, for every variant:
+     * the widest register's worth.
+     */
+    template <typename ValueType>
+    struct SumLanes {
+      enum { value = ( 64 / sizeof( ValueType ) ) };
+    }; // End struct SumLanes<ValueType>
+
+    template <typename Pack>
+    PROFUSE_KERNEL_INLINE void
+    viterbiMatchInsertion (
+      double const * prev_match,
+      double const * prev_insertion,
+      double const * prev_deletion,
+      double const * match_emissions,
+      double const insertion_emission,
+      double const * transitions,
+      double * match,
+      double * insertion,
+      uint32_t const count
+    )
+    {
+      PROFUSE_KERNEL_BEGIN
+      typedef typename Pack::Type V;
+      const double * t = transitions;
+      V t_mm, t_im, t_dm, t_mi, t_ii;
+      Pack::broadcast( t_mm, t[ ProfileTransition::MatchToMatch ] );
+      Pack::broadcast( t_im, t[ ProfileTransition::InsertionToMatch ] );
+      Pack::broadcast( t_dm, t[ ProfileTransition::DeletionToMatch ] );
+      Pack::broadcast( t_mi, t[ ProfileTransition::MatchToInsertion ] );
+      Pack::broadcast( t_ii, t[ ProfileTransition::InsertionToInsertion ] );
+      V e_i;
+      Pack::broadcast( e_i, insertion_emission );
+      uint32_t i = 0;
+      for( ; ( i + Pack::Width ) <= count; i += Pack::Width ) {
+        V m, in, d, e_m, to_match, to_insertion;
+        Pack::load( m, prev_match + i );
+        Pack::load( in, prev_insertion + i );
+        Pack::load( d, prev_deletion + i );
+        Pack::load( e_m, match_emissions + i );
+        Pack::max( to_match, m + t_mm, in + t_im );
+        Pack::max( to_match, to_match, d + t_dm );
+        Pack::max( to_insertion, m + t_mi, in + t_ii );
+        Pack::store( match + i, e_m + to_match );
+        Pack::store( insertion + i, e_i + to_insertion );
+      }
+      for( ; i < count; i++ ) {
+        double to_match, to_insertion;
+        ScalarPack::max( to_match, prev_match[ i ] + t[ ProfileTransition::MatchToMatch ], prev_insertion[ i ] + t[ ProfileTransition::InsertionToMatch ] );
+        ScalarPack::max( to_match, to_match, prev_deletion[ i ] + t[ ProfileTransition::DeletionToMatch ] );
+        ScalarPack::max( to_insertion, prev_match[ i ] + t[ ProfileTransition::MatchToInsertion ], prev_insertion[ i ] + t[ ProfileTransition::InsertionToInsertion ] );
+        match[ i ] = match_emissions[ i ] + to_match;
+        insertion[ i ] = insertion_emission + to_insertion;
+      }
+    } // viterbiMatchInsertion<Pack>( .. )
+
+    template <typename Pack>
+    PROFUSE_KERNEL_INLINE typename Pack::Value
+    forwardMatchInsertion (
+      typename Pack::Value const * prev_match,
+      typename Pack::Value const * prev_insertion,
+      typename Pack::Value const * prev_deletion,
+      typename Pack::Value const * match_emissions,
+      typename Pack::Value const insertion_emission,
+      typename Pack::Value const * transitions,
+      typename Pack::Value * match,
+      typename Pack::Value * insertion,
+      uint32_t const count
+    )
+    {
+      PROFUSE_KERNEL_BEGIN
+      typedef typename Pack::Value T;
+      typedef typename Pack::Type V;
+      enum { Lanes = SumLanes<T>::value, Packs = ( Lanes / Pack::Width ) };
+      const T * t = transitions;
+      V t_mm, t_im, t_dm, t_mi, t_ii;
+      Pack::broadcast( t_mm, t[ ProfileTransition::MatchToMatch ] );
+      Pack::broadcast( t_im, t[ ProfileTransition::InsertionToMatch ] );
+      Pack::broadcast( t_dm, t[ ProfileTransition::DeletionToMatch ] );
+      Pack::broadcast( t_mi, t[ ProfileTransition::MatchToInsertion ] );
+      Pack::broadcast( t_ii, t[ ProfileTransition::InsertionToInsertion ] );
+      V e_i;
+      Pack::broadcast( e_i, insertion_emission );
+      V sums[ Packs ];
+      for( uint32_t pack_i = 0; pack_i < Packs; pack_i++ ) {
+        Pack::broadcast( sums[ pack_i ], 0.0 );
+      }
+      uint32_t i = 0;
+      for( ; ( i + Lanes ) <= count; i += Lanes ) {
+        for( uint32_t pack_i = 0; pack_i < Packs; pack_i++ ) {
+          const uint32_t j = i + ( pack_i * Pack::Width );
+          V m, in, d, e_m;
+          Pack::load( m, prev_match + j );
+          Pack::load( in, prev_insertion + j );
+          Pack::load( d, prev_deletion + j );
+          Pack::load( e_m, match_emissions + j );
+          const V new_match = e_m * ( ( ( m * t_mm ) + ( in * t_im ) ) + ( d * t_dm ) );
+          const V new_insertion = e_i * ( ( m * t_mi ) + ( in * t_ii ) );
+          Pack::store( match + j, new_match );
+          Pack::store( insertion + j, new_insertion );
+          sums[ pack_i ] += new_match;
+          sums[ pack_i ] += new_insertion;
+        }
+      }
+      T lanes[ Lanes ];
+      for( uint32_t pack_i = 0; pack_i < Packs; pack_i++ ) {
+        Pack::store( lanes + ( pack_i * Pack::Width ), sums[ pack_i ] );
+      }
+      for( uint32_t lane_i = 0; i < count; i++, lane_i++ ) {
+        match[ i ] =
+          match_emissions[ i ] *
+          ( ( ( prev_match[ i ] * t[ ProfileTransition::MatchToMatch ] ) + ( prev_insertion[ i ] * t[ ProfileTransition::InsertionToMatch ] ) ) + ( prev_deletion[ i ] * t[ ProfileTransition::DeletionToMatch ] ) );
+        insertion[ i ] =
+          insertion_emission *
+          ( ( prev_match[ i ] * t[ ProfileTransition::MatchToInsertion ] ) + ( prev_insertion[ i ] * t[ ProfileTransition::InsertionToInsertion ] ) );
+        lanes[ lane_i ] += match[ i ];
+        lanes[ lane_i ] += insertion[ i ];
+      }
+      // Pairwise: ( ( lanes[ 0 ] + lanes[ 1 ] ) + ( lanes[ 2 ] + lanes[ 3 ] ) ) + ..
+      for( uint32_t width = ( Lanes / 2 ); width > 0; width /= 2 ) {
+        for( uint32_t lane_i = 0; lane_i < width; lane_i++ ) {
+          lanes[ lane_i ] = ( lanes[ 2 * lane_i ] + lanes[ ( 2 * lane_i ) + 1 ] );
+        }
+      }
+      return lanes[ 0 ];
+    } // forwardMatchInsertion<Pack>( .. )
+
+    template <typename Pack>
+    PROFUSE_KERNEL_INLINE void
+    backwardMatchInsertion (
+      double const * next_match,
+      double const * next_insertion,
+      double const * match_emissions,
+      double const emission_scale,
+      double const insertion_emission,
+      double const * transitions,
+      double * match,
+      double * insertion,
+      double * deletion,
+      uint32_t const count
+    )
+    {
+      PROFUSE_KERNEL_BEGIN
+      typedef typename Pack::Type V;
+      const double * t = transitions;
+      V t_mm, t_im, t_dm, t_mi, t_ii;
+      Pack::broadcast( t_mm, t[ ProfileTransition::MatchToMatch ] );
+      Pack::broadcast( t_im, t[ ProfileTransition::InsertionToMatch ] );
+      Pack::broadcast( t_dm, t[ ProfileTransition::DeletionToMatch ] );
+      Pack::broadcast( t_mi, t[ ProfileTransition::MatchToInsertion ] );
+      Pack::broadcast( t_ii, t[ ProfileTransition::InsertionToInsertion ] );
+      V e_scale;
+      Pack::broadcast( e_scale, emission_scale );
+      V e_i;
+      Pack::broadcast( e_i, insertion_emission );
+      uint32_t i = 0;
+      for( ; ( i + Pack::Width ) <= count; i += Pack::Width ) {
+        V e_m, n_m, n_i;
+        Pack::load( e_m, match_emissions + i );
+        Pack::load( n_m, next_match + i );
+        Pack::load( n_i, next_insertion + i );
+        const V to_match = ( e_m * e_scale ) * n_m;
+        const V to_insertion = e_i * n_i;
+        Pack::store( deletion + i, t_dm * to_match );
+        Pack::store( match + i, ( t_mm * to_match ) + ( t_mi * to_insertion ) );
+        Pack::store( insertion + i, ( t_im * to_match ) + ( t_ii * to_insertion ) );
+      }
+      for( ; i < count; i++ ) {
+        const double to_match = ( match_emissions[ i ] * emission_scale ) * next_match[ i ];
+        const double to_insertion = insertion_emission * next_insertion[ i ];
+        deletion[ i ] = t[ ProfileTransition::DeletionToMatch ] * to_match;
+        match[ i ] = ( t[ ProfileTransition::MatchToMatch ] * to_match ) + ( t[ ProfileTransition::MatchToInsertion ] * to_insertion );
+        insertion[ i ] = ( t[ ProfileTransition::InsertionToMatch ] * to_match ) + ( t[ ProfileTransition::InsertionToInsertion ] * to_insertion );
+      }
+    } // backwardMatchInsertion<Pack>( .. )
+
+    template <typename Pack>
+    PROFUSE_KERNEL_INLINE void
+    scale (
+      typename Pack::Value * values,
+      typename Pack::Value const factor,
+      uint32_t const count
+    )
+    {
+      PROFUSE_KERNEL_BEGIN
+      typedef typename Pack::Type V;
+      V f;
+      Pack::broadcast( f, factor );
+      uint32_t i = 0;
+      for( ; ( i + Pack::Width ) <= count; i += Pack::Width ) {
+        V v;
+        Pack::load( v, values + i );
+        Pack::store( values + i, v * f );
+      }
+      for( ; i < count; i++ ) {
+        values[ i ] *= factor;
+      }
+    } // scale<Pack>( .. )
+
+    template <typename Pack>
+    PROFUSE_KERNEL_INLINE void
+    addEmissionPosteriors (
+      double const * forward,
+      double const * backward,
+      double const weight,
+      double * posteriors,
+      uint32_t const count
+    )
+    {
+      PROFUSE_KERNEL_BEGIN
+      typedef typename Pack::Type V;
+      V w;
+      Pack::broadcast( w, weight );
+      uint32_t i = 0;
+      for( ; ( i + Pack::Width ) <= count; i += Pack::Width ) {
+        V p, f, b;
+        Pack::load( p, posteriors + i );
+        Pack::load( f, forward + i );
+        Pack::load( b, backward + i );
+        Pack::store( posteriors + i, p + ( ( f * b ) * w ) );
+      }
+      for( ; i < count; i++ ) {
+        posteriors[ i ] += ( forward[ i ] * backward[ i ] ) * weight;
+      }
+    } // addEmissionPosteriors<Pack>( .. )
+
+    template <typename Pack>
+    PROFUSE_KERNEL_INLINE void
+    addDeletionTransitionPosteriors (
+      double const * forward_match,
+      double const * forward_deletion,
+      double const * next_deletion,
+      double const weight,
+      double const * transitions,
+      double * match_to_deletion,
+      double * deletion_to_deletion,
+      uint32_t const count
+    )
+    {
+      PROFUSE_KERNEL_BEGIN
+      typedef typename Pack::Type V;
+      const double t_md = transitions[ ProfileTransition::MatchToDeletion ];
+      const double t_dd = transitions[ ProfileTransition::DeletionToDeletion ];
+      V v_md, v_dd, w;
+      Pack::broadcast( v_md, t_md );
+      Pack::broadcast( v_dd, t_dd );
+      Pack::broadcast( w, weight );
+      uint32_t i = 0;
+      for( ; ( i + Pack::Width ) <= count; i += Pack::Width ) {
+        V n_d, f_m, f_d, md, dd;
+        Pack::load( n_d, next_deletion + i );
+        Pack::load( f_m, forward_match + i );
+        Pack::load( f_d, forward_deletion + i );
+        Pack::load( md, match_to_deletion + i );
+        Pack::load( dd, deletion_to_deletion + i );
+        const V to_deletion = n_d * w;
+        Pack::store( match_to_deletion + i, md + ( ( f_m * v_md ) * to_deletion ) );
+        Pack::store( deletion_to_deletion + i, dd + ( ( f_d * v_dd ) * to_deletion ) );
+      }
+      for( ; i < count; i++ ) {
+        const double to_deletion = next_deletion[ i ] * weight;
+        match_to_deletion[ i ] += ( forward_match[ i ] * t_md ) * to_deletion;
+        deletion_to_deletion[ i ] += ( forward_deletion[ i ] * t_dd ) * to_deletion;
+      }
+    } // addDeletionTransitionPosteriors<Pack>( .. )
+
+    template <typename Pack>
+    PROFUSE_KERNEL_INLINE void
+    addEmittingTransitionPosteriors (
+      double const * forward_match,
+      double const * forward_insertion,
+      double const * forward_deletion,
+      double const * next_match,
+      double const * next_insertion,
+      double const * match_emissions,
+      double const insertion_emission,
+      double const weight,
+      double const * transitions,
+      double * match_to_match,
+      double * insertion_to_match,
+      double * deletion_to_match,
+      double * match_to_insertion,
+      double * insertion_to_insertion,
+      uint32_t const count
+    )
+    {
+      PROFUSE_KERNEL_BEGIN
+      typedef typename Pack::Type V;
+      const double * t = transitions;
+      V t_mm, t_im, t_dm, t_mi, t_ii;
+      Pack::broadcast( t_mm, t[ ProfileTransition::MatchToMatch ] );
+      Pack::broadcast( t_im, t[ ProfileTransition::InsertionToMatch ] );
+      Pack::broadcast( t_dm, t[ ProfileTransition::DeletionToMatch ] );
+      Pack::broadcast( t_mi, t[ ProfileTransition::MatchToInsertion ] );
+      Pack::broadcast( t_ii, t[ ProfileTransition::InsertionToInsertion ] );
+      V e_i;
+      Pack::broadcast( e_i, insertion_emission );
+      V w;
+      Pack::broadcast( w, weight );
+      uint32_t i = 0;
+      for( ; ( i + Pack::Width ) <= count; i += Pack::Width ) {
+        V e_m, n_m, n_i, m, in, d, mm, im, dm, mi, ii;
+        Pack::load( e_m, match_emissions + i );
+        Pack::load( n_m, next_match + i );
+        Pack::load( n_i, next_insertion + i );
+        Pack::load( m, forward_match + i );
+        Pack::load( in, forward_insertion + i );
+        Pack::load( d, forward_deletion + i );
+        Pack::load( mm, match_to_match + i );
+        Pack::load( im, insertion_to_match + i );
+        Pack::load( dm, deletion_to_match + i );
+        Pack::load( mi, match_to_insertion + i );
+        Pack::load( ii, insertion_to_insertion + i );
+        const V to_match = ( e_m * n_m ) * w;
+        const V to_insertion = ( e_i * n_i ) * w;
+        Pack::store( match_to_match + i, mm + ( ( m * t_mm ) * to_match ) );
+        Pack::store( insertion_to_match + i, im + ( ( in * t_im ) * to_match ) );
+        Pack::store( deletion_to_match + i, dm + ( ( d * t_dm ) * to_match ) );
+        Pack::store( match_to_insertion + i, mi + ( ( m * t_mi ) * to_insertion ) );
+        Pack::store( insertion_to_insertion + i, ii + ( ( in * t_ii ) * to_insertion ) );
+      }
+      for( ; i < count; i++ ) {
+        const double to_match = ( match_emissions[ i ] * next_match[ i ] ) * weight;
+        const double to_insertion = ( insertion_emission * next_insertion[ i ] ) * weight;
+        match_to_match[ i ] += ( forward_match[ i ] * t[ ProfileTransition::MatchToMatch ] ) * to_match;
+        insertion_to_match[ i ] += ( forward_insertion[ i ] * t[ ProfileTransition::InsertionToMatch ] ) * to_match;
+        deletion_to_match[ i ] += ( forward_deletion[ i ] * t[ ProfileTransition::DeletionToMatch ] ) * to_match;
+        match_to_insertion[ i ] += ( forward_match[ i ] * t[ ProfileTransition::MatchToInsertion ] ) * to_insertion;
+        insertion_to_insertion[ i ] += ( forward_insertion[ i ] * t[ ProfileTransition::InsertionToInsertion ] ) * to_insertion;
+      }
+    } // addEmittingTransitionPosteriors<Pack>( .. )
+
+    /**
+     * TabulatedLogSum::sum( a, b ), by lane (and with the same result).
+     */
+    template <typename Pack>
+    PROFUSE_KERNEL_INLINE void
+    tabulatedLogSum (
+      typename Pack::Type & sum,
+      typename Pack::Type const & a,
+      typename Pack::Type const & b,
+      float const * table
+    )
+    {
+      typedef typename Pack::Type V;
+      V larger, difference, max_difference, zero, scale, x, index, entry, step;
+      Pack::max( larger, a, b );
+      Pack::max( difference, a - b, b - a ); // | a - b | (or NaN)
+      Pack::broadcast( max_difference, TabulatedLogSum::maxDifference() );
+      Pack::broadcast( zero, 0.0 );
+      Pack::broadcast( scale, TabulatedLogSum::Scale );
+      // Where the difference is too big (or NaN), look up anything, and
+      // use just larger.
+      Pack::selectLess( x, difference, max_difference, difference, zero );
+      x = x * scale;
+      Pack::tableEntries( index, entry, step, table, x );
+      Pack::selectLess( sum, difference, max_difference, larger + ( entry + ( ( x - index ) * step ) ), larger );
+    } // tabulatedLogSum<Pack>( .. )
+
+    template <typename Pack>
+    PROFUSE_KERNEL_INLINE void
+    tabulatedLogForwardMatchInsertion (
+      double const * prev_match,
+      double const * prev_insertion,
+      double const * prev_deletion,
+      double const * match_emissions,
+      double const insertion_emission,
+      double const * transitions,
+      double * match,
+      double * insertion,
+      uint32_t const count
+    )
+    {
+      PROFUSE_KERNEL_BEGIN
+      typedef typename Pack::Type V;
+      float const * table = &TabulatedLogSum::table().m_values[ 0 ];
+      const double * t = transitions;
+      V t_mm, t_im, t_dm, t_mi, t_ii;
+      Pack::broadcast( t_mm, t[ ProfileTransition::MatchToMatch ] );
+      Pack::broadcast( t_im, t[ ProfileTransition::InsertionToMatch ] );
+      Pack::broadcast( t_dm, t[ ProfileTransition::DeletionToMatch ] );
+      Pack::broadcast( t_mi, t[ ProfileTransition::MatchToInsertion ] );
+      Pack::broadcast( t_ii, t[ ProfileTransition::InsertionToInsertion ] );
+      V e_i;
+      Pack::broadcast( e_i, insertion_emission );
+      uint32_t i = 0;
+      for( ; ( i + Pack::Width ) <= count; i += Pack::Width ) {
+        V m, in, d, e_m, to_match, to_insertion;
+        Pack::load( m, prev_match + i );
+        Pack::load( in, prev_insertion + i );
+        Pack::load( d, prev_deletion + i );
+        Pack::load( e_m, match_emissions + i );
+        tabulatedLogSum<Pack>( to_match, m + t_mm, in + t_im, table );
+        tabulatedLogSum<Pack>( to_match, to_match, d + t_dm, table );
+        tabulatedLogSum<Pack>( to_insertion, m + t_mi, in + t_ii, table );
+        Pack::store( match + i, e_m + to_match );
+        Pack::store( insertion + i, e_i + to_insertion );
+      }
+      for( ; i < count; i++ ) {
+        double to_match, to_insertion;
+        tabulatedLogSum<ScalarPack>( to_match, prev_match[ i ] + t[ ProfileTransition::MatchToMatch ], prev_insertion[ i ] + t[ ProfileTransition::InsertionToMatch ], table );
+        tabulatedLogSum<ScalarPack>( to_match, to_match, prev_deletion[ i ] + t[ ProfileTransition::DeletionToMatch ], table );
+        tabulatedLogSum<ScalarPack>( to_insertion, prev_match[ i ] + t[ ProfileTransition::MatchToInsertion ], prev_insertion[ i ] + t[ ProfileTransition::InsertionToInsertion ], table );
+        match[ i ] = match_emissions[ i ] + to_match;
+        insertion[ i ] = insertion_emission + to_insertion;
+      }
+    } // tabulatedLogForwardMatchInsertion<Pack>( .. )
+
+/**
+ * Defines the kernels of one variant, in namespace Name, as functions (for
+ * the table of pointers) compiled with the given attributes.
+ */
+#define PROFUSE_DEFINE_ROW_KERNELS( Name, Attributes, PackType, FloatPackType ) \
+    namespace Name { \
+      Attributes inline void \
+      viterbiMatchInsertion ( double const * pm, double const * pi, double const * pd, double const * e, double const ei, double const * t, double * m, double * in, uint32_t const n ) \
+      { row_kernels::viterbiMatchInsertion<PackType>( pm, pi, pd, e, ei, t, m, in, n ); } \
+      Attributes inline double \
+      forwardMatchInsertion ( double const * pm, double const * pi, double const * pd, double const * e, double const ei, double const * t, double * m, double * in, uint32_t const n ) \
+      { return row_kernels::forwardMatchInsertion<PackType>( pm, pi, pd, e, ei, t, m, in, n ); } \
+      Attributes inline void \
+      backwardMatchInsertion ( double const * nm, double const * ni, double const * e, double const es, double const ei, double const * t, double * m, double * in, double * d, uint32_t const n ) \
+      { row_kernels::backwardMatchInsertion<PackType>( nm, ni, e, es, ei, t, m, in, d, n ); } \
+      Attributes inline void \
+      scale ( double * v, double const f, uint32_t const n ) \
+      { row_kernels::scale<PackType>( v, f, n ); } \
+      Attributes inline void \
+      addEmissionPosteriors ( double const * f, double const * b, double const w, double * p, uint32_t const n ) \
+      { row_kernels::addEmissionPosteriors<PackType>( f, b, w, p, n ); } \
+      Attributes inline void \
+      addDeletionTransitionPosteriors ( double const * fm, double const * fd, double const * nd, double const w, double const * t, double * md, double * dd, uint32_t const n ) \
+      { row_kernels::addDeletionTransitionPosteriors<PackType>( fm, fd, nd, w, t, md, dd, n ); } \
+      Attributes inline void \
+      addEmittingTransitionPosteriors ( double const * fm, double const * fi, double const * fd, double const * nm, double const * ni, double const * e, double const ei, double const w, double const * t, double * mm, double * im, double * dm, double * mi, double * ii, uint32_t const n ) \
+      { row_kernels::addEmittingTransitionPosteriors<PackType>( fm, fi, fd, nm, ni, e, ei, w, t, mm, im, dm, mi, ii, n ); } \
+      Attributes inline float \
+      forwardMatchInsertionFloat ( float const * pm, float const * pi, float const * pd, float const * e, float const ei, float const * t, float * m, float * in, uint32_t const n ) \
+      { return row_kernels::forwardMatchInsertion<FloatPackType>( pm, pi, pd, e, ei, t, m, in, n ); } \
+      Attributes inline void \
+      scaleFloat ( float * v, float const f, uint32_t const n ) \
+      { row_kernels::scale<FloatPackType>( v, f, n ); } \
+      Attributes inline void \
+      tabulatedLogForwardMatchInsertion ( double const * pm, double const * pi, double const * pd, double const * e, double const ei, double const * t, double * m, double * in, uint32_t const n ) \
+      { row_kernels::tabulatedLogForwardMatchInsertion<PackType>( pm, pi, pd, e, ei, t, m, in, n ); } \
+    }
+
+#if defined( __GNUC__ ) && !defined( __clang__ )
+    PROFUSE_DEFINE_ROW_KERNELS( scalar, __attribute__(( optimize( "fp-contract=off" ) )), ScalarPack, BasicScalarPack<float> )
+#else
+    PROFUSE_DEFINE_ROW_KERNELS( scalar, , ScalarPack, BasicScalarPack<float> )
+#endif
+#ifdef __PROFUSE_HAVE_KERNEL_ISAS
+    PROFUSE_DEFINE_ROW_KERNELS( sse42, PROFUSE_KERNEL_VARIANT( "sse4.2" ), VectorPack<16>, FloatVectorPack<16> )
+    PROFUSE_DEFINE_ROW_KERNELS( avx2, PROFUSE_KERNEL_VARIANT( "avx2" ), VectorPack<32>, FloatVectorPack<32> )
+    PROFUSE_DEFINE_ROW_KERNELS( avx512, PROFUSE_KERNEL_VARIANT( "avx512f" ), VectorPack<64>, FloatVectorPack<64> )
+#endif // __PROFUSE_HAVE_KERNEL_ISAS
+
+#undef PROFUSE_DEFINE_ROW_KERNELS
+
+#define PROFUSE_ROW_KERNELS_OF( Isa, Name ) \
+    { Isa, Name::viterbiMatchInsertion, Name::forwardMatchInsertion, Name::backwardMatchInsertion, Name::scale, Name::addEmissionPosteriors, Name::addDeletionTransitionPosteriors, Name::addEmittingTransitionPosteriors, Name::forwardMatchInsertionFloat, Name::scaleFloat, Name::tabulatedLogForwardMatchInsertion }
+
+    /**
+     * The kernels of each variant, indexed by KernelIsa::Variant.  Where a
+     * variant isn't compiled in, its entry holds the scalar kernels (but
+     * kernelIsaIsSupported(..) says no).
+     */
+    inline RowKernels const *
+    kernelTable ()
+    {
+      static const RowKernels table[ KernelIsa::Count ] = {
+        PROFUSE_ROW_KERNELS_OF( KernelIsa::Scalar, scalar ),
+#ifdef __PROFUSE_HAVE_KERNEL_ISAS
+        PROFUSE_ROW_KERNELS_OF( KernelIsa::SSE42, sse42 ),
+        PROFUSE_ROW_KERNELS_OF( KernelIsa::AVX2, avx2 ),
+        PROFUSE_ROW_KERNELS_OF( KernelIsa::AVX512, avx512 )
+#else
+        PROFUSE_ROW_KERNELS_OF( KernelIsa::SSE42, scalar ),
+        PROFUSE_ROW_KERNELS_OF( KernelIsa::AVX2, scalar ),
+        PROFUSE_ROW_KERNELS_OF( KernelIsa::AVX512, scalar )
+#endif // __PROFUSE_HAVE_KERNEL_ISAS .. else ..
+      };
+      return table;
+    } // kernelTable()
+
+#undef PROFUSE_ROW_KERNELS_OF
+
+  } // End namespace row_kernels
+
+  /**
+   * The name of the given variant, as accepted by selectKernelIsa(..).
+   */
+  inline char const *
+  kernelIsaName (
+    KernelIsa::Variant const isa
+  )
+  {
+    static char const * const names[ KernelIsa::Count ] = { "scalar", "sse4.2", "avx2", "avx512" };
+    return names[ isa ];
+  } // kernelIsaName( KernelIsa::Variant const )
+
+  /**
+   * True iff the given variant is compiled in and this CPU (and OS) can run
+   * it.
+   */
+  inline bool
+  kernelIsaIsSupported (
+    KernelIsa::Variant const isa
+  )
+  {
+    if( isa == KernelIsa::Scalar ) {
+      return true;
+    }
+#ifdef __PROFUSE_HAVE_KERNEL_ISAS
+    __builtin_cpu_init();
+    switch( isa ) {
+      case KernelIsa::SSE42:
+        return __builtin_cpu_supports( "sse4.2" );
+      case KernelIsa::AVX2:
+        return __builtin_cpu_supports( "avx2" );
+      case KernelIsa::AVX512:
+        return __builtin_cpu_supports( "avx512f" );
+      default:
+        return false;
+    }
+#else
+    return false;
+#endif // __PROFUSE_HAVE_KERNEL_ISAS .. else ..
+  } // kernelIsaIsSupported( KernelIsa::Variant const )
+
+  /**
+   * The widest variant that this CPU supports.
+   */
+  inline KernelIsa::Variant
+  bestKernelIsa ()
+  {
+    for( int isa = ( KernelIsa::Count - 1 ); isa > KernelIsa::Scalar; isa-- ) {
+      if( kernelIsaIsSupported( static_cast<KernelIsa::Variant>( isa ) ) ) {
+        return static_cast<KernelIsa::Variant>( isa );
+      }
+    }
+    return KernelIsa::Scalar;
+  } // bestKernelIsa()
+
+  namespace row_kernels {
+    inline KernelIsa::Variant &
+    selectedIsa ()
+    {
+      static KernelIsa::Variant isa = bestKernelIsa();
+      return isa;
+    } // selectedIsa()
+  } // End namespace row_kernels
+
+  /**
+   * The variant that rowKernels() gives: bestKernelIsa(), unless
+   * selectKernelIsa(..) says otherwise.
+   */
+  inline KernelIsa::Variant
+  selectedKernelIsa ()
+  {
+    return row_kernels::selectedIsa();
+  } // selectedKernelIsa()
+
+  /**
+   * Use the named variant ("scalar", "sse4.2", "avx2", or "avx512"; "auto"
+   * means bestKernelIsa()) from now on.  Throws if the name is unknown or the
+   * CPU can't run that variant.  Call it before starting any threads (and
+   * before constructing the objects that use the kernels).
+   */
+  inline void
+  selectKernelIsa (
+    std::string const & name
+  )
+  {
+    if( name == "auto" ) {
+      row_kernels::selectedIsa() = bestKernelIsa();
+      return;
+    }
+    for( int isa = KernelIsa::Scalar; isa < KernelIsa::Count; isa++ ) {
+      if( name == kernelIsaName( static_cast<KernelIsa::Variant>( isa ) ) ) {
+        if( !kernelIsaIsSupported( static_cast<KernelIsa::Variant>( isa ) ) ) {
+          throw std::string( "The " ) + name + " kernels are not supported on this machine";
+        }
+        row_kernels::selectedIsa() = static_cast<KernelIsa::Variant>( isa );
+        return;
+      }
+    }
+    throw std::string( "Unknown kernel instruction set '" ) + name + "' (expected auto, scalar, sse4.2, avx2, or avx512)";
+  } // selectKernelIsa( string const & )
+
+  /**
+   * The kernels of the selected variant.
+   */
+  inline RowKernels const &
+  rowKernels ()
+  {
+    return row_kernels::kernelTable()[ selectedKernelIsa() ];
+  } // rowKernels()
+
+} // End namespace galosh
+
+#endif // __GALOSH_ROWKERNELS_HPP__
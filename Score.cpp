@@ -9,7 +9,10 @@
 ##      The score program.  It calculates and returns the probability of a
 ##      given sequence dataset (Fasta file of unaligned sequences), given a
 ##      particular Profile HMM model, and conditioning on the number of
-##      sequences (only).
+##      sequences (only).  The numeric types of the dp are chosen with
+##      --precision (see Precision.hpp); with flogsum or mixed it uses the
+##      two-row UnscaledForward or MixedPrecisionForward instead of
+##      DynamicProgramming.
 ##
 #******************************************************************************
 #*
@@ -36,6 +39,11 @@
 #*****************************************************************************/
 
 #include "ScoreAndMaybeAlign.hpp"
+#include "Precision.hpp"
+
+#include <boost/program_options.hpp>
+
+namespace po = boost::program_options;
 
 #ifdef __HAVE_MUSCLE
 int g_argc;
@@ -44,25 +52,85 @@ char **g_argv;
 
 using namespace galosh;
 
+/**
+ * Calculates and prints the forward score, with the numeric types chosen by
+ * dispatchForwardPrecision(..).
+ */
+template <typename ResidueType,
+          typename SequenceResidueType>
+class ScoreRunner {
+public:
+  typedef int result_type;
+
+  ScoreRunner (
+    string const & profile_filename,
+    string const & fasta_filename,
+    uint32_t const sequence_count
+  ) :
+    m_profileFilename( profile_filename ),
+    m_fastaFilename( fasta_filename ),
+    m_sequenceCount( sequence_count )
+  {
+    // Do nothing else.
+  } // <init>( string const &, string const &, uint32_t const )
+
+  template <typename ProbabilityType,
+            typename ScoreType,
+            typename MatrixValueType>
+  int
+  run () const
+  {
+    ScoreAndMaybeAlign<ProbabilityType, ScoreType, MatrixValueType, ResidueType, SequenceResidueType> score_and_maybe_align;
+
+    ScoreType score =
+      score_and_maybe_align.score_and_maybe_align(
+        m_profileFilename,
+        m_fastaFilename,
+        m_sequenceCount,
+        false // just calc forward score, don't use viterbi to get alignments.
+      );
+
+    cout << score << endl;
+    return 0;
+  } // run() const
+
+  /**
+   * Calculates and prints the forward score with one of the forwards that
+   * don't go through DynamicProgramming, one sequence at a time.
+   */
+  template <typename ForwardType>
+  int
+  runForward () const
+  {
+    ProfileTreeRoot<ResidueType, doublerealspace> profile;
+    profile.fromFile( m_profileFilename );
+    Fasta<SequenceResidueType> fasta;
+    fasta.fromFile( m_fastaFilename );
+    const uint32_t sequence_count =
+      ( ( m_sequenceCount == 0 ) ? fasta.size() : min( static_cast<size_t>( m_sequenceCount ), fasta.size() ) );
+
+    const ProfileTables<ResidueType, SequenceResidueType> tables( profile );
+    const ForwardType forward_algorithm( tables );
+    std::vector<uint32_t> residues;
+    double log_score = 0;
+    for( uint32_t seq_i = 0; seq_i < sequence_count; seq_i++ ) {
+      sequenceToOrdinals( fasta[ seq_i ], residues );
+      log_score += forward_algorithm.forward( residues );
+    }
+
+    cout << flogspace::fromLogValue( log_score ) << endl;
+    return 0;
+  } // runForward() const
+
+protected:
+  string m_profileFilename;
+  string m_fastaFilename;
+  uint32_t m_sequenceCount;
+}; // End class ScoreRunner
+
 int
 main ( int const argc, char const ** argv )
 {
-  //typedef bfloat ProbabilityType;
-  //typedef logspace ProbabilityType;
-  //typedef floatrealspace ProbabilityType;
-  typedef doublerealspace ProbabilityType;
-  
-  typedef bfloat ScoreType; // Preferred
-  //typedef logspace ScoreType; // SLOWer than bfloat
-  //typedef realspace ScoreType; // Only for very few & small sequences
-  
-  // if using anything other than LogProbability for the MatrixValueType,
-  // params.useRabinerScaling should be set to true.
-  typedef bfloat MatrixValueType;
-  //typedef logspace MatrixValueType;
-  //typedef doublerealspace MatrixValueType;
-  //typedef floatrealspace MatrixValueType;
-
 #ifdef __PROFUSE_USE_AMINOS
   typedef seqan::AminoAcid20 ResidueType;
   typedef seqan::AminoAcid SequenceResidueType;
@@ -71,38 +139,59 @@ main ( int const argc, char const ** argv )
   typedef seqan::Iupac SequenceResidueType;
 #endif // __PROFUSE_USE_AMINOS .. else ..
 
-  string profile_filename;
-  string fasta_filename;
-  bool use_viterbi = false;
-  if( argc < 3 ) {
-    cout << "Usage: " << argv[ 0 ] << " <profile file> <fasta sequences file>" << endl;
-    exit( 1 );
-  }
-  // else { // ( argc >= 3 )
-  // At least two arguments: profile filename and fasta filename
-  profile_filename = argv[ 1 ];
-  fasta_filename = argv[ 2 ];
-  uint32_t sequence_count = 0; // 0 means use all of the seqs in the fasta file.
-  if( argc > 3 ) {
-    try {
-      sequence_count = boost::lexical_cast<uint32_t>( argv[ 3 ] );
-    } catch( boost::bad_lexical_cast & ) {
-      std::cerr << "Unable to interpret the argument '" << argv[ 3 ] << "' as a count value for use as the number of sequences to use (or as 0 to that all sequences should be used)." << std::endl;
-      exit( 1 );
-    } // End try .. catch block for lexical_cast
-  } // End if argc > 3
+  try {
+    po::options_description visible( "Basic options" );
+    visible.add_options()
+      ( "help,h", "produce help message" )
+      ( "profile,p",
+        po::value<string>(),
+        "filename: where to find the input profile" )
+      ( "fasta,f",
+        po::value<string>(),
+        "input sequences, in (unaligned) Fasta format" )
+      ( "nseq,n",
+        po::value<uint32_t>()->default_value( 0 ),
+        "number of sequences to use (default is ALL)" )
+      ( "precision",
+        po::value<string>()->default_value( "bfloat" ),
+        "the dp matrix values: bfloat (the default; can't underflow), double, float (fastest, with the rows scaled; enough for short sequences), flogsum (unscaled, in log space with tabulated log sums; needs only O(profile length) memory), or mixed (float cells with double row scales, for short sequences; also O(profile length) memory)" )
+      ;
+
+    po::positional_options_description p;
+    p.add( "profile", 1 );
+    p.add( "fasta", 1 );
+    p.add( "nseq", 1 );
 
-  ScoreAndMaybeAlign<ProbabilityType, ScoreType, MatrixValueType, ResidueType, SequenceResidueType> score_and_maybe_align;
+    po::variables_map vm;
+    store( po::command_line_parser( argc, argv ).options( visible ).positional( p ).run(), vm );
+    notify( vm );
 
-  ScoreType score =
-    score_and_maybe_align.score_and_maybe_align(
-      profile_filename,
-      fasta_filename,
-      sequence_count,
-      false // just calc forward score, don't use viterbi to get alignments.
-    );
+#define USAGE() " " << argv[ 0 ] << " [options] <profile file> <fasta sequences file> [<number of sequences to use>]"
 
-  cout << score << endl;
+    if( vm.count( "help" ) > 0 ) {
+      cout << "Usage: " << USAGE() << endl;
+      cout << visible << "\n";
+      return 0;
+    }
+    if( ( vm.count( "profile" ) == 0 ) || ( vm.count( "fasta" ) == 0 ) ) {
+      cout << "Usage: " << USAGE() << endl;
+      exit( 1 );
+    }
 
-  return 0; // success
+    return
+      dispatchForwardPrecision<ResidueType, SequenceResidueType>(
+        parsePrecision( vm[ "precision" ].as<string>() ),
+        ScoreRunner<ResidueType, SequenceResidueType>(
+          vm[ "profile" ].as<string>(),
+          vm[ "fasta" ].as<string>(),
+          vm[ "nseq" ].as<uint32_t>() // 0 means use all of the seqs in the fasta file.
+        )
+      );
+  } catch( std::exception& e ) { /// exceptions thrown by boost stuff
+    cerr << "error: " << e.what() << endl;
+    return 1;
+  } catch( string &err ) {      /// exceptions thrown by parsePrecision, etc.
+    cerr << "error: " << err << endl;
+    return 1;
+  }
 } // main (..)
@@ -52,8 +52,15 @@
 #include "Fasta.hpp"
 #include "Random.hpp"
 #include "DynamicProgramming.hpp"
+#include "ProfileTables.hpp"
+#include "AlignmentPath.hpp"
+#include "PosteriorDecoding.hpp"
+#include "ParallelFor.hpp"
+#include "Precision.hpp"
 
+#include <cctype>
 #include <iostream>
+#include <limits>
 
 #include <seqan/basic.h>
 #include <seqan/sequence.h>
@@ -141,6 +148,9 @@ public:
     ScoreType score;
     DynamicProgramming<ResidueType, ProbabilityType, ScoreType, MatrixValueType> dp;
     typename DynamicProgramming<ResidueType, ProbabilityType, ScoreType, MatrixValueType>::Parameters parameters;
+    if( UsesRabinerScaling<MatrixValueType>::value ) {
+      parameters.useRabinerScaling = true;
+    }
 
     if( use_viterbi ) {
       if( be_verbose ) {
@@ -201,6 +211,159 @@ public:
     return score;
   } // score_and_maybe_align ( string const &, string const &, bool const & use_viterbi )
 
+  /**
+   * The result of posterior-decoding one sequence.
+   */
+  struct PosteriorAlignment {
+    double m_logProbability;
+    double m_expectedAccuracy;
+    AlignmentPath m_path;
+    std::vector<uint8_t> m_confidences;
+  }; // End inner struct PosteriorAlignment
+
+  /**
+   * The parallelFor body for posterior_align: decodes one sequence.
+   */
+  class PosteriorAlignBody {
+  public:
+    PosteriorAlignBody (
+      ProfileTables<ResidueType, SequenceResidueType> const & tables,
+      Fasta<SequenceResidueType> const & fasta,
+      uint32_t const checkpoint_interval,
+      bool const show_confidence,
+      std::vector<PosteriorAlignment> & results
+    ) :
+      m_tables( tables ),
+      m_fasta( fasta ),
+      m_checkpointInterval( checkpoint_interval ),
+      m_showConfidence( show_confidence ),
+      m_results( results )
+    {
+      // Do nothing else.
+    } // <init>( .. )
+
+    void
+    operator() (
+      size_t const seq_i,
+      uint32_t const thread_i
+    )
+    {
+      PosteriorDecoding<ResidueType, SequenceResidueType> decoding( m_tables, m_checkpointInterval );
+      sequenceToOrdinals( m_fasta[ seq_i ], m_residues );
+      PosteriorAlignment & result = m_results[ seq_i ];
+      result.m_logProbability =
+        decoding.decode(
+          m_residues,
+          result.m_path,
+          ( m_showConfidence ? &result.m_confidences : 0 ),
+          result.m_expectedAccuracy
+        );
+    } // operator()( size_t const, uint32_t const )
+
+  protected:
+    ProfileTables<ResidueType, SequenceResidueType> const & m_tables;
+    Fasta<SequenceResidueType> const & m_fasta;
+    uint32_t m_checkpointInterval;
+    bool m_showConfidence;
+    std::vector<PosteriorAlignment> & m_results;
+    std::vector<uint32_t> m_residues; // Per-thread scratch space.
+  }; // End inner class PosteriorAlignBody
+
+  // read in a profile and some sequences, and print the maximum expected
+  // accuracy (posterior decoding) alignment of each sequence to the profile,
+  // and, if show_confidence is true, the posterior probability of each
+  // aligned residue.  The sequences are decoded in parallel on thread_count
+  // threads (0 means one per core), each using
+  // CheckpointedForwardBackward's memory-bounded posteriors.  Returns the
+  // natural log of the total probability of the sequences.
+  double
+  posterior_align (
+    string const & profile_filename,
+    string const & fasta_filename,
+    uint32_t sequence_count, // 0 to use the number of sequences in the fasta file
+    uint32_t const thread_count,
+    uint32_t const checkpoint_interval, // 0 means the square root of each sequence's length
+    bool const show_confidence
+  ) const
+  {
+    typedef ProfileTreeRoot<ResidueType, ProbabilityType> ProfileType;
+
+    ProfileType profile;
+    profile.fromFile( profile_filename );
+
+    Fasta<SequenceResidueType> fasta;
+    fasta.fromFile( fasta_filename );
+
+    sequence_count = ( ( sequence_count == 0 ) ? fasta.size() : min( static_cast<size_t>( sequence_count ), fasta.size() ) );
+
+    const ProfileTables<ResidueType, SequenceResidueType> tables( profile );
+    std::vector<PosteriorAlignment> results( sequence_count );
+    parallelFor(
+      sequence_count,
+      thread_count,
+      PosteriorAlignBody( tables, fasta, checkpoint_interval, show_confidence, results )
+    );
+
+    // The consensus residue of each profile position, for display.
+    const ProfileTables<ResidueType, ResidueType> consensus_tables( profile );
+    std::vector<char> consensus( profile.length() + 1, ' ' );
+    for( uint32_t pos_i = 0; pos_i < profile.length(); pos_i++ ) {
+      uint32_t best_res_i = 0;
+      for( uint32_t res_i = 1; res_i < seqan::ValueSize<ResidueType>::VALUE; res_i++ ) {
+        if( consensus_tables.matchEmission( pos_i, res_i ) > consensus_tables.matchEmission( pos_i, best_res_i ) ) {
+          best_res_i = res_i;
+        }
+      }
+      consensus[ pos_i + 1 ] = static_cast<char>( ResidueType( best_res_i ) );
+    }
+
+    double total_log_probability = 0;
+    std::string profile_line, sequence_line, confidence_line;
+    for( uint32_t seq_i = 0; seq_i < sequence_count; seq_i++ ) {
+      PosteriorAlignment const & result = results[ seq_i ];
+      total_log_probability += result.m_logProbability;
+      cout << "> " << fasta.m_descriptions[ seq_i ] << endl;
+      if( result.m_logProbability == -std::numeric_limits<double>::infinity() ) {
+        cout << "  (this sequence can't be generated by the profile)" << endl << endl;
+        continue;
+      }
+      cout << "  log probability " << result.m_logProbability << ", expected accuracy " << result.m_expectedAccuracy << " of " << seqan::length( fasta[ seq_i ] ) << " residues" << endl;
+      profile_line.clear();
+      sequence_line.clear();
+      confidence_line.clear();
+      uint32_t pos = 0;
+      uint32_t residue_i = 0;
+      for( size_t step_i = 0; step_i < result.m_path.size(); step_i++ ) {
+        const uint8_t state = result.m_path[ step_i ];
+        if( ( state == PathState::Match ) || ( state == PathState::Deletion ) ) {
+          pos += 1;
+          profile_line += consensus[ pos ];
+        } else {
+          profile_line += '.';
+        }
+        if( state == PathState::Deletion ) {
+          sequence_line += '-';
+          confidence_line += ' ';
+          continue;
+        }
+        const char residue = static_cast<char>( fasta[ seq_i ][ residue_i ] );
+        sequence_line += ( ( state == PathState::Match ) ? std::toupper( residue ) : std::tolower( residue ) );
+        if( show_confidence ) {
+          confidence_line += confidenceCode( result.m_confidences[ residue_i ] );
+        }
+        residue_i += 1;
+      } // End foreach step_i
+      cout << "  profile   " << profile_line << endl;
+      cout << "  sequence  " << sequence_line << endl;
+      if( show_confidence ) {
+        cout << "  posterior " << confidence_line << endl;
+      }
+      cout << endl;
+    } // End foreach seq_i
+
+    return total_log_probability;
+  } // posterior_align ( string const &, string const &, uint32_t, uint32_t const, uint32_t const, bool const )
+
 }; // End class ScoreAndMaybeAlign
 
 } // End namespace galosh
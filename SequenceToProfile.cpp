@@ -16,6 +16,13 @@
 ##      defaults as are used in other profuse programs (see
 ##      ProlificParameters.hpp).
 ##
+##      With --all (or --container), every sequence in the Fasta file is
+##      converted, in parallel, each to its own profile: written either to one
+##      file per sequence (named using a pattern, as in
+##      profileToAlignmentProfile) or to a single indexed container file (see
+##      RecordContainer.hpp).  The parameters and conservation rate are set up
+##      once for all of them.
+##
 #******************************************************************************
 #*
 #*    This file is part of profuse, a suite of programs for working with
@@ -45,232 +52,139 @@
 #include "Profile.hpp"
 #include "Fasta.hpp"
 #include "ProlificParameters.hpp" // for the parameters
+#include "ConsensusToProfile.hpp"
+#include "IndividualFilenames.hpp"
+#include "RecordContainer.hpp"
+#include "ParallelFor.hpp"
 
+#include <algorithm>
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include <seqan/basic.h>
 
+#include <boost/program_options.hpp>
+#include <boost/scoped_ptr.hpp>
+
 #ifdef __HAVE_MUSCLE
 int g_argc;
 char **g_argv;
 #endif // __HAVE_MUSCLE
 
+namespace po = boost::program_options;
+
 using namespace seqan;
 
-namespace galosh {
+typedef galosh::ProlificParameters<seqan::Dna, floatrealspace, floatrealspace, floatrealspace>::Parameters ParametersType;
+typedef galosh::ProfileTreeRoot<seqan::Dna, floatrealspace> ProfileType;
 
-/////////////
 /**
+ * The parallelFor body: converts sequence number first_seq + batch_i of the
+ * Fasta into a profile, and puts its text (as it would be written to a
+ * profile file) into slot batch_i.
  */
-template <class ResidueType,
-          class ProbabilityType,
-          class ScoreType,
-          class MatrixValueType,
-          class ProfileType>
-void
-setTransitionsFromParameters (
-  typename ProlificParameters<ResidueType, ProbabilityType, ScoreType, MatrixValueType>::Parameters const & parameters,
-  ProfileType & profile
-)
-{
-  uint32_t profile_length = profile.length();
+class ConvertBody {
+public:
+  ConvertBody (
+    ParametersType const & parameters,
+    galosh::Fasta<seqan::Dna> const & fasta,
+    double const conservation_rate,
+    uint64_t const first_seq,
+    std::vector<std::string> & profile_texts
+  ) :
+    m_parameters( parameters ),
+    m_fasta( fasta ),
+    m_conservationRate( conservation_rate ),
+    m_firstSeq( first_seq ),
+    m_profileTexts( profile_texts )
+  {
+    // Do nothing else.
+  } // <init>( .. )
 
-  double expected_deletions_count =
-      ( parameters.expectedDeletionsCounts.size() > 0 ?
-        parameters.expectedDeletionsCounts[ 0 ] :
-        0.5
-      );
-  double expected_insertions_count =
-    (
-      parameters.useDeletionsForInsertionsParameters ?
-      expected_deletions_count :
-      ( parameters.expectedInsertionsCounts.size() > 0 ?
-        parameters.expectedInsertionsCounts[ 0 ] :
-        0.5
-      )
-    );
-  double expected_deletion_length_as_profile_length_fraction =
-      ( parameters.expectedDeletionLengthAsProfileLengthFractions.size() > 0 ?
-        parameters.expectedDeletionLengthAsProfileLengthFractions[ 0 ] :
-        0.0125
-      );
-  double expected_insertion_length_as_profile_length_fraction =
-    (
-      parameters.useDeletionsForInsertionsParameters ?
-      expected_deletion_length_as_profile_length_fraction :
-      ( parameters.expectedInsertionLengthAsProfileLengthFractions.size() > 0 ?
-        parameters.expectedInsertionLengthAsProfileLengthFractions[ 0 ] :
-        0.0125
-      )
-    );
+  void
+  operator() (
+    size_t const batch_i,
+    uint32_t const thread_i
+  )
+  {
+    galosh::consensusToProfile<seqan::Dna, floatrealspace, floatrealspace, floatrealspace, seqan::Dna, ProfileType>( m_parameters, m_fasta[ m_firstSeq + batch_i ], m_profile, m_conservationRate );
+    std::ostringstream profile_stream;
+    profile_stream << m_profile;
+    m_profileTexts[ batch_i ] = profile_stream.str();
+  } // operator()( size_t const, uint32_t const )
 
-  ProbabilityType deletion_open =
-    ( expected_deletions_count / profile_length );
-  ProbabilityType insertion_open =
-    ( parameters.useDeletionsForInsertionsParameters ?
-    deletion_open :
-    ( expected_insertions_count / profile_length ) );
-        
-  // [ the EV of a geometric is 1/p, where p is prob of stopping, so if q is the prob of continuing, we want ( 1 - q ) = 1/EV. ]
-  ProbabilityType deletion_extension =
-    ( 1.0 - min( ( 1.0 / ( expected_deletion_length_as_profile_length_fraction * profile_length ) ), ( 1.0 / parameters.minExpectedDeletionLength ) ) );
-  ProbabilityType insertion_extension =
-    ( parameters.useDeletionsForInsertionsParameters ? deletion_extension : ( 1.0 - min( ( 1.0 / ( expected_insertion_length_as_profile_length_fraction * profile_length ) ), ( 1.0 / parameters.minExpectedInsertionLength ) ) ) );
-                    
-  // Now set up the profile(s)
-  profile[ Transition::fromPreAlign ][ TransitionFromPreAlign::toPreAlign ] =
-    ( parameters.preAlignInsertion );
-  profile[ Transition::fromPreAlign ][ TransitionFromPreAlign::toBegin ] =
-    ( 1 ) -
-    profile[ Transition::fromPreAlign ][ TransitionFromPreAlign::toPreAlign ];
-  profile[ Transition::fromBegin ][ TransitionFromBegin::toDeletion ] =
-    deletion_open;
-  profile[ Transition::fromBegin ][ TransitionFromBegin::toMatch ] =
-    ( 1 ) -
-    profile[ Transition::fromBegin ][ TransitionFromBegin::toDeletion ];
-                        
-  profile[ Transition::fromMatch ][ TransitionFromMatch::toInsertion ] =
-    insertion_open;
-  profile[ Transition::fromMatch ][ TransitionFromMatch::toDeletion ] =
-    deletion_open;
-  profile[ Transition::fromMatch ][ TransitionFromMatch::toMatch ] =
-    ( 1.0 ) -
-    (
-      profile[ Transition::fromMatch ][ TransitionFromMatch::toInsertion ] +
-      profile[ Transition::fromMatch ][ TransitionFromMatch::toDeletion ]
-    );
-  profile[ Transition::fromInsertion ][ TransitionFromInsertion::toInsertion ] =
-    insertion_extension;
-  profile[ Transition::fromInsertion ][ TransitionFromInsertion::toMatch ] =
-    ( 1.0 ) -
-    profile[ Transition::fromInsertion ][ TransitionFromInsertion::toInsertion ];
-  profile[ Transition::fromDeletion ][ TransitionFromDeletion::toDeletion ] =
-    deletion_extension;
-  profile[ Transition::fromDeletion ][ TransitionFromDeletion::toMatch ] =
-    ( 1.0 ) -
-    profile[ Transition::fromDeletion ][ TransitionFromDeletion::toDeletion ];
-                    
-  // For now we don't use the End distribution ..
-  //profile[ Transition::fromEnd ][ TransitionFromEnd::toPostAlign ] = ( 1 );
-  //profile[ Transition::fromEnd ][ TransitionFromEnd::toLoop ] = ( 0 );
-                      
-  profile[ Transition::fromPostAlign ][ TransitionFromPostAlign::toPostAlign ] =
-    ( parameters.postAlignInsertion );
-  profile[ Transition::fromPostAlign ][ TransitionFromPostAlign::toTerminal ] =
-    ( 1.0 ) -
-    profile[ Transition::fromPostAlign ][ TransitionFromPostAlign::toPostAlign ];
+protected:
+  ParametersType const & m_parameters;
+  galosh::Fasta<seqan::Dna> const & m_fasta;
+  double m_conservationRate;
+  uint64_t m_firstSeq;
+  std::vector<std::string> & m_profileTexts;
+  ProfileType m_profile; // Per-thread, reused across sequences.
+}; // End class ConvertBody
 
-} // setTransitionsFromParameters( ProlificParameters::Parameters const &, ProfileType & profile )
-
-
-/////////////
-/**
- */
-template <class ResidueType,
-          class ProbabilityType,
-          class ScoreType,
-          class MatrixValueType,
-          class SequenceResidueType,
-          class ProfileType>
-void
-consensusToProfile (
-  typename ProlificParameters<ResidueType, ProbabilityType, ScoreType, MatrixValueType>::Parameters const & parameters,
-  Sequence<SequenceResidueType> const & sequence,
-  ProfileType & profile,
-  double const & conservation_rate
-)
+int
+main ( int const argc, char const ** argv )
 {
-  uint32_t profile_length = sequence.length();
+  // For now we assume a Dna distribution.  TODO: Generalize.
+  try {
+    po::options_description visible( "Basic options" );
+    visible.add_options()
+      ( "help,h", "produce help message" )
+      ( "fasta,f",
+        po::value<string>(),
+        "filename: the (unaligned Fasta) sequences" )
+      ( "output,o",
+        po::value<string>(),
+        "filename: where to write the (galosh Profile) profile (default: standard output); with --all, the prefix of the individual profile filenames" )
+      ( "conservation,c",
+        po::value<double>()->default_value( .75 ), // TODO: DEHACKIFY MAGIC # DEFAULT conservation_rate !!
+        "the conservation rate: the match emission mass on each sequence's residue" )
+      ( "all,a",
+        "convert every sequence in the Fasta file, not only the first, each to its own profile" )
+      ( "individual-filename-suffix-pattern,s",
+        po::value<string>()->default_value( "_$n.prof" ),
+        "with --all, pattern for filenames by which to differentiate the output profiles, in which $n will be replaced by the sequence name (possibly modified to be a valid filename) and $d with be replaced by the sequence number" )
+      ( "container,C",
+        po::value<string>(),
+        "filename: write the profiles into this single indexed container file instead of one file per sequence; implies --all" )
+      ( "threads,t",
+        po::value<uint32_t>()->default_value( 0 ),
+        "number of threads for --all (0, the default, means one per core)" )
+      ( "batch-size",
+        po::value<uint32_t>()->default_value( 1024 ),
+        "with --all, number of sequences to convert (in parallel) before writing their profiles out" )
+      ;
 
-  // Resize it, and reinitialize while we're at it.  Note that this will also
-  // even() it.
-  profile.reinitialize( profile_length );
+    po::positional_options_description p;
+    p.add( "fasta", 1 );
+    p.add( "output", 1 );
+    p.add( "conservation", 1 );
 
-  // First calculate the appropriate indel values.
-  setTransitionsFromParameters<ResidueType, ProbabilityType, ScoreType, MatrixValueType, ProfileType>(
-    parameters,
-    profile
-  );
-  // Note Insertion distribution(s) are even now.  TODO: allow an option to set
-  // the Insertion distribution to something else.
+    po::variables_map vm;
+    store( po::command_line_parser( argc, argv ).options( visible ).positional( p ).run(), vm );
+    notify( vm );
 
-  // This is a trick to get the values set correctly:
-  // make an even profile, then set one of them higher than you need it, but
-  // normalize to get the right thing.
+#define USAGE() " " << argv[ 0 ] << " [options] <input (Fasta) filename> [<output (galosh Profile) filename> [<conservation rate>]]"
 
-  // The particular position we use here is arbitrary, since the profile starts
-  // out even().
-  ProbabilityType pattern_trick_value =
-    ( ( conservation_rate == 1.0 ) ? ( 1.0 ) :
-    ( ( ( 1.0 ) - profile[ 0 ][ Emission::Match ][ sequence[ 0 ] ] ) *
-    ( ( conservation_rate / ( 1.0 - conservation_rate ) ) ) ) );
-                      
-  // r is current remaining value (1 - P(base)), p is target value.
-  //x/(r + x) = p
-  //p( r + x) = x
-  // rp + px = x
-  // x - px = rp
-  // x( 1 - p ) = rp
-  // x = r( p / ( 1 - p ) )
-  //cout << "Pattern trick value " << pattern_trick_value << endl; 
-                      
-  for( uint32_t pos_i = 0; pos_i < profile_length; pos_i++ ) {
-    if( conservation_rate == 1.0 ) {
-      profile[ pos_i ][ Emission::Match ].zero();
-    }
-    profile[ pos_i ][ Emission::Match ][ sequence[ pos_i ] ] = pattern_trick_value;
-    if( conservation_rate != 1.0 ) {
-      profile[ pos_i ][ Emission::Match ].normalize( 0 );
+    if( vm.count( "help" ) > 0 ) {
+      cout << "Usage: " << USAGE() << endl;
+      cout << visible << "\n";
+      return 0;
     }
-  } // End foreach position, set it up according to the pattern and conservation_rate.
-
-  // That's it.
-  return;
-} // consensusToProfile( ProlificParameters::Parameters const &, Sequence const &, ProfileType &, double const & )
-
-} // End namespace galosh
-
-int
-main ( int const argc, char const ** argv )
-{
-  // For now we assume a Dna distribution.  TODO: Generalize.
-  if( argc < 2 ) {
-    cout << "Usage: " << argv[ 0 ] << " <input (Fasta) filename> [<output (galosh Profile) filename> [<conservation rate>]]" << endl;
-    exit( 1 );
-  }
-  const bool be_verbose = true; //( argc >= 3 );
-  if( be_verbose ) {
-    cout << "Reading Fasta from file '" << argv[ 1 ] << "'" << endl;
-  }
-  galosh::Fasta<seqan::Dna> fasta;
-  fasta.fromFile( argv[ 1 ] );
-  if( fasta.size() == 0 ) {
-    cout << "No sequences were found in the Fasta file '" << argv[ 1 ] << "'" << endl;
-    return 1;
-  } else if( fasta.size() > 1 ) {
-    if( be_verbose ) {
-      cout << "WARNING: Using only the first sequence in the given Fasta file." << endl;
+    if( vm.count( "fasta" ) == 0 ) {
+      cout << "Usage: " << USAGE() << endl;
+      exit( 1 );
     }
-  }
-  if( be_verbose ) {
-    cout << "\tgot:" << std::endl;
-    cout << fasta[ 0 ];
-    cout << endl;
-  }
 
-  // The parameters
-  // TODO: Let user choose some from command line.
-  galosh::ProlificParameters<seqan::Dna, floatrealspace, floatrealspace, floatrealspace>::Parameters parameters;
+    const string fasta_filename = vm[ "fasta" ].as<string>();
+    const bool use_container = ( vm.count( "container" ) > 0 );
+    const bool convert_all = ( use_container || ( vm.count( "all" ) > 0 ) );
+    const bool be_verbose = !convert_all;
 
-  // arg 3 is the conservation rate (default .75)
-  double conservation_rate = .75; // TODO: DEHACKIFY MAGIC # DEFAULT conservation_rate !!
-  if( argc >= 3 ) {
-    try {
-      conservation_rate = boost::lexical_cast<double>( argv[ 3 ] );
-    } catch( boost::bad_lexical_cast & ) {
-      std::cerr << "Unable to interpret the argument '" << argv[ 3 ] << "' as a real value for use as the conservation rate." << std::endl;
-      exit( 1 );
-    } // End try .. catch block for lexical_cast
+    const double conservation_rate = vm[ "conservation" ].as<double>();
     if( conservation_rate <= 0 ) {
       std::cerr << "The given conservation rate value, " << conservation_rate << ", is zero or negative.  You must supply a value between 0 and 1, and not 0." << std::endl;
       exit( 1 );
@@ -279,28 +193,115 @@ main ( int const argc, char const ** argv )
       std::cerr << "The given conservation rate value, " << conservation_rate << ", is greater than 1.  You must supply a value between 0 and 1." << std::endl;
       exit( 1 );
     }
-  } // End if argc >= 3
-
-  galosh::ProfileTreeRoot<seqan::Dna, floatrealspace> profile;
-  galosh::consensusToProfile<seqan::Dna, floatrealspace, floatrealspace, floatrealspace, seqan::Dna, galosh::ProfileTreeRoot<seqan::Dna, floatrealspace> >( parameters, fasta[ 0 ], profile, conservation_rate );
 
-  if( argc >= 3 ) {
     if( be_verbose ) {
-      cout << "Writing Profile to file '" << argv[ 2 ] << "'" << endl;
+      cout << "Reading Fasta from file '" << fasta_filename << "'" << endl;
     }
-    std::ofstream profile_stream( argv[ 2 ] );
-    assert( profile_stream.good() );
-    profile_stream << profile;
-    profile_stream.close();
-    if( be_verbose ) {
-      cout << "\tdone." << endl;
+    galosh::Fasta<seqan::Dna> fasta;
+    fasta.fromFile( fasta_filename );
+    if( fasta.size() == 0 ) {
+      cout << "No sequences were found in the Fasta file '" << fasta_filename << "'" << endl;
+      return 1;
+    } else if( fasta.size() > 1 ) {
+      if( be_verbose ) {
+        cout << "WARNING: Using only the first sequence in the given Fasta file (use --all to convert them all)." << endl;
+      }
     }
-  } else {
     if( be_verbose ) {
-      cout << "Profile is:" << endl;
+      cout << "\tgot:" << std::endl;
+      cout << fasta[ 0 ];
+      cout << endl;
     }
-    cout << profile;
-    cout << endl;
+
+    // The parameters
+    // TODO: Let user choose some from command line.
+    ParametersType parameters;
+
+    if( !convert_all ) {
+      ProfileType profile;
+      galosh::consensusToProfile<seqan::Dna, floatrealspace, floatrealspace, floatrealspace, seqan::Dna, ProfileType>( parameters, fasta[ 0 ], profile, conservation_rate );
+
+      if( vm.count( "output" ) ) {
+        const string profile_filename = vm[ "output" ].as<string>();
+        if( be_verbose ) {
+          cout << "Writing Profile to file '" << profile_filename << "'" << endl;
+        }
+        std::ofstream profile_stream( profile_filename.c_str() );
+        if( !profile_stream.good() ) {
+          cerr << "The profile output file '" << profile_filename << "' could not be opened." << endl;
+          exit( 1 );
+        }
+        profile_stream << profile;
+        profile_stream.close();
+        if( be_verbose ) {
+          cout << "\tdone." << endl;
+        }
+      } else {
+        if( be_verbose ) {
+          cout << "Profile is:" << endl;
+        }
+        cout << profile;
+        cout << endl;
+      }
+      exit( 0 );
+    } // End if !convert_all
+
+    /// Convert them all, a batch at a time, writing each batch's profiles in
+    /// sequence order (so the output doesn't depend on the number of threads).
+    const uint32_t thread_count = vm[ "threads" ].as<uint32_t>();
+    const uint32_t batch_size = std::max( static_cast<uint32_t>( 1 ), vm[ "batch-size" ].as<uint32_t>() );
+    const string output_filename_prefix = ( vm.count( "output" ) ? vm[ "output" ].as<string>() : string( "" ) );
+    const string individual_filename_suffix_pattern = vm[ "individual-filename-suffix-pattern" ].as<string>();
+    const bool use_stdout = ( !use_container && ( vm.count( "output" ) == 0 ) );
+
+    boost::scoped_ptr<galosh::RecordContainerWriter> container_ptr;
+    if( use_container ) {
+      container_ptr.reset( new galosh::RecordContainerWriter( vm[ "container" ].as<string>(), "Profile" ) );
+    }
+
+    const uint64_t sequence_count = fasta.size();
+    std::vector<std::string> profile_texts( std::min( static_cast<uint64_t>( batch_size ), sequence_count ) );
+    for( uint64_t first_seq = 0; first_seq < sequence_count; first_seq += batch_size ) {
+      const size_t batch_seqs = std::min( static_cast<uint64_t>( batch_size ), ( sequence_count - first_seq ) );
+      galosh::parallelFor(
+        batch_seqs,
+        thread_count,
+        ConvertBody( parameters, fasta, conservation_rate, first_seq, profile_texts )
+      );
+      for( size_t batch_i = 0; batch_i < batch_seqs; batch_i++ ) {
+        const uint64_t seq_i = first_seq + batch_i;
+        if( use_container ) {
+          container_ptr->add( fasta.m_descriptions[ seq_i ], seq_i, profile_texts[ batch_i ] );
+        } else if( use_stdout ) {
+          cout << "#" << fasta.m_descriptions[ seq_i ] << endl;
+          cout << profile_texts[ batch_i ];
+        } else {
+          const string profile_filename =
+            galosh::individual_filename( output_filename_prefix, individual_filename_suffix_pattern, fasta.m_descriptions[ seq_i ], seq_i );
+          std::ofstream profile_stream( profile_filename.c_str() );
+          if( !profile_stream.good() ) {
+            cerr << "The profile output file '" << profile_filename << "' could not be opened." << endl;
+            exit( 1 );
+          }
+          profile_stream << profile_texts[ batch_i ];
+          profile_stream.close();
+          // We print out the output files as a side effect
+          cout << profile_filename << endl;
+        }
+      }
+    } // End foreach batch
+
+    if( use_container ) {
+      container_ptr->close();
+      // We print out the output file as a side effect
+      cout << vm[ "container" ].as<string>() << endl;
+    }
+  } catch( std::exception& e ) { /// exceptions thrown by boost stuff
+    cerr << "error: " << e.what() << endl;
+    return 1;
+  } catch( string &err ) {      /// exceptions thrown by RecordContainerWriter, parallelFor, etc.
+    cerr << "error: " << err << endl;
+    return 1;
   }
 
   exit( 0 );
@@ -0,0 +1,514 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      SequenceWeights.hpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      Sequence weighting schemes for counting a multiple alignment (see
+##      AlignmentColumnCounts.hpp), so that redundant (near-duplicate)
+##      sequences don't dominate the counts:
+##
+##        PositionBasedWeights: Henikoff and Henikoff's position-based
+##          weights.  In each match column with k distinct residues, a
+##          residue that appears n times contributes 1/(k*n) to its sequence's
+##          weight, which is then divided by the sequence's number of
+##          residues in match columns.  Computing them takes the (unweighted)
+##          counts, then one more pass over the rows: linear in the size of
+##          the alignment.
+##
+##        ClusterWeights: each sequence gets 1/(the size of its cluster).
+##          By default the clusters are the sets of sequences identical in
+##          the match columns, found by a 128-bit hash of each, in linear time
+##          and with memory for just one hash per distinct sequence.  Given a
+##          minimum identity below 1, they are near-duplicates instead: each
+##          sequence joins the first cluster whose first sequence is at least
+##          that identical to it, or else starts one.  That takes time
+##          proportional to the number of sequences times the number of
+##          clusters, and keeps a copy of each cluster's first sequence.
+##
+##      Both compute weights for one batch of rows at a time, so they work
+##      with streamed alignments (given the first pass's counts).  The
+##      weights are not normalized; scale the weighted counts instead (see
+##      AlignmentColumnCounts::scaleCounts(..)).
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#if     _MSC_VER > 1000
+#pragma once
+#endif
+
+#ifndef __GALOSH_SEQUENCEWEIGHTS_HPP__
+#define __GALOSH_SEQUENCEWEIGHTS_HPP__
+
+#include "AlignmentColumnCounts.hpp"
+#include "ParallelFor.hpp"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+namespace galosh {
+
+  namespace SequenceWeighting {
+    enum Index {
+      None,
+      PositionBased,
+      Cluster
+    };
+  } // End namespace SequenceWeighting
+
+template <typename ResidueType>
+class PositionBasedWeights {
+public:
+  typedef AlignmentColumnCounts<ResidueType> CountsType;
+  enum { CodeCount = CountsType::CodeCount, GapCode = CountsType::GapCode };
+
+  /**
+   * counts holds the unweighted counts of all of the rows.
+   */
+  PositionBasedWeights (
+    CountsType const & counts
+  ) :
+    m_counts( counts ),
+    m_contributions( counts.profileLength() * CodeCount, 0.0 )
+  {
+    for( uint32_t pos_i = 0; pos_i < counts.profileLength(); pos_i++ ) {
+      uint32_t distinct_residues = 0;
+      for( uint32_t code = 0; code < GapCode; code++ ) {
+        distinct_residues += ( counts.count( pos_i, code ) > 0 );
+      }
+      for( uint32_t code = 0; code < GapCode; code++ ) {
+        if( counts.count( pos_i, code ) > 0 ) {
+          m_contributions[ ( pos_i * CodeCount ) + code ] =
+            ( 1.0 / ( distinct_residues * counts.count( pos_i, code ) ) );
+        }
+      }
+    }
+  } // <init>( CountsType const & )
+
+  /**
+   * Compute the weights of the given rows, using thread_count threads.
+   */
+  void
+  compute (
+    char const * const * rows,
+    size_t const row_count,
+    uint32_t const thread_count,
+    std::vector<double> & weights
+  ) const
+  {
+    weights.resize( row_count );
+    const size_t tile_count = ( ( row_count + CountsType::TileRows - 1 ) / CountsType::TileRows );
+    parallelFor( tile_count, thread_count, ComputeTileBody( *this, rows, row_count, weights ) );
+  } // compute( char const * const *, size_t const, uint32_t const, vector<double> & ) const
+
+protected:
+  /**
+   * The parallelFor body: computes the weights of the rows in tile tile_i,
+   * a block of match columns at a time (so that block's contributions stay
+   * in cache).  Each row's contributions are summed in column order, so the
+   * weights don't depend on the number of threads.
+   */
+  class ComputeTileBody {
+  public:
+    ComputeTileBody (
+      PositionBasedWeights const & pb_weights,
+      char const * const * rows,
+      size_t const row_count,
+      std::vector<double> & weights
+    ) :
+      m_pbWeights( pb_weights ),
+      m_rows( rows ),
+      m_rowCount( row_count ),
+      m_weights( weights )
+    {
+      // Do nothing else.
+    } // <init>( .. )
+
+    void
+    operator() (
+      size_t const tile_i,
+      uint32_t const thread_i
+    )
+    {
+      CountsType const & counts = m_pbWeights.m_counts;
+      std::vector<uint32_t> const & match_columns = counts.matchColumns();
+      const size_t first_row = tile_i * CountsType::TileRows;
+      const uint32_t tile_rows =
+        static_cast<uint32_t>( std::min( static_cast<size_t>( CountsType::TileRows ), ( m_rowCount - first_row ) ) );
+      m_sums.assign( tile_rows, 0.0 );
+      m_lengths.assign( tile_rows, 0 );
+      for( uint32_t first_pos = 0; first_pos < match_columns.size(); first_pos += CountsType::BlockColumns ) {
+        const uint32_t last_pos =
+          std::min( static_cast<uint32_t>( first_pos + CountsType::BlockColumns ), static_cast<uint32_t>( match_columns.size() ) );
+        for( uint32_t row_i = 0; row_i < tile_rows; row_i++ ) {
+          char const * row = m_rows[ first_row + row_i ];
+          double sum = m_sums[ row_i ];
+          uint32_t length = m_lengths[ row_i ];
+          for( uint32_t pos_i = first_pos; pos_i < last_pos; pos_i++ ) {
+            const uint8_t code = counts.code( row[ match_columns[ pos_i ] ] );
+            sum += m_pbWeights.m_contributions[ ( pos_i * CodeCount ) + code ];
+            length += ( code != GapCode );
+          }
+          m_sums[ row_i ] = sum;
+          m_lengths[ row_i ] = length;
+        }
+      } // End foreach block of match columns
+      for( uint32_t row_i = 0; row_i < tile_rows; row_i++ ) {
+        m_weights[ first_row + row_i ] =
+          ( ( m_lengths[ row_i ] == 0 ) ? 0.0 : ( m_sums[ row_i ] / m_lengths[ row_i ] ) );
+      }
+    } // operator()( size_t const, uint32_t const )
+
+  protected:
+    PositionBasedWeights const & m_pbWeights;
+    char const * const * m_rows;
+    size_t m_rowCount;
+    std::vector<double> & m_weights;
+    std::vector<double> m_sums; // Per-thread scratch space.
+    std::vector<uint32_t> m_lengths; // Per-thread scratch space.
+  }; // End inner class ComputeTileBody
+
+  CountsType const & m_counts;
+  /// 1/(k*n) for each match column and residue code (0 for gaps).
+  std::vector<double> m_contributions;
+
+}; // End class PositionBasedWeights
+
+template <typename ResidueType>
+class ClusterWeights {
+public:
+  typedef AlignmentColumnCounts<ResidueType> CountsType;
+  enum { GapCode = CountsType::GapCode };
+
+  /**
+   * counts supplies the match columns and residue codes; it needn't have any
+   * rows counted yet.  Rows that are at least min_identity identical (see
+   * isIdentical(..)) share a cluster; with the default, 1, only rows that
+   * are identical in the match columns do.
+   */
+  ClusterWeights (
+    CountsType const & counts,
+    double const min_identity = 1.0
+  ) :
+    m_counts( counts ),
+    m_minIdentity( min_identity )
+  {
+    // Do nothing else.
+  } // <init>( CountsType const &, double const )
+
+  /**
+   * Add the given rows to the clusters (all of the rows must be added before
+   * computing any weights).
+   */
+  void
+  add (
+    char const * const * rows,
+    size_t const row_count,
+    uint32_t const thread_count
+  )
+  {
+    if( isExact() ) {
+      hashRows( rows, row_count, thread_count );
+      for( size_t row_i = 0; row_i < row_count; row_i++ ) {
+        m_hashedSizes[ m_hashes[ row_i ] ] += 1;
+      }
+      return;
+    }
+    // Each row joins the first cluster whose representative (its first row)
+    // it is identical enough to, or else starts one.  Among the clusters
+    // from before this batch, that is found in parallel; then the rows that
+    // found none are compared, in order, to the ones this batch started.
+    const size_t old_cluster_count = m_sizes.size();
+    findClusters( rows, row_count, old_cluster_count, thread_count );
+    std::vector<uint32_t> const & match_columns = m_counts.matchColumns();
+    for( size_t row_i = 0; row_i < row_count; row_i++ ) {
+      size_t cluster_i = m_clusterIndices[ row_i ];
+      if( cluster_i == NoCluster ) {
+        for( cluster_i = old_cluster_count; cluster_i < m_sizes.size(); cluster_i++ ) {
+          if( isIdentical( representative( cluster_i ), rows[ row_i ] ) ) {
+            break;
+          }
+        }
+        if( cluster_i == m_sizes.size() ) {
+          for( size_t pos_i = 0; pos_i < match_columns.size(); pos_i++ ) {
+            m_representatives.push_back( m_counts.code( rows[ row_i ][ match_columns[ pos_i ] ] ) );
+          }
+          m_sizes.push_back( 0 );
+        }
+      }
+      m_sizes[ cluster_i ] += 1;
+    }
+  } // add( char const * const *, size_t const, uint32_t const )
+
+  /**
+   * The number of clusters made so far.
+   */
+  size_t
+  clusterCount () const
+  {
+    return ( isExact() ? m_hashedSizes.size() : m_sizes.size() );
+  } // clusterCount() const
+
+  /**
+   * Compute the weights of the given rows, using thread_count threads.
+   */
+  void
+  compute (
+    char const * const * rows,
+    size_t const row_count,
+    uint32_t const thread_count,
+    std::vector<double> & weights
+  )
+  {
+    weights.resize( row_count );
+    if( isExact() ) {
+      hashRows( rows, row_count, thread_count );
+      for( size_t row_i = 0; row_i < row_count; row_i++ ) {
+        typename HashedSizeMap::const_iterator it = m_hashedSizes.find( m_hashes[ row_i ] );
+        if( it == m_hashedSizes.end() ) {
+          throw std::string( "ClusterWeights::compute(..): a row was not added first" );
+        }
+        weights[ row_i ] = ( 1.0 / it->second );
+      }
+      return;
+    }
+    // (Each row finds the cluster that it joined when it was added: no
+    // earlier cluster's representative was identical enough to it then,
+    // either.)
+    findClusters( rows, row_count, m_sizes.size(), thread_count );
+    for( size_t row_i = 0; row_i < row_count; row_i++ ) {
+      if( m_clusterIndices[ row_i ] == NoCluster ) {
+        throw std::string( "ClusterWeights::compute(..): a row was not added first" );
+      }
+      weights[ row_i ] = ( 1.0 / m_sizes[ m_clusterIndices[ row_i ] ] );
+    }
+  } // compute( char const * const *, size_t const, uint32_t const, vector<double> & )
+
+protected:
+  static const size_t NoCluster = static_cast<size_t>( -1 );
+
+  /**
+   * A row's match column codes, hashed twice (FNV-1a, and a
+   * multiply-xorshift hash), for 128 bits: with n distinct rows, the chance
+   * that any two of them collide is about n^2 / 2^129 (under 1e-20 for a
+   * billion rows), so rows aren't kept to be compared.
+   */
+  typedef std::pair<uint64_t, uint64_t> RowHash;
+  typedef std::map<RowHash, uint64_t> HashedSizeMap;
+
+  bool
+  isExact () const
+  {
+    return ( m_minIdentity >= 1.0 );
+  } // isExact() const
+
+  /**
+   * The match column codes of the representative of the given cluster.
+   */
+  uint8_t const *
+  representative (
+    size_t const cluster_i
+  ) const
+  {
+    return &m_representatives[ cluster_i * m_counts.matchColumns().size() ];
+  } // representative( size_t const ) const
+
+  /**
+   * True iff row is at least m_minIdentity identical to the row with the
+   * given match column codes: of the match columns at which either has a
+   * residue, that fraction have the same residue in both.  (Two rows with
+   * no residues at all are identical.)
+   */
+  bool
+  isIdentical (
+    uint8_t const * codes,
+    char const * row
+  ) const
+  {
+    std::vector<uint32_t> const & match_columns = m_counts.matchColumns();
+    uint32_t same_count = 0;
+    uint32_t residue_count = 0;
+    for( size_t pos_i = 0; pos_i < match_columns.size(); pos_i++ ) {
+      const uint8_t code = m_counts.code( row[ match_columns[ pos_i ] ] );
+      if( ( code != GapCode ) || ( codes[ pos_i ] != GapCode ) ) {
+        residue_count += 1;
+        same_count += ( code == codes[ pos_i ] );
+      }
+    }
+    return ( same_count >= ( m_minIdentity * residue_count ) );
+  } // isIdentical( uint8_t const *, char const * ) const
+
+  /**
+   * The parallelFor body: hashes the match column codes of each row in tile
+   * tile_i.
+   */
+  class HashTileBody {
+  public:
+    HashTileBody (
+      CountsType const & counts,
+      char const * const * rows,
+      size_t const row_count,
+      std::vector<RowHash> & hashes
+    ) :
+      m_counts( counts ),
+      m_rows( rows ),
+      m_rowCount( row_count ),
+      m_hashes( hashes )
+    {
+      // Do nothing else.
+    } // <init>( .. )
+
+    void
+    operator() (
+      size_t const tile_i,
+      uint32_t const thread_i
+    )
+    {
+      std::vector<uint32_t> const & match_columns = m_counts.matchColumns();
+      const size_t first_row = tile_i * CountsType::TileRows;
+      const size_t last_row = std::min( ( first_row + CountsType::TileRows ), m_rowCount );
+      for( size_t row_i = first_row; row_i < last_row; row_i++ ) {
+        char const * row = m_rows[ row_i ];
+        uint64_t fnv_hash = 14695981039346656037ull;
+        uint64_t xorshift_hash = 0;
+        for( size_t pos_i = 0; pos_i < match_columns.size(); pos_i++ ) {
+          const uint8_t code = m_counts.code( row[ match_columns[ pos_i ] ] );
+          fnv_hash ^= code;
+          fnv_hash *= 1099511628211ull;
+          xorshift_hash = ( ( xorshift_hash + code + 1 ) * 11400714819323198485ull );
+          xorshift_hash ^= ( xorshift_hash >> 29 );
+        }
+        m_hashes[ row_i ] = RowHash( fnv_hash, xorshift_hash );
+      }
+    } // operator()( size_t const, uint32_t const )
+
+  protected:
+    CountsType const & m_counts;
+    char const * const * m_rows;
+    size_t m_rowCount;
+    std::vector<RowHash> & m_hashes;
+  }; // End inner class HashTileBody
+
+  void
+  hashRows (
+    char const * const * rows,
+    size_t const row_count,
+    uint32_t const thread_count
+  )
+  {
+    m_hashes.resize( row_count );
+    const size_t tile_count = ( ( row_count + CountsType::TileRows - 1 ) / CountsType::TileRows );
+    parallelFor( tile_count, thread_count, HashTileBody( m_counts, rows, row_count, m_hashes ) );
+  } // hashRows( char const * const *, size_t const, uint32_t const )
+
+  /**
+   * The parallelFor body: finds, for each row in tile tile_i, the first of
+   * the first cluster_count clusters whose representative it is identical
+   * enough to (or NoCluster).
+   */
+  class FindClustersTileBody {
+  public:
+    FindClustersTileBody (
+      ClusterWeights const & clusters,
+      char const * const * rows,
+      size_t const row_count,
+      size_t const cluster_count,
+      std::vector<size_t> & cluster_indices
+    ) :
+      m_clusters( clusters ),
+      m_rows( rows ),
+      m_rowCount( row_count ),
+      m_clusterCount( cluster_count ),
+      m_clusterIndices( cluster_indices )
+    {
+      // Do nothing else.
+    } // <init>( .. )
+
+    void
+    operator() (
+      size_t const tile_i,
+      uint32_t const thread_i
+    )
+    {
+      const size_t first_row = tile_i * CountsType::TileRows;
+      const size_t last_row = std::min( ( first_row + CountsType::TileRows ), m_rowCount );
+      for( size_t row_i = first_row; row_i < last_row; row_i++ ) {
+        m_clusterIndices[ row_i ] = NoCluster;
+        for( size_t cluster_i = 0; cluster_i < m_clusterCount; cluster_i++ ) {
+          if( m_clusters.isIdentical( m_clusters.representative( cluster_i ), m_rows[ row_i ] ) ) {
+            m_clusterIndices[ row_i ] = cluster_i;
+            break;
+          }
+        }
+      }
+    } // operator()( size_t const, uint32_t const )
+
+  protected:
+    ClusterWeights const & m_clusters;
+    char const * const * m_rows;
+    size_t m_rowCount;
+    size_t m_clusterCount;
+    std::vector<size_t> & m_clusterIndices;
+  }; // End inner class FindClustersTileBody
+
+  void
+  findClusters (
+    char const * const * rows,
+    size_t const row_count,
+    size_t const cluster_count,
+    uint32_t const thread_count
+  )
+  {
+    m_clusterIndices.resize( row_count );
+    const size_t tile_count = ( ( row_count + CountsType::TileRows - 1 ) / CountsType::TileRows );
+    parallelFor( tile_count, thread_count, FindClustersTileBody( *this, rows, row_count, cluster_count, m_clusterIndices ) );
+  } // findClusters( char const * const *, size_t const, size_t const, uint32_t const )
+
+  CountsType const & m_counts;
+  double m_minIdentity;
+
+  /// With m_minIdentity 1: the number of rows with each hash.
+  HashedSizeMap m_hashedSizes;
+
+  /// Otherwise: the match column codes of each cluster's representative,
+  /// one after another, and the number of rows in each cluster.
+  std::vector<uint8_t> m_representatives;
+  std::vector<uint64_t> m_sizes;
+
+  std::vector<RowHash> m_hashes; // Scratch space.
+  std::vector<size_t> m_clusterIndices; // Scratch space.
+
+}; // End class ClusterWeights
+
+} // End namespace galosh
+
+#endif // __GALOSH_SEQUENCEWEIGHTS_HPP__
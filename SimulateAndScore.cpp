@@ -0,0 +1,253 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      SimulateAndScore.cpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      The simulateAndScore program.  It draws sequences from a "true"
+##      profile and scores and aligns them to a scoring profile (by default
+##      the same one), in memory and in parallel (see SimulateAndScore.hpp),
+##      then reports how well the alignments recover the true paths, and how
+##      fast it all went.  It uses profuse's in-tree dp engines, not the
+##      prolific DynamicProgramming of the score and align programs, and it
+##      names them in its output: its metrics are those engines', not what
+##      drawSequences followed by score or align would give.
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#include "Algebra.hpp"
+#include "Profile.hpp"
+#include "SimulateAndScore.hpp"
+#include "ParallelFor.hpp"
+
+#include <algorithm>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <seqan/basic.h>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/program_options.hpp>
+
+#ifdef __HAVE_MUSCLE
+int g_argc;
+char **g_argv;
+#endif // __HAVE_MUSCLE
+
+namespace po = boost::program_options;
+
+using namespace seqan;
+
+int
+main ( int const argc, char const ** argv )
+{
+#ifdef __PROFUSE_USE_AMINOS
+  typedef seqan::AminoAcid20 ResidueType;
+#else // __PROFUSE_USE_AMINOS .. else
+  typedef seqan::Dna ResidueType;
+#endif // __PROFUSE_USE_AMINOS .. else ..
+
+  //typedef bfloat ProbabilityType;
+  //typedef logspace ProbabilityType;
+  //typedef floatrealspace ProbabilityType;
+  typedef doublerealspace ProbabilityType;
+
+  try {
+    po::options_description visible( "Basic options" );
+    visible.add_options()
+      ( "help,h", "produce help message" )
+      ( "profile,p",
+        po::value<string>(),
+        "filename: the (galosh Profile) true profile to draw sequences from" )
+      ( "nseq,n",
+        po::value<uint64_t>(),
+        "number of sequences to draw" )
+      ( "scoring-profile,s",
+        po::value<string>(),
+        "filename: the (galosh Profile) profile to score and align the sequences with (default: the true profile)" )
+      ( "seed,r",
+        po::value<uint64_t>(),
+        "random seed (default: the current time)" )
+      ( "align,a",
+        po::value<string>()->default_value( "viterbi" ),
+        "how to align the sequences, with the in-tree engines (not align's DynamicProgramming): viterbi (CheckpointedViterbi), mea (maximum expected accuracy, by PosteriorDecoding), or none (just score them)" )
+      ( "forward,f",
+        po::value<string>()->default_value( "scaled" ),
+        "how to compute the forward scores, with the in-tree engines (not score's DynamicProgramming), with --align viterbi or none (--align mea scores the sequences with its own scaled forward-backward, so it can't be combined with this option): scaled (doubles, each dp row scaled to sum to 1), mixed (floats, each dp row scaled to sum to 1, for short sequences; within about 1e-7 nats per residue), flogsum (unscaled, in log space, with tabulated log sums, each within 5e-7 nats), or logsum (unscaled, in exact log space)" )
+      ( "threads,t",
+        po::value<uint32_t>()->default_value( 0 ),
+        "number of threads (0, the default, means one per core); the results don't depend on it" )
+      ( "batch-size",
+        po::value<uint32_t>()->default_value( 65536 ),
+        "number of sequences to process (in parallel) at a time; memory use is proportional to this, not to the number of sequences" )
+      ( "checkpoint-interval",
+        po::value<uint32_t>()->default_value( 0 ),
+        "keep every this-many-th dp row (0, the default, means the square root of the sequence length)" )
+      ( "isa",
+        po::value<string>()->default_value( "auto" ),
+        "the instruction set of the dp kernels: auto (the default: the best that this CPU supports), scalar, sse4.2, avx2, or avx512; the results don't depend on it" )
+      ( "verbose,v",
+        "show the profiles" )
+      ;
+
+    po::positional_options_description p;
+    p.add( "profile", 1 );
+    p.add( "nseq", 1 );
+    p.add( "seed", 1 );
+
+    po::variables_map vm;
+    store( po::command_line_parser( argc, argv ).options( visible ).positional( p ).run(), vm );
+    notify( vm );
+
+#define USAGE() " " << argv[ 0 ] << " [options] <true (galosh Profile) profile filename> <num seqs> [<random seed>]"
+
+    if( vm.count( "help" ) > 0 ) {
+      cout << "Usage: " << USAGE() << endl;
+      cout << visible << "\n";
+      return 0;
+    }
+    if( ( vm.count( "profile" ) == 0 ) || ( vm.count( "nseq" ) == 0 ) ) {
+      cout << "Usage: " << USAGE() << endl;
+      exit( 1 );
+    }
+
+    const string profile_filename = vm[ "profile" ].as<string>();
+    const string scoring_profile_filename =
+      ( vm.count( "scoring-profile" ) ? vm[ "scoring-profile" ].as<string>() : profile_filename );
+    const uint64_t num_draws = vm[ "nseq" ].as<uint64_t>();
+    const uint64_t random_seed =
+      ( vm.count( "seed" ) ? vm[ "seed" ].as<uint64_t>() : static_cast<uint64_t>( std::time( NULL ) ) );
+    const uint32_t thread_count = vm[ "threads" ].as<uint32_t>();
+    const uint32_t batch_size = std::max( static_cast<uint32_t>( 1 ), vm[ "batch-size" ].as<uint32_t>() );
+    const uint32_t checkpoint_interval = vm[ "checkpoint-interval" ].as<uint32_t>();
+    const bool be_verbose = ( vm.count( "verbose" ) > 0 );
+    galosh::selectKernelIsa( vm[ "isa" ].as<string>() );
+
+    galosh::AlignMethod::Index align_method;
+    const string align_name = vm[ "align" ].as<string>();
+    if( align_name == "viterbi" ) {
+      align_method = galosh::AlignMethod::Viterbi;
+    } else if( align_name == "mea" ) {
+      align_method = galosh::AlignMethod::MEA;
+    } else if( align_name == "none" ) {
+      align_method = galosh::AlignMethod::None;
+    } else {
+      cerr << "Unknown alignment method '" << align_name << "': use viterbi, mea, or none." << endl;
+      exit( 1 );
+    }
+
+    galosh::ForwardMethod::Index forward_method;
+    const string forward_name = vm[ "forward" ].as<string>();
+    if( forward_name == "scaled" ) {
+      forward_method = galosh::ForwardMethod::Scaled;
+    } else if( forward_name == "mixed" ) {
+      forward_method = galosh::ForwardMethod::MixedPrecision;
+    } else if( forward_name == "flogsum" ) {
+      forward_method = galosh::ForwardMethod::TabulatedLogSum;
+    } else if( forward_name == "logsum" ) {
+      forward_method = galosh::ForwardMethod::ExactLogSum;
+    } else {
+      cerr << "Unknown forward method '" << forward_name << "': use scaled, mixed, flogsum, or logsum." << endl;
+      exit( 1 );
+    }
+    if( ( align_method == galosh::AlignMethod::MEA ) && !vm[ "forward" ].defaulted() ) {
+      cerr << "--forward can't be used with --align mea, which computes the forward scores with its own (scaled) forward-backward." << endl;
+      exit( 1 );
+    }
+
+    typedef galosh::ProfileTreeRoot<ResidueType, ProbabilityType> ProfileType;
+    ProfileType true_profile;
+    true_profile.fromFile( profile_filename );
+    ProfileType scoring_profile;
+    scoring_profile.fromFile( scoring_profile_filename );
+    if( be_verbose ) {
+      cout << "True profile, from file '" << profile_filename << "':" << endl;
+      cout << true_profile << endl;
+      cout << "Scoring profile, from file '" << scoring_profile_filename << "':" << endl;
+      cout << scoring_profile << endl;
+    }
+
+    const galosh::ProfileSampler<ResidueType> sampler( true_profile );
+    const galosh::ProfileTables<ResidueType, ResidueType> tables( scoring_profile );
+    galosh::ProfileTables<ResidueType, ResidueType> log_tables( tables );
+    log_tables.convertToLogs();
+    const galosh::MixedPrecisionForward<ResidueType, ResidueType> mixed_forward( tables );
+    const galosh::UnscaledForward<ResidueType, ResidueType, galosh::flogspace> tabulated_forward( tables );
+    const galosh::UnscaledForward<ResidueType, ResidueType, galosh::exactlogspace> exact_forward( tables );
+
+    const boost::posix_time::ptime start_time = boost::posix_time::microsec_clock::universal_time();
+    galosh::SimulationTotals totals;
+    std::vector<galosh::SimulatedSequenceResult> results( std::min( static_cast<uint64_t>( batch_size ), num_draws ) );
+    for( uint64_t first_draw = 0; first_draw < num_draws; first_draw += batch_size ) {
+      const size_t batch_draws = std::min( static_cast<uint64_t>( batch_size ), ( num_draws - first_draw ) );
+      galosh::parallelFor(
+        batch_draws,
+        thread_count,
+        galosh::SimulateAndScoreBody<ResidueType>( sampler, tables, log_tables, forward_method, mixed_forward, tabulated_forward, exact_forward, align_method, checkpoint_interval, random_seed, first_draw, results )
+      );
+      for( size_t batch_i = 0; batch_i < batch_draws; batch_i++ ) {
+        totals.add( results[ batch_i ], tables.m_profileLength );
+      }
+    } // End foreach batch
+    const double elapsed_seconds =
+      ( boost::posix_time::microsec_clock::universal_time() - start_time ).total_microseconds() / 1.0E6;
+
+    cout << "true profile\t" << profile_filename << endl;
+    cout << "scoring profile\t" << scoring_profile_filename << endl;
+    cout << "alignment method\t" << align_name << endl;
+    if( align_method != galosh::AlignMethod::MEA ) {
+      cout << "forward method\t" << forward_name << endl;
+    }
+    cout << "random seed\t" << random_seed << endl;
+    // The totals are of these engines, not of score's and align's.
+    if( align_method == galosh::AlignMethod::MEA ) {
+      cout << "forward engine\tPosteriorDecoding" << endl;
+    } else if( forward_method == galosh::ForwardMethod::MixedPrecision ) {
+      cout << "forward engine\tMixedPrecisionForward" << endl;
+    } else if( forward_method == galosh::ForwardMethod::Scaled ) {
+      cout << "forward engine\tCheckpointedForwardBackward" << endl;
+    } else {
+      cout << "forward engine\tUnscaledForward" << endl;
+    }
+    if( align_method == galosh::AlignMethod::Viterbi ) {
+      cout << "alignment engine\tCheckpointedViterbi" << endl;
+    } else if( align_method == galosh::AlignMethod::MEA ) {
+      cout << "alignment engine\tPosteriorDecoding" << endl;
+    }
+    totals.write( cout, align_method, elapsed_seconds );
+  } catch( std::exception& e ) { /// exceptions thrown by boost stuff
+    cerr << "error: " << e.what() << endl;
+    return 1;
+  } catch( string &err ) {      /// exceptions thrown by ProfileSampler, parallelFor, etc.
+    cerr << "error: " << err << endl;
+    return 1;
+  }
+
+  return 0; // success
+} // main (..)
@@ -0,0 +1,360 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      SimulateAndScore.hpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      The in-memory simulate-and-score pipeline: sequences are drawn from a
+##      "true" profile (see ProfileSampler.hpp), with their true paths, and
+##      handed straight to the scoring and alignment engines
+##      (CheckpointedForwardBackward, CheckpointedViterbi, PosteriorDecoding)
+##      for a (possibly different) scoring profile, with no files in between.
+##      Each alignment is compared to the true path, and the per-sequence
+##      results are summed into accuracy and throughput totals.
+##
+##      These are profuse's own engines, not the prolific DynamicProgramming
+##      (through ScoreAndMaybeAlign) that the score and align programs use,
+##      so the totals measure them: how well, and how fast, these engines
+##      recover the true paths, not what score or align would report for the
+##      same sequences.
+##
+##      Sequence i is drawn with the Philox stream of the seed and i, and the
+##      totals are summed in sequence order, so the results for a given seed
+##      don't depend on the number of threads.
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#if     _MSC_VER > 1000
+#pragma once
+#endif
+
+#ifndef __GALOSH_SIMULATEANDSCORE_HPP__
+#define __GALOSH_SIMULATEANDSCORE_HPP__
+
+#include "ProfileTables.hpp"
+#include "AlignmentPath.hpp"
+#include "ProfileSampler.hpp"
+#include "CheckpointedViterbi.hpp"
+#include "CheckpointedForwardBackward.hpp"
+#include "PosteriorDecoding.hpp"
+#include "UnscaledForward.hpp"
+#include "MixedPrecisionForward.hpp"
+#include "Philox.hpp"
+
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+namespace galosh {
+
+  namespace ForwardMethod {
+    enum Index {
+      Scaled, // doubles, each row scaled to sum to 1 (CheckpointedForwardBackward)
+      MixedPrecision, // floats, each row scaled to sum to 1 (MixedPrecisionForward)
+      TabulatedLogSum, // unscaled, in flogspace (UnscaledForward)
+      ExactLogSum // unscaled, in exactlogspace (UnscaledForward)
+    };
+  } // End namespace ForwardMethod
+
+  namespace AlignMethod {
+    enum Index {
+      None,
+      Viterbi,
+      MEA
+    };
+  } // End namespace AlignMethod
+
+  /**
+   * The outcome of simulating, scoring and aligning one sequence.
+   */
+  struct SimulatedSequenceResult {
+    uint32_t m_length;
+    /// Natural log of the probability of the sequence under the scoring
+    /// profile (the forward score).
+    double m_logProbability;
+    /// Residues aligned to the same state (and position) as in the true path.
+    uint32_t m_correctResidues;
+    /// Residues truly emitted by Match states.
+    uint32_t m_trueMatchResidues;
+    /// Residues aligned to Match states.
+    uint32_t m_alignedMatchResidues;
+    /// Residues truly emitted by a Match state and aligned to that one.
+    uint32_t m_correctMatchResidues;
+    bool m_isExactPath;
+  }; // End struct SimulatedSequenceResult
+
+  /**
+   * Compare the aligned path of a sequence to its true path, filling in the
+   * accuracy fields of result.
+   */
+  inline void
+  compareToTruePath (
+    AlignmentPath const & true_path,
+    AlignmentPath const & aligned_path,
+    std::vector<uint8_t> & true_states, // scratch
+    std::vector<uint32_t> & true_positions, // scratch
+    std::vector<uint8_t> & aligned_states, // scratch
+    std::vector<uint32_t> & aligned_positions, // scratch
+    SimulatedSequenceResult & result
+  )
+  {
+    result.m_correctResidues = 0;
+    result.m_trueMatchResidues = 0;
+    result.m_alignedMatchResidues = 0;
+    result.m_correctMatchResidues = 0;
+    result.m_isExactPath = ( true_path == aligned_path );
+    pathToResidueStates( true_path, true_states, true_positions );
+    pathToResidueStates( aligned_path, aligned_states, aligned_positions );
+    for( size_t residue_i = 0; residue_i < true_states.size(); residue_i++ ) {
+      const bool is_true_match = ( true_states[ residue_i ] == PathState::Match );
+      if( is_true_match ) {
+        result.m_trueMatchResidues += 1;
+      }
+      if( residue_i >= aligned_states.size() ) {
+        continue; // The alignment failed.
+      }
+      if( aligned_states[ residue_i ] == PathState::Match ) {
+        result.m_alignedMatchResidues += 1;
+      }
+      if( ( aligned_states[ residue_i ] == true_states[ residue_i ] ) &&
+          ( aligned_positions[ residue_i ] == true_positions[ residue_i ] ) ) {
+        result.m_correctResidues += 1;
+        if( is_true_match ) {
+          result.m_correctMatchResidues += 1;
+        }
+      }
+    } // End foreach residue_i
+  } // compareToTruePath( .. )
+
+  /**
+   * Sums of SimulatedSequenceResults.
+   */
+  struct SimulationTotals {
+    uint64_t m_sequenceCount;
+    uint64_t m_impossibleCount;
+    uint64_t m_residueCount;
+    /// ( sequence length + 1 ) x ( profile length + 1 ) per sequence.
+    uint64_t m_cellCount;
+    double m_logProbability;
+    uint64_t m_correctResidues;
+    uint64_t m_trueMatchResidues;
+    uint64_t m_alignedMatchResidues;
+    uint64_t m_correctMatchResidues;
+    uint64_t m_exactPaths;
+
+    SimulationTotals () :
+      m_sequenceCount( 0 ),
+      m_impossibleCount( 0 ),
+      m_residueCount( 0 ),
+      m_cellCount( 0 ),
+      m_logProbability( 0 ),
+      m_correctResidues( 0 ),
+      m_trueMatchResidues( 0 ),
+      m_alignedMatchResidues( 0 ),
+      m_correctMatchResidues( 0 ),
+      m_exactPaths( 0 )
+    {
+      // Do nothing else.
+    } // <init>()
+
+    void
+    add (
+      SimulatedSequenceResult const & result,
+      uint32_t const profile_length
+    )
+    {
+      m_sequenceCount += 1;
+      m_residueCount += result.m_length;
+      m_cellCount += ( static_cast<uint64_t>( result.m_length ) + 1 ) * ( profile_length + 1 );
+      if( result.m_logProbability == -std::numeric_limits<double>::infinity() ) {
+        m_impossibleCount += 1;
+      } else {
+        m_logProbability += result.m_logProbability;
+      }
+      m_correctResidues += result.m_correctResidues;
+      m_trueMatchResidues += result.m_trueMatchResidues;
+      m_alignedMatchResidues += result.m_alignedMatchResidues;
+      m_correctMatchResidues += result.m_correctMatchResidues;
+      if( result.m_isExactPath ) {
+        m_exactPaths += 1;
+      }
+    } // add( SimulatedSequenceResult const &, uint32_t const )
+
+    static double
+    fraction (
+      uint64_t const numerator,
+      uint64_t const denominator
+    )
+    {
+      return ( ( denominator == 0 ) ? 0.0 : ( static_cast<double>( numerator ) / denominator ) );
+    } // fraction( uint64_t const, uint64_t const )
+
+    /**
+     * Write the totals, and their rates over elapsed_seconds, one per line.
+     */
+    template <class AnyCharT, class AnyTraitsT>
+    void
+    write (
+      std::basic_ostream<AnyCharT,AnyTraitsT> & os,
+      AlignMethod::Index const align_method,
+      double const elapsed_seconds
+    ) const
+    {
+      os << "sequences\t" << m_sequenceCount << std::endl;
+      os << "residues\t" << m_residueCount << std::endl;
+      os << "impossible sequences\t" << m_impossibleCount << std::endl;
+      os << "total log probability\t" << m_logProbability << std::endl;
+      os << "mean log probability per residue\t" << ( ( m_residueCount == 0 ) ? 0.0 : ( m_logProbability / m_residueCount ) ) << std::endl;
+      if( align_method != AlignMethod::None ) {
+        os << "residues correctly aligned\t" << fraction( m_correctResidues, m_residueCount ) << std::endl;
+        os << "match sensitivity\t" << fraction( m_correctMatchResidues, m_trueMatchResidues ) << std::endl;
+        os << "match precision\t" << fraction( m_correctMatchResidues, m_alignedMatchResidues ) << std::endl;
+        os << "exact paths\t" << fraction( m_exactPaths, m_sequenceCount ) << std::endl;
+      }
+      os << "seconds\t" << elapsed_seconds << std::endl;
+      if( elapsed_seconds > 0 ) {
+        os << "sequences per second\t" << ( m_sequenceCount / elapsed_seconds ) << std::endl;
+        os << "residues per second\t" << ( m_residueCount / elapsed_seconds ) << std::endl;
+        os << "dp cells per second\t" << ( m_cellCount / elapsed_seconds ) << std::endl;
+      }
+    } // write( basic_ostream &, AlignMethod::Index const, double const ) const
+
+  }; // End struct SimulationTotals
+
+/**
+ * \class SimulateAndScoreBody
+ * \brief The parallelFor body: draws sequence number first_draw + batch_i from
+ * the true profile, then scores and aligns it with the scoring profile,
+ * putting the outcome in slot batch_i.
+ */
+template <typename ResidueType>
+class SimulateAndScoreBody {
+public:
+  typedef ProfileTables<ResidueType, ResidueType> ProfileTablesType;
+
+  /**
+   * log_tables must be tables after convertToLogs() (for Viterbi); tables
+   * must be the same tables, not converted.
+   */
+  SimulateAndScoreBody (
+    ProfileSampler<ResidueType> const & sampler,
+    ProfileTablesType const & tables,
+    ProfileTablesType const & log_tables,
+    ForwardMethod::Index const forward_method,
+    MixedPrecisionForward<ResidueType, ResidueType> const & mixed_forward,
+    UnscaledForward<ResidueType, ResidueType, flogspace> const & tabulated_forward,
+    UnscaledForward<ResidueType, ResidueType, exactlogspace> const & exact_forward,
+    AlignMethod::Index const align_method,
+    uint32_t const checkpoint_interval,
+    uint64_t const random_seed,
+    uint64_t const first_draw,
+    std::vector<SimulatedSequenceResult> & results
+  ) :
+    m_sampler( sampler ),
+    m_tables( tables ),
+    m_logTables( log_tables ),
+    m_forwardMethod( forward_method ),
+    m_mixedForward( mixed_forward ),
+    m_tabulatedForward( tabulated_forward ),
+    m_exactForward( exact_forward ),
+    m_alignMethod( align_method ),
+    m_checkpointInterval( checkpoint_interval ),
+    m_randomSeed( random_seed ),
+    m_firstDraw( first_draw ),
+    m_results( results )
+  {
+    // Do nothing else.
+  } // <init>( .. )
+
+  void
+  operator() (
+    size_t const batch_i,
+    uint32_t const thread_i
+  )
+  {
+    PhiloxStream random( m_randomSeed, m_firstDraw + batch_i );
+    m_sampler.draw( random, m_drawnResidues, &m_truePath );
+    m_residues.assign( m_drawnResidues.begin(), m_drawnResidues.end() );
+
+    SimulatedSequenceResult & result = m_results[ batch_i ];
+    result.m_length = m_residues.size();
+    if( m_alignMethod == AlignMethod::MEA ) {
+      PosteriorDecoding<ResidueType, ResidueType> decoding( m_tables, m_checkpointInterval );
+      double expected_accuracy;
+      result.m_logProbability = decoding.decode( m_residues, m_alignedPath, 0, expected_accuracy );
+    } else {
+      if( m_forwardMethod == ForwardMethod::MixedPrecision ) {
+        result.m_logProbability = m_mixedForward.forward( m_residues );
+      } else if( m_forwardMethod == ForwardMethod::TabulatedLogSum ) {
+        result.m_logProbability = m_tabulatedForward.forward( m_residues );
+      } else if( m_forwardMethod == ForwardMethod::ExactLogSum ) {
+        result.m_logProbability = m_exactForward.forward( m_residues );
+      } else {
+        CheckpointedForwardBackward<ResidueType, ResidueType> forward_backward( m_tables, m_checkpointInterval );
+        result.m_logProbability = forward_backward.forward( m_residues );
+      }
+      if( m_alignMethod == AlignMethod::Viterbi ) {
+        CheckpointedViterbi<ResidueType, ResidueType> viterbi( m_logTables, m_checkpointInterval );
+        viterbi.viterbi( m_residues, m_alignedPath );
+      } else {
+        m_alignedPath.clear();
+      }
+    }
+    compareToTruePath( m_truePath, m_alignedPath, m_trueStates, m_truePositions, m_alignedStates, m_alignedPositions, result );
+  } // operator()( size_t const, uint32_t const )
+
+protected:
+  ProfileSampler<ResidueType> const & m_sampler;
+  ProfileTablesType const & m_tables;
+  ProfileTablesType const & m_logTables;
+  ForwardMethod::Index m_forwardMethod;
+  MixedPrecisionForward<ResidueType, ResidueType> const & m_mixedForward;
+  UnscaledForward<ResidueType, ResidueType, flogspace> const & m_tabulatedForward;
+  UnscaledForward<ResidueType, ResidueType, exactlogspace> const & m_exactForward;
+  AlignMethod::Index m_alignMethod;
+  uint32_t m_checkpointInterval;
+  uint64_t m_randomSeed;
+  uint64_t m_firstDraw;
+  std::vector<SimulatedSequenceResult> & m_results;
+
+  // Per-thread scratch space.
+  std::vector<uint8_t> m_drawnResidues;
+  std::vector<uint32_t> m_residues;
+  AlignmentPath m_truePath;
+  AlignmentPath m_alignedPath;
+  std::vector<uint8_t> m_trueStates;
+  std::vector<uint32_t> m_truePositions;
+  std::vector<uint8_t> m_alignedStates;
+  std::vector<uint32_t> m_alignedPositions;
+}; // End class SimulateAndScoreBody
+
+} // End namespace galosh
+
+#endif // __GALOSH_SIMULATEANDSCORE_HPP__
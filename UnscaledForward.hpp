@@ -0,0 +1,316 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      UnscaledForward.hpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      Class definition for the UnscaledForward class, which runs the forward
+##      algorithm (in two rows) with the dp cells, emissions and transitions
+##      all held as MatrixValueTypes, and no Rabiner scaling of the rows.  It
+##      is for MatrixValueTypes that can't underflow, such as flogspace or
+##      exactlogspace (see LogSum.hpp) or bfloat; with a flogspace, its sums
+##      are table lookups rather than calls to log and exp, and the Match and
+##      Insertion cells of each row are computed by a row kernel (see
+##      RowKernels.hpp), several positions at a time.
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#if     _MSC_VER > 1000
+#pragma once
+#endif
+
+#ifndef __GALOSH_UNSCALEDFORWARD_HPP__
+#define __GALOSH_UNSCALEDFORWARD_HPP__
+
+#include "ProfileTables.hpp"
+#include "LogSum.hpp"
+#include "RowKernels.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+#include <boost/static_assert.hpp>
+
+namespace galosh {
+
+  /**
+   * The natural log of the given value.  Overloaded for the value types that
+   * can hold values too small for a double.
+   */
+  template <typename ValueType>
+  inline double
+  toLogDouble (
+    ValueType const & value
+  )
+  {
+    return std::log( toDouble( value ) );
+  } // toLogDouble( ValueType const & )
+
+  template <typename LogSumType>
+  inline double
+  toLogDouble (
+    basic_logspace<LogSumType> const & value
+  )
+  {
+    return value.logValue();
+  } // toLogDouble( basic_logspace const & )
+
+  namespace unscaled_forward {
+    /**
+     * The Match and Insertion cells of a forward row, from the previous
+     * row: match[ i ] and insertion[ i ] from the previous values at i (see
+     * RowKernels::forwardMatchInsertion).
+     */
+    template <typename MatrixValueType>
+    inline void
+    matchInsertion (
+      RowKernels const &, // (unused)
+      MatrixValueType const * prev_match,
+      MatrixValueType const * prev_insertion,
+      MatrixValueType const * prev_deletion,
+      MatrixValueType const * match_emissions,
+      MatrixValueType const & insertion_emission,
+      MatrixValueType const * transitions,
+      MatrixValueType * match,
+      MatrixValueType * insertion,
+      uint32_t const count
+    )
+    {
+      const MatrixValueType t_mm = transitions[ ProfileTransition::MatchToMatch ];
+      const MatrixValueType t_im = transitions[ ProfileTransition::InsertionToMatch ];
+      const MatrixValueType t_dm = transitions[ ProfileTransition::DeletionToMatch ];
+      const MatrixValueType t_mi = transitions[ ProfileTransition::MatchToInsertion ];
+      const MatrixValueType t_ii = transitions[ ProfileTransition::InsertionToInsertion ];
+      for( uint32_t i = 0; i < count; i++ ) {
+        const MatrixValueType m = prev_match[ i ];
+        const MatrixValueType in = prev_insertion[ i ];
+        match[ i ] =
+          match_emissions[ i ] * ( ( ( m * t_mm ) + ( in * t_im ) ) + ( prev_deletion[ i ] * t_dm ) );
+        insertion[ i ] = insertion_emission * ( ( m * t_mi ) + ( in * t_ii ) );
+      }
+    } // matchInsertion<MatrixValueType>( .. )
+
+    /**
+     * For flogspace, the same sums, by the row kernel.  (A flogspace is laid
+     * out as just its log value, so the cells can be handed over as
+     * doubles.)
+     */
+    inline void
+    matchInsertion (
+      RowKernels const & kernels,
+      flogspace const * prev_match,
+      flogspace const * prev_insertion,
+      flogspace const * prev_deletion,
+      flogspace const * match_emissions,
+      flogspace const & insertion_emission,
+      flogspace const * transitions,
+      flogspace * match,
+      flogspace * insertion,
+      uint32_t const count
+    )
+    {
+      BOOST_STATIC_ASSERT( sizeof( flogspace ) == sizeof( double ) );
+      kernels.tabulatedLogForwardMatchInsertion(
+        reinterpret_cast<double const *>( prev_match ),
+        reinterpret_cast<double const *>( prev_insertion ),
+        reinterpret_cast<double const *>( prev_deletion ),
+        reinterpret_cast<double const *>( match_emissions ),
+        insertion_emission.logValue(),
+        reinterpret_cast<double const *>( transitions ),
+        reinterpret_cast<double *>( match ),
+        reinterpret_cast<double *>( insertion ),
+        count
+      );
+    } // matchInsertion( RowKernels const &, flogspace const *, .. )
+  } // End namespace unscaled_forward
+
+template <typename ResidueType,
+          typename SequenceResidueType,
+          typename MatrixValueType>
+class UnscaledForward {
+public:
+  typedef ProfileTables<ResidueType, SequenceResidueType> ProfileTablesType;
+  enum { AlphabetSize = ProfileTablesType::AlphabetSize };
+
+  /**
+   * The tables must hold probabilities (not logs); they are converted to
+   * MatrixValueTypes once, here.
+   */
+  UnscaledForward (
+    ProfileTablesType const & tables
+  ) :
+    m_kernels( rowKernels() ),
+    m_profileLength( tables.m_profileLength ),
+    m_matchEmissions( AlphabetSize * tables.m_profileLength ),
+    m_insertionEmissions( AlphabetSize )
+  {
+    assert( !tables.m_isLog );
+    for( uint32_t res_i = 0; res_i < AlphabetSize; res_i++ ) {
+      double const * match_emissions = tables.matchEmissions( res_i );
+      for( uint32_t pos_i = 0; pos_i < m_profileLength; pos_i++ ) {
+        m_matchEmissions[ ( res_i * m_profileLength ) + pos_i ] = MatrixValueType( match_emissions[ pos_i ] );
+      }
+      m_insertionEmissions[ res_i ] = MatrixValueType( tables.insertionEmission( res_i ) );
+    }
+    for( uint32_t t = 0; t < ProfileTransition::Count; t++ ) {
+      m_transitions[ t ] = MatrixValueType( tables[ static_cast<ProfileTransition::Index>( t ) ] );
+    }
+  } // <init>( ProfileTablesType const & )
+
+  /**
+   * Returns the natural log of the probability of the given sequence (given
+   * as residue ordinal values; see sequenceToOrdinals(..)).
+   */
+  double
+  forward (
+    std::vector<uint32_t> const & residues
+  ) const
+  {
+    const uint32_t sequence_length = residues.size();
+    Row current, next;
+    current.reinitialize( m_profileLength );
+    next.reinitialize( m_profileLength );
+    firstRow( current );
+    for( uint32_t row_i = 1; row_i <= sequence_length; row_i++ ) {
+      nextRow( current, residues[ row_i - 1 ], next );
+      std::swap( current, next );
+    }
+    return toLogDouble( current.m_postAlign * m_transitions[ ProfileTransition::PostAlignToTerminal ] );
+  } // forward( vector<uint32_t> const & ) const
+
+protected:
+  /**
+   * One row of the forward matrix; the vectors have profile length + 1
+   * entries, and entry 0 is unused.
+   */
+  struct Row {
+    MatrixValueType m_preAlign;
+    MatrixValueType m_postAlign;
+    std::vector<MatrixValueType> m_match;
+    std::vector<MatrixValueType> m_insertion;
+    std::vector<MatrixValueType> m_deletion;
+
+    void
+    reinitialize (
+      uint32_t const profile_length
+    )
+    {
+      m_match.resize( profile_length + 1 );
+      m_insertion.resize( profile_length + 1 );
+      m_deletion.resize( profile_length + 1 );
+    } // reinitialize( uint32_t const )
+  }; // End inner struct Row
+
+  RowKernels const & m_kernels;
+
+  uint32_t m_profileLength;
+
+  /// At [ ( res_i * m_profileLength ) + pos_i ] (pos_i 0-based).
+  std::vector<MatrixValueType> m_matchEmissions;
+  std::vector<MatrixValueType> m_insertionEmissions;
+  MatrixValueType m_transitions[ ProfileTransition::Count ];
+
+  /**
+   * Forward row 0: nothing emitted yet.
+   */
+  void
+  firstRow (
+    Row & row
+  ) const
+  {
+    const MatrixValueType zero( 0.0 );
+    row.m_preAlign = MatrixValueType( 1.0 );
+    std::fill( row.m_match.begin(), row.m_match.end(), zero );
+    std::fill( row.m_insertion.begin(), row.m_insertion.end(), zero );
+    row.m_deletion[ 0 ] = zero;
+    row.m_deletion[ 1 ] =
+      m_transitions[ ProfileTransition::PreAlignToBegin ] * m_transitions[ ProfileTransition::BeginToDeletion ];
+    for( uint32_t pos = 2; pos <= m_profileLength; pos++ ) {
+      row.m_deletion[ pos ] = row.m_deletion[ pos - 1 ] * m_transitions[ ProfileTransition::DeletionToDeletion ];
+    }
+    row.m_postAlign = row.m_deletion[ m_profileLength ];
+  } // firstRow( Row & ) const
+
+  /**
+   * Calculate forward row i from row i - 1 and the i^th residue (the same
+   * recurrences as CheckpointedForwardBackward::nextRow(..), unscaled).
+   */
+  void
+  nextRow (
+    Row const & prev,
+    uint32_t const residue,
+    Row & row
+  ) const
+  {
+    const uint32_t profile_length = m_profileLength;
+    MatrixValueType const * match_emissions = &m_matchEmissions[ 0 ] + ( residue * profile_length );
+    const MatrixValueType insertion_emission = m_insertionEmissions[ residue ];
+    const MatrixValueType t_md = m_transitions[ ProfileTransition::MatchToDeletion ];
+    const MatrixValueType t_dd = m_transitions[ ProfileTransition::DeletionToDeletion ];
+
+    row.m_preAlign =
+      prev.m_preAlign * m_transitions[ ProfileTransition::PreAlignToPreAlign ] * insertion_emission;
+    const MatrixValueType begin =
+      prev.m_preAlign * m_transitions[ ProfileTransition::PreAlignToBegin ];
+    row.m_match[ 1 ] = match_emissions[ 0 ] * begin * m_transitions[ ProfileTransition::BeginToMatch ];
+
+    // Match at pos + 1 and Insertion at pos both come from position pos of
+    // prev.
+    unscaled_forward::matchInsertion(
+      m_kernels,
+      &prev.m_match[ 0 ] + 1,
+      &prev.m_insertion[ 0 ] + 1,
+      &prev.m_deletion[ 0 ] + 1,
+      match_emissions + 1,
+      insertion_emission,
+      m_transitions,
+      &row.m_match[ 0 ] + 2,
+      &row.m_insertion[ 0 ] + 1,
+      profile_length - 1
+    );
+
+    // Deletions depend on the states to their left in this row.
+    MatrixValueType deletion =
+      row.m_preAlign * m_transitions[ ProfileTransition::PreAlignToBegin ] * m_transitions[ ProfileTransition::BeginToDeletion ];
+    row.m_deletion[ 1 ] = deletion;
+    for( uint32_t pos = 2; pos <= profile_length; pos++ ) {
+      deletion = ( row.m_match[ pos - 1 ] * t_md ) + ( deletion * t_dd );
+      row.m_deletion[ pos ] = deletion;
+    }
+
+    row.m_postAlign =
+      ( prev.m_postAlign * m_transitions[ ProfileTransition::PostAlignToPostAlign ] * insertion_emission ) +
+      row.m_match[ profile_length ] + row.m_deletion[ profile_length ];
+  } // nextRow( Row const &, uint32_t const, Row & ) const
+
+}; // End class UnscaledForward
+
+} // End namespace galosh
+
+#endif // __GALOSH_UNSCALEDFORWARD_HPP__
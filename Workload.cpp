@@ -0,0 +1,539 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      Workload.cpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      The workload program.  It makes a named, versioned set of benchmark
+##      datasets from a spec file (see WorkloadSpec.hpp), for comparing
+##      throughput across releases and machines.  For each (sweep-expanded)
+##      dataset it
+##        1. draws a random consensus sequence from the background
+##           distribution (as createRandomSequences does),
+##        2. makes a profile from it (as sequenceToProfile does; see
+##           ConsensusToProfile.hpp), with the dataset's conservation and
+##           indel settings,
+##        3. draws homologous sequences from that profile, with their true
+##           paths (as drawSequences does), and
+##        4. draws i.i.d. background sequences, with lengths from the
+##           dataset's read-length distribution,
+##      writing them to <output dir>/<workload>-<version>/<dataset>/ as
+##      consensus.fa, profile.txt, sequences.fa (homologs, then background)
+##      and paths.bin (a path sidecar for the homologs; see PathSidecar.hpp).
+##      A MANIFEST lists each dataset's settings.
+##
+##      Every random stream is keyed by the spec's seed and the dataset's
+##      name, so the output for a given spec is bit-identical from run to run
+##      (for any number of threads), and adding or removing a dataset doesn't
+##      change the others.
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#include "Algebra.hpp"
+#include "Profile.hpp"
+#include "Sequence.hpp"
+#include "ProlificParameters.hpp"
+#include "ConsensusToProfile.hpp"
+#include "WorkloadSpec.hpp"
+#include "RandomSequenceGenerator.hpp"
+#include "ProfileSampler.hpp"
+#include "PathSidecar.hpp"
+#include "AliasTable.hpp"
+#include "Philox.hpp"
+#include "ParallelFor.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <seqan/basic.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/program_options.hpp>
+
+#ifdef __HAVE_MUSCLE
+int g_argc;
+char **g_argv;
+#endif // __HAVE_MUSCLE
+
+namespace po = boost::program_options;
+
+using namespace seqan;
+
+/// Bump this when a change to this program changes its output for a spec.
+static const uint32_t WorkloadFormatVersion = 1;
+
+namespace WorkloadStream {
+  enum Index {
+    Consensus = 0,
+    Homologs = 1,
+    Background = 2
+  };
+} // End namespace WorkloadStream
+
+/**
+ * The seed of one of a dataset's random streams: Philox, keyed by the spec's
+ * seed, of the FNV-1a hash of the dataset's name and the stream's purpose.
+ */
+uint64_t
+datasetSeed (
+  uint64_t const spec_seed,
+  std::string const & dataset_name,
+  WorkloadStream::Index const purpose
+)
+{
+  uint64_t name_hash = 0xCBF29CE484222325ull;
+  for( size_t i = 0; i < dataset_name.size(); i++ ) {
+    name_hash ^= static_cast<uint8_t>( dataset_name[ i ] );
+    name_hash *= 0x100000001B3ull;
+  }
+  const uint32_t counter[ 4 ] = {
+    static_cast<uint32_t>( name_hash ),
+    static_cast<uint32_t>( name_hash >> 32 ),
+    static_cast<uint32_t>( purpose ),
+    0
+  };
+  const uint32_t key[ 2 ] = {
+    static_cast<uint32_t>( spec_seed ),
+    static_cast<uint32_t>( spec_seed >> 32 )
+  };
+  uint32_t out[ 4 ];
+  galosh::philox4x32_10( counter, key, out );
+  return ( ( static_cast<uint64_t>( out[ 1 ] ) << 32 ) | out[ 0 ] );
+} // datasetSeed( uint64_t const, string const &, WorkloadStream::Index const )
+
+/**
+ * A read-length distribution: "fixed:<length>", "uniform:<min>:<max>" or
+ * "geometric:<mean>" (on 1, 2, ..).
+ */
+class ReadLengthDistribution {
+public:
+  ReadLengthDistribution (
+    std::string const & spec
+  )
+  {
+    std::vector<std::string> fields;
+    std::string::size_type start = 0;
+    while( true ) {
+      const std::string::size_type colon = spec.find( ':', start );
+      fields.push_back( spec.substr( start, ( ( colon == std::string::npos ) ? std::string::npos : ( colon - start ) ) ) );
+      if( colon == std::string::npos ) {
+        break;
+      }
+      start = colon + 1;
+    }
+    try {
+      m_kind = fields[ 0 ];
+      if( ( m_kind == "fixed" ) && ( fields.size() == 2 ) ) {
+        m_min = m_max = boost::lexical_cast<uint32_t>( fields[ 1 ] );
+      } else if( ( m_kind == "uniform" ) && ( fields.size() == 3 ) ) {
+        m_min = boost::lexical_cast<uint32_t>( fields[ 1 ] );
+        m_max = boost::lexical_cast<uint32_t>( fields[ 2 ] );
+      } else if( ( m_kind == "geometric" ) && ( fields.size() == 2 ) ) {
+        m_mean = boost::lexical_cast<double>( fields[ 1 ] );
+        m_min = m_max = 0;
+      } else {
+        throw std::string( "The read length distribution '" ) + spec + "' is not valid; use fixed:<length>, uniform:<min>:<max> or geometric:<mean>";
+      }
+    } catch( boost::bad_lexical_cast & ) {
+      throw std::string( "The read length distribution '" ) + spec + "' is not valid; use fixed:<length>, uniform:<min>:<max> or geometric:<mean>";
+    }
+    if( ( m_kind == "geometric" ) ? !( m_mean >= 1.0 ) : ( ( m_min == 0 ) || ( m_min > m_max ) ) ) {
+      throw std::string( "The read length distribution '" ) + spec + "' must have positive lengths";
+    }
+  } // <init>( string const & )
+
+  template <typename RandomType>
+  uint32_t
+  draw (
+    RandomType & random
+  ) const
+  {
+    if( m_kind == "geometric" ) {
+      if( m_mean == 1.0 ) {
+        return 1;
+      }
+      // Number of trials to the first success, success probability 1 / mean.
+      return ( 1 + static_cast<uint32_t>( std::log( 1.0 - random.nextUniform() ) / std::log( 1.0 - ( 1.0 / m_mean ) ) ) );
+    }
+    if( m_min == m_max ) {
+      return m_min;
+    }
+    return ( m_min + static_cast<uint32_t>( random.nextUniform() * ( static_cast<double>( m_max - m_min ) + 1 ) ) );
+  } // draw( RandomType & ) const
+
+protected:
+  std::string m_kind;
+  uint32_t m_min;
+  uint32_t m_max;
+  double m_mean;
+}; // End class ReadLengthDistribution
+
+/**
+ * The parallelFor body for homologs: draws homolog first_draw + batch_i.
+ */
+template <typename ResidueType>
+class HomologBody {
+public:
+  HomologBody (
+    galosh::ProfileSampler<ResidueType> const & sampler,
+    uint64_t const random_seed,
+    uint64_t const first_draw,
+    std::vector<std::vector<uint8_t> > & sequences,
+    std::vector<galosh::AlignmentPath> & paths
+  ) :
+    m_sampler( sampler ),
+    m_randomSeed( random_seed ),
+    m_firstDraw( first_draw ),
+    m_sequences( sequences ),
+    m_paths( paths )
+  {
+    // Do nothing else.
+  } // <init>( .. )
+
+  void
+  operator() (
+    size_t const batch_i,
+    uint32_t const thread_i
+  )
+  {
+    galosh::PhiloxStream random( m_randomSeed, m_firstDraw + batch_i );
+    m_sampler.draw( random, m_sequences[ batch_i ], &m_paths[ batch_i ] );
+  } // operator()( size_t const, uint32_t const )
+
+protected:
+  galosh::ProfileSampler<ResidueType> const & m_sampler;
+  uint64_t m_randomSeed;
+  uint64_t m_firstDraw;
+  std::vector<std::vector<uint8_t> > & m_sequences;
+  std::vector<galosh::AlignmentPath> & m_paths;
+}; // End class HomologBody
+
+/**
+ * The parallelFor body for background sequences: draws background sequence
+ * first_draw + batch_i.
+ */
+class BackgroundBody {
+public:
+  BackgroundBody (
+    galosh::AliasTable const & residue_table,
+    ReadLengthDistribution const & read_lengths,
+    uint64_t const random_seed,
+    uint64_t const first_draw,
+    std::vector<std::vector<uint8_t> > & sequences
+  ) :
+    m_residueTable( residue_table ),
+    m_readLengths( read_lengths ),
+    m_randomSeed( random_seed ),
+    m_firstDraw( first_draw ),
+    m_sequences( sequences )
+  {
+    // Do nothing else.
+  } // <init>( .. )
+
+  void
+  operator() (
+    size_t const batch_i,
+    uint32_t const thread_i
+  )
+  {
+    galosh::PhiloxStream random( m_randomSeed, m_firstDraw + batch_i );
+    std::vector<uint8_t> & sequence = m_sequences[ batch_i ];
+    sequence.resize( m_readLengths.draw( random ) );
+    for( size_t i = 0; i < sequence.size(); i++ ) {
+      sequence[ i ] = static_cast<uint8_t>( m_residueTable.drawFromBits( random.nextUint32() ) );
+    }
+  } // operator()( size_t const, uint32_t const )
+
+protected:
+  galosh::AliasTable const & m_residueTable;
+  ReadLengthDistribution const & m_readLengths;
+  uint64_t m_randomSeed;
+  uint64_t m_firstDraw;
+  std::vector<std::vector<uint8_t> > & m_sequences;
+}; // End class BackgroundBody
+
+/**
+ * Parse the background-probabilities setting ("uniform", or comma-separated
+ * weights in alphabet order).
+ */
+std::vector<double>
+backgroundWeights (
+  galosh::WorkloadSpec::Instance const & instance,
+  uint32_t const alphabet_size
+)
+{
+  const std::string setting = instance[ "background-probabilities" ];
+  std::vector<double> weights;
+  if( setting == "uniform" ) {
+    weights.assign( alphabet_size, 1.0 );
+    return weights;
+  }
+  std::string::size_type start = 0;
+  while( true ) {
+    const std::string::size_type comma = setting.find( ',', start );
+    try {
+      weights.push_back( boost::lexical_cast<double>( setting.substr( start, ( ( comma == std::string::npos ) ? std::string::npos : ( comma - start ) ) ) ) );
+    } catch( boost::bad_lexical_cast & ) {
+      throw std::string( "In dataset '" ) + instance.m_name + "', the background probabilities '" + setting + "' are not valid";
+    }
+    if( comma == std::string::npos ) {
+      break;
+    }
+    start = comma + 1;
+  }
+  if( weights.size() != alphabet_size ) {
+    throw std::string( "In dataset '" ) + instance.m_name + "', there must be " + boost::lexical_cast<std::string>( alphabet_size ) + " background probabilities";
+  }
+  return weights;
+} // backgroundWeights( WorkloadSpec::Instance const &, uint32_t const )
+
+/**
+ * Make one dataset in the given directory.
+ */
+template <typename ResidueType>
+void
+makeDataset (
+  galosh::WorkloadSpec const & spec,
+  galosh::WorkloadSpec::Instance const & instance,
+  boost::filesystem::path const & directory,
+  uint32_t const thread_count,
+  uint32_t const batch_size
+)
+{
+  typedef floatrealspace ProbabilityType;
+  typedef galosh::ProfileTreeRoot<ResidueType, ProbabilityType> ProfileType;
+  enum { AlphabetSize = seqan::ValueSize<ResidueType>::VALUE };
+
+  boost::filesystem::create_directories( directory );
+  const std::vector<double> background_weights = backgroundWeights( instance, AlphabetSize );
+
+  // 1. The consensus.
+  const uint32_t profile_length = instance.as<uint32_t>( "profile-length" );
+  if( profile_length == 0 ) {
+    throw std::string( "In dataset '" ) + instance.m_name + "', the profile length must be positive";
+  }
+  const galosh::RandomSequenceGenerator<ResidueType> consensus_generator(
+    background_weights,
+    datasetSeed( spec.m_seed, instance.m_name, WorkloadStream::Consensus ),
+    profile_length
+  );
+  std::vector<uint8_t> consensus_residues, chunk;
+  std::vector<uint32_t> random_bits;
+  for( uint64_t chunk_i = 0; chunk_i < consensus_generator.chunksPerSequence(); chunk_i++ ) {
+    consensus_generator.generateChunk( 0, chunk_i, chunk, random_bits );
+    consensus_residues.insert( consensus_residues.end(), chunk.begin(), chunk.end() );
+  }
+  {
+    std::ofstream consensus_stream( ( directory / "consensus.fa" ).string().c_str(), std::ios::out | std::ios::binary );
+    galosh::FastaLineWriter<ResidueType> consensus_writer( consensus_stream, 60 );
+    consensus_writer.beginSequence( instance.m_name + " consensus" );
+    consensus_writer.write( consensus_residues );
+    consensus_writer.endSequence();
+  }
+
+  // 2. The profile.
+  galosh::Sequence<ResidueType> consensus;
+  consensus.reinitialize( profile_length );
+  for( uint32_t pos_i = 0; pos_i < profile_length; pos_i++ ) {
+    consensus[ pos_i ] = ResidueType( consensus_residues[ pos_i ] );
+  }
+  typename galosh::ProlificParameters<ResidueType, ProbabilityType, ProbabilityType, ProbabilityType>::Parameters parameters;
+  const double expected_indels = instance.as<double>( "expected-indels" );
+  const double indel_length_fraction = instance.as<double>( "indel-length-fraction" );
+  parameters.useDeletionsForInsertionsParameters = true;
+  parameters.expectedDeletionsCounts.clear();
+  parameters.expectedDeletionsCounts.push_back( expected_indels );
+  parameters.expectedInsertionsCounts.clear();
+  parameters.expectedInsertionsCounts.push_back( expected_indels );
+  parameters.expectedDeletionLengthAsProfileLengthFractions.clear();
+  parameters.expectedDeletionLengthAsProfileLengthFractions.push_back( indel_length_fraction );
+  parameters.expectedInsertionLengthAsProfileLengthFractions.clear();
+  parameters.expectedInsertionLengthAsProfileLengthFractions.push_back( indel_length_fraction );
+  parameters.preAlignInsertion = instance.as<double>( "pre-align-insertion" );
+  parameters.postAlignInsertion = instance.as<double>( "post-align-insertion" );
+  const double conservation_rate = instance.as<double>( "conservation" );
+  if( !( conservation_rate > 0 ) || ( conservation_rate > 1 ) ) {
+    throw std::string( "In dataset '" ) + instance.m_name + "', the conservation rate must be in ( 0, 1 ]";
+  }
+  ProfileType profile;
+  galosh::consensusToProfile<ResidueType, ProbabilityType, ProbabilityType, ProbabilityType, ResidueType, ProfileType>( parameters, consensus, profile, conservation_rate );
+  {
+    std::ofstream profile_stream( ( directory / "profile.txt" ).string().c_str(), std::ios::out | std::ios::binary );
+    profile_stream << profile;
+    if( !profile_stream.good() ) {
+      throw std::string( "Unable to write the profile of dataset '" ) + instance.m_name + "'";
+    }
+  }
+
+  // 3. and 4. The homologs and the background sequences.
+  std::ofstream sequences_stream( ( directory / "sequences.fa" ).string().c_str(), std::ios::out | std::ios::binary );
+  galosh::FastaLineWriter<ResidueType> sequences_writer( sequences_stream, 60 );
+  galosh::PathSidecarWriter path_sidecar;
+  path_sidecar.open( ( directory / "paths.bin" ).string() );
+  std::vector<std::vector<uint8_t> > sequences( batch_size );
+  std::vector<galosh::AlignmentPath> paths( batch_size );
+
+  const uint64_t homolog_count = instance.as<uint64_t>( "homologs" );
+  const uint64_t homolog_seed = datasetSeed( spec.m_seed, instance.m_name, WorkloadStream::Homologs );
+  const galosh::ProfileSampler<ResidueType> sampler( profile );
+  for( uint64_t first_draw = 0; first_draw < homolog_count; first_draw += batch_size ) {
+    const size_t batch_draws = std::min( static_cast<uint64_t>( batch_size ), ( homolog_count - first_draw ) );
+    galosh::parallelFor(
+      batch_draws,
+      thread_count,
+      HomologBody<ResidueType>( sampler, homolog_seed, first_draw, sequences, paths )
+    );
+    for( size_t batch_i = 0; batch_i < batch_draws; batch_i++ ) {
+      sequences_writer.beginSequence( "homolog" + boost::lexical_cast<std::string>( first_draw + batch_i ) );
+      sequences_writer.write( sequences[ batch_i ] );
+      sequences_writer.endSequence();
+      path_sidecar.append( paths[ batch_i ] );
+    }
+  } // End foreach batch of homologs
+  path_sidecar.close();
+
+  const uint64_t background_count = instance.as<uint64_t>( "background" );
+  const uint64_t background_seed = datasetSeed( spec.m_seed, instance.m_name, WorkloadStream::Background );
+  const galosh::AliasTable residue_table( &background_weights[ 0 ], AlphabetSize );
+  const ReadLengthDistribution read_lengths( instance[ "background-length" ] );
+  for( uint64_t first_draw = 0; first_draw < background_count; first_draw += batch_size ) {
+    const size_t batch_draws = std::min( static_cast<uint64_t>( batch_size ), ( background_count - first_draw ) );
+    galosh::parallelFor(
+      batch_draws,
+      thread_count,
+      BackgroundBody( residue_table, read_lengths, background_seed, first_draw, sequences )
+    );
+    for( size_t batch_i = 0; batch_i < batch_draws; batch_i++ ) {
+      sequences_writer.beginSequence( "background" + boost::lexical_cast<std::string>( first_draw + batch_i ) );
+      sequences_writer.write( sequences[ batch_i ] );
+      sequences_writer.endSequence();
+    }
+  } // End foreach batch of background sequences
+  sequences_stream.close();
+  if( sequences_stream.fail() ) {
+    throw std::string( "Unable to write the sequences of dataset '" ) + instance.m_name + "'";
+  }
+} // makeDataset<ResidueType>( .. )
+
+int
+main ( int const argc, char const ** argv )
+{
+#ifdef __PROFUSE_USE_AMINOS
+  typedef seqan::AminoAcid20 ResidueType;
+#else // __PROFUSE_USE_AMINOS .. else
+  typedef seqan::Dna ResidueType;
+#endif // __PROFUSE_USE_AMINOS .. else ..
+
+  try {
+    po::options_description visible( "Basic options" );
+    visible.add_options()
+      ( "help,h", "produce help message" )
+      ( "spec,s",
+        po::value<std::string>(),
+        "filename: the workload spec" )
+      ( "output,o",
+        po::value<std::string>()->default_value( "." ),
+        "directory: where to put the workload's directory, <workload>-<version>" )
+      ( "threads,t",
+        po::value<uint32_t>()->default_value( 0 ),
+        "number of threads (0, the default, means one per core); the output doesn't depend on it" )
+      ( "batch-size",
+        po::value<uint32_t>()->default_value( 65536 ),
+        "number of sequences to draw (in parallel) before writing them out" )
+      ( "list,l",
+        "just list the (sweep-expanded) datasets" )
+      ;
+
+    po::positional_options_description p;
+    p.add( "spec", 1 );
+    p.add( "output", 1 );
+
+    po::variables_map vm;
+    store( po::command_line_parser( argc, argv ).options( visible ).positional( p ).run(), vm );
+    notify( vm );
+
+#define USAGE() " " << argv[ 0 ] << " [options] <workload spec file> [<output directory>]"
+
+    if( vm.count( "help" ) > 0 ) {
+      std::cout << "Usage: " << USAGE() << std::endl;
+      std::cout << visible << "\n";
+      return 0;
+    }
+    if( vm.count( "spec" ) == 0 ) {
+      std::cout << "Usage: " << USAGE() << std::endl;
+      exit( 1 );
+    }
+
+    galosh::WorkloadSpec spec;
+    spec.fromFile( vm[ "spec" ].as<std::string>() );
+    std::vector<galosh::WorkloadSpec::Instance> instances;
+    spec.expand( instances );
+
+    if( vm.count( "list" ) > 0 ) {
+      for( size_t instance_i = 0; instance_i < instances.size(); instance_i++ ) {
+        std::cout << instances[ instance_i ].m_name << std::endl;
+      }
+      return 0;
+    }
+
+    const boost::filesystem::path workload_directory =
+      boost::filesystem::path( vm[ "output" ].as<std::string>() ) / ( spec.m_name + "-" + spec.m_version );
+    boost::filesystem::create_directories( workload_directory );
+    std::ofstream manifest( ( workload_directory / "MANIFEST" ).string().c_str(), std::ios::out | std::ios::binary );
+    manifest << "profuse workload format " << WorkloadFormatVersion << '\n';
+    manifest << "workload " << spec.m_name << '\n';
+    manifest << "version " << spec.m_version << '\n';
+    manifest << "seed " << spec.m_seed << '\n';
+    const uint32_t batch_size = std::max( static_cast<uint32_t>( 1 ), vm[ "batch-size" ].as<uint32_t>() );
+    for( size_t instance_i = 0; instance_i < instances.size(); instance_i++ ) {
+      galosh::WorkloadSpec::Instance const & instance = instances[ instance_i ];
+      std::cout << "Making dataset '" << instance.m_name << "'" << std::endl;
+      makeDataset<ResidueType>( spec, instance, ( workload_directory / instance.m_name ), vm[ "threads" ].as<uint32_t>(), batch_size );
+      manifest << '\n' << "dataset " << instance.m_name << '\n';
+      for( uint32_t setting_i = 0; setting_i < galosh::WorkloadSetting::Count; setting_i++ ) {
+        manifest << "  " << galosh::WorkloadSetting::Names[ setting_i ] << ' ' << instance[ galosh::WorkloadSetting::Names[ setting_i ] ] << '\n';
+      }
+    }
+    manifest.close();
+    if( manifest.fail() ) {
+      throw std::string( "Unable to write the workload manifest" );
+    }
+  } catch( std::exception& e ) { /// exceptions thrown by boost stuff
+    std::cerr << "error: " << e.what() << std::endl;
+    return 1;
+  } catch( std::string &err ) {      /// exceptions thrown by WorkloadSpec, parallelFor, etc.
+    std::cerr << "error: " << err << std::endl;
+    return 1;
+  }
+
+  return 0; // success
+} // main (..)
@@ -0,0 +1,312 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      WorkloadSpec.hpp
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      Class definition for the WorkloadSpec class, the parsed form of a
+##      workload spec file (see the workload program, Workload.cpp).
+##
+##      A spec file is a list of lines of whitespace-separated words; '#'
+##      starts a comment.  The first word of a line is a key and the rest are
+##      its values:
+##
+##        workload <name>          (required)
+##        version <version>        (required)
+##        seed <unsigned integer>  (default 0)
+##        dataset <name>           (starts a dataset; at least one)
+##        <setting> <value> ..     (before any dataset: a default for all)
+##
+##      A setting given more than one value is a sweep: the dataset is
+##      expanded into one instance per combination of the values of its swept
+##      settings (in the order of WorkloadSetting::Names, the last one
+##      varying fastest), named <dataset>_<setting>-<value>_... (with any ':'
+##      or ',' in the values changed to '-').
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#if     _MSC_VER > 1000
+#pragma once
+#endif
+
+#ifndef __GALOSH_WORKLOADSPEC_HPP__
+#define __GALOSH_WORKLOADSPEC_HPP__
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/lexical_cast.hpp>
+
+namespace galosh {
+
+  namespace WorkloadSetting {
+    /// The settings, with their defaults.  The order here is the order of
+    /// sweep expansion and of the settings in the manifest.
+    static const char * const Names[] = {
+      "profile-length",            // consensus (and profile) length
+      "conservation",              // match emission mass on the consensus residue
+      "expected-indels",           // expected deletions (and insertions) per sequence
+      "indel-length-fraction",     // expected indel length, as a fraction of the profile length
+      "pre-align-insertion",       // N -> N probability
+      "post-align-insertion",      // C -> C probability
+      "homologs",                  // number of sequences drawn from the profile
+      "background",                // number of i.i.d. background sequences
+      "background-length",         // fixed:<L>, uniform:<min>:<max> or geometric:<mean>
+      "background-probabilities"   // comma-separated residue weights, or "uniform"
+    };
+    static const char * const Defaults[] = {
+      "100",
+      "0.75",
+      "1.0",
+      "0.0125",
+      "0.01",
+      "0.01",
+      "1000",
+      "0",
+      "fixed:100",
+      "uniform"
+    };
+    enum { Count = ( sizeof( Names ) / sizeof( Names[ 0 ] ) ) };
+
+    inline bool
+    isSetting (
+      std::string const & key
+    )
+    {
+      for( uint32_t setting_i = 0; setting_i < Count; setting_i++ ) {
+        if( key == Names[ setting_i ] ) {
+          return true;
+        }
+      }
+      return false;
+    } // isSetting( string const & )
+  } // End namespace WorkloadSetting
+
+class WorkloadSpec {
+public:
+  typedef std::map<std::string, std::vector<std::string> > SettingsType;
+
+  /**
+   * One dataset of the spec, before sweep expansion.
+   */
+  struct Dataset {
+    std::string m_name;
+    SettingsType m_settings;
+  }; // End inner struct Dataset
+
+  /**
+   * One dataset instance, after sweep expansion: one value per setting.
+   */
+  struct Instance {
+    std::string m_name;
+    std::map<std::string, std::string> m_settings;
+
+    std::string const &
+    operator[] (
+      std::string const & key
+    ) const
+    {
+      std::map<std::string, std::string>::const_iterator it = m_settings.find( key );
+      if( it == m_settings.end() ) {
+        throw std::string( "Unknown workload setting '" ) + key + "'";
+      }
+      return it->second;
+    } // operator[]( string const & ) const
+
+    template <typename ValueType>
+    ValueType
+    as (
+      std::string const & key
+    ) const
+    {
+      try {
+        return boost::lexical_cast<ValueType>( ( *this )[ key ] );
+      } catch( boost::bad_lexical_cast & ) {
+        throw std::string( "In dataset '" ) + m_name + "', the value '" + ( *this )[ key ] + "' of '" + key + "' is not valid";
+      }
+    } // as<ValueType>( string const & ) const
+  }; // End inner struct Instance
+
+  std::string m_name;
+  std::string m_version;
+  uint64_t m_seed;
+  std::vector<Dataset> m_datasets;
+
+  WorkloadSpec () :
+    m_seed( 0 )
+  {
+    // Do nothing else.
+  } // <init>()
+
+  void
+  fromFile (
+    std::string const & filename
+  )
+  {
+    std::ifstream spec_stream( filename.c_str() );
+    if( !spec_stream.good() ) {
+      throw std::string( "The workload spec file '" ) + filename + "' could not be opened.";
+    }
+    fromStream( spec_stream, filename );
+  } // fromFile( string const & )
+
+  void
+  fromStream (
+    std::istream & is,
+    std::string const & source_name
+  )
+  {
+    SettingsType defaults;
+    for( uint32_t setting_i = 0; setting_i < WorkloadSetting::Count; setting_i++ ) {
+      defaults[ WorkloadSetting::Names[ setting_i ] ].assign( 1, WorkloadSetting::Defaults[ setting_i ] );
+    }
+    m_datasets.clear();
+    m_name.clear();
+    m_version.clear();
+    m_seed = 0;
+
+    std::string line;
+    uint32_t line_number = 0;
+    while( std::getline( is, line ) ) {
+      line_number += 1;
+      const std::string::size_type comment = line.find( '#' );
+      if( comment != std::string::npos ) {
+        line.erase( comment );
+      }
+      std::istringstream words( line );
+      std::string key;
+      if( !( words >> key ) ) {
+        continue; // Blank.
+      }
+      std::vector<std::string> values;
+      std::string value;
+      while( words >> value ) {
+        values.push_back( value );
+      }
+      const std::string where = source_name + ", line " + boost::lexical_cast<std::string>( line_number ) + ": ";
+      if( values.empty() ) {
+        throw where + "'" + key + "' needs a value";
+      }
+      if( ( key == "workload" ) || ( key == "version" ) || ( key == "seed" ) || ( key == "dataset" ) ) {
+        if( values.size() != 1 ) {
+          throw where + "'" + key + "' takes exactly one value";
+        }
+        if( key == "workload" ) {
+          m_name = values[ 0 ];
+        } else if( key == "version" ) {
+          m_version = values[ 0 ];
+        } else if( key == "seed" ) {
+          try {
+            m_seed = boost::lexical_cast<uint64_t>( values[ 0 ] );
+          } catch( boost::bad_lexical_cast & ) {
+            throw where + "the seed must be an unsigned integer";
+          }
+        } else {
+          m_datasets.push_back( Dataset() );
+          m_datasets.back().m_name = values[ 0 ];
+          m_datasets.back().m_settings = defaults;
+        }
+      } else if( WorkloadSetting::isSetting( key ) ) {
+        if( m_datasets.empty() ) {
+          defaults[ key ] = values;
+        } else {
+          m_datasets.back().m_settings[ key ] = values;
+        }
+      } else {
+        throw where + "unknown key '" + key + "'";
+      }
+    } // End foreach line
+    if( m_name.empty() || m_version.empty() ) {
+      throw source_name + ": the spec must give a workload name and version";
+    }
+    if( m_datasets.empty() ) {
+      throw source_name + ": the spec must have at least one dataset";
+    }
+  } // fromStream( istream &, string const & )
+
+  /**
+   * Expand the datasets' sweeps into instances, in spec order.
+   */
+  void
+  expand (
+    std::vector<Instance> & instances
+  ) const
+  {
+    instances.clear();
+    for( size_t dataset_i = 0; dataset_i < m_datasets.size(); dataset_i++ ) {
+      Dataset const & dataset = m_datasets[ dataset_i ];
+      std::vector<uint32_t> choices( WorkloadSetting::Count, 0 );
+      while( true ) {
+        Instance instance;
+        instance.m_name = dataset.m_name;
+        for( uint32_t setting_i = 0; setting_i < WorkloadSetting::Count; setting_i++ ) {
+          std::vector<std::string> const & values =
+            dataset.m_settings.find( WorkloadSetting::Names[ setting_i ] )->second;
+          instance.m_settings[ WorkloadSetting::Names[ setting_i ] ] = values[ choices[ setting_i ] ];
+          if( values.size() > 1 ) {
+            std::string value = values[ choices[ setting_i ] ];
+            std::replace( value.begin(), value.end(), ':', '-' ); // For file names.
+            std::replace( value.begin(), value.end(), ',', '-' );
+            instance.m_name += std::string( "_" ) + WorkloadSetting::Names[ setting_i ] + "-" + value;
+          }
+        }
+        instances.push_back( instance );
+
+        // Next combination (last setting varies fastest).
+        int setting_i = WorkloadSetting::Count - 1;
+        for( ; setting_i >= 0; setting_i-- ) {
+          const size_t value_count = dataset.m_settings.find( WorkloadSetting::Names[ setting_i ] )->second.size();
+          if( ++choices[ setting_i ] < value_count ) {
+            break;
+          }
+          choices[ setting_i ] = 0;
+        }
+        if( setting_i < 0 ) {
+          break;
+        }
+      } // End foreach combination
+    } // End foreach dataset_i
+    for( size_t instance_i = 0; instance_i < instances.size(); instance_i++ ) {
+      for( size_t other_i = 0; other_i < instance_i; other_i++ ) {
+        if( instances[ other_i ].m_name == instances[ instance_i ].m_name ) {
+          throw std::string( "The workload has two datasets named '" ) + instances[ instance_i ].m_name + "'";
+        }
+      }
+    }
+  } // expand( vector<Instance> & ) const
+
+}; // End class WorkloadSpec
+
+} // End namespace galosh
+
+#endif // __GALOSH_WORKLOADSPEC_HPP__
@@ -0,0 +1,270 @@
+/*---------------------------------------------------------------------------##
+##  Library:
+##      galosh::profuse
+##  File:
+##      libprofuse.h
+##  Author:
+##      D'Oleris Paul Thatcher Edlefsen   paul@galosh.org
+##  Description:
+##      The C API of libprofuse, for using profuse from other programs (in C,
+##      C++, or anything with a C foreign function interface) without
+##      running the command-line tools.  Profiles are loaded once and then
+##      used to score and align sequences, and to accumulate alignment
+##      profiles (expected counts), all in memory: sequences are passed in as
+##      caller-owned character buffers, and results come back in arrays.
+##
+##      The library is built once per alphabet (libprofuse_AA for amino acid
+##      profiles and libprofuse_DNA for nucleotide profiles), with the same
+##      API; profuse_alphabet() says which one was linked.
+##
+##      Every function that can fail returns a profuse_status, and on failure
+##      profuse_last_error() describes what went wrong.  No C++ exception
+##      ever escapes the library.  Profiles are immutable once loaded, so one
+##      profile may be used from many threads at once; an alignment profile
+##      accumulator may only be used from one thread at a time.
+##
+#******************************************************************************
+#*
+#*    This file is part of profuse, a suite of programs for working with
+#*    Profile HMMs.  Please see the document CITING, which should have been
+#*    included with this file.  You may use at will, subject to the license
+#*    (Apache v2.0), but *please cite the relevant papers* in your documentation
+#*    and publications associated with uses of this library.  Thank you!
+#*
+#*    Copyright (C) 2016 by Paul T. Edlefsen, Fred Hutchinson Cancer
+#*    Research Center.
+#*
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+#*****************************************************************************/
+
+#ifndef __PROFUSE_LIBPROFUSE_H__
+#define __PROFUSE_LIBPROFUSE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined( __GNUC__ )
+#define PROFUSE_API __attribute__(( visibility( "default" ) ))
+#else
+#define PROFUSE_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Bumped whenever the API changes incompatibly.
+ */
+#define PROFUSE_API_VERSION 1
+
+typedef enum profuse_status {
+  PROFUSE_OK = 0,
+  PROFUSE_INVALID_ARGUMENT = 1, /* eg. a NULL pointer where one isn't allowed */
+  PROFUSE_BAD_PROFILE = 2,      /* the profile could not be read */
+  PROFUSE_FAILED = 3            /* anything else */
+} profuse_status;
+
+/**
+ * The states of an alignment path (the same as the state codes N, M, I, D
+ * and C of the command-line tools).  Match and Deletion states advance the
+ * profile position; all but Deletion emit a residue.
+ */
+typedef enum profuse_state {
+  PROFUSE_STATE_PREALIGN = 0,
+  PROFUSE_STATE_MATCH = 1,
+  PROFUSE_STATE_INSERTION = 2,
+  PROFUSE_STATE_DELETION = 3,
+  PROFUSE_STATE_POSTALIGN = 4
+} profuse_state;
+
+/**
+ * The transitions of a profile, indexing the transition counts of an
+ * alignment profile.
+ */
+typedef enum profuse_transition {
+  PROFUSE_PREALIGN_TO_PREALIGN = 0,
+  PROFUSE_PREALIGN_TO_BEGIN,
+  PROFUSE_BEGIN_TO_MATCH,
+  PROFUSE_BEGIN_TO_DELETION,
+  PROFUSE_MATCH_TO_MATCH,
+  PROFUSE_MATCH_TO_INSERTION,
+  PROFUSE_MATCH_TO_DELETION,
+  PROFUSE_INSERTION_TO_MATCH,
+  PROFUSE_INSERTION_TO_INSERTION,
+  PROFUSE_DELETION_TO_MATCH,
+  PROFUSE_DELETION_TO_DELETION,
+  PROFUSE_POSTALIGN_TO_POSTALIGN,
+  PROFUSE_POSTALIGN_TO_TERMINAL,
+  PROFUSE_TRANSITION_COUNT
+} profuse_transition;
+
+typedef enum profuse_method {
+  PROFUSE_VITERBI = 0,  /* the single most likely path */
+  PROFUSE_POSTERIOR = 1 /* forward-backward: the sequence's total probability, the maximum expected accuracy path, and expected counts */
+} profuse_method;
+
+/**
+ * A sequence: length residue characters (which need not be
+ * null-terminated), in the alphabet of the sequences (eg. IUPAC codes for
+ * DNA); characters outside it are treated as the unknown residue.
+ */
+typedef struct profuse_sequence {
+  const char * residues;
+  size_t length;
+} profuse_sequence;
+
+typedef struct profuse_profile profuse_profile;
+
+/**
+ * The alignment of one sequence to a profile.
+ */
+typedef struct profuse_alignment {
+  /* With PROFUSE_VITERBI, the natural log of the probability of the path;
+   * with PROFUSE_POSTERIOR, that of the sequence.  -HUGE_VAL if the profile
+   * can't generate the sequence, in which case the path is empty. */
+  double log_probability;
+  /* With PROFUSE_POSTERIOR, the sum of the posterior probabilities of the
+   * path's states (the expected number of correctly aligned residues);
+   * otherwise 0. */
+  double expected_accuracy;
+  size_t path_length;
+  const uint8_t * path; /* path_length profuse_states */
+  /* With PROFUSE_POSTERIOR, if asked for, the posterior probability of each
+   * residue's state on the path, times 255; otherwise NULL. */
+  const uint8_t * confidences;
+} profuse_alignment;
+
+typedef struct profuse_alignments profuse_alignments;
+
+typedef struct profuse_alignment_profile profuse_alignment_profile;
+
+/**
+ * PROFUSE_API_VERSION, as the library was built.
+ */
+PROFUSE_API uint32_t profuse_api_version( void );
+
+/**
+ * The residues of the profiles' alphabet, in the order in which they index
+ * the emission counts (eg. "ACGT").
+ */
+PROFUSE_API const char * profuse_alphabet( void );
+
+/**
+ * A description of the last error on the calling thread, or "" if there
+ * was none.  Valid until the next call into the library on this thread.
+ */
+PROFUSE_API const char * profuse_last_error( void );
+
+/**
+ * Load a profile from a profile file (as written by the command-line
+ * tools).
+ */
+PROFUSE_API profuse_status profuse_profile_read_file( const char * filename, profuse_profile ** profile );
+
+/**
+ * Load a profile from the size bytes of text of a profile file.
+ */
+PROFUSE_API profuse_status profuse_profile_read_text( const char * text, size_t size, profuse_profile ** profile );
+
+/**
+ * Load a profile from a boost binary archive of it, such as a record of a
+ * ProfileTree container (see profileTreeToProfile --container).
+ */
+PROFUSE_API profuse_status profuse_profile_read_archive( const void * bytes, size_t size, profuse_profile ** profile );
+
+PROFUSE_API void profuse_profile_free( profuse_profile * profile );
+
+/**
+ * The number of positions of the profile.
+ */
+PROFUSE_API uint32_t profuse_profile_length( const profuse_profile * profile );
+
+/**
+ * Put the natural log of the probability of each of the count sequences
+ * (PROFUSE_POSTERIOR: forward) or of its Viterbi path (PROFUSE_VITERBI)
+ * into log_probabilities[ 0 .. count - 1 ] (-HUGE_VAL where it is 0).  Uses
+ * thread_count threads (0 means one per core); the results don't depend on
+ * it.
+ */
+PROFUSE_API profuse_status profuse_score( const profuse_profile * profile, const profuse_sequence * sequences, size_t count, profuse_method method, uint32_t thread_count, double * log_probabilities );
+
+/**
+ * Align each of the count sequences to the profile, by its Viterbi path or
+ * (PROFUSE_POSTERIOR) its maximum expected accuracy path, and, if
+ * with_confidences is nonzero (PROFUSE_POSTERIOR only), the posterior of
+ * each aligned residue.  The dp rows are checkpointed every
+ * checkpoint_interval rows (0 means the square root of each sequence's
+ * length).  Free the result with profuse_alignments_free(..).
+ */
+PROFUSE_API profuse_status profuse_align( const profuse_profile * profile, const profuse_sequence * sequences, size_t count, profuse_method method, int with_confidences, uint32_t thread_count, uint32_t checkpoint_interval, profuse_alignments ** alignments );
+
+PROFUSE_API size_t profuse_alignments_count( const profuse_alignments * alignments );
+
+/**
+ * The alignment of sequence seq_i; valid until the alignments are freed.
+ */
+PROFUSE_API const profuse_alignment * profuse_alignments_get( const profuse_alignments * alignments, size_t seq_i );
+
+PROFUSE_API void profuse_alignments_free( profuse_alignments * alignments );
+
+/**
+ * Make an empty (all-zero) alignment profile for the given profile.  The
+ * profile must outlive it.
+ */
+PROFUSE_API profuse_status profuse_alignment_profile_create( const profuse_profile * profile, profuse_alignment_profile ** alignment_profile );
+
+/**
+ * Add the counts of the states and transitions used by each of the count
+ * sequences, times its weight (weights may be NULL, meaning 1 for every
+ * sequence): their posterior expected counts (PROFUSE_POSTERIOR) or the
+ * hard counts of their Viterbi paths (PROFUSE_VITERBI).  If
+ * log_probabilities isn't NULL, each sequence's natural log probability (as
+ * in profuse_score(..)) is put there.  The emission count of an ambiguous
+ * residue (eg. N, or X) is spread over the residues it stands for, in
+ * proportion to their probabilities in the emitting state.  Fails, adding
+ * nothing, if any of the sequences is impossible given the profile.  The
+ * counts don't depend on thread_count.
+ */
+PROFUSE_API profuse_status profuse_alignment_profile_add( profuse_alignment_profile * alignment_profile, const profuse_sequence * sequences, size_t count, const double * weights, profuse_method method, uint32_t thread_count, uint32_t checkpoint_interval, double * log_probabilities );
+
+PROFUSE_API void profuse_alignment_profile_free( profuse_alignment_profile * alignment_profile );
+
+/**
+ * Set all of the counts back to 0.
+ */
+PROFUSE_API void profuse_alignment_profile_zero( profuse_alignment_profile * alignment_profile );
+
+/**
+ * The match emission counts, at [ ( pos * alphabet size ) + residue ] for
+ * positions 1 .. profile length (position 0 is all 0).
+ */
+PROFUSE_API const double * profuse_alignment_profile_match_emissions( const profuse_alignment_profile * alignment_profile );
+
+/**
+ * The insertion emission counts, at [ ( pos * alphabet size ) + residue ]
+ * for positions 0 (PreAlign) .. profile length (PostAlign).
+ */
+PROFUSE_API const double * profuse_alignment_profile_insertion_emissions( const profuse_alignment_profile * alignment_profile );
+
+/**
+ * The transition counts, at [ ( pos * PROFUSE_TRANSITION_COUNT ) +
+ * transition ] for positions 0 .. profile length.
+ */
+PROFUSE_API const double * profuse_alignment_profile_transitions( const profuse_alignment_profile * alignment_profile );
+
+#ifdef __cplusplus
+} // End extern "C"
+#endif
+
+#endif // __PROFUSE_LIBPROFUSE_H__
@@ -41,7 +41,37 @@
  * -i [ --individual ]           output individual alignment profiles instead of
  *                               combined
  * -n [ --nseq ] arg             number of sequences to use (default is ALL)
- * -v [ --viterbi ]              use viterbi algorithm
+ * -C [ --container ] arg        write the individual alignment profiles to this
+ *                               single indexed container file instead of one
+ *                               file per sequence (implies --individual)
+ * -u [ --incremental ]          update the running sum saved alongside the
+ *                               output with just these sequences, instead of
+ *                               recomputing the combined alignment profile
+ * -r [ --remove ]               with --incremental, subtract these sequences'
+ *                               contributions instead of adding them
+ * -S [ --state ] arg            filename prefix of the incremental state
+ *                               (default: output prefix + ".state")
+ * -k [ --checkpointed ]         compute the posteriors with a checkpointed
+ *                               forward-backward that uses memory proportional
+ *                               to the square root of the sequence length
+ * --checkpoint-interval arg     with --checkpointed, keep every arg-th forward
+ *                               row (default: the square root of the sequence
+ *                               length)
+ * --verify [=arg(=1e-06)]       with --checkpointed, also compute the alignment
+ *                               profiles with the full dp matrices
+ *                               (calculateAlignmentProfiles), and fail if any
+ *                               count differs by more than arg (relative)
+ * -v [ --viterbi ]              count the states and transitions of each
+ *                               sequence's Viterbi path (hard counts) instead
+ *                               of their posterior expectations; much faster
+ * --isa arg (=auto)             with --checkpointed or --viterbi, the
+ *                               instruction set of the dp kernels: auto (the
+ *                               best that this CPU supports), scalar, sse4.2,
+ *                               avx2, or avx512
+ * --precision arg (=bfloat)     without --checkpointed or --viterbi, the dp
+ *                               matrix values: bfloat (can't underflow),
+ *                               double, or float (fastest, with the rows
+ *                               scaled; enough for short sequences)
  * </pre>
  *
  */
@@ -51,7 +81,12 @@
 #include <boost/lexical_cast.hpp>
 #include <boost/filesystem.hpp>
 
+#include <sstream>
+
 #include "GenAlignmentProfiles.hpp"
+#include "Precision.hpp"
+#include "IndividualFilenames.hpp"
+#include "RecordContainer.hpp"
 
 #ifdef __HAVE_MUSCLE
 int g_argc;
@@ -60,8 +95,102 @@ char **g_argv;
 
 using namespace galosh;
 
-// forward decls
-string escape_path ( const string & unescaped_path );
+/**
+ * Generates the alignment profiles and writes them out, with the numeric
+ * types chosen by dispatchPrecision(..).
+ */
+template <typename ResidueType,
+          typename SequenceResidueType>
+class AlignmentProfileRunner {
+public:
+  typedef int result_type;
+
+  AlignmentProfileRunner (
+    po::variables_map const & options
+  ) :
+    m_options( options )
+  {
+    // Do nothing else.
+  } // <init>( po::variables_map const & )
+
+  template <typename ProbabilityType,
+            typename ScoreType,
+            typename MatrixValueType>
+  int
+  run () const
+  {
+    typename DynamicProgramming<ResidueType, ProbabilityType, ScoreType, MatrixValueType>::Parameters params;
+    params.m_galosh_options_map = m_options;
+    const bool use_container = ( params.m_galosh_options_map ).count( "container" ) > 0;
+    const bool indiv_profiles = ( params.m_galosh_options_map ).count( "individual" ) > 0;
+
+    GenAlignmentProfiles<ProbabilityType, ScoreType, MatrixValueType, ResidueType, SequenceResidueType> genAlignProf;
+    std::vector<typename DynamicProgramming<ResidueType, ProbabilityType, ScoreType, MatrixValueType>::AlignmentProfile> alignment_profiles;
+    alignment_profiles = genAlignProf.gen_alignment_profiles( params );
+
+    const std::string output_filename_prefix = ( params.m_galosh_options_map )[ "alignment_profiles_prefix" ].template as<string>();
+    const std::string individual_filename_suffix_pattern = ( params.m_galosh_options_map )[ "individual-filename-suffix-pattern" ].template as<string>();
+
+    if( use_container ) {
+      /// Output the results, sequentially, to one indexed container.  Each
+      /// record holds exactly what would have been written to that sequence's
+      /// individual file, so extractAlignmentProfiles can recreate them.
+      const std::string container_filename = ( params.m_galosh_options_map )[ "container" ].template as<string>();
+      RecordContainerWriter container( container_filename, "AlignmentProfile" );
+      for( int i = 0; i < alignment_profiles.size(); i++ )
+      {
+        std::ostringstream record_stream;
+        record_stream << alignment_profiles[ i ];
+        container.add( alignment_profiles[ i ].m_comment, i, record_stream.str() );
+      }
+      container.close();
+      // We print out the output file as a side effect
+      cout << container_filename << endl;
+      return 0; // success
+    } // End if use_container
+
+    std::string individual_output_filename = output_filename_prefix;
+    if( indiv_profiles ) {
+      individual_output_filename += individual_filename_suffix_pattern;
+    } 
+    string const * output_filename_ptr = &individual_output_filename;
+
+    /// Output the results
+    if( ( output_filename_ptr == NULL ) ) { //|| ( output_filename.compare( "" ) == 0 ) || ( output_filename.compare( "-" ) == 0 ) ) {
+      for( int i = 0; i < alignment_profiles.size(); i++ )
+      {
+        if( alignment_profiles.size() > 1 ) {
+          std:cout << "#" << alignment_profiles[ i ].m_comment << std::endl;
+        }
+        std::cout << alignment_profiles[ i ];
+      }  
+    } else {
+      for( int i = 0; i < alignment_profiles.size(); i++ )
+      {
+        if( indiv_profiles ) {
+          individual_output_filename =
+            individual_filename( output_filename_prefix, individual_filename_suffix_pattern, alignment_profiles[ i ].m_comment, i );
+          output_filename_ptr = &individual_output_filename;
+        }
+      std::ofstream fs ( output_filename_ptr->c_str() );
+      if( !fs.is_open() ) {
+        // TODO: ?
+        cerr << "The alignment profiles output file '" << *output_filename_ptr << "' could not be opened." << endl;
+      } else {
+          fs << alignment_profiles[ i ];
+          fs.close();
+          // We print out the output files as a side effect
+          cout << *output_filename_ptr << endl;
+        }  
+      } // End foreach alignment_profile i
+    } // End if profile_output_filename_ptr != NULL
+    
+    return 0; // success
+  } // run() const
+
+protected:
+  po::variables_map const & m_options;
+}; // End class AlignmentProfileRunner
 
 /**
  * \fn int main(int const argc, char ** argv)
@@ -71,6 +200,8 @@ string escape_path ( const string & unescaped_path );
 int
 main ( int const argc, char ** argv )
 {
+  // The options of the DynamicProgramming Parameters are the same for every
+  // precision; these types are just for parsing them.
   typedef doublerealspace ProbabilityType;
   typedef bfloat ScoreType;
   typedef bfloat MatrixValueType;
@@ -115,11 +246,35 @@ main ( int const argc, char ** argv )
       ("individual-filename-suffix-pattern,s",
        po::value<string>()->default_value(  "_$n.aprof" ),
        "pattern for filenames by which to differentiate output individual alignment profiles, in which $n will be replaced by the sequence name (possibly modified to be a valid filename) and $d with be replaced by the sequence number (default: '_$n.aprof'")
+      ("container,C",
+       po::value<string>(),
+       "filename: write the individual alignment profiles into this single indexed container file (see extractAlignmentProfiles) instead of one file per sequence; implies --individual")
+      ("incremental,u",
+       "update the combined alignment profile incrementally: add the contributions of just the given sequences to the unscaled running sum and sequence count saved (in <state>.aprof and <state>.nseq) by a previous run, and save the result")
+      ("remove,r",
+       "with --incremental, subtract the contributions of the given sequences from the saved state instead of adding them")
+      ("state,S",
+       po::value<string>(),
+       "filename prefix of the incremental state files (default: the output prefix followed by '.state')")
       ("nseq,n",
        po::value<int>(),
        "number of sequences to use (default is ALL)")
-      ("viterbi,v", // todo: remove this.  it's just for debugging.
-       "use viterbi algorithm")
+      ("checkpointed,k",
+       "compute the posterior alignment profiles with a checkpointed forward-backward, which keeps only some of the forward rows and recomputes the others during the backward pass; the results are the same, but memory use is proportional to the square root of the sequence length instead of to the sequence length")
+      ("checkpoint-interval",
+       po::value<uint32_t>(),
+       "with --checkpointed, keep every this-many-th forward row (default: the square root of the sequence length; larger uses more memory and less recomputation)")
+      ("verify",
+       po::value<double>()->implicit_value( 1E-6 ),
+       "with --checkpointed, also compute the alignment profiles with the full dp matrices (calculateAlignmentProfiles, as without --checkpointed), and fail if any count differs by more than this (relative, for counts of more than 1)")
+      ("viterbi,v",
+       "count the states and transitions of each sequence's Viterbi path (hard counts) instead of their posterior expectations; much faster, and uses memory proportional to the square root of the sequence length")
+      ("isa",
+       po::value<string>()->default_value( "auto" ),
+       "with --checkpointed or --viterbi, the instruction set of the dp kernels: auto (the default: the best that this CPU supports), scalar, sse4.2, avx2, or avx512; the results don't depend on it")
+      ("precision",
+       po::value<string>()->default_value( "bfloat" ),
+       "without --checkpointed or --viterbi, the dp matrix values: bfloat (the default; can't underflow), double, or float (fastest, with the rows scaled; enough for short sequences)")
       ;
 
 
@@ -206,57 +361,17 @@ main ( int const argc, char ** argv )
     //    }
 
     /// Do the work
-    const bool indiv_profiles = ( params.m_galosh_options_map ).count( "individual" ) > 0;
-    
-    GenAlignmentProfiles<ProbabilityType, ScoreType, MatrixValueType, ResidueType, SequenceResidueType> genAlignProf;
-    std::vector<DynamicProgramming<ResidueType, ProbabilityType, ScoreType, MatrixValueType>::AlignmentProfile> alignment_profiles;
-    alignment_profiles = genAlignProf.gen_alignment_profiles( params );
-
-    const std::string output_filename_prefix = ( params.m_galosh_options_map )[ "alignment_profiles_prefix" ].template as<string>();
-    const std::string individual_filename_suffix_pattern = ( params.m_galosh_options_map )[ "individual-filename-suffix-pattern" ].template as<string>();
-
-    std::string individual_output_filename = output_filename_prefix;
-    if( indiv_profiles ) {
-      individual_output_filename += individual_filename_suffix_pattern;
-    } 
-    string const * output_filename_ptr = &individual_output_filename;
+    const bool use_container = ( params.m_galosh_options_map ).count( "container" ) > 0;
+    if( use_container && ( ( params.m_galosh_options_map ).count( "individual" ) == 0 ) ) {
+      // The container holds individual alignment profiles.
+      params.m_galosh_options_map.insert( std::make_pair( "individual", po::variable_value( string( "" ), false ) ) );
+    }
 
-    /// Output the results
-    if( ( output_filename_ptr == NULL ) ) { //|| ( output_filename.compare( "" ) == 0 ) || ( output_filename.compare( "-" ) == 0 ) ) {
-      for( int i = 0; i < alignment_profiles.size(); i++ )
-      {
-        if( alignment_profiles.size() > 1 ) {
-          std:cout << "#" << alignment_profiles[ i ].m_comment << std::endl;
-        }
-        std::cout << alignment_profiles[ i ];
-      }  
-    } else {
-      for( int i = 0; i < alignment_profiles.size(); i++ )
-      {
-        if( indiv_profiles ) {
-          individual_output_filename = output_filename_prefix + individual_filename_suffix_pattern;
-          if( alignment_profiles[ i ].m_comment.length() > 0 ) {
-            boost::replace_all( individual_output_filename, "$n", escape_path( alignment_profiles[ i ].m_comment ) );
-          } else {
-            boost::replace_all( individual_output_filename, "$n", boost::lexical_cast<std::string>( i ) );
-          }
-          boost::replace_all( individual_output_filename, "$d", boost::lexical_cast<std::string>( i ) );
-          output_filename_ptr = &individual_output_filename;
-        }
-      std::ofstream fs ( output_filename_ptr->c_str() );
-      if( !fs.is_open() ) {
-        // TODO: ?
-        cerr << "The alignment profiles output file '" << *output_filename_ptr << "' could not be opened." << endl;
-      } else {
-          fs << alignment_profiles[ i ];
-          fs.close();
-          // We print out the output files as a side effect
-          cout << *output_filename_ptr << endl;
-        }  
-      } // End foreach alignment_profile i
-    } // End if profile_output_filename_ptr != NULL
-    
-    return 0; // success
+    return
+      dispatchPrecision(
+        parsePrecision( ( params.m_galosh_options_map )[ "precision" ].as<string>() ),
+        AlignmentProfileRunner<ResidueType, SequenceResidueType>( params.m_galosh_options_map )
+      );
   } catch( std::exception& e ) { /// exceptions thrown by boost stuff
     cerr << "error: " << e.what() << endl;
     return 1;
@@ -269,17 +384,3 @@ main ( int const argc, char ** argv )
   }
     
 } // main (..)
-
-string escape_path ( const string & unescaped_path )
-{
-  std::string escaped_path_str( unescaped_path );
-  boost::replace_all( escaped_path_str, "|", "-x-BAR-x-" );
-  boost::replace_all( escaped_path_str, "/", "-x-SLASH-x-" );
-  boost::replace_all( escaped_path_str, "\\", "-x-BACKSLASH-x-" );
-  boost::replace_all( escaped_path_str, "..", "-x-DOTDOT-x-" );
-  boost::replace_all( escaped_path_str, ".", "-x-DOT-x-" );
-  boost::filesystem::path escaped_path( escaped_path_str );
-  // TODO: REMOVE
-  //cout << "escape_path( " << unescaped_path << " ): " << escaped_path.native() << endl;
-  return( escaped_path.native() );
-} // escape_path ( const string & )